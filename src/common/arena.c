@@ -0,0 +1,218 @@
+/*
+ * arena.c
+ *
+ * This file is part of the navdtools source code.
+ *
+ * (C) Copyright 2014-2016 Timothy D. Walker and others.
+ *
+ * All rights reserved. This program and the accompanying materials are made
+ * available under the terms of the GNU General Public License (GPL) version 2
+ * which accompanies this distribution (LICENSE file), and is also available at
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * Contributors:
+ *     Timothy D. Walker
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compat/compat.h"
+
+#include "arena.h"
+
+#define NDT_ARENA_GRAIN (16)                            // size class granularity
+#define NDT_ARENA_SMALL (4096)                          // larger: standalone blocks
+#define NDT_ARENA_CLASS (NDT_ARENA_SMALL / NDT_ARENA_GRAIN)
+#define NDT_ARENA_CHUNK (64 * 1024)                     // new chunk size (bytes)
+
+typedef struct arena_block
+{
+    struct arena_block *prev;
+    struct arena_block *next;
+    size_t              size;
+    size_t              pad;                            // keep payload 16-byte aligned
+} arena_block;
+
+typedef struct arena_slot
+{
+    struct arena_slot *next;
+} arena_slot;
+
+struct ndt_arena
+{
+    arena_block *chunks;                                // slots are cut from those
+    arena_block *blocks;                                // large standalone objects
+    char        *bump;                                  // unused space in chunks
+    size_t       left;
+    size_t       size;                                  // total memory allocated
+    arena_slot  *free[NDT_ARENA_CLASS];                 // per-class freed slots
+};
+
+static size_t arena_class(size_t size)
+{
+    return size ? (size - 1) / NDT_ARENA_GRAIN : 0;
+}
+
+ndt_arena* ndt_arena_init()
+{
+    return calloc(1, sizeof(ndt_arena));
+}
+
+void ndt_arena_close(ndt_arena **_arena)
+{
+    if (_arena && *_arena)
+    {
+        ndt_arena *arena = *_arena;
+
+        while (arena->chunks)
+        {
+            arena_block *next = arena->chunks->next;
+            free(arena->chunks);
+            arena->chunks = next;
+        }
+        while (arena->blocks)
+        {
+            arena_block *next = arena->blocks->next;
+            free(arena->blocks);
+            arena->blocks = next;
+        }
+
+        free(arena);
+
+        *_arena = NULL;
+    }
+}
+
+void* ndt_arena_alloc(ndt_arena *arena, size_t size)
+{
+    if (!arena)
+    {
+        return calloc(1, size);
+    }
+
+    if (size > NDT_ARENA_SMALL)
+    {
+        arena_block *block = calloc(1, sizeof(arena_block) + size);
+        if (!block)
+        {
+            return NULL;
+        }
+        if ((block->next = arena->blocks))
+        {
+            block->next->prev = block;
+        }
+        arena->blocks = block;
+        block->size   = size;
+        arena->size  += size;
+        return block + 1;
+    }
+
+    size_t      class = arena_class(size);
+    arena_slot *slot  = arena->free[class];
+    if (slot)
+    {
+        arena->free[class] = slot->next;
+        memset(slot, 0, (class + 1) * NDT_ARENA_GRAIN);
+        return slot;
+    }
+
+    size_t slotsize = (class + 1) * NDT_ARENA_GRAIN;
+    if (arena->left < slotsize)
+    {
+        /*
+         * Whatever's left in the current chunk is too small for this object;
+         * it stays unused (less than NDT_ARENA_SMALL per chunk, at most).
+         */
+        arena_block *chunk = malloc(sizeof(arena_block) + NDT_ARENA_CHUNK);
+        if (!chunk)
+        {
+            return NULL;
+        }
+        chunk->prev   = NULL;
+        chunk->next   = arena->chunks;
+        chunk->size   = NDT_ARENA_CHUNK;
+        arena->chunks = chunk;
+        arena->bump   = (char*)(chunk + 1);
+        arena->left   = NDT_ARENA_CHUNK;
+        arena->size  += NDT_ARENA_CHUNK;
+    }
+    void *ptr    = arena->bump;
+    arena->bump += slotsize;
+    arena->left -= slotsize;
+    return memset(ptr, 0, slotsize);
+}
+
+void* ndt_arena_realloc(ndt_arena *arena, void *ptr, size_t oldsize, size_t newsize)
+{
+    if (!arena)
+    {
+        return realloc(ptr, newsize);
+    }
+    if (!ptr)
+    {
+        return ndt_arena_alloc(arena, newsize);
+    }
+    if (oldsize <= NDT_ARENA_SMALL && newsize <= NDT_ARENA_SMALL &&
+        arena_class(oldsize) == arena_class(newsize))
+    {
+        return ptr; // slot is large enough already
+    }
+
+    void *new = ndt_arena_alloc(arena, newsize);
+    if (!new)
+    {
+        return NULL;
+    }
+    memcpy(new, ptr, oldsize < newsize ? oldsize : newsize);
+    ndt_arena_free(arena, ptr, oldsize);
+    return new;
+}
+
+void ndt_arena_free(ndt_arena *arena, void *ptr, size_t size)
+{
+    if (!arena)
+    {
+        free(ptr);
+        return;
+    }
+    if (!ptr)
+    {
+        return;
+    }
+
+    if (size > NDT_ARENA_SMALL)
+    {
+        arena_block *block = (arena_block*)ptr - 1;
+        if (block->prev)
+        {
+            block->prev->next = block->next;
+        }
+        else
+        {
+            arena->blocks = block->next;
+        }
+        if (block->next)
+        {
+            block->next->prev = block->prev;
+        }
+        arena->size -= block->size;
+        free(block);
+        return;
+    }
+
+    arena_slot *slot   = ptr;
+    size_t      class  = arena_class(size);
+    slot->next         = arena->free[class];
+    arena->free[class] = slot;
+}
+
+size_t ndt_arena_size(ndt_arena *arena)
+{
+    return arena ? arena->size : 0;
+}
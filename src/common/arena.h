@@ -0,0 +1,45 @@
+/*
+ * arena.h
+ *
+ * This file is part of the navdtools source code.
+ *
+ * (C) Copyright 2014-2016 Timothy D. Walker and others.
+ *
+ * All rights reserved. This program and the accompanying materials are made
+ * available under the terms of the GNU General Public License (GPL) version 2
+ * which accompanies this distribution (LICENSE file), and is also available at
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * Contributors:
+ *     Timothy D. Walker
+ */
+
+#ifndef NDT_ARENA_H
+#define NDT_ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Pool allocator for groups of objects sharing the same lifetime (e.g. all of
+ * a flight plan's route segments, legs and custom waypoints): objects are cut
+ * from large chunks, freed objects' slots are reused for new objects of a
+ * similar size, and closing the arena releases everything it ever allocated.
+ *
+ * A NULL arena is valid everywhere, and means regular heap allocation.
+ *
+ * Arenas aren't thread-safe: each thread should use its own arena(s).
+ */
+typedef struct ndt_arena ndt_arena;
+
+ndt_arena* ndt_arena_init   (                                                           );
+void       ndt_arena_close  (ndt_arena **_arena                                         );
+void*      ndt_arena_alloc  (ndt_arena   *arena,                         size_t    size);
+void*      ndt_arena_realloc(ndt_arena   *arena, void *ptr, size_t oldsz, size_t newsize);
+void       ndt_arena_free   (ndt_arena   *arena, void *ptr, size_t size                 );
+size_t     ndt_arena_size   (ndt_arena   *arena                                         );
+
+#endif /* NDT_ARENA_H */
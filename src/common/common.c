@@ -127,7 +127,7 @@ char* ndt_file_slurp(const char *name, int *p)
         goto end;
     }
 
-    if (file[len-1] != '\n')
+    if (!len || file[len-1] != '\n')
     {
         file[len++]  = '\n';
     }
@@ -140,7 +140,7 @@ end:
         file = NULL;
     }
     if (p) *p = ret;
-    fclose(fdes);
+    if (fdes) fclose(fdes);
     return file;
 }
 
@@ -427,6 +427,32 @@ ndt_position ndt_position_init(double lat, double lon, ndt_distance alt)
     return position;
 }
 
+ndt_latlon ndt_position_pack(ndt_position pos)
+{
+    ndt_latlon latlon;
+
+    latlon.latitude  = pos.latitude. equator  * pos.latitude. value;
+    latlon.longitude = pos.longitude.meridian * pos.longitude.value;
+
+    return latlon;
+}
+
+ndt_position ndt_position_unpack(ndt_latlon latlon, ndt_distance alt)
+{
+    ndt_position position;
+
+    position.latitude. equator  = (latlon.latitude  >= 0 ? 1 : -1);
+    position.latitude. value    = (latlon.latitude  * position.latitude. equator);
+    position.longitude.meridian = (latlon.longitude >= 0 ? 1 : -1);
+    position.longitude.value    = (latlon.longitude * position.longitude.meridian);
+
+    position.altitude     = alt;
+    position.precision[0] = ndt_distance_init(1, NDT_ALTUNIT_FT);
+    position.precision[1] = ndt_distance_init(1, NDT_ALTUNIT_FT);
+
+    return position;
+}
+
 double ndt_position_getlatitude(ndt_position pos, ndt_angle_unit aut)
 {
     if (aut == NDT_ANGUNIT_RAD)
@@ -551,6 +577,78 @@ ndt_distance ndt_position_calcdistance(ndt_position from, ndt_position to)
     return ndt_distance_init(EARTHRAD * dis2, NDT_ALTUNIT_ME);
 }
 
+/*
+ * Equirectangular approximation (flat Earth, longitude scaled by the cosine of
+ * the mean latitude): a single cos() and a sqrt() instead of haversine's asin.
+ *
+ * Error: with θ the (approximate) angular distance in radians and φ the highest
+ * absolute latitude of either endpoint, the relative error vs. haversine never
+ * exceeds θ² / (8 * cos²(φ)); it's typically 2-3 times smaller. That's under
+ * 0.05% for 100 nautical miles at 60°N, but degrades fast near the poles, so
+ * no bound is provided beyond θ = 0.25 (~850 nm) or 89° of latitude (error is
+ * then set to a negative value and the caller should use haversine instead).
+ *
+ * The reported error also covers calcdistance's truncation to whole meters, so
+ * the bound holds against ndt_position_calcdistance's result, not just the
+ * mathematical great circle distance.
+ */
+ndt_distance ndt_position_calcdistapprx(ndt_position from, ndt_position to, ndt_distance *error)
+{
+    if (!memcmp(&from.latitude,  &to.latitude,  sizeof(to.latitude)) &&
+        !memcmp(&from.longitude, &to.longitude, sizeof(to.longitude)))
+    {
+        if (error) *error = NDT_DISTANCE_ZERO;
+        return NDT_DISTANCE_ZERO;
+    }
+
+    double lat1 = ndt_position_getlatitude (from, NDT_ANGUNIT_RAD);
+    double lon1 = ndt_position_getlongitude(from, NDT_ANGUNIT_RAD);
+    double lat2 = ndt_position_getlatitude (to,   NDT_ANGUNIT_RAD);
+    double lon2 = ndt_position_getlongitude(to,   NDT_ANGUNIT_RAD);
+    double dlon = ndt_mod(lon2 - lon1 + M_PI, 2. * M_PI) - M_PI;
+    double dlat = lat2 - lat1;
+    double xdis = dlon * cos((lat1 + lat2) / 2.);
+    double dis2 = sqrt(xdis * xdis + dlat * dlat);
+
+    if (error)
+    {
+        double cmin = cos(fmax(fabs(lat1), fabs(lat2)));
+        if (dis2 > .25 || cmin < cos(89. * M_PI / 180.))
+        {
+            *error = ndt_distance_init(-1, NDT_ALTUNIT_NA);
+        }
+        else
+        {
+            double rerr = dis2 * dis2 / (8. * cmin * cmin); // relative to exact
+            double aerr = EARTHRAD * dis2 * rerr / (1. - rerr) + 1.;
+            *error      = ndt_distance_init(ceil(aerr * 10000.), NDT_ALTUNIT_NA);
+        }
+    }
+
+    return ndt_distance_init(EARTHRAD * dis2 * 10000., NDT_ALTUNIT_NA);
+}
+
+int ndt_position_calcwithin(ndt_position from, ndt_position to, ndt_distance dist)
+{
+    /*
+     * Equivalent to calcdistance(from, to) < dist, but only
+     * falls back to haversine when we're close to threshold.
+     */
+    ndt_distance error, approx = ndt_position_calcdistapprx(from, to, &error);
+    if (error.value >= 0)
+    {
+        if (approx.value + error.value < dist.value)
+        {
+            return 1;
+        }
+        if (approx.value - error.value > dist.value)
+        {
+            return 0;
+        }
+    }
+    return ndt_position_calcdistance(from, to).value < dist.value;
+}
+
 int ndt_position_calcduration(ndt_position from, ndt_position to, ndt_airspeed at)
 {
     return 0;
@@ -626,7 +724,7 @@ int ndt_position_calcpos4pbpb(ndt_position *out, ndt_position pos1, double tru1,
     double ang2 = fabs (a2a3);
     double ang3 = acos (cos(ang1) * cos(ang2) * -1.    +    sin(ang1) * sin(ang2) * cos(dis2));
     double dis3 = atan2(sin(dis2) * sin(ang1) * sin(ang2),  cos(ang2) + cos(ang1) * cos(ang3));
-    double lat3 = asin (sin(lat1) * cos(dis2) + cos(lat1) * sin(dis3) * cos(cr13));
+    double lat3 = asin (sin(lat1) * cos(dis3) + cos(lat1) * sin(dis3) * cos(cr13));
     double dlon = atan2(sin(cr13) * sin(dis3) * cos(lat1),  cos(dis3) - sin(lat1) * sin(lat3));
     double lon3 = ndt_mod(lon1 - dlon + M_PI, 2. * M_PI) - M_PI;
     ndt_position pos3 = ndt_position_init(lat3 * 180. / M_PI, lon3 * 180. / M_PI * -1., NDT_DISTANCE_ZERO);
@@ -641,7 +739,7 @@ int ndt_position_calcpos4pbpd(ndt_position *out, ndt_position pos1, double trub,
     /*
      * If pos1 == pos2, math is really easy :)
      */
-    if (ndt_distance_get(ndt_position_calcdistance(pos1, pos2), NDT_ALTUNIT_FT) < INT64_C(66))
+    if (ndt_position_calcwithin(pos1, pos2, ndt_distance_init(66, NDT_ALTUNIT_FT)))
     {
         posn = ndt_position_calcpos4pbd(pos1, trub, dist);
         goto end;
@@ -924,6 +1022,19 @@ int ndt_position_fprintllc(ndt_position pos, ndt_llcfmt fmt, FILE *fd)
     return ndt_fprintf(fd, "%s", buf);
 }
 
+int ndt_position_sinkllc(ndt_position pos, ndt_llcfmt fmt, ndt_sink *sink)
+{
+    char buf[25];
+    int  ret = ndt_position_sprintllc(pos, fmt, buf, sizeof(buf));
+
+    if (ret < 0)
+    {
+        return EIO;
+    }
+
+    return ndt_sink_write(sink, buf, ret);
+}
+
 ndt_frequency ndt_frequency_init(double f)
 {
     ndt_frequency freqcy = { .value = round(f * 600.) }; // lcm(20, 40, 120, 200)
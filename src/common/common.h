@@ -26,6 +26,8 @@
 #include <stdio.h>
 #include <time.h>
 
+#include "common/sink.h"
+
 #ifndef TIM_ONLY
 #define TIM_ONLY 1
 #define TDFDRVEC 1
@@ -145,9 +147,26 @@ typedef enum
     NDT_LLCFMT_SVECT,   // optimized for SkyVector
 } ndt_llcfmt;
 
+/*
+ * Compact (8 bytes) latitude/longitude pair, for bulk storage in the database.
+ *
+ * Same fixed-point representation as ndt_position (1/1650 arc second ticks, as
+ * 180 * 3600 * 1650 still fits in a signed 32-bit integer), with the hemisphere
+ * folded into the sign: packing and unpacking are lossless, and equal positions
+ * remain equal after a round trip. There is no altitude nor precision; callers
+ * supply an altitude when unpacking, where it's meaningful.
+ */
+typedef struct ndt_latlon
+{
+    int32_t latitude;  // unit: 1/1650 arc seconds (equator  * value)
+    int32_t longitude; // unit: 1/1650 arc seconds (meridian * value)
+} ndt_latlon;
+
 #define NDT_POSITION_NULL (ndt_position_init(0., 0., NDT_DISTANCE_ZERO))
 
 ndt_position ndt_position_init         (double        latitude, double         longitude,                       ndt_distance altitude);
+ndt_position ndt_position_unpack       (ndt_latlon    latlon,                                                   ndt_distance altitude);
+ndt_latlon   ndt_position_pack         (ndt_position  position                                                                       );
 ndt_distance ndt_position_getaltitude  (ndt_position  position                                                                       );
 double       ndt_position_getlatitude  (ndt_position  position, ndt_angle_unit unit                                                  );
 double       ndt_position_getlongitude (ndt_position  position, ndt_angle_unit unit                                                  );
@@ -157,6 +176,8 @@ double       ndt_position_calcbearing  (ndt_position  from,     ndt_position   t
 double       ndt_position_bearing_angle(double initial_bearing, double target_bearing                                                );
 double       ndt_position_angle_reverse(double obverse_angle                                                                         );
 ndt_distance ndt_position_calcdistance (ndt_position  from,     ndt_position   to                                                    );
+ndt_distance ndt_position_calcdistapprx(ndt_position  from,     ndt_position   to,                                ndt_distance *error);
+int          ndt_position_calcwithin   (ndt_position  from,     ndt_position   to,                                 ndt_distance dist);
 int          ndt_position_calcduration (ndt_position  from,     ndt_position   to,                                    ndt_airspeed at);
 int          ndt_position_calcintercept(ndt_position  from,     ndt_position   to,                                  ndt_position orig);
 ndt_position ndt_position_calcpos4pbd  (ndt_position  from,     double trubearing,                                  ndt_distance dist);
@@ -164,6 +185,7 @@ int          ndt_position_calcpos4pbpb (ndt_position  *out,     ndt_position pos
 int          ndt_position_calcpos4pbpd (ndt_position  *out,     ndt_position pos1, double trueb, ndt_position pos2, ndt_distance dist);
 int          ndt_position_sprintllc    (ndt_position position,  ndt_llcfmt format, char *buffer,                          size_t size);
 int          ndt_position_fprintllc    (ndt_position position,  ndt_llcfmt format, FILE *fd                                          );
+int          ndt_position_sinkllc      (ndt_position position,  ndt_llcfmt format, ndt_sink *sink                                    );
 
 typedef struct ndt_frequency
 {
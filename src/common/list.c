@@ -24,24 +24,32 @@
 
 #include "compat/compat.h"
 
+#include "arena.h"
 #include "list.h"
 
 #define NDT_LIST_DEFAULT_SIZE 10
 
 struct ndt_list
 {
-    void **items;
-    int    count;
-    int    alloc;
+    void      **items;
+    int         count;
+    int         alloc;
+    ndt_arena  *arena;
 };
 
 ndt_list* ndt_list_init()
 {
-    ndt_list *l = calloc(1, sizeof(ndt_list));
+    return ndt_list_init2(NULL);
+}
+
+ndt_list* ndt_list_init2(ndt_arena *arena)
+{
+    ndt_list *l = ndt_arena_alloc(arena, sizeof(ndt_list));
 
     if (l)
     {
-        l->items = malloc(NDT_LIST_DEFAULT_SIZE * sizeof(void*));
+        l->arena = arena;
+        l->items = ndt_arena_alloc(arena, NDT_LIST_DEFAULT_SIZE * sizeof(void*));
 
         if (l->items)
         {
@@ -59,6 +67,14 @@ size_t ndt_list_count(const ndt_list *l)
     return l && l->count > 0 ? l->count : 0;
 }
 
+/*
+ * Bytes used by the list itself (not its items).
+ */
+size_t ndt_list_size(const ndt_list *l)
+{
+    return l ? sizeof(ndt_list) + l->alloc * sizeof(void*) : 0;
+}
+
 void* ndt_list_item(const ndt_list *l, int i)
 {
     if (!l || l->count <= 0 || l->count <= i)
@@ -100,8 +116,9 @@ void ndt_list_insert(ndt_list *l, void *p, int i)
 
     if (l->alloc == l->count)
     {
-        void *ptr = realloc(l->items,
-                            sizeof(void*) * (l->alloc + NDT_LIST_DEFAULT_SIZE));
+        void *ptr = ndt_arena_realloc(l->arena, l->items,
+                                      sizeof(void*) * (l->alloc),
+                                      sizeof(void*) * (l->alloc + NDT_LIST_DEFAULT_SIZE));
         if (!ptr)
         {
             /* l->items it untouched, but we can't add anything */
@@ -169,8 +186,8 @@ void ndt_list_close(ndt_list **_l)
     {
         ndt_list *l = *_l;
 
-        free(l->items);
-        free(l);
+        ndt_arena_free(l->arena, l->items, sizeof(void*) * l->alloc);
+        ndt_arena_free(l->arena, l, sizeof(ndt_list));
 
         *_l = NULL;
     }
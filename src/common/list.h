@@ -23,10 +23,14 @@
 
 #include <inttypes.h>
 
+#include "common/arena.h"
+
 typedef struct ndt_list ndt_list;
 
 ndt_list* ndt_list_init  (                                         );
+ndt_list* ndt_list_init2 (      ndt_arena *arena                   );
 size_t    ndt_list_count (const ndt_list *list                     );
+size_t    ndt_list_size  (const ndt_list *list                     );
 void*     ndt_list_item  (const ndt_list *list,             int idx);
 void      ndt_list_insert(      ndt_list *list, void *item, int idx);
 void      ndt_list_add   (      ndt_list *list, void *item         );
@@ -0,0 +1,339 @@
+/*
+ * sink.c
+ *
+ * This file is part of the navdtools source code.
+ *
+ * (C) Copyright 2014-2016 Timothy D. Walker and others.
+ *
+ * All rights reserved. This program and the accompanying materials are made
+ * available under the terms of the GNU General Public License (GPL) version 2
+ * which accompanies this distribution (LICENSE file), and is also available at
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * Contributors:
+ *     Timothy D. Walker
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compat/compat.h"
+
+#include "sink.h"
+
+#define NDT_SINK_FIRST (4096)                           // initial buffer size
+#define NDT_SINK_BLOCK (64 * 1024)                      // file sinks: write size
+
+struct ndt_sink
+{
+    FILE   *file;                                       // NULL: memory only
+    char   *buf;
+    size_t  len;
+    size_t  cap;
+    int     err;                                        // first error (sticky)
+};
+
+static const double   sink_pow10d[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, };
+static const uint64_t sink_pow10u[] = { UINT64_C(1),         UINT64_C(10),
+                                        UINT64_C(100),       UINT64_C(1000),
+                                        UINT64_C(10000),     UINT64_C(100000),
+                                        UINT64_C(1000000),   UINT64_C(10000000),
+                                        UINT64_C(100000000), UINT64_C(1000000000), };
+
+ndt_sink* ndt_sink_init(FILE *file)
+{
+    ndt_sink *sink = calloc(1, sizeof(ndt_sink));
+    if (sink)
+    {
+        sink->file = file;
+    }
+    return sink;
+}
+
+void ndt_sink_close(ndt_sink **_sink)
+{
+    if (_sink && *_sink)
+    {
+        free((*_sink)->buf);
+        free((*_sink));
+        *_sink = NULL;
+    }
+}
+
+int ndt_sink_flush(ndt_sink *sink)
+{
+    if (!sink)
+    {
+        return ENOMEM;
+    }
+    if (sink->err || !sink->file || !sink->len)
+    {
+        return sink->err;
+    }
+    if (fwrite(sink->buf, 1, sink->len, sink->file) != sink->len)
+    {
+        return (sink->err = errno ? errno : EIO);
+    }
+    sink->len = 0;
+    return 0;
+}
+
+void ndt_sink_reset(ndt_sink *sink)
+{
+    if (sink)
+    {
+        sink->len = 0;
+        sink->err = 0;
+    }
+}
+
+/*
+ * Make room for size more bytes (plus a terminating NULL character), writing
+ * the buffer to file first when it has grown large enough (file sinks only).
+ */
+static int sink_reserve(ndt_sink *sink, size_t size)
+{
+    if (sink->err)
+    {
+        return sink->err;
+    }
+    if (sink->file && sink->len && sink->len + size + 1 > NDT_SINK_BLOCK)
+    {
+        if (ndt_sink_flush(sink))
+        {
+            return sink->err;
+        }
+    }
+    if (sink->len + size + 1 > sink->cap)
+    {
+        size_t cap = sink->cap ? sink->cap : NDT_SINK_FIRST;
+        while (cap < sink->len + size + 1)
+        {
+            cap *= 2;
+        }
+        char *buf = realloc(sink->buf, cap);
+        if (!buf)
+        {
+            return (sink->err = ENOMEM);
+        }
+        sink->buf = buf;
+        sink->cap = cap;
+    }
+    return 0;
+}
+
+const char* ndt_sink_data(ndt_sink *sink, size_t *len)
+{
+    if (!sink || sink_reserve(sink, 0))
+    {
+        if (len)
+        {
+            *len = 0;
+        }
+        return NULL;
+    }
+    if (len)
+    {
+        *len = sink->len;
+    }
+    sink->buf[sink->len] = '\0';
+    return sink->buf;
+}
+
+char* ndt_sink_detach(ndt_sink *sink, size_t *len)
+{
+    char *buf;
+
+    if (!ndt_sink_data(sink, len))
+    {
+        return NULL;
+    }
+    buf       = sink->buf;
+    sink->buf = NULL;
+    sink->cap = 0;
+    sink->len = 0;
+    return buf;
+}
+
+int ndt_sink_write(ndt_sink *sink, const char *buf, size_t len)
+{
+    if (!sink || !buf)
+    {
+        return ENOMEM;
+    }
+    if (sink_reserve(sink, len))
+    {
+        return sink->err;
+    }
+    memcpy(sink->buf + sink->len, buf, len);
+    sink->len += len;
+    return 0;
+}
+
+int ndt_sink_printf(ndt_sink *sink, const char *fmt, ...)
+{
+    va_list ap;
+    int     ret;
+
+    if (!sink || !fmt)
+    {
+        return !sink ? ENOMEM : EINVAL;
+    }
+    if (sink_reserve(sink, 128)) // most lines fit, avoid formatting twice
+    {
+        return sink->err;
+    }
+    va_start(ap, fmt);
+    ret = vsnprintf(sink->buf + sink->len, sink->cap - sink->len, fmt, ap);
+    va_end  (ap);
+    if (ret < 0)
+    {
+        return (sink->err = errno ? errno : EINVAL);
+    }
+    if ((size_t)ret >= sink->cap - sink->len)
+    {
+        if (sink_reserve(sink, ret))
+        {
+            return sink->err;
+        }
+        va_start(ap, fmt);
+        ret = vsnprintf(sink->buf + sink->len, sink->cap - sink->len, fmt, ap);
+        va_end  (ap);
+        if (ret < 0)
+        {
+            return (sink->err = errno ? errno : EINVAL);
+        }
+    }
+    sink->len += ret;
+    return 0;
+}
+
+/*
+ * Append a formatted field: optional sign, then digits (or string),
+ * justified or zero-padded to width, exactly like the printf family.
+ */
+static int sink_field(ndt_sink *sink, char sign, const char *str, size_t len, int width, int flags)
+{
+    size_t full = len + !!sign;
+    size_t fill = width > 0 && (size_t)width > full ? (size_t)width - full : 0;
+    if (sink_reserve(sink, full + fill))
+    {
+        return sink->err;
+    }
+    char *ptr = sink->buf + sink->len;
+    if (fill && !(flags & (NDT_SINKFMT_LEFT|NDT_SINKFMT_ZERO)))
+    {
+        memset(ptr, ' ', fill);
+        ptr += fill;
+    }
+    if (sign)
+    {
+        *ptr++ = sign;
+    }
+    if (fill && (flags & NDT_SINKFMT_ZERO) && !(flags & NDT_SINKFMT_LEFT))
+    {
+        memset(ptr, '0', fill);
+        ptr += fill;
+    }
+    memcpy(ptr, str, len);
+    ptr += len;
+    if (fill && (flags & NDT_SINKFMT_LEFT))
+    {
+        memset(ptr, ' ', fill);
+        ptr += fill;
+    }
+    sink->len = ptr - sink->buf;
+    return 0;
+}
+
+int ndt_sink_putstr(ndt_sink *sink, const char *str, int width, int flags)
+{
+    if (!sink || !str)
+    {
+        return ENOMEM;
+    }
+    return sink_field(sink, 0, str, strlen(str), width, flags & NDT_SINKFMT_LEFT);
+}
+
+/*
+ * Write value's decimal digits at the end of buf, returns the first digit.
+ */
+static char* sink_digits(char *end, uint64_t value, int mindigits)
+{
+    char *ptr = end;
+    do
+    {
+        *--ptr = '0' + value % 10;
+        value /= 10;
+    }
+    while (value || end - ptr < mindigits);
+    return ptr;
+}
+
+int ndt_sink_putint(ndt_sink *sink, int64_t val, int width, int flags)
+{
+    char      buf[24], *str;
+    uint64_t  abs = val < 0 ? -(uint64_t)val : (uint64_t)val;
+    char     sign = val < 0 ? '-' : flags & NDT_SINKFMT_PLUS ? '+' : 0;
+
+    if (!sink)
+    {
+        return ENOMEM;
+    }
+    str = sink_digits(buf + sizeof(buf), abs, 1);
+    return sink_field(sink, sign, str, buf + sizeof(buf) - str, width, flags);
+}
+
+int ndt_sink_putfix(ndt_sink *sink, double val, int width, int prec, int flags)
+{
+    char buf[32], *str, *end = buf + sizeof(buf);
+
+    if (!sink)
+    {
+        return ENOMEM;
+    }
+    if (prec < 0 || prec > 9 || !isfinite(val))
+    {
+        goto slow;
+    }
+
+    /*
+     * Rounding a value's exact decimal expansion (as printf does) is the same
+     * as rounding our scaled value, unless the latter's fractional part is so
+     * close to one half that the multiplication's rounding error may matter.
+     */
+    double scl = fabs(val) * sink_pow10d[prec], flr = floor(scl), frc = scl - flr;
+    if (scl >= 1e9 || fabs(frc - .5) < 1e-6)
+    {
+        goto slow;
+    }
+    uint64_t num = (uint64_t)flr + (frc > .5);
+    if (prec)
+    {
+        str    = sink_digits(end, num % sink_pow10u[prec], prec);
+        *--str = '.';
+        str    = sink_digits(str, num / sink_pow10u[prec],    1);
+    }
+    else
+    {
+        str    = sink_digits(end, num, 1);
+    }
+    return sink_field(sink, signbit(val) ? '-' : flags & NDT_SINKFMT_PLUS ? '+' : 0, str, end - str, width, flags);
+
+slow:
+    snprintf(buf, sizeof(buf), "%%%s%s%s%d.%dlf",
+             flags & NDT_SINKFMT_LEFT ? "-" : "",
+             flags & NDT_SINKFMT_PLUS ? "+" : "",
+             flags & NDT_SINKFMT_ZERO ? "0" : "", width, prec);
+    return ndt_sink_printf(sink, buf, val);
+}
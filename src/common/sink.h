@@ -0,0 +1,64 @@
+/*
+ * sink.h
+ *
+ * This file is part of the navdtools source code.
+ *
+ * (C) Copyright 2014-2016 Timothy D. Walker and others.
+ *
+ * All rights reserved. This program and the accompanying materials are made
+ * available under the terms of the GNU General Public License (GPL) version 2
+ * which accompanies this distribution (LICENSE file), and is also available at
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * Contributors:
+ *     Timothy D. Walker
+ */
+
+#ifndef NDT_SINK_H
+#define NDT_SINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Buffered output for the flight plan writers: everything is appended to a
+ * growable memory buffer, which is either kept in memory (NULL file), or
+ * written to a file in large blocks (on ndt_sink_flush, or when it fills up).
+ *
+ * Errors are sticky: all functions return 0, or the first error encountered
+ * (errno-style); a writer may check the return value of its last call only.
+ *
+ * Sinks aren't thread-safe: each thread should use its own sink(s).
+ */
+typedef struct ndt_sink ndt_sink;
+
+ndt_sink*   ndt_sink_init  (FILE        *file                                                  );
+void        ndt_sink_close (ndt_sink   **_sink                                                 );
+int         ndt_sink_flush (ndt_sink    *sink                                                  );
+void        ndt_sink_reset (ndt_sink    *sink                                                  );
+const char* ndt_sink_data  (ndt_sink    *sink,                                      size_t *len);
+char*       ndt_sink_detach(ndt_sink    *sink,                                      size_t *len);
+int         ndt_sink_write (ndt_sink    *sink, const char *buf,                     size_t  len);
+int         ndt_sink_printf(ndt_sink    *sink, const char *format,                          ...);
+
+/*
+ * Fast formatting for fixed numeric fields, same output as the printf family:
+ *
+ * ndt_sink_putstr: %-7s               -> (str, 7, NDT_SINKFMT_LEFT)
+ * ndt_sink_putint: %05d               -> (val, 5, NDT_SINKFMT_ZERO)
+ * ndt_sink_putfix: %+010.6lf          -> (val, 10, 6, NDT_SINKFMT_PLUS|NDT_SINKFMT_ZERO)
+ */
+#define NDT_SINKFMT_LEFT 1 // left-justify within field width
+#define NDT_SINKFMT_PLUS 2 // always print a sign
+#define NDT_SINKFMT_ZERO 4 // pad with leading zeroes (after sign)
+
+int         ndt_sink_putstr(ndt_sink    *sink, const char *str, int width,           int flags);
+int         ndt_sink_putint(ndt_sink    *sink, int64_t     val, int width,           int flags);
+int         ndt_sink_putfix(ndt_sink    *sink, double      val, int width, int prec, int flags);
+
+#endif /* NDT_SINK_H */
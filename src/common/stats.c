@@ -0,0 +1,155 @@
+/*
+ * stats.c
+ *
+ * This file is part of the navdtools source code.
+ *
+ * (C) Copyright 2014-2016 Timothy D. Walker and others.
+ *
+ * All rights reserved. This program and the accompanying materials are made
+ * available under the terms of the GNU General Public License (GPL) version 2
+ * which accompanies this distribution (LICENSE file), and is also available at
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * Contributors:
+ *     Timothy D. Walker
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "sink.h"
+#include "stats.h"
+
+static const char *stats_names[NDT_STAT_COUNT] =
+{
+    [NDT_STAT_AIRAC]     = "parse_airac",
+    [NDT_STAT_AIRPORTS]  = "parse_airports",
+    [NDT_STAT_AIRWAYS]   = "parse_airways",
+    [NDT_STAT_NAVAIDS]   = "parse_navaids",
+    [NDT_STAT_WAYPOINTS] = "parse_waypoints",
+    [NDT_STAT_SORTAPT]   = "sort airports",
+    [NDT_STAT_SORTAWY]   = "sort airways",
+    [NDT_STAT_SORTWPT]   = "sort waypoints",
+    [NDT_STAT_WMMINIT]   = "ndt_wmm_init",
+    [NDT_STAT_PROCS]     = "airport procedures",
+    [NDT_STAT_ROUTE]     = "route parsing",
+    [NDT_STAT_LEGS]      = "route_leg_update",
+    [NDT_STAT_WRITE]     = "flight plan writers",
+};
+
+static struct
+{
+    uint64_t count;
+    uint64_t    ns;
+} stats_data[NDT_STAT_COUNT];
+
+static int stats_enabled = 0;
+
+static int64_t stats_now(void)
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts))
+    {
+        return 0;
+    }
+    return (int64_t)ts.tv_sec * INT64_C(1000000000) + ts.tv_nsec;
+}
+
+void ndt_stats_enable(int enabled)
+{
+    __atomic_store_n(&stats_enabled, !!enabled, __ATOMIC_RELAXED);
+}
+
+int64_t ndt_stats_begin(void)
+{
+    if (!__atomic_load_n(&stats_enabled, __ATOMIC_RELAXED))
+    {
+        return -1;
+    }
+    return stats_now();
+}
+
+void ndt_stats_end(ndt_statid id, int64_t start)
+{
+    if (start < 0 || id < 0 || id >= NDT_STAT_COUNT)
+    {
+        return;
+    }
+    int64_t ns = stats_now() - start;
+    __atomic_add_fetch(&stats_data[id].count,                 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats_data[id].ns, ns > 0 ? ns : 0, __ATOMIC_RELAXED);
+}
+
+void ndt_stats_get(ndt_statid id, uint64_t *count, uint64_t *ns)
+{
+    int valid = id >= 0 && id < NDT_STAT_COUNT;
+    if (count)
+    {
+        *count = valid ? __atomic_load_n(&stats_data[id].count, __ATOMIC_RELAXED) : 0;
+    }
+    if (ns)
+    {
+        *ns = valid ? __atomic_load_n(&stats_data[id].ns, __ATOMIC_RELAXED) : 0;
+    }
+}
+
+const char* ndt_stats_name(ndt_statid id)
+{
+    return id >= 0 && id < NDT_STAT_COUNT ? stats_names[id] : NULL;
+}
+
+/*
+ * Peak resident set size in bytes (0 if unknown).
+ */
+size_t ndt_stats_peakrss(void)
+{
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;         // bytes
+#else
+    return (size_t)usage.ru_maxrss * 1024;  // kilobytes
+#endif
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Human-readable report: one line per stage (call count, total and average
+ * time), then peak RSS; stages are inclusive (e.g. route parsing includes
+ * any route_leg_update it triggers).
+ */
+int ndt_stats_print(ndt_sink *sink)
+{
+    uint64_t count, ns;
+
+    if (!sink)
+    {
+        return ENOMEM;
+    }
+    ndt_sink_printf(sink, "%-20s %10s %12s %12s\n", "Stage", "Calls", "Total (ms)", "Average (us)");
+    for (int i = 0; i < NDT_STAT_COUNT; i++)
+    {
+        ndt_stats_get(i, &count, &ns);
+        ndt_sink_printf(sink, "%-20s %10"PRIu64" %12.3lf %12.3lf\n", stats_names[i], count,
+                        ns / 1e6, count ? ns / 1e3 / count : 0.);
+    }
+    return ndt_sink_printf(sink, "%-20s %10s %12.1lf MiB\n", "peak RSS", "", ndt_stats_peakrss() / 1048576.);
+}
@@ -0,0 +1,66 @@
+/*
+ * stats.h
+ *
+ * This file is part of the navdtools source code.
+ *
+ * (C) Copyright 2014-2016 Timothy D. Walker and others.
+ *
+ * All rights reserved. This program and the accompanying materials are made
+ * available under the terms of the GNU General Public License (GPL) version 2
+ * which accompanies this distribution (LICENSE file), and is also available at
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * Contributors:
+ *     Timothy D. Walker
+ */
+
+#ifndef NDT_STATS_H
+#define NDT_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/sink.h"
+
+/*
+ * Profiling: call counts and total (monotonic) time for the expensive parts of
+ * loading navdata and building flight plans; process-wide and thread-safe.
+ *
+ * Disabled by default (ndt_stats_begin then returns -1, and ndt_stats_end does
+ * nothing), so the library's instrumentation is basically free unless used:
+ *
+ *     int64_t start = ndt_stats_begin();
+ *     ...
+ *     ndt_stats_end(NDT_STAT_ROUTE, start);
+ */
+typedef enum
+{
+    NDT_STAT_AIRAC,                                     // parse cycle information
+    NDT_STAT_AIRPORTS,                                  // parse airports, runways
+    NDT_STAT_AIRWAYS,                                   // parse airways
+    NDT_STAT_NAVAIDS,                                   // parse navaids
+    NDT_STAT_WAYPOINTS,                                 // parse waypoints
+    NDT_STAT_SORTAPT,                                   // sort airports
+    NDT_STAT_SORTAWY,                                   // sort airways
+    NDT_STAT_SORTWPT,                                   // sort waypoints
+    NDT_STAT_WMMINIT,                                   // World Magnetic Model
+    NDT_STAT_PROCS,                                     // procedures (per airport)
+    NDT_STAT_ROUTE,                                     // route parsing
+    NDT_STAT_LEGS,                                      // route_leg_update
+    NDT_STAT_WRITE,                                     // flight plan writers
+    NDT_STAT_COUNT,
+} ndt_statid;
+
+void        ndt_stats_enable (int        enabled                          );
+int64_t     ndt_stats_begin  (void                                        );
+void        ndt_stats_end    (ndt_statid id, int64_t start                );
+void        ndt_stats_get    (ndt_statid id, uint64_t *count, uint64_t *ns);
+const char* ndt_stats_name   (ndt_statid id                               );
+size_t      ndt_stats_peakrss(void                                        );
+int         ndt_stats_print  (ndt_sink  *sink                             );
+
+#endif /* NDT_STATS_H */
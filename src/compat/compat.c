@@ -20,6 +20,10 @@
 
 #include "compat.h"
 
+#if COMPAT_GETLINE
+#include "getline.c"
+#endif
+
 #if COMPAT_STRCASESTR
 #include "strcasestr.c"
 #endif
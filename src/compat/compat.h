@@ -22,12 +22,19 @@
 #define NDT_COMPAT_H
 
 #if COMPAT_MINGW_DEFAULT
+#define COMPAT_GETLINE    1
 #define COMPAT_STRCASESTR 1
 #define COMPAT_STRERROR_R 1
 #define COMPAT_STRNDUP    1
 #define COMPAT_STRSEP     1
 #endif
 
+#if COMPAT_GETLINE
+#include <stdio.h>
+#include <sys/types.h>
+ssize_t getline(char **lineptr, size_t *n, FILE *stream);
+#endif
+
 #if COMPAT_STRCASESTR
 char* strcasestr(const char *s1, const char *s2);
 #endif
@@ -0,0 +1,65 @@
+/*
+ * getline.c
+ *
+ * This file is part of the navdtools source code.
+ *
+ * (C) Copyright 2014-2016 Timothy D. Walker and others.
+ *
+ * All rights reserved. This program and the accompanying materials are made
+ * available under the terms of the GNU General Public License (GPL) version 2
+ * which accompanies this distribution (LICENSE file), and is also available at
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * Contributors:
+ *     Timothy D. Walker
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+ssize_t getline(char **lineptr, size_t *n, FILE *stream)
+{
+    size_t len = 0;
+    int      c;
+
+    if (!lineptr || !n || !stream)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while ((c = fgetc(stream)) != EOF)
+    {
+        if (len + 1 >= *n || !*lineptr)
+        {
+            size_t cap = *n && *lineptr ? *n * 2 : 128;
+            char  *buf = realloc(*lineptr, cap);
+            if (!buf)
+            {
+                errno = ENOMEM;
+                return -1;
+            }
+            *lineptr = buf;
+            *n       = cap;
+        }
+        (*lineptr)[len++] = c;
+        if (c == '\n')
+        {
+            break;
+        }
+    }
+
+    if (!len)
+    {
+        return -1; // end of file or read error
+    }
+
+    (*lineptr)[len] = '\0';
+    return len;
+}
@@ -38,6 +38,7 @@ ndt_airport* ndt_airport_init()
     {
         goto end;
     }
+    pthread_mutex_init(&apt->lock, NULL);
 
     apt->runways = ndt_list_init();
     if (!apt->runways)
@@ -98,6 +99,8 @@ void ndt_airport_close(ndt_airport **_apt)
             ndt_list_close(&apt->stars);
         }
 
+        pthread_mutex_destroy(&apt->lock);
+
         free(apt);
 
         *_apt = NULL;
@@ -21,6 +21,8 @@
 #ifndef NDT_AIRPORT_H
 #define NDT_AIRPORT_H
 
+#include <pthread.h>
+
 #include "common/common.h"
 #include "common/list.h"
 
@@ -39,6 +41,8 @@ typedef struct ndt_airport
     ndt_list *allprocs;        // procedure master list   (used for  storage only)
     ndt_list     *sids;        // list of SID  procedures (no enroute transitions)
     ndt_list    *stars;        // list of STAR procedures (no enroute transitions)
+    int           ready;       // initialized (see ndt_navdata_init_airport)
+    pthread_mutex_t lock;      // serializes lazy init. of airport & procedures
 } ndt_airport;
 
 ndt_airport* ndt_airport_init (                      );
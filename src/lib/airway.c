@@ -69,13 +69,19 @@ ndt_airway_leg* ndt_airway_startpoint(ndt_airway *awy, const char *wpt, ndt_posi
     }
 
     ndt_airway_leg *leg = awy->leg;
+    ndt_latlon   latlon = ndt_position_pack(pos);
 
     while (leg)
     {
-        if (!strcmp(wpt, leg->in.info.idnt) &&
-            !ndt_distance_get(ndt_position_calcdistance(pos, leg->in.position), NDT_ALTUNIT_NA))
+        if (!strcmp(wpt, leg->in.info.idnt))
         {
-            return leg;
+            // exact tick match first, else same under-1m test as ndt_navdata_get_wpt4pos
+            if ((leg->in.position.latitude  == latlon.latitude &&
+                 leg->in.position.longitude == latlon.longitude) ||
+                !ndt_distance_get(ndt_position_calcdistance(pos, ndt_position_unpack(leg->in.position, ndt_position_getaltitude(pos))), NDT_ALTUNIT_NA))
+            {
+                return leg;
+            }
         }
 
         leg = leg->next;
@@ -93,13 +99,19 @@ ndt_airway_leg* ndt_airway_endpoint(ndt_airway_leg *in, const char *wpt, ndt_pos
     }
 
     ndt_airway_leg *leg = in;
+    ndt_latlon   latlon = ndt_position_pack(pos);
 
     while (leg)
     {
-        if (!strcmp(wpt, leg->out.info.idnt) &&
-            !ndt_distance_get(ndt_position_calcdistance(pos, leg->out.position), NDT_ALTUNIT_NA))
+        if (!strcmp(wpt, leg->out.info.idnt))
         {
-            return leg;
+            // exact tick match first, else same under-1m test as ndt_navdata_get_wpt4pos
+            if ((leg->out.position.latitude  == latlon.latitude &&
+                 leg->out.position.longitude == latlon.longitude) ||
+                !ndt_distance_get(ndt_position_calcdistance(pos, ndt_position_unpack(leg->out.position, ndt_position_getaltitude(pos))), NDT_ALTUNIT_NA))
+            {
+                return leg;
+            }
         }
 
         leg = leg->next;
@@ -124,7 +136,7 @@ ndt_airway_leg* ndt_airway_intersect(ndt_airway_leg *in, ndt_airway *awy)
 
     while (leg)
     {
-        if (ndt_airway_startpoint(awy, leg->out.info.idnt, leg->out.position))
+        if (ndt_airway_startpoint(awy, leg->out.info.idnt, ndt_position_unpack(leg->out.position, NDT_DISTANCE_ZERO)))
         {
             return leg;
         }
@@ -48,13 +48,13 @@ typedef struct ndt_airway_leg
     struct
     {
         ndt_info     info;
-        ndt_position position;
+        ndt_latlon   position; // packed: no altitude for airway waypoints
     } in;
 
     struct
     {
         ndt_info     info;
-        ndt_position position;
+        ndt_latlon   position; // packed: no altitude for airway waypoints
     } out;
 
     struct
@@ -67,6 +67,17 @@ typedef struct ndt_airway_leg
 
     struct ndt_airway     *awy;
     struct ndt_airway_leg *next;
+
+    struct // looked up on first use (see ndt_route_segment_airway)
+    {
+        int                  valid; // set last, once everything else is
+        struct ndt_waypoint   *src; // waypoint matching in  (may be NULL)
+        struct ndt_waypoint   *dst; // waypoint matching out
+        ndt_distance           dis; // leg geometry, src to dst (if src set)
+        double                 trb;
+        double                 imb;
+        double                 omb;
+    } cache;
 } ndt_airway_leg;
 
 ndt_airway*     ndt_airway_init      (                                                                   );
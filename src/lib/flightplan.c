@@ -21,12 +21,15 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "common/common.h"
 #include "common/list.h"
+#include "common/stats.h"
+#include "common/sink.h"
 
 #include "compat/compat.h"
 
@@ -40,44 +43,73 @@
 #include "ndb_xpgns.h"
 #include "waypoint.h"
 
-static int route_leg_update(ndt_flightplan *flp                                              );
-static int route_leg_airway(ndt_flightplan *flp, ndt_navdatabase *ndb, ndt_route_segment *rsg);
+static int  route_leg_update(ndt_flightplan *flp                                              );
+static int  route_leg_airway(ndt_flightplan *flp, ndt_navdatabase *ndb, ndt_route_segment *rsg);
+static void route_leg_coords(ndt_route_leg  *leg, void            *wmm                        );
+static int  route_leg_overlap(ndt_flightplan *flp                                             );
+static size_t route_leg_dirty(ndt_flightplan *flp, ndt_waypoint   *dep                        );
+static int  route_leg_xpfmok(ndt_route_leg  *leg, ndt_route_leg *prv, ndt_route_leg *nxt, ndt_waypoint *src, ndt_distance alt);
+static void route_leg_xpfmrm(ndt_flightplan *flp, ndt_route_leg *leg, size_t        keep                                    );
+static int  route_leg_memoget(ndt_flightplan *flp, ndt_route_leg *leg, ndt_waypoint *src, ndt_distance alt, ndt_runway *rwy, double *brg);
+static void route_leg_memoput(ndt_flightplan *flp, ndt_route_leg *leg, ndt_waypoint *src, ndt_distance alt, ndt_runway *rwy, double  brg);
+
+static ndt_procedure* procedure_open(ndt_navdatabase *ndb, ndt_procedure *proc);
 
 ndt_flightplan* ndt_flightplan_init(ndt_navdatabase *ndb)
+{
+    return ndt_flightplan_init2(ndb, NULL, NULL);
+}
+
+ndt_flightplan* ndt_flightplan_init2(ndt_navdatabase *ndb, ndt_route_check_callback *cb, void *ctx)
 {
     if (!ndb)
     {
         return NULL;
     }
 
-    ndt_flightplan *flp = calloc(1, sizeof(ndt_flightplan));
+    /*
+     * Everything the flight plan owns (route segments, legs, custom waypoints,
+     * the lists referencing them and the flight plan itself) is allocated from
+     * the same arena, so rebuilding or closing a flight plan is cheap.
+     */
+    ndt_arena *arena = ndt_arena_init();
+    if (!arena)
+    {
+        return NULL;
+    }
+
+    ndt_flightplan *flp = ndt_arena_alloc(arena, sizeof(ndt_flightplan));
     if (!flp)
     {
+        ndt_arena_close(&arena);
         goto end;
     }
+    flp->arena = arena;
 
-    flp->cws = ndt_list_init();
+    flp->cws = ndt_list_init2(flp->arena);
     if (!flp->cws)
     {
         ndt_flightplan_close(&flp);
         goto end;
     }
 
-    flp->rte = ndt_list_init();
+    flp->rte = ndt_list_init2(flp->arena);
     if (!flp->rte)
     {
         ndt_flightplan_close(&flp);
         goto end;
     }
 
-    flp->legs = ndt_list_init();
+    flp->legs = ndt_list_init2(flp->arena);
     if (!flp->legs)
     {
         ndt_flightplan_close(&flp);
         goto end;
     }
 
-    flp->ndb = ndb;
+    flp->ndb       = ndb;
+    flp->check.cb  = cb;
+    flp->check.ctx = ctx;
 
     // default cruising altitude to remain compatible
     // with most procedures' restrictions if possible
@@ -142,45 +174,113 @@ void ndt_flightplan_close(ndt_flightplan **_flp)
 {
     if (_flp && *_flp)
     {
-        size_t i;
-        ndt_flightplan *flp = *_flp;
+        ndt_arena *arena = (*_flp)->arena;
 
-        if (flp->cws)
-        {
-            while ((i = ndt_list_count(flp->cws)))
-            {
-                ndt_waypoint *wpt = ndt_list_item(flp->cws, i-1);
-                ndt_list_rem                     (flp->cws, wpt);
-                ndt_waypoint_close               (         &wpt);
-            }
-            ndt_list_close(&flp->cws);
-        }
-        if (flp->rte)
-        {
-            while ((i = ndt_list_count(flp->rte)))
-            {
-                ndt_route_segment *rsg = ndt_list_item(flp->rte, i-1);
-                ndt_list_rem                          (flp->rte, rsg);
-                ndt_route_segment_close               (         &rsg);
-            }
-            ndt_list_close(&flp->rte);
-        }
-        if (flp->legs)
-        {
-            ndt_list_close(&flp->legs);
-        }
-        if (flp->arr.last.rsgt)
+        /*
+         * Everything we own was allocated from our arena (including ourselves),
+         * no need to close our custom waypoints, route segments and legs one at
+         * a time; none of them are referenced anywhere else once we're gone.
+         */
+        ndt_arena_close(&arena);
+
+        *_flp = NULL;
+    }
+}
+
+typedef struct ndt_usrwpt
+{
+    struct ndt_usrwpt *next;
+    ndt_waypoint       *wpt;
+} ndt_usrwpt;
+
+static size_t usrwpt_bucket(const char *idnt)
+{
+    uint32_t hash = 2166136261u; // FNV-1a
+    while (*idnt)
+    {
+        hash = (hash ^ (unsigned char)*idnt++) * 16777619u;
+    }
+    return hash % NDT_FLIGHTPLAN_USRWPTS;
+}
+
+int ndt_flightplan_user_waypoint(ndt_flightplan *flp, const char *idnt, ndt_position coordinates)
+{
+    if (!flp || !idnt)
+    {
+        return ENOMEM;
+    }
+    if (!*idnt || strlen(idnt) >= sizeof(((ndt_info*)0)->idnt))
+    {
+        ndt_log("flightplan: invalid user waypoint identifier \"%s\"\n", idnt);
+        return EINVAL;
+    }
+
+    ndt_usrwpt   *usr = ndt_arena_alloc(flp->arena, sizeof(ndt_usrwpt));
+    ndt_waypoint *wpt = ndt_waypoint_posn(coordinates,   flp->arena);
+    if (!usr || !wpt)
+    {
+        ndt_arena_free     (flp->arena, usr, sizeof(ndt_usrwpt));
+        ndt_waypoint_close2(&wpt, flp->arena);
+        return ENOMEM;
+    }
+    snprintf(wpt->info.idnt, sizeof(wpt->info.idnt), "%s", idnt);
+
+    /*
+     * Newest first: a user waypoint replaces any previous user waypoint with
+     * the same identifier, but the latter remains valid (may be referenced).
+     */
+    size_t bucket    = usrwpt_bucket(idnt);
+    usr->wpt         = wpt;
+    usr->next        = flp->usr[bucket];
+    flp->usr[bucket] = usr;
+    ndt_list_add(flp->cws, wpt);
+    return 0;
+}
+
+static ndt_waypoint* usrwpt_get(ndt_flightplan *flp, const char *idnt)
+{
+    for (ndt_usrwpt *usr = flp->usr[usrwpt_bucket(idnt)]; usr; usr = usr->next)
+    {
+        if (!strcmp(idnt, usr->wpt->info.idnt))
         {
-            ndt_route_segment_close(&flp->arr.last.rsgt);
+            return usr->wpt;
         }
-        reset_sid (flp);
-        reset_star(flp);
-        reset_apch(flp);
+    }
+    return NULL;
+}
 
-        free(flp);
+ndt_waypoint* ndt_flightplan_get_waypoint(ndt_flightplan *flp, const char *idnt, size_t *idx)
+{
+    if (!flp || !idnt)
+    {
+        return NULL;
+    }
 
-        *_flp = NULL;
+    /*
+     * A user waypoint hides all navigation database waypoints with the same
+     * identifier; it's the only match, so it's always at index zero.
+     */
+    ndt_waypoint *wpt = usrwpt_get(flp, idnt);
+    if (wpt)
+    {
+        return (idx && *idx) ? NULL : wpt;
     }
+    return ndt_navdata_get_waypoint(flp->ndb, idnt, idx);
+}
+
+ndt_waypoint* ndt_flightplan_get_wptnear2(ndt_flightplan *flp, const char *idnt, size_t *idx, ndt_position pos)
+{
+    if (!flp || !idnt)
+    {
+        return NULL;
+    }
+
+    ndt_waypoint *wpt = usrwpt_get(flp, idnt);
+    if (wpt)
+    {
+        return (idx && *idx) ? NULL : wpt;
+    }
+    return ndt_navdata_get_wptnear2(flp->ndb, idnt, idx, pos);
 }
 
 int ndt_flightplan_set_departure(ndt_flightplan *flp, const char *icao, const char *rwid)
@@ -306,14 +406,14 @@ int ndt_flightplan_set_departsid(ndt_flightplan *flp, const char *name, const ch
     }
 
     // we only open a procedure right before we need it, for performance reasons
-    if (!proc->opened && !ndt_procedure_open(flp->ndb, proc))
+    if (!ndt_procedure_open(flp->ndb, proc))
     {
         ndt_log("flightplan: %s: failed to open SID '%s'\n",
                 flp->dep.apt->info.idnt, name);
         err = EINVAL;
         goto end;
     }
-    if (nrte && !nrte->opened && !ndt_procedure_open(flp->ndb, nrte))
+    if (nrte && !ndt_procedure_open(flp->ndb, nrte))
     {
         ndt_log("flightplan: %s: failed to open transition '%s' for SID '%s'\n",
                 flp->dep.apt->info.idnt, trans, name);
@@ -324,7 +424,7 @@ int ndt_flightplan_set_departsid(ndt_flightplan *flp, const char *name, const ch
     // if the departure runway is not set, we set src to NULL, so
     // ndt_route_segment_proced will insert a discontinuity for us
     ndt_waypoint *src = flp->dep.rwy ? flp->dep.rwy->waypoint : NULL;
-    flp->dep.sid.rsgt = ndt_route_segment_proced(src, NULL, proc, flp->ndb);
+    flp->dep.sid.rsgt = ndt_route_segment_proced(src, NULL, proc, flp->ndb, flp->arena);
     flp->dep.sid.proc = proc;
     if (!flp->dep.sid.rsgt)
     {
@@ -335,7 +435,7 @@ int ndt_flightplan_set_departsid(ndt_flightplan *flp, const char *name, const ch
     {
         ndt_route_leg *leg = ndt_list_item(flp->dep.sid.rsgt->legs, -1);
         ndt_restriction *c = leg ? &leg->constraints : NULL;
-        flp->dep.sid.enroute.rsgt = ndt_route_segment_proced(flp->dep.sid.rsgt->dst, c, nrte, flp->ndb);
+        flp->dep.sid.enroute.rsgt = ndt_route_segment_proced(flp->dep.sid.rsgt->dst, c, nrte, flp->ndb, flp->arena);
         flp->dep.sid.enroute.proc = nrte;
         if (!flp->dep.sid.enroute.rsgt)
         {
@@ -487,14 +587,14 @@ int ndt_flightplan_set_arrivstar(ndt_flightplan *flp, const char *name, const ch
     }
 
     // we only open a procedure right before we need it, for performance reasons
-    if (!proc->opened && !ndt_procedure_open(flp->ndb, proc))
+    if (!ndt_procedure_open(flp->ndb, proc))
     {
         ndt_log("flightplan: %s: failed to open STAR '%s'\n",
                 flp->arr.apt->info.idnt, name);
         err = EINVAL;
         goto end;
     }
-    if (nrte && !nrte->opened && !ndt_procedure_open(flp->ndb, nrte))
+    if (nrte && !ndt_procedure_open(flp->ndb, nrte))
     {
         ndt_log("flightplan: %s: failed to open transition '%s' for STAR '%s'\n",
                 flp->arr.apt->info.idnt, trans, name);
@@ -522,7 +622,7 @@ int ndt_flightplan_set_arrivstar(ndt_flightplan *flp, const char *name, const ch
     ndt_restriction *cst = leg ? &leg->constraints : NULL;
     if (nrte)
     {
-        flp->arr.star.enroute.rsgt = ndt_route_segment_proced(src, cst, nrte, flp->ndb);
+        flp->arr.star.enroute.rsgt = ndt_route_segment_proced(src, cst, nrte, flp->ndb, flp->arena);
         flp->arr.star.enroute.proc = nrte;
         if (!flp->arr.star.enroute.rsgt)
         {
@@ -537,7 +637,7 @@ int ndt_flightplan_set_arrivstar(ndt_flightplan *flp, const char *name, const ch
         leg = ndt_list_item(flp->arr.star.enroute.rsgt->legs, -1);
         cst = leg ? &leg->constraints : NULL;
     }
-    flp->arr.star.rsgt = ndt_route_segment_proced(src, cst, proc, flp->ndb);
+    flp->arr.star.rsgt = ndt_route_segment_proced(src, cst, proc, flp->ndb, flp->arena);
     flp->arr.star.proc = proc;
     if (!flp->arr.star.rsgt)
     {
@@ -602,14 +702,14 @@ int ndt_flightplan_set_arrivapch(ndt_flightplan *flp, const char *name, const ch
     }
 
     // we only open a procedure right before we need it, for performance reasons
-    if (!proc->opened && !ndt_procedure_open(flp->ndb, proc))
+    if (!ndt_procedure_open(flp->ndb, proc))
     {
         ndt_log("flightplan: %s: failed to open approach '%s'\n",
                 flp->arr.apt->info.idnt, name);
         err = EINVAL;
         goto end;
     }
-    if (aptr && !aptr->opened && !ndt_procedure_open(flp->ndb, aptr))
+    if (aptr && !ndt_procedure_open(flp->ndb, aptr))
     {
         ndt_log("flightplan: %s: failed to open transition '%s' for approach '%s'\n",
                 flp->arr.apt->info.idnt, trans, name);
@@ -645,7 +745,7 @@ int ndt_flightplan_set_arrivapch(ndt_flightplan *flp, const char *name, const ch
     ndt_restriction *cst = leg ? &leg->constraints : NULL;
     if (aptr)
     {
-        flp->arr.apch.transition.rsgt = ndt_route_segment_proced(src, cst, aptr, flp->ndb);
+        flp->arr.apch.transition.rsgt = ndt_route_segment_proced(src, cst, aptr, flp->ndb, flp->arena);
         flp->arr.apch.transition.proc = aptr;
         if (!flp->arr.apch.transition.rsgt)
         {
@@ -660,7 +760,7 @@ int ndt_flightplan_set_arrivapch(ndt_flightplan *flp, const char *name, const ch
         leg = ndt_list_item(flp->arr.apch.transition.rsgt->legs, -1);
         cst = leg ? &leg->constraints : NULL;
     }
-    flp->arr.apch.rsgt = ndt_route_segment_proced(src, cst, proc, flp->ndb);
+    flp->arr.apch.rsgt = ndt_route_segment_proced(src, cst, proc, flp->ndb, flp->arena);
     flp->arr.apch.proc = proc;
     if (!flp->arr.apch.rsgt)
     {
@@ -689,8 +789,9 @@ end:
 
 int ndt_flightplan_set_route(ndt_flightplan *flp, const char *rte, ndt_fltplanformat fmt)
 {
-    int  err = 0;
-    char errbuf[64];
+    int64_t start = ndt_stats_begin();
+    int       err = 0;
+    char   errbuf[64];
 
     if (!flp || !rte || !(*rte))
     {
@@ -718,6 +819,7 @@ int ndt_flightplan_set_route(ndt_flightplan *flp, const char *rte, ndt_fltplanfo
     }
 
 end:
+    ndt_stats_end(NDT_STAT_ROUTE, start);
     if (err)
     {
         strerror_r(err, errbuf, sizeof(errbuf));
@@ -729,50 +831,78 @@ end:
 
 int ndt_flightplan_write(ndt_flightplan *flp, FILE *file, ndt_fltplanformat fmt)
 {
-    int  err = 0;
-    char errbuf[64];
+    ndt_sink *sink;
+    int       err;
 
     if (!flp || !file)
+    {
+        return ENOMEM;
+    }
+    if (!(sink = ndt_sink_init(file)))
+    {
+        return ENOMEM;
+    }
+    if (!(err = ndt_flightplan_write2(flp, sink, fmt)))
+    {
+        err = ndt_sink_flush(sink);
+    }
+    ndt_sink_close(&sink);
+    return err;
+}
+
+int ndt_flightplan_write2(ndt_flightplan *flp, ndt_sink *sink, ndt_fltplanformat fmt)
+{
+    int64_t start = ndt_stats_begin();
+    int       err = 0;
+    char   errbuf[64];
+
+    if (!flp || !sink)
     {
         err = ENOMEM;
         goto end;
     }
+    if (flp->check.cb)
+    {
+        ndt_log("flightplan: can't write a validation-only flight plan\n");
+        err = EINVAL;
+        goto end;
+    }
 
     switch (fmt)
     {
         case NDT_FLTPFMT_AIBXT:
-            err = ndt_fmt_aibxt_flightplan_write(flp, file);
+            err = ndt_fmt_aibxt_flightplan_write(flp, sink);
             break;
 
         case NDT_FLTPFMT_DCDED:
-            err = ndt_fmt_dcded_flightplan_write(flp, file);
+            err = ndt_fmt_dcded_flightplan_write(flp, sink);
             break;
 
         case NDT_FLTPFMT_DTEST:
-            err = ndt_fmt_dtest_flightplan_write(flp, file);
+            err = ndt_fmt_dtest_flightplan_write(flp, sink);
             break;
 
         case NDT_FLTPFMT_ICAOR:
-            err = ndt_fmt_icaor_flightplan_write(flp, file);
+            err = ndt_fmt_icaor_flightplan_write(flp, sink);
             break;
 
         case NDT_FLTPFMT_ICAOX:
-            err = ndt_fmt_icaox_flightplan_write(flp, file);
+            err = ndt_fmt_icaox_flightplan_write(flp, sink);
             break;
 
         case NDT_FLTPFMT_IRECP:
-            err = ndt_fmt_irecp_flightplan_write(flp, file);
+            err = ndt_fmt_irecp_flightplan_write(flp, sink);
             break;
 
         case NDT_FLTPFMT_SBRIF:
-            err = ndt_fmt_sbrif_flightplan_write(flp, file);
+            err = ndt_fmt_sbrif_flightplan_write(flp, sink);
             break;
 
         case NDT_FLTPFMT_XPCDU:
         case NDT_FLTPFMT_XPCVA:
         case NDT_FLTPFMT_XPHLP:
         case NDT_FLTPFMT_XPFMS:
-            err = ndt_fmt_xpfms_flightplan_write(flp, file, fmt);
+            err = ndt_fmt_xpfms_flightplan_write(flp, sink, fmt);
             break;
 
         default:
@@ -781,6 +911,7 @@ int ndt_flightplan_write(ndt_flightplan *flp, FILE *file, ndt_fltplanformat fmt)
     }
 
 end:
+    ndt_stats_end(NDT_STAT_WRITE, start);
     if (err)
     {
         strerror_r(err, errbuf, sizeof(errbuf));
@@ -789,9 +920,63 @@ end:
     return err;
 }
 
-static ndt_route_leg* route_leg_direct(ndt_waypoint *src, ndt_waypoint *dst)
+typedef struct flightplan_writer
+{
+    ndt_flightplan         *flp;
+    ndt_flightplan_output  *out;
+    pthread_t            thread;
+    int                 started;
+} flightplan_writer;
+
+static void* flightplan_writer_main(void *arg)
 {
-    ndt_route_leg *leg = ndt_route_leg_init();
+    flightplan_writer *wrt = arg;
+    wrt->out->err = ndt_flightplan_write2(wrt->flp, wrt->out->sink, wrt->out->format);
+    return NULL;
+}
+
+int ndt_flightplan_writeall(ndt_flightplan *flp, ndt_flightplan_output *out, size_t count)
+{
+    flightplan_writer *wrt = NULL;
+    int                err = 0;
+
+    if (!flp || !out)
+    {
+        return ENOMEM;
+    }
+
+    /*
+     * The first output is written by the calling thread; if we can't start a
+     * thread for any of the others, the calling thread writes them too.
+     */
+    if (count > 1 && (wrt = calloc(count, sizeof(flightplan_writer))))
+    {
+        for (size_t i = 1; i < count; i++)
+        {
+            wrt[i].flp     = flp;
+            wrt[i].out     = &out[i];
+            wrt[i].started = !pthread_create(&wrt[i].thread, NULL, &flightplan_writer_main, &wrt[i]);
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (wrt && wrt[i].started)
+        {
+            pthread_join(wrt[i].thread, NULL);
+        }
+        else
+        {
+            out[i].err = ndt_flightplan_write2(flp, out[i].sink, out[i].format);
+        }
+        err = err ? err : out[i].err;
+    }
+    free(wrt);
+    return err;
+}
+
+static ndt_route_leg* route_leg_direct(ndt_waypoint *src, ndt_waypoint *dst, ndt_arena *arena)
+{
+    ndt_route_leg *leg = ndt_route_leg_init2(arena);
     if (leg && dst)
     {
         leg->type = NDT_LEGTYPE_TF;
@@ -817,7 +1002,7 @@ static int split_airways(ndt_flightplan *flp)
             {
                 if ((leg = ndt_list_item(rsg->legs, j)))
                 {
-                    if ((new_rsg = ndt_route_segment_init()) == NULL)
+                    if ((new_rsg = ndt_route_segment_init(flp->arena)) == NULL)
                     {
                         return ENOMEM;
                     }
@@ -891,7 +1076,7 @@ void* ndt_flightplan_insert_airway(ndt_flightplan *flp, ndt_waypoint  *src, ndt_
         {
             if (tmp == rsg)
             {
-                if ((rsg = ndt_route_segment_airway(src, dst, awy, in, out, flp->ndb)) == NULL)
+                if ((rsg = ndt_route_segment_airway(src, dst, awy, in, out, flp->ndb, flp->arena)) == NULL)
                 {
                     err = ENOMEM; goto end;
                 }
@@ -988,7 +1173,7 @@ void* ndt_flightplan_insert_direct(ndt_flightplan *flp, ndt_waypoint *wpt, void
                 (prev_dst = prev_leg->dst);
             }
         }
-        if ((new_rsg = ndt_route_segment_direct(prev_dst, wpt)) == NULL)
+        if ((new_rsg = ndt_route_segment_direct(prev_dst, wpt, flp->arena)) == NULL)
         {
             err = ENOMEM;
             goto end;
@@ -1024,7 +1209,7 @@ void* ndt_flightplan_insert_direct(ndt_flightplan *flp, ndt_waypoint *wpt, void
                 {
                     (prev_dst = prev_leg->dst);
                 }
-                if ((new_leg = route_leg_direct(prev_dst, wpt)) == NULL)
+                if ((new_leg = route_leg_direct(prev_dst, wpt, flp->arena)) == NULL)
                 {
                     err = ENOMEM;
                     goto end;
@@ -1041,7 +1226,7 @@ void* ndt_flightplan_insert_direct(ndt_flightplan *flp, ndt_waypoint *wpt, void
                 (prev_dst = prev_leg->dst);
             }
         }
-        if ((new_rsg = ndt_route_segment_direct(prev_dst, wpt)) == NULL)
+        if ((new_rsg = ndt_route_segment_direct(prev_dst, wpt, flp->arena)) == NULL)
         {
             err = ENOMEM;
             goto end;
@@ -1167,7 +1352,7 @@ void* ndt_flightplan_insert_direct(ndt_flightplan *flp, ndt_waypoint *wpt, void
         }
         if (insert_after)
         {
-            if ((new_leg = route_leg_direct(curr_leg->dst, wpt)) == NULL)
+            if ((new_leg = route_leg_direct(curr_leg->dst, wpt, flp->arena)) == NULL)
             {
                 err = ENOMEM;
                 goto end;
@@ -1175,7 +1360,7 @@ void* ndt_flightplan_insert_direct(ndt_flightplan *flp, ndt_waypoint *wpt, void
             ndt_list_insert(curr_rsg->legs, new_leg, insert_at_indx);
             goto end;
         }
-        if ((new_leg = route_leg_direct(prev_dst, wpt)) == NULL)
+        if ((new_leg = route_leg_direct(prev_dst, wpt, flp->arena)) == NULL)
         {
             err = ENOMEM;
             goto end;
@@ -1250,7 +1435,7 @@ void* ndt_flightplan_insert_direct(ndt_flightplan *flp, ndt_waypoint *wpt, void
         err = EINVAL;
         goto end;
     }
-    if ((new_rsg = ndt_route_segment_direct(prev_dst, wpt)) == NULL)
+    if ((new_rsg = ndt_route_segment_direct(prev_dst, wpt, flp->arena)) == NULL)
     {
         err = ENOMEM;
         goto end;
@@ -1457,13 +1642,26 @@ ndt_procedure* ndt_procedure_open(ndt_navdatabase *ndb, ndt_procedure *proc)
     {
         return  NULL;
     }
+    if (__atomic_load_n(&proc->opened, __ATOMIC_ACQUIRE))
+    {
+        return proc; // transitions are opened first, so they're all available
+    }
+    pthread_mutex_t *lock = proc->apt ? &proc->apt->lock : &ndb->lock;
+    pthread_mutex_lock(lock);
+    proc = procedure_open(ndb, proc);
+    pthread_mutex_unlock(lock);
+    return proc;
+}
+
+static ndt_procedure* procedure_open(ndt_navdatabase *ndb, ndt_procedure *proc)
+{
     switch (proc->type)
     {
         case NDT_PROCTYPE_SID_1:
         case NDT_PROCTYPE_SID_4:
             if (proc->transition.sid)
             {
-                if (ndt_procedure_open(ndb, proc->transition.sid) == NULL)
+                if (procedure_open(ndb, proc->transition.sid) == NULL)
                 {
                     return NULL;
                 }
@@ -1475,7 +1673,7 @@ ndt_procedure* ndt_procedure_open(ndt_navdatabase *ndb, ndt_procedure *proc)
         case NDT_PROCTYPE_STAR9:
             if (proc->transition.star)
             {
-                if (ndt_procedure_open(ndb, proc->transition.star) == NULL)
+                if (procedure_open(ndb, proc->transition.star) == NULL)
                 {
                     return NULL;
                 }
@@ -1713,15 +1911,16 @@ void ndt_procedure_trans(ndt_list *transitions, ndt_list *output)
     ndt_list_sort(output, sizeof(const char*), &compare_str);
 }
 
-ndt_route_segment* ndt_route_segment_init()
+ndt_route_segment* ndt_route_segment_init(ndt_arena *arena)
 {
-    ndt_route_segment *rsg = calloc(1, sizeof(ndt_route_segment));
+    ndt_route_segment *rsg = ndt_arena_alloc(arena, sizeof(ndt_route_segment));
     if (!rsg)
     {
         goto end;
     }
+    rsg->arena = arena;
 
-    rsg->legs = ndt_list_init();
+    rsg->legs = ndt_list_init2(arena);
     if (!rsg->legs)
     {
         goto end;
@@ -1751,15 +1950,47 @@ void ndt_route_segment_close(ndt_route_segment **_rsg)
             ndt_list_close(&rsg->legs);
         }
 
-        free(rsg);
+        ndt_arena_free(rsg->arena, rsg, sizeof(ndt_route_segment));
 
         *_rsg = NULL;
     }
 }
 
-ndt_route_segment* ndt_route_segment_airway(ndt_waypoint *src, ndt_waypoint *dst, ndt_airway *awy, ndt_airway_leg *in, ndt_airway_leg *out, ndt_navdatabase *ndb)
+/*
+ * The same airway legs recur across flight plans: look up their waypoints and
+ * compute their geometry once, then reuse them for every new route segment.
+ */
+static ndt_waypoint* airway_leg_lookup(ndt_navdatabase *ndb, ndt_airway_leg *awl)
 {
-    ndt_route_segment *rsg = ndt_route_segment_init();
+    if (__atomic_load_n(&awl->cache.valid, __ATOMIC_ACQUIRE))
+    {
+        return awl->cache.dst;
+    }
+
+    pthread_mutex_lock(&ndb->lock);
+    if (!awl->cache.valid)
+    {
+        ndt_position src = ndt_position_unpack(awl->in. position, NDT_DISTANCE_ZERO);
+        ndt_position dst = ndt_position_unpack(awl->out.position, NDT_DISTANCE_ZERO);
+        if ((awl->cache.dst = ndt_navdata_get_wpt4pos(ndb, awl->out.info.idnt, NULL, dst)))
+        {
+            if ((awl->cache.src = ndt_navdata_get_wpt4pos(ndb, awl->in.info.idnt, NULL, src)))
+            {
+                awl->cache.dis = ndt_position_calcdistance(awl->cache.src->position, awl->cache.dst->position);
+                awl->cache.trb = ndt_position_calcbearing (awl->cache.src->position, awl->cache.dst->position);
+                awl->cache.imb = ndt_wmm_getbearing_mag   (ndb->wmm, awl->cache.trb, awl->cache.dst->position);
+                awl->cache.omb = ndt_wmm_getbearing_mag   (ndb->wmm, awl->cache.trb, awl->cache.src->position);
+            }
+            __atomic_store_n(&awl->cache.valid, 1, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&ndb->lock);
+    return awl->cache.dst;
+}
+
+ndt_route_segment* ndt_route_segment_airway(ndt_waypoint *src, ndt_waypoint *dst, ndt_airway *awy, ndt_airway_leg *in, ndt_airway_leg *out, ndt_navdatabase *ndb, ndt_arena *arena)
+{
+    ndt_route_segment *rsg = ndt_route_segment_init(arena);
     if (!rsg)
     {
         goto fail;
@@ -1781,34 +2012,44 @@ ndt_route_segment* ndt_route_segment_airway(ndt_waypoint *src, ndt_waypoint *dst
 
     while (in)
     {
-        dst = ndt_navdata_get_wpt4pos(ndb, in->out.info.idnt, NULL, in->out.position);
+        ndt_position posn = ndt_position_unpack(in->out.position, NDT_DISTANCE_ZERO);
+        dst = airway_leg_lookup(ndb, in);
         if (!dst)
         {
             // navdata bug
             ndt_log("ndt_route_segment_airway:"
                     " waypoint '%s/%+010.6lf/%+011.6lf' not found for airway '%s'\n",
                     in->out.info.idnt,
-                    ndt_position_getlatitude (in->out.position, NDT_ANGUNIT_DEG),
-                    ndt_position_getlongitude(in->out.position, NDT_ANGUNIT_DEG),
+                    ndt_position_getlatitude (posn, NDT_ANGUNIT_DEG),
+                    ndt_position_getlongitude(posn, NDT_ANGUNIT_DEG),
                     awy->info.idnt);
             goto fail;
         }
 
-        ndt_route_leg *leg = ndt_route_leg_init();
+        ndt_route_leg *leg = ndt_route_leg_init2(arena);
         if (!leg)
         {
             goto fail;
         }
         // note: we must update split_airways too should we update this function
-        leg->dis     = ndt_position_calcdistance(src->position,   dst->position);
-        leg->trb     = ndt_position_calcbearing (src->position,   dst->position);
-        leg->imb     = ndt_wmm_getbearing_mag(ndb->wmm, leg->trb, dst->position);
-        leg->omb     = ndt_wmm_getbearing_mag(ndb->wmm, leg->trb, src->position);
         leg->type    = NDT_LEGTYPE_TF;
         leg->src     = src;
         leg->dst     = dst;
         leg->rsg     = rsg;
         leg->awyleg  = in;
+        if (src == in->cache.src)
+        {
+            // same endpoints, same geometry
+            leg->dis         = in->cache.dis;
+            leg->trb         = in->cache.trb;
+            leg->imb         = in->cache.imb;
+            leg->omb         = in->cache.omb;
+            leg->geom.src    = src;
+            leg->geom.dst    = dst;
+            leg->geom.srcpos = src->position;
+            leg->geom.dstpos = dst->position;
+        }
+        route_leg_coords(leg, ndb->wmm);
         ndt_list_add(rsg->legs, leg);
 
         if (in == out)
@@ -1829,14 +2070,14 @@ fail:
     return NULL;
 }
 
-ndt_route_segment* ndt_route_segment_direct(ndt_waypoint *src, ndt_waypoint *dst)
+ndt_route_segment* ndt_route_segment_direct(ndt_waypoint *src, ndt_waypoint *dst, ndt_arena *arena)
 {
     if (!dst)
     {
         goto fail;
     }
 
-    ndt_route_segment *rsg = ndt_route_segment_init();
+    ndt_route_segment *rsg = ndt_route_segment_init(arena);
     if (!rsg)
     {
         goto fail;
@@ -1868,7 +2109,7 @@ ndt_route_segment* ndt_route_segment_direct(ndt_waypoint *src, ndt_waypoint *dst
      *  }
      */
 
-    ndt_route_leg *leg = route_leg_direct(src, dst);
+    ndt_route_leg *leg = route_leg_direct(src, dst, arena);
     if (!leg)
     {
         goto fail;
@@ -1883,9 +2124,9 @@ fail:
     return NULL;
 }
 
-static ndt_route_leg* route_leg_discon(void)
+static ndt_route_leg* route_leg_discon(ndt_arena *arena)
 {
-    ndt_route_leg *leg = ndt_route_leg_init();
+    ndt_route_leg *leg = ndt_route_leg_init2(arena);
     if (leg)
     {
         leg->type = NDT_LEGTYPE_ZZ;
@@ -1895,9 +2136,9 @@ static ndt_route_leg* route_leg_discon(void)
     return leg;
 }
 
-ndt_route_segment* ndt_route_segment_discon(void)
+ndt_route_segment* ndt_route_segment_discon(ndt_arena *arena)
 {
-    ndt_route_segment *rsg = ndt_route_segment_init();
+    ndt_route_segment *rsg = ndt_route_segment_init(arena);
     if (!rsg)
     {
         goto fail;
@@ -1908,7 +2149,7 @@ ndt_route_segment* ndt_route_segment_discon(void)
     rsg->src  = NULL;
     rsg->dst  = NULL;
 
-    ndt_route_leg *leg = route_leg_discon();
+    ndt_route_leg *leg = route_leg_discon(arena);
     if (!leg)
     {
         goto fail;
@@ -1923,15 +2164,21 @@ fail:
     return NULL;
 }
 
-static ndt_route_leg* route_leg4procedure(ndt_route_leg *leg, ndt_waypoint *src)
+static ndt_route_leg* route_leg4procedure(ndt_route_leg *leg, ndt_waypoint *src, ndt_arena *arena)
 {
-    ndt_route_leg *copy = ndt_route_leg_init();
+    ndt_route_leg *copy = ndt_route_leg_init2(arena);
     if (!copy || !leg)
     {
         goto fail;
     }
 
     memcpy(copy, leg, sizeof(ndt_route_leg));
+    copy->arena = arena;
+
+    /* Dummies are computed per copy, but may be shared via the original leg */
+    struct ndt_xpfms_memo **memo = leg->xpfmc.memo ? leg->xpfmc.memo : &leg->xpfmc.shared;
+    memset(&copy->xpfmc, 0, sizeof(copy->xpfmc));
+    copy->xpfmc.memo = memo;
 
     /* Holds can be returned "as is" */
     if (copy->type == NDT_LEGTYPE_HF ||
@@ -1948,7 +2195,7 @@ static ndt_route_leg* route_leg4procedure(ndt_route_leg *leg, ndt_waypoint *src)
     }
 
     /* Other leg types may require dummy waypoints for navigation */
-    if (!(copy->xpfms = ndt_list_init()))
+    if (!(copy->xpfms = ndt_list_init2(arena)))
     {
         goto fail;
     }
@@ -1965,13 +2212,13 @@ fail:
     return NULL;
 }
 
-ndt_route_segment* ndt_route_segment_proced(ndt_waypoint *src, ndt_restriction *constraints, ndt_procedure *proc, ndt_navdatabase *ndb)
+ndt_route_segment* ndt_route_segment_proced(ndt_waypoint *src, ndt_restriction *constraints, ndt_procedure *proc, ndt_navdatabase *ndb, ndt_arena *arena)
 {
     size_t firstwpplus1 = 0;
     ndt_route_leg *rleg, *disc, *copy;
     ndt_restriction *skippedcstrs = NULL;
     ndt_list *proclegs = ndt_list_init();
-    ndt_route_segment *rsgt = ndt_route_segment_init();
+    ndt_route_segment *rsgt = ndt_route_segment_init(arena);
     if (!proc || !ndb || !proclegs || !rsgt)
     {
         goto fail;
@@ -2039,7 +2286,7 @@ ndt_route_segment* ndt_route_segment_proced(ndt_waypoint *src, ndt_restriction *
          *       KABQ's LARGO 2), else an incomplete procedure (e.g. inserted by
          *       ICAO route parser).
          */
-        if (!(disc = route_leg_discon()))
+        if (!(disc = route_leg_discon(arena)))
         {
             goto fail;
         }
@@ -2054,7 +2301,7 @@ ndt_route_segment* ndt_route_segment_proced(ndt_waypoint *src, ndt_restriction *
         if (!src)
         {
             /* Departure runway not set, threshold waypoint unavailable */
-            if (!(disc = route_leg_discon()))
+            if (!(disc = route_leg_discon(arena)))
             {
                 goto fail;
             }
@@ -2118,7 +2365,7 @@ ndt_route_segment* ndt_route_segment_proced(ndt_waypoint *src, ndt_restriction *
             /* We need a discontinuity, unless we already have one */
             if (src)
             {
-                if (!(disc = route_leg_discon()))
+                if (!(disc = route_leg_discon(arena)))
                 {
                     goto fail;
                 }
@@ -2134,7 +2381,7 @@ ndt_route_segment* ndt_route_segment_proced(ndt_waypoint *src, ndt_restriction *
             }
             if (rleg->src)
             {
-                if (!(copy = route_leg_direct(NULL, rleg->src)))
+                if (!(copy = route_leg_direct(NULL, rleg->src, arena)))
                 {
                     goto fail;
                 }
@@ -2175,7 +2422,7 @@ ndt_route_segment* ndt_route_segment_proced(ndt_waypoint *src, ndt_restriction *
         }
 
         /* Copy leg from procedure to segment and adjust as required */
-        if (!(copy = route_leg4procedure(rleg, src)))
+        if (!(copy = route_leg4procedure(rleg, src, arena)))
         {
             goto fail;
         }
@@ -2186,7 +2433,7 @@ ndt_route_segment* ndt_route_segment_proced(ndt_waypoint *src, ndt_restriction *
         /* Manual termination (expect VECTORS); append discontinuity */
         if (copy->type == NDT_LEGTYPE_FM || copy->type == NDT_LEGTYPE_VM)
         {
-            if (!(disc = route_leg_discon()))
+            if (!(disc = route_leg_discon(arena)))
             {
                 goto fail;
             }
@@ -2201,10 +2448,12 @@ ndt_route_segment* ndt_route_segment_proced(ndt_waypoint *src, ndt_restriction *
     {
         *constraints = *skippedcstrs;
     }
+    ndt_list_close(&proclegs);
     return rsgt;
 
 fail:
     ndt_route_segment_close(&rsgt);
+    ndt_list_close     (&proclegs);
     return NULL;
 }
 
@@ -2225,11 +2474,17 @@ ndt_restriction ndt_leg_const_init(void)
 
 ndt_route_leg* ndt_route_leg_init()
 {
-    ndt_route_leg *leg = calloc(1, sizeof(ndt_route_leg));
+    return ndt_route_leg_init2(NULL);
+}
+
+ndt_route_leg* ndt_route_leg_init2(ndt_arena *arena)
+{
+    ndt_route_leg *leg = ndt_arena_alloc(arena, sizeof(ndt_route_leg));
     if (!leg)
     {
         goto end;
     }
+    leg->arena = arena;
 
     leg->constraints = ndt_leg_const_init();
     leg->type        = NDT_LEGTYPE_ZZ;
@@ -2248,8 +2503,9 @@ void ndt_route_leg_close(ndt_route_leg **_leg)
         {
             ndt_list_close(&leg->xpfms);
         }
+        free(leg->xpfmc.shared);
 
-        free(leg);
+        ndt_arena_free(leg->arena, leg, sizeof(ndt_route_leg));
 
         *_leg = NULL;
     }
@@ -2376,7 +2632,7 @@ int ndt_route_leg_restrict(ndt_route_leg *leg, ndt_restriction constraints)
 }
 
 static int endpoint_intcpt(ndt_list *xpfms,
-                           ndt_list *cwlst,
+                           ndt_list *cwlst, ndt_arena *arena,
                            void *wmm,
                            int curr_type, int next_type,
                            ndt_waypoint *src1, double brg1,
@@ -2509,7 +2765,7 @@ force_intercept:
     goto endpoint;
 
 endpoint:
-    if (!(wpt = ndt_waypoint_pbpb(src1, brg1, src2, brg2, wmm)))
+    if (!(wpt = ndt_waypoint_pbpb(src1, brg1, src2, brg2, wmm, arena)))
     {
         return ENOMEM;
     }
@@ -2524,7 +2780,7 @@ endpoint:
     return 0;
 }
 
-static int endpoint_radial(ndt_list *xpfms, ndt_list *cwlst, void *wmm,
+static int endpoint_radial(ndt_list *xpfms, ndt_list *cwlst, ndt_arena *arena, void *wmm,
                            ndt_waypoint *src,    double bearing,
                            ndt_waypoint *navaid, double radial)
 {
@@ -2564,7 +2820,7 @@ static int endpoint_radial(ndt_list *xpfms, ndt_list *cwlst, void *wmm,
         ndt_list_add(xpfms, navaid);
         return 0;
     }
-    ndt_waypoint *wpt = ndt_waypoint_pbpb(src, bearing, navaid, radial, wmm);
+    ndt_waypoint *wpt = ndt_waypoint_pbpb(src, bearing, navaid, radial, wmm, arena);
     if (!wpt)
     {
         return ENOMEM;
@@ -2576,7 +2832,7 @@ static int endpoint_radial(ndt_list *xpfms, ndt_list *cwlst, void *wmm,
     return 0;
 }
 
-static int endpoint_dmedis(ndt_list *xpfms, ndt_list *cwlst, void *wmm, ndt_waypoint *src,
+static int endpoint_dmedis(ndt_list *xpfms, ndt_list *cwlst, ndt_arena *arena, void *wmm, ndt_waypoint *src,
                            ndt_waypoint *dmenav, double bearing, ndt_distance dmedis)
 {
     if (!xpfms || !cwlst || !wmm)
@@ -2587,7 +2843,7 @@ static int endpoint_dmedis(ndt_list *xpfms, ndt_list *cwlst, void *wmm, ndt_wayp
     {
         return EINVAL;
     }
-    ndt_waypoint *wpt = ndt_waypoint_pbpd(src, bearing, dmenav, dmedis, wmm);
+    ndt_waypoint *wpt = ndt_waypoint_pbpd(src, bearing, dmenav, dmedis, wmm, arena);
     if (!wpt)
     {
         return ENOMEM;
@@ -2600,7 +2856,7 @@ static int endpoint_dmedis(ndt_list *xpfms, ndt_list *cwlst, void *wmm, ndt_wayp
     return 0;
 }
 
-static int endpoint_altitd(ndt_list *xpfms, ndt_list *cwlst, void *wmm, ndt_waypoint *src,
+static int endpoint_altitd(ndt_list *xpfms, ndt_list *cwlst, ndt_arena *arena, void *wmm, ndt_waypoint *src,
                            double bearing, ndt_distance altfrom, ndt_distance altstop, ndt_distance rwyl)
 {
     if (!xpfms || !cwlst || !wmm)
@@ -2625,7 +2881,7 @@ static int endpoint_altitd(ndt_list *xpfms, ndt_list *cwlst, void *wmm, ndt_wayp
         // descending 3.0° (1 vertical feet per 15 horizontal feet)
         dist = ndt_distance_init(ndt_distance_get(diff, NDT_ALTUNIT_NA) * -15LL, NDT_ALTUNIT_NA);
     }
-    if (!(wpt = ndt_waypoint_pbd(src, bearing, dist, wmm)))
+    if (!(wpt = ndt_waypoint_pbd(src, bearing, dist, wmm, arena)))
     {
         return ENOMEM;
     }
@@ -2636,6 +2892,134 @@ static int endpoint_altitd(ndt_list *xpfms, ndt_list *cwlst, void *wmm, ndt_wayp
     return 0;
 }
 
+/*
+ * Dummies computed for a procedure leg, in a given context (starting position,
+ * altitude and runway); immutable once published, freed along with the leg.
+ *
+ * Keyed on the starting point's position, not the waypoint: after a procedure's
+ * first leg, it's the previous leg's last dummy, which belongs to a single plan.
+ */
+typedef struct ndt_xpfms_memo
+{
+    int           type;
+    ndt_position srcpos;
+    ndt_distance    alt;
+    ndt_runway     *rwy;
+    double          brg;         // PI legs: final course
+    size_t        count;
+    struct
+    {
+        ndt_waypoint *ref;       // not a dummy (e.g. navaid), use it "as is"
+        ndt_waypoint  tpl;       // else, dummy template
+    } items[];
+} ndt_xpfms_memo;
+
+size_t ndt_route_leg_memosize(ndt_route_leg *leg)
+{
+    // procedure legs only: the memo published for flight plans to share, if any
+    ndt_xpfms_memo *memo = leg ? __atomic_load_n(&leg->xpfmc.shared, __ATOMIC_ACQUIRE) : NULL;
+    return memo ? sizeof(ndt_xpfms_memo) + memo->count * sizeof(memo->items[0]) : 0;
+}
+
+static int leg_altitude_based(int type)
+{
+    return (type == NDT_LEGTYPE_CA || type == NDT_LEGTYPE_FA || type == NDT_LEGTYPE_VA);
+}
+
+static int route_leg_memoget(ndt_flightplan *flp, ndt_route_leg *leg, ndt_waypoint *src, ndt_distance alt, ndt_runway *rwy, double *brg)
+{
+    ndt_xpfms_memo *memo = leg->xpfmc.memo ? __atomic_load_n(leg->xpfmc.memo, __ATOMIC_ACQUIRE) : NULL;
+    if (!memo || memo->type != leg->type || memo->rwy != rwy ||
+        memcmp(&memo->srcpos, &src->position, sizeof(ndt_position)) ||
+        (leg_altitude_based(leg->type) && memcmp(&memo->alt, &alt, sizeof(ndt_distance))))
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < memo->count; i++)
+    {
+        ndt_waypoint *wpt = memo->items[i].ref;
+        if (!wpt)
+        {
+            if (!(wpt = ndt_waypoint_init2(flp->arena)))
+            {
+                route_leg_xpfmrm(flp, leg, 0);
+                return 0;
+            }
+            memcpy(wpt, &memo->items[i].tpl, sizeof(ndt_waypoint));
+            ndt_list_add(flp->cws, wpt);
+        }
+        ndt_list_add(leg->xpfms, wpt);
+    }
+    *brg = memo->brg;
+    return 1;
+}
+
+static void route_leg_memoput(ndt_flightplan *flp, ndt_route_leg *leg, ndt_waypoint *src, ndt_distance alt, ndt_runway *rwy, double brg)
+{
+    ndt_xpfms_memo *memo = NULL, *none = NULL;
+    size_t         count = ndt_list_count(leg->xpfms);
+    if (!leg->xpfmc.memo || __atomic_load_n(leg->xpfmc.memo, __ATOMIC_ACQUIRE))
+    {
+        return; // not a procedure leg, or dummies already shared (first one wins)
+    }
+    if (!(memo = calloc(1, sizeof(ndt_xpfms_memo) + count * sizeof(memo->items[0]))))
+    {
+        return;
+    }
+    memo->type   = leg->type;
+    memo->srcpos = src->position;
+    memo->alt    = alt;
+    memo->rwy    = rwy;
+    memo->brg    = brg;
+    memo->count  = count;
+    for (size_t i = 0; i < count; i++)
+    {
+        ndt_waypoint *wpt = ndt_list_item(leg->xpfms, i);
+        if (!wpt->arena) // not ours (e.g. navaids)
+        {
+            memo->items[i].ref = wpt;
+            continue;
+        }
+        memcpy(&memo->items[i].tpl, wpt, sizeof(ndt_waypoint));
+        memset(&memo->items[i].tpl.pbpb, 0, sizeof(memo->items[i].tpl.pbpb)); // may reference our waypoints
+    }
+    if (!__atomic_compare_exchange_n(leg->xpfmc.memo, &none, memo, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    {
+        free(memo); // another thread was faster
+    }
+}
+
+/*
+ * A leg's dummies depend on its starting point and neighbours (intercepts); if
+ * none of them changed, it needn't be recomputed (see route_leg_update).
+ */
+static int route_leg_xpfmok(ndt_route_leg *leg, ndt_route_leg *prv, ndt_route_leg *nxt, ndt_waypoint *src, ndt_distance alt)
+{
+    return (leg->xpfmc.valid    && leg->xpfmc.type == leg->type &&
+            leg->xpfmc.prv == prv && leg->xpfmc.nxt == nxt && (!nxt || nxt->xpfmc.prv == leg) &&
+            leg->xpfmc.src == src && (!src || !memcmp(&leg->xpfmc.srcpos, &src->position, sizeof(ndt_position))) &&
+            (!leg_altitude_based(leg->type) || !memcmp(&leg->xpfmc.alt, &alt, sizeof(ndt_distance))));
+}
+
+/*
+ * Remove a leg's dummies, except the first keep ones (the previous leg's);
+ * waypoints we don't own (e.g. navaids) are removed from the list only.
+ */
+static void route_leg_xpfmrm(ndt_flightplan *flp, ndt_route_leg *leg, size_t keep)
+{
+    while (ndt_list_count(leg->xpfms) > keep)
+    {
+        ndt_waypoint *wpt = ndt_list_item(leg->xpfms, -1);
+        size_t      count = ndt_list_count(flp->cws);
+        ndt_list_rem(leg->xpfms, wpt);
+        ndt_list_rem(flp->cws,   wpt);
+        if (ndt_list_count(flp->cws) < count)
+        {
+            ndt_waypoint_close2(&wpt, flp->arena);
+        }
+    }
+}
+
 /*
  * Notes.
  *
@@ -2666,7 +3050,7 @@ static ndt_waypoint* route_leg_xpfms(ndt_flightplan *flp,
     int            err = 0;
     ndt_waypoint  *wpt;
     void          *wmm;
-    double pi_finalbrg;
+    double pi_finalbrg = 0.;
 
     if (!flp || !legsrc || !leg || !_alt || !(wmm = flp->ndb->wmm))
     {
@@ -2700,10 +3084,6 @@ static ndt_waypoint* route_leg_xpfms(ndt_flightplan *flp,
         }
     }
 
-    /*
-     * Note: if we want to recalculate some legs every time,
-     * then empty their xpfms list here and goto as required.
-     */
     switch (leg->type)
     {
         case NDT_LEGTYPE_AF:
@@ -2741,7 +3121,7 @@ static ndt_waypoint* route_leg_xpfms(ndt_flightplan *flp,
      * Calculate dummy waypoints for complex legs.
      */
 dummies:
-    if (ndt_list_count(leg->xpfms))
+    if (leg->xpfmc.valid || ndt_list_count(leg->xpfms))
     {
         goto altitude;
     }
@@ -2750,6 +3130,10 @@ dummies:
         err = EINVAL;
         goto end;
     }
+    if (route_leg_memoget(flp, leg, legsrc, *_alt, rwy, &pi_finalbrg))
+    {
+        goto intc; // same dummies as another flight plan's copy of this leg
+    }
     if (leg->type == NDT_LEGTYPE_CA ||
         leg->type == NDT_LEGTYPE_FA ||
         leg->type == NDT_LEGTYPE_VA)
@@ -2773,12 +3157,12 @@ dummies:
             default:
                 break; // compiler warning…
         }
-        if ((err = endpoint_altitd(leg->xpfms, flp->cws, wmm, legsrc, brg,
+        if ((err = endpoint_altitd(leg->xpfms, flp->cws, flp->arena, wmm, legsrc, brg,
                                    *_alt, alt, rwy ? rwy->length : NDT_DISTANCE_ZERO)))
         {
             goto end;
         }
-        goto intc;
+        goto memo;
     }
     if (leg->type == NDT_LEGTYPE_CD ||
         leg->type == NDT_LEGTYPE_FD ||
@@ -2816,12 +3200,12 @@ dummies:
             err = EINVAL;
             goto end;
         }
-        if ((err = endpoint_dmedis(leg->xpfms, flp->cws,
+        if ((err = endpoint_dmedis(leg->xpfms, flp->cws, flp->arena,
                                    wmm, src, nav, brg, dme)))
         {
             goto end;
         }
-        goto intc;
+        goto memo;
     }
     if (leg->type == NDT_LEGTYPE_CR ||
         leg->type == NDT_LEGTYPE_VR)
@@ -2849,18 +3233,18 @@ dummies:
             err = EINVAL;
             goto end;
         }
-        if ((err = endpoint_radial(leg->xpfms, flp->cws,
+        if ((err = endpoint_radial(leg->xpfms, flp->cws, flp->arena,
                                    wmm, legsrc, brg, nav, rad)))
         {
             goto end;
         }
-        goto intc;
+        goto memo;
     }
     if (leg->type == NDT_LEGTYPE_FC)
     {
         if (!(wpt = ndt_waypoint_pbd(legsrc,
                                      leg->fix.course,
-                                     leg->fix.distance, wmm)))
+                                     leg->fix.distance, wmm, flp->arena)))
         {
             err = ENOMEM;
             goto end;
@@ -2868,7 +3252,7 @@ dummies:
         wpt->type = NDT_WPTYPE_LLC;
         ndt_list_add(leg->xpfms, wpt);
         ndt_list_add(flp->cws,   wpt);
-        goto intc;
+        goto memo;
     }
     if (leg->type == NDT_LEGTYPE_AF)
     {
@@ -2898,7 +3282,7 @@ dummies:
         {
             double radial = ndt_mod(leg->arc.start + ((double)i * stp), 360.);
             if (!(wpt = ndt_waypoint_pbd(leg->arc.center, radial,
-                                         leg->arc.distance, wmm)))
+                                         leg->arc.distance, wmm, flp->arena)))
             {
                 err = ENOMEM;
                 goto end;
@@ -2908,7 +3292,7 @@ dummies:
                                                             wpt->position), NDT_ALTUNIT_NM))
             {
                 // wpt too close to legsrc and we'll have another, skip this one
-                ndt_waypoint_close(&wpt);
+                ndt_waypoint_close2(&wpt, flp->arena);
                 continue;
             }
             wpt->type = NDT_WPTYPE_LLC;
@@ -2919,7 +3303,7 @@ dummies:
             ndt_list_add(leg->xpfms, wpt);
             ndt_list_add(flp->cws,   wpt);
         }
-        goto intc;
+        goto memo;
     }
     if (leg->type == NDT_LEGTYPE_RF)
     {
@@ -2949,7 +3333,7 @@ dummies:
         {
             double bearing = ndt_mod(start + ((double)i * rstep), 360.);
             if (!(wpt = ndt_waypoint_pbd(leg->radius.center, bearing,
-                                         leg->radius.distance, wmm)))
+                                         leg->radius.distance, wmm, flp->arena)))
             {
                 err = ENOMEM;
                 goto end;
@@ -2962,7 +3346,7 @@ dummies:
             ndt_list_add(leg->xpfms, wpt);
             ndt_list_add(flp->cws,   wpt);
         }
-        goto intc;
+        goto memo;
     }
     if (leg->type == NDT_LEGTYPE_PI) // TODO: re-write
     {
@@ -2972,7 +3356,7 @@ dummies:
         ndt_waypoint *wpt1, *wpt2, *wpt3;
         ndt_distance  dist = leg->turn.outdis;
         double        brng = leg->turn.outbrg;
-        if (!(wpt1 = ndt_waypoint_pbd(leg->turn.waypoint, brng, dist, wmm)))
+        if (!(wpt1 = ndt_waypoint_pbd(leg->turn.waypoint, brng, dist, wmm, flp->arena)))
         {
             err = ENOMEM;
             goto end;
@@ -2989,7 +3373,7 @@ dummies:
          */
         dist = ndt_distance_init(INT64_C(12500), NDT_ALTUNIT_FT); // turn diameter (TAS ~181 w/bank 25)
         brng = brng + leg->turn.tangle;
-        if (!(wpt2 = ndt_waypoint_pbd(wpt1, brng, dist, wmm)))
+        if (!(wpt2 = ndt_waypoint_pbd(wpt1, brng, dist, wmm, flp->arena)))
         {
             err = ENOMEM;
             goto end;
@@ -3004,7 +3388,7 @@ dummies:
          */
         dist = ndt_distance_init(INT64_C(12500), NDT_ALTUNIT_FT); // turn diameter (TAS ~181 w/bank 25)
         brng = brng - leg->turn.tangle / 2.;
-        if (!(wpt3 = ndt_waypoint_pbd(wpt1, brng, dist, wmm)))
+        if (!(wpt3 = ndt_waypoint_pbd(wpt1, brng, dist, wmm, flp->arena)))
         {
             err = ENOMEM;
             goto end;
@@ -3018,18 +3402,28 @@ dummies:
          */
         double tbrg = ndt_position_calcbearing(wpt2->position, wpt3->position);
         pi_finalbrg = ndt_wmm_getbearing_mag  (     wmm, tbrg, wpt2->position);
-        goto intc;
+        goto memo;
     }
 
+    /*
+     * Share the dummies with other copies of the same procedure leg.
+     */
+memo:
+    route_leg_memoput(flp, leg, legsrc, *_alt, rwy, pi_finalbrg);
+    goto intc;
+
     /*
      * Compute explicit or implicit intercept course
      * to the next leg, and add waypoint if required.
      *
      * nxt must be course-defined and have a fix as either its start or endpoint.
      * Note: nxt w/type DF is implicitly course-defined if leg is course-defined.
+     *
+     * Dummies (ours, and those we insert in nxt's xpfms list) are still valid
+     * if neither this leg nor its neighbours changed (see route_leg_update).
      */
 intc:
-    if (!nxt)
+    if (!nxt || leg->xpfmc.valid)
     {
         goto altitude;
     }
@@ -3166,7 +3560,7 @@ intc:
      *         CF,KLO,47.45713889,8.54558333,1,KLO,0.0,0.0,255,4.00,2,4000,0,1,210,0,0,0
      *         // turn left to KLO, but QPAC plugin defaults right (A350 v1.2.1)
      */
-    if ((err = endpoint_intcpt(xpfm, flp->cws, wmm,
+    if ((err = endpoint_intcpt(xpfm, flp->cws, flp->arena, wmm,
                                leg->type, nxt->type,
                                src1, brg1, src2, brg2, intc)))
     {
@@ -3280,7 +3674,7 @@ intc_drect:
     {
         // http://www.csgnetwork.com/aircraftturninfocalc.html
         dctd = ndt_distance_init(INT64_C(25000), NDT_ALTUNIT_FT); // turn diameter (TAS ~256 w/bank 25)
-        if (!(wpt = ndt_waypoint_pbd(nxt->dst, brg1, dctd, wmm)))
+        if (!(wpt = ndt_waypoint_pbd(nxt->dst, brg1, dctd, wmm, flp->arena)))
         {
             err = ENOMEM;
             goto end;
@@ -3300,7 +3694,7 @@ intc_drect:
             default:
                 goto altitude;
         }
-        if (!(wpt = ndt_waypoint_pbd(nxt->dst, brg1, dctd, wmm)))
+        if (!(wpt = ndt_waypoint_pbd(nxt->dst, brg1, dctd, wmm, flp->arena)))
         {
             err = ENOMEM;
             goto end;
@@ -3338,11 +3732,11 @@ intc_drect:
         }
         if (angl < 0.)
         {
-            wpt = ndt_waypoint_pbd(src1, ndt_mod(brg1 - 90., 360.), dctd, wmm);
+            wpt = ndt_waypoint_pbd(src1, ndt_mod(brg1 - 90., 360.), dctd, wmm, flp->arena);
         }
         else
         {
-            wpt = ndt_waypoint_pbd(src1, ndt_mod(brg1 + 90., 360.), dctd, wmm);
+            wpt = ndt_waypoint_pbd(src1, ndt_mod(brg1 + 90., 360.), dctd, wmm, flp->arena);
         }
         if (!wpt)
         {
@@ -3371,7 +3765,8 @@ altitude:
     {
         // some compilers dislike variable declarations after a label
     }
-    int ptype = leg->rsg->prc ? leg->rsg->prc->type : NDT_PROCTYPE_ENRTE;
+    int ptype = ((leg->rsg->type == NDT_RSTYPE_PRC || leg->rsg->type == NDT_RSTYPE_MAP) && // prc: union w/awy
+                 (leg->rsg->prc)) ? leg->rsg->prc->type : NDT_PROCTYPE_ENRTE;
     int64_t horiz, alt_prev = ndt_distance_get(*_alt, NDT_ALTUNIT_FT);
     ndt_distance climb, desct, interdis, totaldis = NDT_DISTANCE_ZERO;
     ndt_waypoint *dst_wpt, *src_wpt = legsrc;
@@ -3619,14 +4014,204 @@ static int list_add_legs(ndt_list *list, ndt_list *legs)
     return 0;
 }
 
+static void route_leg_coords(ndt_route_leg *leg, void *wmm)
+{
+    /*
+     * Distance, bearings (two WMM lookups) are the costliest part of updating
+     * a leg; most edits only change a few legs' endpoints (the edited legs and
+     * their immediate neighbours), so only recompute them when they changed.
+     */
+    if (leg->geom.src == leg->src && !memcmp(&leg->geom.srcpos, &leg->src->position, sizeof(ndt_position)) &&
+        leg->geom.dst == leg->dst && !memcmp(&leg->geom.dstpos, &leg->dst->position, sizeof(ndt_position)))
+    {
+        return;
+    }
+    leg->dis         = ndt_position_calcdistance(leg->src->position, leg->dst->position);
+    leg->trb         = ndt_position_calcbearing (leg->src->position, leg->dst->position);
+    leg->imb         = ndt_wmm_getbearing_mag   (     wmm, leg->trb, leg->dst->position);
+    leg->omb         = ndt_wmm_getbearing_mag   (     wmm, leg->trb, leg->src->position);
+    leg->geom.src    = leg->src;
+    leg->geom.dst    = leg->dst;
+    leg->geom.srcpos = leg->src->position;
+    leg->geom.dstpos = leg->dst->position;
+}
+
+static int route_leg_overlap(ndt_flightplan *flp)
+{
+    /*
+     * Resolve some overlaps; e.g. at KLAX:
+     * - SADDE6 STAR: SADDE BAYST SMO JAVSI
+     * - ILS 24L, SMO transition: SMO SAPPI JULLI
+     * We try to merge this to: SADDE BAYST SMO SAPPI JULLI
+     *
+     * Future: in the above case, we remove legs from the STAR; if we change
+     *         the approach/trans., we must remember to reload the STAR too.
+     *
+     * For each leg (with fix-based termination), the overlap is closed by the
+     * first later leg ending at the same fix, provided said leg is an IF or is
+     * marked as IAF, and isn't a hold (we don't handle overlaps when a manual
+     * discontinuity is present); any leg between leg (included) and the later
+     * leg (not included) is removed, then we resume at the later leg.
+     *
+     * A later leg's overlap is never affected by the legs removed before it,
+     * so we can find every leg's candidate in a single (reverse) pass, using
+     * a map of each fix to the nearest later leg closing an overlap at it.
+     */
+    ndt_route_leg *leg, **legs = NULL;
+    ndt_waypoint **keys = NULL;
+    size_t        *vals = NULL, *next = NULL, *disc = NULL;
+    size_t count = ndt_list_count(flp->legs), mask, removed = 0;
+    int    err   = 0;
+
+    if (count < 2)
+    {
+        goto end;
+    }
+    for (mask = 15; mask < 2 * count; mask = mask * 2 + 1)
+    {
+        continue;
+    }
+    if (!(legs = malloc(sizeof(*legs) * count))    ||
+        !(next = malloc(sizeof(*next) * count))    ||
+        !(disc = malloc(sizeof(*disc) * count))    ||
+        !(keys = calloc(mask + 1, sizeof(*keys)))  ||
+        !(vals = malloc(sizeof(*vals) * (mask + 1))))
+    {
+        err = ENOMEM;
+        goto end;
+    }
+
+    for (size_t i = count, d = count; i > 0; i--)
+    {
+        if (!(leg = legs[i - 1] = ndt_list_item(flp->legs, i - 1)))
+        {
+            err = ENOMEM;
+            goto end;
+        }
+        size_t h = leg->dst ? ((uintptr_t)leg->dst >> 4) * 2654435761u & mask : 0;
+        if (leg->dst)
+        {
+            while (keys[h] && keys[h] != leg->dst)
+            {
+                h = (h + 1) & mask;
+            }
+        }
+        next[i - 1] = leg->dst && keys[h] ? vals[h] : count;
+        disc[i - 1] = d;
+        if (leg->rsg && leg->rsg->type == NDT_RSTYPE_DSC)
+        {
+            d = i - 1; // manual disc.: no overlap across it
+            continue;
+        }
+        if ((leg->dst) &&
+            (leg->type != NDT_LEGTYPE_HA &&
+             leg->type != NDT_LEGTYPE_HF &&
+             leg->type != NDT_LEGTYPE_HM) &&
+            (leg->                type == NDT_LEGTYPE_IF ||
+             leg->constraints.waypoint == NDT_WPTCONST_IAF))
+        {
+            keys[h] = leg->dst;
+            vals[h] = i - 1;
+        }
+    }
+
+    for (size_t i = 0; i + 1 < count;)
+    {
+        if (legs[i]->dst && next[i] < disc[i])
+        {
+            for (size_t j = i; j < next[i]; j++)
+            {
+                if (!legs[j]->rsg)
+                {
+                    err = ENOMEM;
+                    goto end;
+                }
+                ndt_list_rem(legs[j]->rsg->legs, legs[j]);
+                ndt_route_leg_close            (&legs[j]);
+                removed++;
+            }
+            i = next[i];
+            continue;
+        }
+        i++;
+    }
+
+    if (removed)
+    {
+        ndt_list_empty(flp->legs);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (legs[i])
+            {
+                ndt_list_add(flp->legs, legs[i]);
+            }
+        }
+    }
+
+end:
+    free(legs);
+    free(keys);
+    free(vals);
+    free(next);
+    free(disc);
+    return err;
+}
+
+typedef struct ndt_route_upd
+{
+    ndt_route_leg *leg;
+    ndt_waypoint  *dst;     // leg's endpoint (and its position)
+    ndt_position   dstpos;
+    ndt_waypoint  *legsrc;  // dummy xpfms state after leg
+    ndt_distance   altitud;
+} ndt_route_upd;
+
+static size_t route_leg_dirty(ndt_flightplan *flp, ndt_waypoint *dep)
+{
+    /*
+     * Edits insert, remove or replace legs (or their route segments), they
+     * don't modify them; a leg whose list position and endpoint match those
+     * recorded by the last update, and every leg before it too, is unchanged.
+     * New legs (even if allocated at a previous leg's address) aren't valid.
+     *
+     * Returns the first leg to update: the leg before the first changed one
+     * (its dummies depend on the next leg), or the leg count if none changed.
+     */
+    size_t count = ndt_list_count(flp->legs), i = 0;
+    if (flp->upd.dep != dep || memcmp(&flp->upd.deppos, &dep->position, sizeof(ndt_position)))
+    {
+        return 0;
+    }
+    for (; i < count && i < flp->upd.count; i++)
+    {
+        ndt_route_leg *leg = ndt_list_item(flp->legs, i);
+        ndt_route_upd *upd = &flp->upd.legs[i];
+        if (!leg || leg != upd->leg || !leg->xpfmc.valid || leg->dst != upd->dst ||
+            (leg->dst && memcmp(&upd->dstpos, &leg->dst->position, sizeof(ndt_position))))
+        {
+            break;
+        }
+    }
+    if (i == count && i == flp->upd.count)
+    {
+        return count;
+    }
+    return i ? i - 1 : 0;
+}
+
 static int route_leg_update(ndt_flightplan *flp)
 {
-    int  err = 0;
+    int64_t start = ndt_stats_begin();
+    int       err = 0;
     if (!flp)
     {
         err = ENOMEM;
         goto end;
     }
+    if (flp->check.cb)
+    {
+        goto end; // validation only, legs not needed
+    }
 
     /* Flightplan's leg list doesn't own the legs, so cleanup is easy */
     ndt_list_empty(flp->legs);
@@ -3686,84 +4271,26 @@ static int route_leg_update(ndt_flightplan *flp)
         goto end;
     }
 
-    /*
-     * Resolve some overlaps; e.g. at KLAX:
-     * - SADDE6 STAR: SADDE BAYST SMO JAVSI
-     * - ILS 24L, SMO transition: SMO SAPPI JULLI
-     * We try to merge this to: SADDE BAYST SMO SAPPI JULLI
-     *
-     * Future: in the above case, we remove legs from the STAR; if we change
-     *         the approach/trans., we must remember to reload the STAR too.
-     *
-     * Note: size_t is unsigned and ndt_list_count() may return 0, so compare
-     *       i + 1 to ndt_list_count() rather than i to ndt_list_count() - 1.
-     */
-    ndt_route_leg *leg;
-    for (size_t i = 0; i + 1 < ndt_list_count(flp->legs); i++)
+    if ((err = route_leg_overlap(flp)))
     {
-        if (!(leg = ndt_list_item(flp->legs, i)))
-        {
-            err = ENOMEM;
-            goto end;
-        }
-        if (!leg->dst)
-        {
-            continue; // leg without fix-based termination
-        }
-        for (size_t j = i + 1; j < ndt_list_count(flp->legs); j++)
-        {
-            ndt_route_leg *fleg = ndt_list_item(flp->legs, j);
-            if (!fleg)
-            {
-                err = ENOMEM;
-                goto end;
-            }
-            if (fleg->rsg && fleg->rsg->type == NDT_RSTYPE_DSC)
-            {
-                break; // don't handle overlaps when a manual disc. is present
-            }
-            if (!fleg->dst)
-            {
-                continue; // leg without fix-based termination
-            }
-            if ((fleg->dst == leg->dst) &&
-                (fleg->type != NDT_LEGTYPE_HA &&
-                 fleg->type != NDT_LEGTYPE_HF &&
-                 fleg->type != NDT_LEGTYPE_HM) &&
-                (fleg->                type == NDT_LEGTYPE_IF ||
-                 fleg->constraints.waypoint == NDT_WPTCONST_IAF))
-            {
-                // we have an overlap and the incriminating fix is marked as
-                // IAF in the future leg closing the overlap, remove any leg
-                // between leg (included) and fleg (not included)
-                // also remember k unsigned (same issue as above)
-                for (size_t k = j; k > i; k--)
-                {
-                    ndt_route_leg *skip = ndt_list_item(flp->legs, k - 1);
-                    if (!skip || !skip->rsg)
-                    {
-                        err = ENOMEM;
-                        goto end;
-                    }
-                    ndt_list_rem(skip->rsg->legs, skip);
-                    ndt_list_rem(flp->      legs, skip);
-                    ndt_route_leg_close         (&skip);
-                }
-                i--; break; // fleg (next in the i loop) ends up at index ((i--)++)
-            }
-        }
-        // we're here after the break (or if no overlap found)
-        continue;
+        goto end;
     }
 
     /*
+     * Only update legs from the first one affected by edits since the last
+     * update (see route_leg_dirty), the previous ones are still up to date.
+     *
      * Ensure endpoint consistency (if e.g. legs were added or removed);
      * the initial waypoint is always the departure airport or runway.
      */
+    ndt_route_leg *leg;
     void         *wmm = flp->ndb->wmm;
     ndt_date      now = ndt_date_now();
-    ndt_waypoint *src = flp->dep.rwy ? flp->dep.rwy->waypoint : flp->dep.apt->waypoint;
-    for (size_t i = 0; i < ndt_list_count(flp->legs); i++)
+    ndt_waypoint *dep = flp->dep.rwy ? flp->dep.rwy->waypoint : flp->dep.apt->waypoint;
+    size_t      dirty = route_leg_dirty(flp, dep);
+    ndt_waypoint *src = dirty ? ((ndt_route_leg*)ndt_list_item(flp->legs, dirty - 1))->dst : dep;
+    flp->upd.count    = 0;
+    for (size_t i = dirty; i < ndt_list_count(flp->legs); i++)
     {
         ndt_route_leg *nxt = ndt_list_item(flp->legs, i + 1);
         if (!(leg = ndt_list_item(flp->legs, i)))
@@ -3826,10 +4353,7 @@ static int route_leg_update(ndt_flightplan *flp)
         if (leg->src && leg->dst && !ndt_list_count(leg->xpfms))
         {
             // TODO: set distance even with xpfms dummies
-            leg->dis = ndt_position_calcdistance(leg->src->position, leg->dst->position);
-            leg->trb = ndt_position_calcbearing (leg->src->position, leg->dst->position);
-            leg->imb = ndt_wmm_getbearing_mag   (     wmm, leg->trb, leg->dst->position);
-            leg->omb = ndt_wmm_getbearing_mag   (     wmm, leg->trb, leg->src->position);
+            route_leg_coords(leg, wmm);
         }
         src = leg->dst;
     }
@@ -3854,7 +4378,7 @@ static int route_leg_update(ndt_flightplan *flp)
     {
         if (!flp->arr.last.rsgt)
         {
-            if (!(flp->arr.last.rsgt = ndt_route_segment_direct(src, dst)))
+            if (!(flp->arr.last.rsgt = ndt_route_segment_direct(src, dst, flp->arena)))
             {
                 err = ENOMEM;
                 goto end;
@@ -3869,11 +4393,7 @@ static int route_leg_update(ndt_flightplan *flp)
         flp->arr.last.rleg->dst = dst;
         if (src && dst)
         {
-            leg      = flp->arr.last.rleg;
-            leg->dis = ndt_position_calcdistance(leg->src->position, leg->dst->position);
-            leg->trb = ndt_position_calcbearing (leg->src->position, leg->dst->position);
-            leg->imb = ndt_wmm_getbearing_mag   (     wmm, leg->trb, leg->dst->position);
-            leg->omb = ndt_wmm_getbearing_mag   (     wmm, leg->trb, leg->src->position);
+            route_leg_coords(flp->arr.last.rleg, wmm);
         }
     }
     else if (flp->arr.last.rsgt)
@@ -3884,23 +4404,79 @@ static int route_leg_update(ndt_flightplan *flp)
 
     /*
      * Set dummy xpfms waypoints.
+     *
+     * Only recompute them for legs whose context changed: a leg's dummies may
+     * be followed by its own intercept, and preceded by the previous leg's (if
+     * any), so a stale leg also invalidates the next leg's xpfms list.
      */
-    ndt_waypoint *legsrc = flp->dep.rwy ? flp->dep.rwy->waypoint           : flp->dep.apt->waypoint;
-    ndt_distance altitud = flp->dep.rwy ? flp->dep.rwy->threshold.altitude : flp->dep.apt->coordinates.altitude;
-    for (size_t i = 0; i < ndt_list_count(flp->legs); i++)
+    size_t         count  = ndt_list_count(flp->legs);
+    ndt_route_leg *prv    = dirty ? flp->upd.legs[dirty - 1].leg     : NULL;
+    ndt_waypoint  *legsrc = dirty ? flp->upd.legs[dirty - 1].legsrc  : dep;
+    ndt_distance  altitud = dirty ? flp->upd.legs[dirty - 1].altitud :
+                            flp->dep.rwy ? flp->dep.rwy->threshold.altitude : flp->dep.apt->coordinates.altitude;
+    if (count > flp->upd.alloc)
+    {
+        ndt_route_upd *legs = ndt_arena_realloc(flp->arena, flp->upd.legs,
+                                                flp->upd.alloc * sizeof(ndt_route_upd),
+                                                count * 2      * sizeof(ndt_route_upd));
+        if (!legs)
+        {
+            err = ENOMEM;
+            goto end;
+        }
+        flp->upd.legs  = legs;
+        flp->upd.alloc = count * 2;
+    }
+    for (size_t i = dirty; i < count; i++, prv = leg)
     {
         ndt_route_leg *nxt = ndt_list_item(flp->legs, i + 1);
+        ndt_waypoint  *src = legsrc;
+        ndt_distance   alt = altitud;
         if (!(leg = ndt_list_item(flp->legs, i)))
         {
             err = ENOMEM;
             goto end;
         }
+        int legtype = leg->type, nxttype = nxt ? nxt->type : NDT_LEGTYPE_ZZ;
+        if (!route_leg_xpfmok(leg, prv, nxt, src, alt))
+        {
+            route_leg_xpfmrm(flp, leg, leg->xpfmc.prvn);
+            leg->xpfmc.valid = 0;
+            if (nxt)
+            {
+                route_leg_xpfmrm(flp, nxt, 0);
+                nxt->xpfmc.valid = 0;
+                nxt->xpfmc.prvn  = 0;
+            }
+        }
         if (!(legsrc = route_leg_xpfms(flp, legsrc, leg, nxt, &altitud)))
         {
             err = EINVAL;
             goto end;
         }
+        if (!leg->xpfmc.valid)
+        {
+            leg->xpfmc.prv    = prv;
+            leg->xpfmc.nxt    = nxt;
+            leg->xpfmc.src    = src;
+            leg->xpfmc.srcpos = src->position;
+            leg->xpfmc.alt    = alt;
+            leg->xpfmc.type   = leg->type;
+            leg->xpfmc.valid  = legtype == leg->type && (!nxt || nxttype == nxt->type); // sanitized types: recompute
+            if (nxt)
+            {
+                nxt->xpfmc.prvn = ndt_list_count(nxt->xpfms);
+            }
+        }
+        flp->upd.legs[i].leg     = leg;
+        flp->upd.legs[i].dst     = leg->dst;
+        flp->upd.legs[i].dstpos  = leg->dst ? leg->dst->position : flp->upd.legs[i].dstpos;
+        flp->upd.legs[i].legsrc  = legsrc;
+        flp->upd.legs[i].altitud = altitud;
     }
+    flp->upd.count  = count;
+    flp->upd.dep    = dep;
+    flp->upd.deppos = dep->position;
 
 end:
     if (err)
@@ -3908,7 +4484,7 @@ end:
         char error[64];
         strerror_r(err, error, sizeof(error));
         ndt_log("flightplan: route_leg_update failed (%s)\n", error);
-        return err;
     }
+    ndt_stats_end(NDT_STAT_LEGS, start);
     return err;
 }
@@ -21,8 +21,10 @@
 #ifndef NDT_FLIGHTPLAN_H
 #define NDT_FLIGHTPLAN_H
 
+#include "common/arena.h"
 #include "common/common.h"
 #include "common/list.h"
+#include "common/sink.h"
 
 #include "airport.h"
 #include "airway.h"
@@ -45,6 +47,23 @@ typedef enum ndt_fltplanformat
     NDT_FLTPFMT_XPCDU, // optimized for use with QPAC's MCDU
 } ndt_fltplanformat;
 
+#define NDT_FLIGHTPLAN_USRWPTS 64 // user waypoint index (number of buckets)
+
+/*
+ * Validation-only flight plans (see ndt_flightplan_init2): route elements are
+ * resolved as usual, and reported one by one, but legs are never decoded.
+ */
+typedef struct ndt_route_check
+{
+    const char   *elem;        // route element
+    size_t      offset;        // position of the element in the route
+    int          error;        // non-zero: element couldn't be resolved
+    const char   *what;        // element type (e.g. "airway"), or reason for error
+    ndt_waypoint  *wpt;        // resolved waypoint (if applicable)
+} ndt_route_check;
+
+typedef void (ndt_route_check_callback)(const ndt_route_check *check, void *context);
+
 typedef struct ndt_flightplan
 {
     ndt_info             info; // identification information
@@ -121,9 +140,45 @@ typedef struct ndt_flightplan
 
     ndt_list *rte;             // list of segments (struct ndt_route_segment)
     ndt_list *legs;            // decoded route    (struct ndt_route_leg)
+
+    /*
+     * User waypoints, indexed by identifier; identifier lookups check them
+     * before the navigation database (see ndt_flightplan_get_waypoint), so
+     * they can be referenced in a route, without modifying the database.
+     */
+    struct ndt_usrwpt *usr[NDT_FLIGHTPLAN_USRWPTS];
+
+    struct // legs as of the last update (route_leg_update skips their unchanged prefix)
+    {
+        struct ndt_route_upd *legs;
+        size_t               count;
+        size_t               alloc;
+        ndt_waypoint          *dep; // initial waypoint (and its position)
+        ndt_position        deppos;
+    } upd;
+
+    struct // validation only (legs never decoded)
+    {
+        ndt_route_check_callback *cb;
+        void                    *ctx;
+    } check;
+
+    ndt_arena *arena;          // everything above is allocated from it
 } ndt_flightplan;
 
+/*
+ * Same flight plan, several formats (see ndt_flightplan_writeall): writers only
+ * read the compiled plan, so they all run at the same time, one thread each.
+ */
+typedef struct ndt_flightplan_output
+{
+    ndt_fltplanformat format;
+    ndt_sink           *sink;
+    int                  err;  // set by ndt_flightplan_writeall
+} ndt_flightplan_output;
+
 ndt_flightplan* ndt_flightplan_init         (ndt_navdatabase *navdatabase                                             );
+ndt_flightplan* ndt_flightplan_init2        (ndt_navdatabase *navdatabase, ndt_route_check_callback *cb, void *ctx    );
 void            ndt_flightplan_close        (ndt_flightplan **_flightplan                                             );
 int             ndt_flightplan_set_departure(ndt_flightplan   *flightplan, const char *icao,  const char       *runway);
 int             ndt_flightplan_set_departsid(ndt_flightplan   *flightplan, const char *name,  const char   *transition);
@@ -132,6 +187,11 @@ int             ndt_flightplan_set_arrivstar(ndt_flightplan   *flightplan, const
 int             ndt_flightplan_set_arrivapch(ndt_flightplan   *flightplan, const char *name,  const char   *transition);
 int             ndt_flightplan_set_route    (ndt_flightplan   *flightplan, const char *route, ndt_fltplanformat format);
 int             ndt_flightplan_write        (ndt_flightplan   *flightplan, FILE *file,        ndt_fltplanformat format);
+int             ndt_flightplan_write2       (ndt_flightplan   *flightplan, ndt_sink *sink,    ndt_fltplanformat format);
+int             ndt_flightplan_writeall     (ndt_flightplan   *flightplan, ndt_flightplan_output *out,    size_t count);
+int             ndt_flightplan_user_waypoint(ndt_flightplan   *flightplan, const char *idnt,  ndt_position coordinates);
+ndt_waypoint*   ndt_flightplan_get_waypoint (ndt_flightplan   *flightplan, const char *idnt,  size_t              *idx);
+ndt_waypoint*   ndt_flightplan_get_wptnear2 (ndt_flightplan   *flightplan, const char *idnt,  size_t *idx, ndt_position pos);
 int             ndt_flightplan_remove_leg   (ndt_flightplan   *flightplan,                    void *leg               );
 void*           ndt_flightplan_insert_direct(ndt_flightplan   *flightplan, ndt_waypoint *wpt, void *leg, int after_leg);
 void*           ndt_flightplan_insert_airway(ndt_flightplan   *flightplan,
@@ -258,15 +318,16 @@ typedef struct ndt_route_segment
         ndt_procedure *prc;
     };
 
-    ndt_list *legs;
+    ndt_list   *legs;
+    ndt_arena *arena;          // where the segment was allocated (NULL: heap)
 } ndt_route_segment;
 
-ndt_route_segment* ndt_route_segment_init  (                                                                                                                                                 );
-void               ndt_route_segment_close (ndt_route_segment **_segment                                                                                                                     );
-ndt_route_segment* ndt_route_segment_airway(ndt_waypoint        *src_wpt,  ndt_waypoint *dst_wpt, ndt_airway *airway, ndt_airway_leg *inleg, ndt_airway_leg *outleg, ndt_navdatabase *navdata);
-ndt_route_segment* ndt_route_segment_direct(ndt_waypoint        *src_wpt,  ndt_waypoint *dst_wpt                                                                                             );
-ndt_route_segment* ndt_route_segment_discon(                                                                                                                                                 );
-ndt_route_segment* ndt_route_segment_proced(ndt_waypoint        *src_wpt,  ndt_restriction              *constraints, ndt_procedure                      *procedure, ndt_navdatabase *navdata);
+ndt_route_segment* ndt_route_segment_init  (                                                                                                                                                  ndt_arena *arena);
+void               ndt_route_segment_close (ndt_route_segment **_segment                                                                                                                                      );
+ndt_route_segment* ndt_route_segment_airway(ndt_waypoint        *src_wpt,  ndt_waypoint *dst_wpt, ndt_airway *airway, ndt_airway_leg *inleg, ndt_airway_leg *outleg, ndt_navdatabase *navdata, ndt_arena *arena);
+ndt_route_segment* ndt_route_segment_direct(ndt_waypoint        *src_wpt,  ndt_waypoint *dst_wpt,                                                                                              ndt_arena *arena);
+ndt_route_segment* ndt_route_segment_discon(                                                                                                                                                  ndt_arena *arena);
+ndt_route_segment* ndt_route_segment_proced(ndt_waypoint        *src_wpt,  ndt_restriction              *constraints, ndt_procedure                      *procedure, ndt_navdatabase *navdata, ndt_arena *arena);
 
 typedef struct ndt_route_leg
 {
@@ -283,6 +344,27 @@ typedef struct ndt_route_leg
     ndt_restriction constraints;    // altitude constraints
     ndt_distance    altitude;       // altitude at leg->dst
 
+    struct
+    {
+        ndt_waypoint *src, *dst;    // endpoints dis, trb, imb and omb were last computed for
+        ndt_position  srcpos;       // (positions too, in case waypoints were modified/reused)
+        ndt_position  dstpos;
+    } geom;
+
+    struct
+    {
+        struct ndt_route_leg  *prv;     // neighbours xpfms dummies were last computed with
+        struct ndt_route_leg  *nxt;
+        ndt_waypoint          *src;     // starting point (and its position, see geom)
+        ndt_position        srcpos;
+        ndt_distance           alt;     // altitude at starting point (CA, FA and VA legs)
+        size_t                prvn;     // leading dummies inserted by prv (intercepts)
+        int                   type;     // leg type (may be changed by intercepts)
+        int                  valid;
+        struct ndt_xpfms_memo **memo;   // procedure leg's dummies, shared by flight plans
+        struct ndt_xpfms_memo *shared;  // (procedure legs only)
+    } xpfmc;
+
     enum
     {
         // ARINC 424
@@ -406,11 +488,15 @@ typedef struct ndt_route_leg
             double  inbound_course;
         } hold;
     };
+
+    ndt_arena *arena;               // where the leg was allocated (NULL: heap)
 } ndt_route_leg;
 
 ndt_restriction ndt_leg_const_init    (void                                             );
 ndt_route_leg*  ndt_route_leg_init    (                                                 );
+ndt_route_leg*  ndt_route_leg_init2   (ndt_arena      *arena                            );
 void            ndt_route_leg_close   (ndt_route_leg **_leg                             );
 int             ndt_route_leg_restrict(ndt_route_leg   *leg, ndt_restriction constraints);
+size_t          ndt_route_leg_memosize(ndt_route_leg   *leg                             );
 
 #endif /* NDT_FLIGHTPLAN_H */
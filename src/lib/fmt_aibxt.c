@@ -29,6 +29,7 @@
 
 #include "common/common.h"
 #include "common/list.h"
+#include "common/sink.h"
 
 #include "compat/compat.h"
 
@@ -37,7 +38,7 @@
 #include "fmt_aibxt.h"
 #include "waypoint.h"
 
-static int print_directto(FILE *fd, size_t idx, ndt_waypoint *dst);
+static int print_directto(ndt_sink *fd, size_t idx, ndt_waypoint *dst);
 
 int ndt_fmt_aibxt_flightplan_set_route(ndt_flightplan *flp, const char *rte)
 {
@@ -312,10 +313,10 @@ int ndt_fmt_aibxt_flightplan_set_route(ndt_flightplan *flp, const char *rte)
 
         if (!awyidt) // direct to
         {
-            ndt_waypoint *dst = ndt_navdata_get_wptnear2(flp->ndb, dstidt, NULL,
-                                                         ndt_position_init(latitude,
-                                                                           longitude,
-                                                                           ndt_distance_init(0, NDT_ALTUNIT_NA)));
+            ndt_waypoint *dst = ndt_flightplan_get_wptnear2(flp, dstidt, NULL,
+                                                            ndt_position_init(latitude,
+                                                                              longitude,
+                                                                              ndt_distance_init(0, NDT_ALTUNIT_NA)));
             if (!dst || ndt_distance_get(ndt_position_calcdistance(dst->position,
                                                                    ndt_position_init(latitude,
                                                                                      longitude,
@@ -337,14 +338,14 @@ int ndt_fmt_aibxt_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                     snprintf(buf, sizeof(buf), "%+010.6lf/%+011.6lf",
                              latitude, longitude);
                 }
-                if (!(dst = ndt_waypoint_llc(buf)))
+                if (!(dst = ndt_waypoint_llc(buf, flp->arena)))
                 {
                     err = ENOMEM;
                     goto end;
                 }
                 ndt_list_add(flp->cws, dst);
             }
-            rsg = ndt_route_segment_direct(src, dst);
+            rsg = ndt_route_segment_direct(src, dst, flp->arena);
         }
         else if (!strcmp(awyidt, "DCT") || (!strncmp(awyidt, "NAT", 3) && strlen(awyidt) == 4)) // direct to coded as airway
         {
@@ -356,22 +357,22 @@ int ndt_fmt_aibxt_flightplan_set_route(ndt_flightplan *flp, const char *rte)
              * (in which case we simply insert a route discontinuity below).
              */
             ndt_position   posn = src ? src->position : flp->dep.apt->coordinates;
-            ndt_waypoint  *wpt1 = ndt_navdata_get_wptnear2(flp->ndb, srcidt, NULL, posn);
-            if (!wpt1 && !(wpt1 = ndt_waypoint_llc(srcidt)))
+            ndt_waypoint  *wpt1 = ndt_flightplan_get_wptnear2(flp, srcidt, NULL, posn);
+            if (!wpt1 && !(wpt1 = ndt_waypoint_llc(srcidt, flp->arena)))
             {
                 ndt_log("[fmt_aibxt]: invalid waypoint '%s'\n", srcidt);
                 err = EINVAL;
                 goto end;
             }
 
-            ndt_waypoint  *wpt2 = ndt_navdata_get_wptnear2(flp->ndb, dstidt, NULL, wpt1->position);
-            if (!wpt2 && !(wpt2 = ndt_waypoint_llc(dstidt)))
+            ndt_waypoint  *wpt2 = ndt_flightplan_get_wptnear2(flp, dstidt, NULL, wpt1->position);
+            if (!wpt2 && !(wpt2 = ndt_waypoint_llc(dstidt, flp->arena)))
             {
                 ndt_log("[fmt_aibxt]: invalid waypoint '%s'\n", dstidt);
                 err = EINVAL;
                 goto end;
             }
-            rsg = ndt_route_segment_direct(wpt1, wpt2);
+            rsg = ndt_route_segment_direct(wpt1, wpt2, flp->arena);
         }
         else // airway
         {
@@ -385,7 +386,7 @@ int ndt_fmt_aibxt_flightplan_set_route(ndt_flightplan *flp, const char *rte)
              * possible, pick the first one where the source waypoint matches
              * that of the previous segment, else pick the first valid segment.
              */
-            for (size_t wptidx = 0; (wpt = ndt_navdata_get_waypoint(flp->ndb, srcidt, &wptidx)); wptidx++)
+            for (size_t wptidx = 0; (wpt = ndt_flightplan_get_waypoint(flp, srcidt, &wptidx)); wptidx++)
             {
                 ndt_airway *awy;
                 ndt_waypoint *dst;
@@ -417,7 +418,7 @@ int ndt_fmt_aibxt_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                 err = EINVAL;
                 goto end;
             }
-            rsg = ndt_route_segment_airway(src1, dst1, awy1, in1, out1, flp->ndb);
+            rsg = ndt_route_segment_airway(src1, dst1, awy1, in1, out1, flp->ndb, flp->arena);
         }
 
         if (!rsg)
@@ -429,8 +430,8 @@ int ndt_fmt_aibxt_flightplan_set_route(ndt_flightplan *flp, const char *rte)
         /* Check for discontinuities */
         if (src && src != rsg->src)
         {
-            ndt_route_segment *dsc = ndt_route_segment_discon();
-            ndt_route_segment *dct = ndt_route_segment_direct(NULL, rsg->src);
+            ndt_route_segment *dsc = ndt_route_segment_discon(flp->arena);
+            ndt_route_segment *dct = ndt_route_segment_direct(NULL, rsg->src, flp->arena);
             if (!dsc || !dct)
             {
                 err = ENOMEM;
@@ -531,7 +532,7 @@ end:
     return err;
 }
 
-int ndt_fmt_aibxt_flightplan_write(ndt_flightplan *flp, FILE *fd)
+int ndt_fmt_aibxt_flightplan_write(ndt_flightplan *flp, ndt_sink *fd)
 {
     int err = 0;
 
@@ -549,19 +550,19 @@ int ndt_fmt_aibxt_flightplan_write(ndt_flightplan *flp, FILE *fd)
     }
 
     // header
-    err = ndt_fprintf(fd, "[CoRte]\n");
+    err = ndt_sink_printf(fd, "[CoRte]\n");
     if (err)
     {
         goto end;
     }
 
     // departure & arrival airports
-    err = ndt_fprintf(fd, "ArptDep=%s\n", flp->dep.apt->info.idnt);
+    err = ndt_sink_printf(fd, "ArptDep=%s\n", flp->dep.apt->info.idnt);
     if (err)
     {
         goto end;
     }
-    err = ndt_fprintf(fd, "ArptArr=%s\n", flp->arr.apt->info.idnt);
+    err = ndt_sink_printf(fd, "ArptArr=%s\n", flp->arr.apt->info.idnt);
     if (err)
     {
         goto end;
@@ -570,7 +571,7 @@ int ndt_fmt_aibxt_flightplan_write(ndt_flightplan *flp, FILE *fd)
     // departure & arrival runways (optional)
     if (flp->dep.rwy)
     {
-        err = ndt_fprintf(fd, "RwyDep=%s%s\n", flp->dep.apt->info.idnt, flp->dep.rwy->info.idnt);
+        err = ndt_sink_printf(fd, "RwyDep=%s%s\n", flp->dep.apt->info.idnt, flp->dep.rwy->info.idnt);
         if (err)
         {
             goto end;
@@ -578,7 +579,7 @@ int ndt_fmt_aibxt_flightplan_write(ndt_flightplan *flp, FILE *fd)
     }
     if (flp->arr.rwy)
     {
-        err = ndt_fprintf(fd, "RwyArr=%s%s\n", flp->arr.apt->info.idnt, flp->arr.rwy->info.idnt);
+        err = ndt_sink_printf(fd, "RwyArr=%s%s\n", flp->arr.apt->info.idnt, flp->arr.rwy->info.idnt);
         if (err)
         {
             goto end;
@@ -588,14 +589,14 @@ int ndt_fmt_aibxt_flightplan_write(ndt_flightplan *flp, FILE *fd)
     // SID/STAR and transitions (optional)
     if (flp->dep.sid.proc)
     {
-        err = ndt_fprintf(fd, "SID=%s\n", flp->dep.sid.proc->info.idnt);
+        err = ndt_sink_printf(fd, "SID=%s\n", flp->dep.sid.proc->info.idnt);
         if (err)
         {
             goto end;
         }
         if (flp->dep.sid.enroute.proc)
         {
-            err = ndt_fprintf(fd, "SID_Trans=%s\n", flp->dep.sid.enroute.proc->info.misc);
+            err = ndt_sink_printf(fd, "SID_Trans=%s\n", flp->dep.sid.enroute.proc->info.misc);
             if (err)
             {
                 goto end;
@@ -604,14 +605,14 @@ int ndt_fmt_aibxt_flightplan_write(ndt_flightplan *flp, FILE *fd)
     }
     if (flp->arr.star.proc)
     {
-        err = ndt_fprintf(fd, "STAR=%s\n", flp->arr.star.proc->info.idnt);
+        err = ndt_sink_printf(fd, "STAR=%s\n", flp->arr.star.proc->info.idnt);
         if (err)
         {
             goto end;
         }
         if (flp->arr.star.enroute.proc)
         {
-            err = ndt_fprintf(fd, "STAR_Trans=%s\n", flp->arr.star.enroute.proc->info.misc);
+            err = ndt_sink_printf(fd, "STAR_Trans=%s\n", flp->arr.star.enroute.proc->info.misc);
             if (err)
             {
                 goto end;
@@ -632,13 +633,13 @@ int ndt_fmt_aibxt_flightplan_write(ndt_flightplan *flp, FILE *fd)
         switch (rsg->type)
         {
             case NDT_RSTYPE_AWY:
-                err = ndt_fprintf(fd,
-                                  "Airway%zu=%s\n"
-                                  "Airway%zuFROM=%s\n"
-                                  "Airway%zuTO=%s\n",
-                                  j, rsg->awy.awy->info.idnt,
-                                  j, rsg->src->info.idnt,
-                                  j, rsg->dst->info.idnt);
+                err = ndt_sink_printf(fd,
+                                      "Airway%zu=%s\n"
+                                      "Airway%zuFROM=%s\n"
+                                      "Airway%zuTO=%s\n",
+                                      j, rsg->awy.awy->info.idnt,
+                                      j, rsg->src->info.idnt,
+                                      j, rsg->dst->info.idnt);
                 break;
 
             case NDT_RSTYPE_DCT:
@@ -664,7 +665,7 @@ end:
     return err;
 }
 
-static int print_directto(FILE *fd, size_t idx, ndt_waypoint *dst)
+static int print_directto(ndt_sink *fd, size_t idx, ndt_waypoint *dst)
 {
     double latlf = ndt_position_getlatitude (dst->position, NDT_ANGUNIT_DEG);
     double lonlf = ndt_position_getlongitude(dst->position, NDT_ANGUNIT_DEG);
@@ -679,10 +680,10 @@ static int print_directto(FILE *fd, size_t idx, ndt_waypoint *dst)
         case NDT_WPTYPE_FIX:
         case NDT_WPTYPE_NDB:
         case NDT_WPTYPE_VOR:
-            return ndt_fprintf(fd,
-                               "DctWpt%zu=%s\n"
-                               "DctWpt%zuCoordinates=%.6lf,%.6lf\n",
-                               idx, dst->info.idnt, idx, latlf, lonlf);
+            return ndt_sink_printf(fd,
+                                   "DctWpt%zu=%s\n"
+                                   "DctWpt%zuCoordinates=%.6lf,%.6lf\n",
+                                   idx, dst->info.idnt, idx, latlf, lonlf);
 
         default:
             break;
@@ -691,24 +692,24 @@ static int print_directto(FILE *fd, size_t idx, ndt_waypoint *dst)
     // use the coordinates
     if (lonrd / 100)
     {
-        return ndt_fprintf(fd,
-                           "DctWpt%zu=%02d%c%02d\n"
-                           "DctWpt%zuCoordinates=%.6lf,%.6lf\n",
-                           idx,
-                           (latrd < 0) ? -latrd : latrd,
-                           (latrd < 0  && lonrd < 0) ? 'W' : (latrd < 0) ? 'S' : (lonrd < 0) ? 'N' : 'E',
-                           (lonrd < 0) ? -lonrd % 100 : lonrd % 100,
-                           idx, latlf, lonlf);
+        return ndt_sink_printf(fd,
+                               "DctWpt%zu=%02d%c%02d\n"
+                               "DctWpt%zuCoordinates=%.6lf,%.6lf\n",
+                               idx,
+                               (latrd < 0) ? -latrd : latrd,
+                               (latrd < 0  && lonrd < 0) ? 'W' : (latrd < 0) ? 'S' : (lonrd < 0) ? 'N' : 'E',
+                               (lonrd < 0) ? -lonrd % 100 : lonrd % 100,
+                               idx, latlf, lonlf);
     }
     else
     {
-        return ndt_fprintf(fd,
-                           "DctWpt%zu=%02d%02d%c\n"
-                           "DctWpt%zuCoordinates=%.6lf,%.6lf\n",
-                           idx,
-                           (latrd < 0) ? -latrd : latrd,
-                           (lonrd < 0) ? -lonrd : lonrd,
-                           (latrd < 0  && lonrd < 0) ? 'W' : (latrd < 0) ? 'S' : (lonrd < 0) ? 'N' : 'E',
-                           idx, latlf, lonlf);
+        return ndt_sink_printf(fd,
+                               "DctWpt%zu=%02d%02d%c\n"
+                               "DctWpt%zuCoordinates=%.6lf,%.6lf\n",
+                               idx,
+                               (latrd < 0) ? -latrd : latrd,
+                               (lonrd < 0) ? -lonrd : lonrd,
+                               (latrd < 0  && lonrd < 0) ? 'W' : (latrd < 0) ? 'S' : (lonrd < 0) ? 'N' : 'E',
+                               idx, latlf, lonlf);
     }
 }
@@ -22,11 +22,12 @@
 #define NDT_FMT_AIBXT_H
 
 #include "common/common.h"
+#include "common/sink.h"
 
 #include "flightplan.h"
 #include "navdata.h"
 
 int ndt_fmt_aibxt_flightplan_set_route(ndt_flightplan *flightplan, const char *route);
-int ndt_fmt_aibxt_flightplan_write    (ndt_flightplan *flightplan, FILE       *file );
+int ndt_fmt_aibxt_flightplan_write    (ndt_flightplan *flightplan, ndt_sink   *sink );
 
 #endif /* NDT_FMT_AIBXT_H */
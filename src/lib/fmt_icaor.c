@@ -29,6 +29,7 @@
 
 #include "common/common.h"
 #include "common/list.h"
+#include "common/sink.h"
 
 #include "compat/compat.h"
 
@@ -39,9 +40,11 @@
 #include "fmt_icaor.h"
 #include "waypoint.h"
 
-static int icao_printrt(FILE *fd, ndt_list     *rte,                    ndt_fltplanformat fmt);
-static int icao_printwp(FILE *fd, ndt_waypoint *dst, ndt_llcfmt llcfmt, ndt_fltplanformat fmt);
-static int icao_printlg(FILE *fd, ndt_list     *lgs,                    ndt_fltplanformat fmt);
+static int icao_printrt(ndt_sink *fd, ndt_list     *rte,                    ndt_fltplanformat fmt);
+static int icao_printwp(ndt_sink *fd, ndt_waypoint *dst, ndt_llcfmt llcfmt, ndt_fltplanformat fmt);
+static int icao_printlg(ndt_sink *fd, ndt_list     *lgs,                    ndt_fltplanformat fmt);
+static int icao_matchpb(const char *elem, const char *prefix, char *place, double *brg, double *dis);
+static void icao_report(ndt_flightplan *flp, const char *elem, size_t offset, int error, const char *what, ndt_waypoint *wpt);
 
 int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
 {
@@ -50,7 +53,8 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
     ndt_runway   *lastrwy  = NULL;
     ndt_waypoint *src      = NULL, *lastpl = NULL;
     char         *awy1id   = NULL, *awy2id = NULL;
-    char         *rtestart = NULL, *prefix = NULL, *rtenext, *elem;
+    const char   *rtenext  = rte, *elemptr = NULL, *why = NULL;
+    char          elem[64], prefix[64], awyidt[2][64];
 
     if (!flp || !rte)
     {
@@ -58,22 +62,34 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
         goto end;
     }
 
-    rtestart = rtenext = strdup(rte);
-    if (!rtestart)
+    /*
+     * Elements are copied to (and split within) fixed-size buffers: parsing
+     * a route doesn't allocate anything besides the flight plan's contents.
+     */
+    while (*(rtenext += strspn(rtenext, " \r\n\t")))
     {
-        err = ENOMEM;
-        goto end;
-    }
+        size_t len = strcspn(rtenext, " \r\n\t");
+        elemptr    = rtenext;
+        why        = NULL;
+        if (len >= sizeof(elem))
+        {
+            ndt_log("[fmt_icaor]: invalid element '%.*s'\n", (int)len, rtenext);
+            snprintf(elem, sizeof(elem), "%.*s", (int)len, rtenext);
+            why = "element too long";
+            err = EINVAL;
+            goto end;
+        }
+        memcpy(elem, rtenext, len);
+        elem[len] = '\0';
+        rtenext  += len;
 
-    while ((elem = strsep(&rtenext, " \r\n\t")))
-    {
-        if (strnlen(elem,      1) &&
-            strcmp (elem,  "DCT") && strcmp(elem, "DIRECT") &&
+        if (strcmp (elem,  "DCT") && strcmp(elem, "DIRECT") &&
             strcmp (elem,  "SID") &&
             strcmp (elem, "STAR"))
         {
             char         *dstidt = NULL;
             ndt_waypoint *cuswpt = NULL;
+            const char   *what   = "waypoint";
             ndt_position lastpos;
 
             /*
@@ -81,18 +97,16 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
              *
              * The second substring contains additional info
              * (step climbs?) which we ignore for now.
-             */
-            char *suffix = strdup(elem);
-            if (prefix)
-            {
-                free(prefix);
-            }
-            /*
+             *
              * AIRPORT/RUNWAY           KLAX/06L
              * WAYPOINT/STEPCLIMB       BASIK/N0412F330
              * SID.TRANS, STAR.TRANS    CASTA4.AVE
              */
-            prefix = strsep(&suffix, "/.");
+            char *suffix = strpbrk(memcpy(prefix, elem, len + 1), "/.");
+            if (suffix)
+            {
+                *suffix++ = '\0';
+            }
 
             /* New element, reset last airport & runway. */
             lastapt = NULL;
@@ -127,6 +141,7 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                         ndt_log("[fmt_icaor]: invalid departure '%s%s'\n",
                                 firstapt ? firstapt->info.idnt : NULL,
                                 firstrwy ? firstrwy->info.idnt : "");
+                        why = "invalid departure";
                         goto end;
                     }
                 }
@@ -153,20 +168,7 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
             ndt_distance ndstce;
             char         place[8];
             double       bearing, distance;
-            int          bgbuf[3], dibuf[3];
-            if (sscanf(prefix, "%5[^0-9]%1d%1d%1d%1d%1d%1d%c", place,
-                       &bgbuf[0],
-                       &bgbuf[1],
-                       &bgbuf[2],
-                       &dibuf[0],
-                       &dibuf[1],
-                       &dibuf[2], place) == 7)
-            {
-                bearing  = bgbuf[0] * 100. + bgbuf[1] * 10. + bgbuf[2] * 1.;
-                distance = dibuf[0] * 100. + dibuf[1] * 10. + dibuf[2] * 1.;
-            }
-            else if (sscanf(elem, "%7[^/]/%lf/%lf%c",  place, &bearing, &distance, place) != 3 &&
-                     sscanf(elem, "%7[^0-9]%lf/%lf%c", place, &bearing, &distance, place) != 3)
+            if (!icao_matchpb(elem, prefix, place, &bearing, &distance))
             {
                 // no match
                 bearing = distance = -1.;
@@ -174,7 +176,7 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
 
             if (distance > 0. &&
                 bearing >= 0. && bearing <= 360. &&
-                ndt_navdata_get_waypoint(flp->ndb, place, NULL))
+                ndt_flightplan_get_waypoint(flp, place, NULL))
             {
                 /*
                  * Handled first because we have a specific, reliable match.
@@ -194,7 +196,7 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                 if (lastpl == NULL || strcmp(lastpl->info.idnt, place))
                 {
                     lastpos = src ? src->position : lastpl ? lastpl->position : flp->dep.apt->coordinates;
-                    lastpl  = ndt_navdata_get_wptnear2(flp->ndb, place, NULL, lastpos);
+                    lastpl  = ndt_flightplan_get_wptnear2(flp, place, NULL, lastpos);
                 }
                 if (lastpl == NULL)
                 {
@@ -204,7 +206,8 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
 
                 // convert nautical miles to meters for distance
                 ndstce = ndt_distance_init((int64_t)(distance * 1852.), NDT_ALTUNIT_ME);
-                cuswpt = ndt_waypoint_pbd(lastpl, bearing, ndstce, flp->ndb->wmm);
+                cuswpt = ndt_waypoint_pbd(lastpl, bearing, ndstce, flp->ndb->wmm, flp->arena);
+                what   = "place/bearing/distance";
             }
             else if (strlen(prefix) == 4 && !strncmp(prefix, "NAT", 3))
             {
@@ -212,6 +215,7 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                  * North Atlantic Track; we can't decode it,
                  * but skip it rather than bailing out.
                  */
+                icao_report(flp, elem, elemptr - rte, 0, "skipped", NULL);
                 continue;
             }
             else if (ndt_navdata_get_airway(flp->ndb, elem, NULL))
@@ -226,9 +230,10 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                      * No startpoint, this can't be an airway; check
                      * whether it's a waypoint before erroring out.
                      */
-                    if (!ndt_navdata_get_waypoint(flp->ndb, prefix, NULL))
+                    if (!ndt_flightplan_get_waypoint(flp, prefix, NULL))
                     {
                         ndt_log("[fmt_icaor]: no startpoint for airway '%s'\n", elem);
+                        why = "no startpoint for airway";
                         err = EINVAL;
                         goto end;
                     }
@@ -250,7 +255,7 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                             {
                                 if (ndt_airway_intersect(in, awy2))
                                 {
-                                    awy2id = strdup(elem);
+                                    awy2id = strcpy(awyidt[awy1id == awyidt[0]], elem);
                                     break;
                                 }
                             }
@@ -258,7 +263,7 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                             {
                                 break;
                             }
-                            for (size_t dstidx = 0; (dst = ndt_navdata_get_waypoint(flp->ndb, prefix, &dstidx)); dstidx++)
+                            for (size_t dstidx = 0; (dst = ndt_flightplan_get_waypoint(flp, prefix, &dstidx)); dstidx++)
                             {
                                 if (ndt_airway_endpoint(in, dst->info.idnt, dst->position))
                                 {
@@ -274,7 +279,7 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                     }
                     if (!awy2id && !dstidt)
                     {
-                         awy2id = strdup(elem);
+                         awy2id = strcpy(awyidt[awy1id == awyidt[0]], elem);
                     }
                 }
                 else
@@ -289,7 +294,7 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                     {
                         if (ndt_airway_startpoint(awy1, src->info.idnt, src->position))
                         {
-                            awy1id = strdup(elem);
+                            awy1id = strcpy(awyidt[awy2id == awyidt[0]], elem);
                             break;
                         }
                     }
@@ -311,14 +316,14 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                          */
                         if (rsg1 && rsg1->type == NDT_RSTYPE_DCT)
                         {
-                            for (size_t dstidx = 0; (dst = ndt_navdata_get_waypoint(flp->ndb, rsg1->dst->info.idnt, &dstidx)); dstidx++)
+                            for (size_t dstidx = 0; (dst = ndt_flightplan_get_waypoint(flp, rsg1->dst->info.idnt, &dstidx)); dstidx++)
                             {
                                 for (size_t awy1idx = 0; (awy1 = ndt_navdata_get_airway(flp->ndb, elem, &awy1idx)); awy1idx++)
                                 {
                                     if (ndt_airway_startpoint(awy1, dst->info.idnt, dst->position))
                                     {
                                         src    = rsg1->dst = dst;
-                                        awy1id = strdup(elem);
+                                        awy1id = strcpy(awyidt[awy2id == awyidt[0]], elem);
                                         break;
                                     }
                                 }
@@ -331,18 +336,18 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                     }
                     if (!awy1id)
                     {
-                        if (ndt_navdata_get_waypoint(flp->ndb, prefix, NULL))
+                        if (ndt_flightplan_get_waypoint(flp, prefix, NULL))
                         {
                             dstidt = prefix;
                         }
                         else
                         {
-                            awy1id = strdup(elem);
+                            awy1id = strcpy(awyidt[awy2id == awyidt[0]], elem);
                         }
                     }
                 }
             }
-            else if (cuswpt == NULL && (cuswpt = ndt_waypoint_llc(elem)))
+            else if (cuswpt == NULL && (cuswpt = ndt_waypoint_llc(elem, flp->arena)))
             {
                 /*
                  * Valid latitude and longitude coordinates.
@@ -350,40 +355,42 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                  * Note: always check the full element first to avoid
                  * a false match, e.g. '4600N' for '4600N/05000W'.
                  */
-                if (ndt_navdata_get_waypoint(flp->ndb, elem, NULL))
+                if (ndt_flightplan_get_waypoint(flp, elem, NULL))
                 {
                     /*
                      * False match, e.g. '4600N' is both
                      * a valid LLC but also a named fix.
                      */
                     dstidt = elem;
-                    ndt_waypoint_close(&cuswpt);
+                    ndt_waypoint_close2(&cuswpt, flp->arena);
                 }
                 else
                 {
                     ndt_list_add(flp->cws, cuswpt);
+                    what = "coordinates";
                 }
             }
-            else if (cuswpt == NULL && (cuswpt = ndt_waypoint_llc(prefix)))
+            else if (cuswpt == NULL && (cuswpt = ndt_waypoint_llc(prefix, flp->arena)))
             {
                 /*
                  * Valid latitude and longitude coordinates.
                  */
-                if (ndt_navdata_get_waypoint(flp->ndb, prefix, NULL))
+                if (ndt_flightplan_get_waypoint(flp, prefix, NULL))
                 {
                     /*
                      * False match, e.g. '4600N' is both
                      * a valid LLC but also a named fix.
                      */
                     dstidt = prefix;
-                    ndt_waypoint_close(&cuswpt);
+                    ndt_waypoint_close2(&cuswpt, flp->arena);
                 }
                 else
                 {
                     ndt_list_add(flp->cws, cuswpt);
+                    what = "coordinates";
                 }
             }
-            else if (ndt_navdata_get_waypoint(flp->ndb, prefix, NULL))
+            else if (ndt_flightplan_get_waypoint(flp, prefix, NULL))
             {
                 dstidt = prefix;
             }
@@ -397,14 +404,17 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                 if (flp->dep.sid.proc)
                 {
                     ndt_log("[fmt_icaor]: warning: ignoring SID '%s'\n", elem);
+                    icao_report(flp, elem, elemptr - rte, 0, "skipped (SID already set)", NULL);
                 }
                 else
                 {
                     if ((err = ndt_flightplan_set_departsid(flp, prefix, suffix)))
                     {
+                        why = "invalid SID";
                         goto end;
                     }
                     src = flp->dep.sid.enroute.rsgt ? flp->dep.sid.enroute.rsgt->dst : flp->dep.sid.rsgt->dst;
+                    icao_report(flp, elem, elemptr - rte, 0, "SID", src);
                 }
                 continue;
             }
@@ -413,14 +423,17 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                 if (flp->dep.sid.proc)
                 {
                     ndt_log("[fmt_icaor]: warning: ignoring SID '%s'\n", elem);
+                    icao_report(flp, elem, elemptr - rte, 0, "skipped (SID already set)", NULL);
                 }
                 else
                 {
                     if ((err = ndt_flightplan_set_departsid(flp, suffix, prefix)))
                     {
+                        why = "invalid SID";
                         goto end;
                     }
                     src = flp->dep.sid.enroute.rsgt ? flp->dep.sid.enroute.rsgt->dst : flp->dep.sid.rsgt->dst;
+                    icao_report(flp, elem, elemptr - rte, 0, "SID", src);
                 }
                 continue;
             }
@@ -428,21 +441,26 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
             {
                 if ((err = ndt_flightplan_set_arrivstar(flp, prefix, suffix)))
                 {
+                    why = "invalid STAR";
                     goto end;
                 }
+                icao_report(flp, elem, elemptr - rte, 0, "STAR", NULL);
                 continue;
             }
             else if (flp->arr.apt && ndt_procedure_get(flp->arr.apt->stars, suffix, NULL))
             {
                 if ((err = ndt_flightplan_set_arrivstar(flp, suffix, prefix)))
                 {
+                    why = "invalid STAR";
                     goto end;
                 }
+                icao_report(flp, elem, elemptr - rte, 0, "STAR", NULL);
                 continue;
             }
             else
             {
                 ndt_log("[fmt_icaor]: invalid element '%s'\n", elem);
+                why = "unknown element";
                 err = EINVAL;
                 goto end;
             }
@@ -460,19 +478,21 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
 
                 if      (awy2id)
                 {
-                    dst = ndt_navdata_get_wpt4aws(flp->ndb, src, awy2id, awy1id, &awy, &in, &out);
-                    free(awy1id);
+                    why  = "airways don't intersect";
+                    what = "airway";
+                    dst  = ndt_navdata_get_wpt4aws(flp->ndb, src, awy2id, awy1id, &awy, &in, &out);
                     awy1id = awy2id;
                     awy2id = NULL;
                 }
                 else if (awy1id)
                 {
+                    why = "waypoint not on airway";
                     dst = ndt_navdata_get_wpt4awy(flp->ndb, src, dstidt, awy1id, &awy, &in, &out);
-                    free(awy1id);
                     awy1id = NULL;
                 }
                 else if (dstidt)
                 {
+                    why     = "waypoint not found";
                     lastpos = src ? src->position : lastpl ? lastpl->position : flp->dep.apt->coordinates;
                     {
                         // waypoints in the route should be either of: airport, standalone DME, fix, NDB or VOR
@@ -480,7 +500,7 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                         // we exclude them and only check for them if we have no match w/a supported point type
                         ndt_waypoint *nxt;
                         int64_t dis, min = INT64_MAX;
-                        for (size_t i = 0; (nxt = ndt_navdata_get_waypoint(flp->ndb, dstidt, &i)); i++)
+                        for (size_t i = 0; (nxt = ndt_flightplan_get_waypoint(flp, dstidt, &i)); i++)
                         {
                             dis = ndt_distance_get(ndt_position_calcdistance(lastpos, nxt->position), NDT_ALTUNIT_NA);
                             if (min > dis && (nxt->type == NDT_WPTYPE_APT ||
@@ -497,7 +517,7 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                     }
                     if (dst == NULL)
                     {
-                        dst = ndt_navdata_get_wptnear2(flp->ndb, dstidt, NULL, lastpos);
+                        dst = ndt_flightplan_get_wptnear2(flp, dstidt, NULL, lastpos);
                     }
 
                     /*
@@ -531,66 +551,80 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                 if (flp->arr.star.proc && dst != flp->arr.apt->waypoint)
                 {
                     ndt_log("[fmt_icaor]: unexpected waypoint '%s' after STAR\n", dst->info.idnt);
+                    why = "unexpected waypoint after STAR";
                     err = EINVAL;
                     goto end;
                 }
-
-                if (awy && in && out)
-                {
-                    rsg = ndt_route_segment_airway(src, dst, awy, in, out, flp->ndb);
-                }
-                else
-                {
-                    rsg = ndt_route_segment_direct(src, dst);
-                }
-
-                if (!rsg)
-                {
-                    err = ENOMEM;
-                    goto end;
-                }
+                icao_report(flp, elem, elemptr - rte, 0, what, dst);
 
                 /* Remove pointless legs */
-                if (rsg->type == NDT_RSTYPE_DCT)
+                if (!(awy && in && out))
                 {
-                    if (!fv && ((flp->dep.apt && flp->dep.apt->waypoint == rsg->dst) ||
-                                (flp->dep.rwy && flp->dep.rwy->waypoint == rsg->dst)))
+                    if (!fv && ((flp->dep.apt && flp->dep.apt->waypoint == dst) ||
+                                (flp->dep.rwy && flp->dep.rwy->waypoint == dst)))
                     {
-                        ndt_route_segment_close(&rsg);
                         continue;
                     }
-                    else if (rsg->src == rsg->dst)
+                    else if (src == dst)
                     {
-                        ndt_route_segment_close(&rsg);
                         continue;
                     }
-                    else if (rsg->src)
+                    else if (src)
                     {
-                        ndt_position a = rsg->src->position;
-                        ndt_position b = rsg->dst->position;
+                        ndt_position a = src->position;
+                        ndt_position b = dst->position;
                         ndt_distance d = ndt_position_calcdistance(a, b);
                         if (ndt_distance_get(d, NDT_ALTUNIT_NA) == 0)
                         {
-                            ndt_route_segment_close(&rsg);
                             continue;
                         }
                     }
                 }
                 fv = 1; // valid waypoint, don't skip additional airports/runways
 
-                /* We have a leg, our last endpoint becomes our new startpoint */
-                if (rsg->dst->type != NDT_WPTYPE_LLC)
+                /*
+                 * Validation only: the element is resolved, and the segment would
+                 * never be decoded, so don't build it (nor expand airways at all).
+                 */
+                if (!flp->check.cb)
                 {
-                    lastpl = rsg->dst;
+                    if (awy && in && out)
+                    {
+                        rsg = ndt_route_segment_airway(src, dst, awy, in, out, flp->ndb, flp->arena);
+                    }
+                    else
+                    {
+                        rsg = ndt_route_segment_direct(src, dst, flp->arena);
+                    }
+
+                    if (!rsg)
+                    {
+                        err = ENOMEM;
+                        goto end;
+                    }
+
+                    /* Let's not forget to add our new segment to the route */
+                    ndt_list_add(flp->rte, rsg);
                 }
-                src = rsg->dst;
 
-                /* Let's not forget to add our new segment to the route */
-                ndt_list_add(flp->rte, rsg);
+                /* We have a leg, our last endpoint becomes our new startpoint */
+                if (dst->type != NDT_WPTYPE_LLC)
+                {
+                    lastpl = dst;
+                }
+                src = dst;
                 continue;
             }
+
+            /* Airway: its endpoint will be the next element. */
+            icao_report(flp, elem, elemptr - rte, 0, "airway", NULL);
+        }
+        else
+        {
+            icao_report(flp, elem, elemptr - rte, 0, "skipped", NULL);
         }
     }
+    elemptr = NULL;
 
     /* Set the arrival airport and runway if required. */
     if (!flp->arr.apt || (!flp->arr.rwy && flp->arr.apt == lastapt))
@@ -603,6 +637,7 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
             ndt_log("[fmt_icaor]: invalid arrival '%s%s'\n",
                     lastapt ? lastapt->info.idnt : NULL,
                     lastrwy ? lastrwy->info.idnt : "");
+            why = "invalid arrival";
             goto end;
         }
     }
@@ -644,14 +679,15 @@ int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flp, const char *rte)
     }
 
 end:
-    free(rtestart);
-    free(awy1id);
-    free(awy2id);
-    free(prefix);
+    if (err && (elemptr || why))
+    {
+        icao_report(flp, elemptr ? elem : "", elemptr ? (size_t)(elemptr - rte) : strlen(rte),
+                    err, why ? why : "invalid element", NULL);
+    }
     return err;
 }
 
-int ndt_fmt_dcded_flightplan_write(ndt_flightplan *flp, FILE *fd)
+int ndt_fmt_dcded_flightplan_write(ndt_flightplan *flp, ndt_sink *fd)
 {
     int ret = 0;
 
@@ -679,10 +715,10 @@ end:
     {
         return ret;
     }
-    return ndt_fprintf(fd, "%s", "\n");
+    return ndt_sink_printf(fd, "%s", "\n");
 }
 
-int ndt_fmt_dtest_flightplan_write(ndt_flightplan *flp, FILE *fd)
+int ndt_fmt_dtest_flightplan_write(ndt_flightplan *flp, ndt_sink *fd)
 {
     int ret = 0;
 
@@ -702,7 +738,7 @@ int ndt_fmt_dtest_flightplan_write(ndt_flightplan *flp, FILE *fd)
     if (flp->dep.rwy)
     {
         if ((ret = icao_printwp(fd, flp->dep.rwy->waypoint, NDT_LLCFMT_SVECT, NDT_FLTPFMT_DTEST)) ||
-            (ret = ndt_fprintf (fd, "%s", " ")))
+            (ret = ndt_sink_printf(fd, "%s", " ")))
         {
             goto end;
         }
@@ -716,7 +752,7 @@ int ndt_fmt_dtest_flightplan_write(ndt_flightplan *flp, FILE *fd)
 
     if (flp->arr.rwy)
     {
-        if ((ret = ndt_fprintf (fd, "%s", " ")) ||
+        if ((ret = ndt_sink_printf(fd, "%s", " ")) ||
             (ret = icao_printwp(fd, flp->arr.rwy->waypoint, NDT_LLCFMT_SVECT, NDT_FLTPFMT_DTEST)))
         {
             goto end;
@@ -728,10 +764,10 @@ end:
     {
         return ret;
     }
-    return ndt_fprintf(fd, "%s", "\n");
+    return ndt_sink_printf(fd, "%s", "\n");
 }
 
-int ndt_fmt_icaor_flightplan_write(ndt_flightplan *flp, FILE *fd)
+int ndt_fmt_icaor_flightplan_write(ndt_flightplan *flp, ndt_sink *fd)
 {
     int ret = 0;
 
@@ -749,7 +785,7 @@ int ndt_fmt_icaor_flightplan_write(ndt_flightplan *flp, FILE *fd)
     }
 
     // departure airport
-    if ((ret = ndt_fprintf(fd, "%s SID", flp->dep.apt->info.idnt)))
+    if ((ret = ndt_sink_printf(fd, "%s SID", flp->dep.apt->info.idnt)))
     {
         goto end;
     }
@@ -759,7 +795,7 @@ int ndt_fmt_icaor_flightplan_write(ndt_flightplan *flp, FILE *fd)
     {
         if (flp->dep.sid.enroute.rsgt->dst)
         {
-            if ((ret = ndt_fprintf(fd, " %s", flp->dep.sid.enroute.rsgt->dst->info.idnt)))
+            if ((ret = ndt_sink_printf(fd, " %s", flp->dep.sid.enroute.rsgt->dst->info.idnt)))
             {
                 goto end;
             }
@@ -769,7 +805,7 @@ int ndt_fmt_icaor_flightplan_write(ndt_flightplan *flp, FILE *fd)
     {
         if (flp->dep.sid.rsgt->dst)
         {
-            if ((ret = ndt_fprintf(fd, " %s", flp->dep.sid.rsgt->dst->info.idnt)))
+            if ((ret = ndt_sink_printf(fd, " %s", flp->dep.sid.rsgt->dst->info.idnt)))
             {
                 goto end;
             }
@@ -777,7 +813,7 @@ int ndt_fmt_icaor_flightplan_write(ndt_flightplan *flp, FILE *fd)
     }
 
     // encoded route
-    if ((ret = ndt_fprintf(fd, "%s", " ")))
+    if ((ret = ndt_sink_printf(fd, "%s", " ")))
     {
         goto end;
     }
@@ -790,14 +826,14 @@ int ndt_fmt_icaor_flightplan_write(ndt_flightplan *flp, FILE *fd)
     }
     else
     {
-        if ((ret = ndt_fprintf(fd, "%s", "DCT")))
+        if ((ret = ndt_sink_printf(fd, "%s", "DCT")))
         {
             goto end;
         }
     }
 
     // arrival airport
-    ret = ndt_fprintf(fd, " STAR %s\n", flp->arr.apt->info.idnt);
+    ret = ndt_sink_printf(fd, " STAR %s\n", flp->arr.apt->info.idnt);
     if (ret)
     {
         goto end;
@@ -807,7 +843,7 @@ end:
     return ret;
 }
 
-int ndt_fmt_icaox_flightplan_write(ndt_flightplan *flp, FILE *fd)
+int ndt_fmt_icaox_flightplan_write(ndt_flightplan *flp, ndt_sink *fd)
 {
     int ret = 0;
 
@@ -825,7 +861,7 @@ int ndt_fmt_icaox_flightplan_write(ndt_flightplan *flp, FILE *fd)
     }
 
     // departure airport
-    if ((ret = ndt_fprintf(fd, "%s SID", flp->dep.apt->info.idnt)))
+    if ((ret = ndt_sink_printf(fd, "%s SID", flp->dep.apt->info.idnt)))
     {
         goto end;
     }
@@ -880,7 +916,7 @@ int ndt_fmt_icaox_flightplan_write(ndt_flightplan *flp, FILE *fd)
     if (sid_dst)
     {
         // SID endpoint, if it's a fix
-        if ((ret = ndt_fprintf(fd, " %s", sid_dst->info.idnt)))
+        if ((ret = ndt_sink_printf(fd, " %s", sid_dst->info.idnt)))
         {
             goto end;
         }
@@ -888,12 +924,12 @@ int ndt_fmt_icaox_flightplan_write(ndt_flightplan *flp, FILE *fd)
     if (num_route_legs)
     {
         // mandatory "via" field except for first waypoint
-        if (sid_dst && (ret = ndt_fprintf(fd, "%s", " DCT")))
+        if (sid_dst && (ret = ndt_sink_printf(fd, "%s", " DCT")))
         {
             goto end;
         }
         // encoded route
-        if ((ret = ndt_fprintf(fd, "%s", " ")))
+        if ((ret = ndt_sink_printf(fd, "%s", " ")))
         {
             goto end;
         }
@@ -905,19 +941,19 @@ int ndt_fmt_icaox_flightplan_write(ndt_flightplan *flp, FILE *fd)
     else if (arr_src)
     {
         // mandatory "via" field except for first waypoint
-        if ((sid_dst || num_route_legs) && (ret = ndt_fprintf(fd, "%s", " DCT")))
+        if ((sid_dst || num_route_legs) && (ret = ndt_sink_printf(fd, "%s", " DCT")))
         {
             goto end;
         }
         // STAR or approach entry point, if it's an applicable fix
-        if ((ret = ndt_fprintf(fd, " %s", arr_src->info.idnt)))
+        if ((ret = ndt_sink_printf(fd, " %s", arr_src->info.idnt)))
         {
             goto end;
         }
     }
 
     // arrival airport
-    if ((ret = ndt_fprintf(fd, " STAR %s\n", flp->arr.apt->info.idnt)))
+    if ((ret = ndt_sink_printf(fd, " STAR %s\n", flp->arr.apt->info.idnt)))
     {
         goto end;
     }
@@ -926,7 +962,7 @@ end:
     return ret;
 }
 
-static int fmt_irecp_print_leg(FILE *fd, ndt_route_leg *leg)
+static int fmt_irecp_print_leg(ndt_sink *fd, ndt_route_leg *leg)
 {
     if (!fd || !leg)
     {
@@ -935,7 +971,7 @@ static int fmt_irecp_print_leg(FILE *fd, ndt_route_leg *leg)
     switch (leg->type)
     {
         case NDT_LEGTYPE_ZZ:
-            return ndt_fprintf(fd, "\n%s\n", "        ----F-PLN DISCONTINUITY----");
+            return ndt_sink_printf(fd, "\n%s\n", "        ----F-PLN DISCONTINUITY----");
 
         default:
         {
@@ -973,19 +1009,19 @@ static int fmt_irecp_print_leg(FILE *fd, ndt_route_leg *leg)
             if (leg->src && leg->dst && leg->src != leg->dst && !ndt_list_count(leg->xpfms))
             {
                 double dist = ndt_distance_get(leg->dis, NDT_ALTUNIT_ME) / 1852.;
-                if ((rvalue = ndt_fprintf(fd, "\n%-16s  %05.1lf° (%05.1lf°T) %5.1lf nm\n",
-                                          idt1, leg->omb, leg->trb, dist)))
+                if ((rvalue = ndt_sink_printf(fd, "\n%-16s  %05.1lf° (%05.1lf°T) %5.1lf nm\n",
+                                              idt1, leg->omb, leg->trb, dist)))
                 {
                     return rvalue;
                 }
             }
-            else if ((rvalue = ndt_fprintf(fd, "\n%s\n", idt1)))
+            else if ((rvalue = ndt_sink_printf(fd, "\n%s\n", idt1)))
             {
                 // future: print magnetic course if we have it
                 return rvalue;
             }
             if ((*leg->info.misc) &&
-                (rvalue = ndt_fprintf(fd, "%s\n", leg->info.misc)))
+                (rvalue = ndt_sink_printf(fd, "%s\n", leg->info.misc)))
             {
                 return rvalue;
             }
@@ -998,16 +1034,16 @@ static int fmt_irecp_print_leg(FILE *fd, ndt_route_leg *leg)
                     return EIO;
                 }
                 if ((*leg->dst->info.misc) &&
-                    (rvalue = ndt_fprintf(fd, "%s\n", leg->dst->info.misc)))
+                    (rvalue = ndt_sink_printf(fd, "%s\n", leg->dst->info.misc)))
                 {
                     return rvalue;
                 }
-                if ((rvalue = ndt_fprintf(fd, "%-21s  %s\n", idt2, recap)))
+                if ((rvalue = ndt_sink_printf(fd, "%-21s  %s\n", idt2, recap)))
                 {
                     return rvalue;
                 }
             }
-            else if ((rvalue = ndt_fprintf(fd, "%s\n", idt2)))
+            else if ((rvalue = ndt_sink_printf(fd, "%s\n", idt2)))
             {
                 return rvalue;
             }
@@ -1059,7 +1095,7 @@ static const char* navaid_type_name(ndt_runway *rwy)
     return NULL;
 }
 
-static int print_apt_info(FILE *fd, ndt_airport *apt, const char *prefix)
+static int print_apt_info(ndt_sink *fd, ndt_airport *apt, const char *prefix)
 {
     if (!apt)
     {
@@ -1088,14 +1124,14 @@ static int print_apt_info(FILE *fd, ndt_airport *apt, const char *prefix)
     {
         snprintf(trbuf + trlen, sizeof(trbuf) - trlen, "/%s", "ATC");
     }
-    return ndt_fprintf(fd,
-                       "%s%s (%s), elevation (ft): %d, transition (ft): %.*s\n",
-                       prefix ? prefix : "",
-                       apt->info.idnt, apt->info.misc,
-                       apt_elev, sizeof(trbuf) - 1, trbuf);
+    return ndt_sink_printf(fd,
+                           "%s%s (%s), elevation (ft): %d, transition (ft): %.*s\n",
+                           prefix ? prefix : "",
+                           apt->info.idnt, apt->info.misc,
+                           apt_elev, sizeof(trbuf) - 1, trbuf);
 }
 
-static int print_rwy_info(FILE *fd, ndt_runway *rwy, const char *prefix)
+static int print_rwy_info(ndt_sink *fd, ndt_runway *rwy, const char *prefix)
 {
     if (!rwy)
     {
@@ -1105,30 +1141,30 @@ static int print_rwy_info(FILE *fd, ndt_runway *rwy, const char *prefix)
     int rwy_wid = ndt_distance_get(rwy->width,  NDT_ALTUNIT_FT);
     if (rwy->ils.avail)
     {
-        return ndt_fprintf(fd,
-                           "%s%s (%03d°), %d (%d) ft, surface: %s, %s: %.2lf (%03d°, %.1lf°)\n",
-                           prefix ? prefix : "",
-                           rwy->info.idnt,
-                           rwy->ndb_heading,
-                           rwy_len, rwy_wid,
-                           surfacetype_name (rwy),
-                           navaid_type_name (rwy),
-                           ndt_frequency_get(rwy->ils.freq),
-                           rwy->ils.course, rwy->ils.slope);
+        return ndt_sink_printf(fd,
+                               "%s%s (%03d°), %d (%d) ft, surface: %s, %s: %.2lf (%03d°, %.1lf°)\n",
+                               prefix ? prefix : "",
+                               rwy->info.idnt,
+                               rwy->ndb_heading,
+                               rwy_len, rwy_wid,
+                               surfacetype_name (rwy),
+                               navaid_type_name (rwy),
+                               ndt_frequency_get(rwy->ils.freq),
+                               rwy->ils.course, rwy->ils.slope);
     }
     else
     {
-        return ndt_fprintf(fd,
-                           "%s%s (%03d°), %d (%d) ft, surface: %s\n",
-                           prefix ? prefix : "",
-                           rwy->info.idnt,
-                           rwy->ndb_heading,
-                           rwy_len, rwy_wid,
-                           surfacetype_name(rwy));
+        return ndt_sink_printf(fd,
+                               "%s%s (%03d°), %d (%d) ft, surface: %s\n",
+                               prefix ? prefix : "",
+                               rwy->info.idnt,
+                               rwy->ndb_heading,
+                               rwy_len, rwy_wid,
+                               surfacetype_name(rwy));
     }
 }
 
-int ndt_fmt_irecp_flightplan_write(ndt_flightplan *flp, FILE *fd)
+int ndt_fmt_irecp_flightplan_write(ndt_flightplan *flp, ndt_sink *fd)
 {
     char sbrif[13], recap[24];
     double disnmile;
@@ -1164,14 +1200,14 @@ int ndt_fmt_irecp_flightplan_write(ndt_flightplan *flp, FILE *fd)
     {
         if (flp->dep.sid.enroute.proc)
         {
-            ret = ndt_fprintf(fd, "SID:       %-9s with transition: %s\n",
-                              flp->dep.sid.        proc->info.idnt,
-                              flp->dep.sid.enroute.proc->info.misc);
+            ret = ndt_sink_printf(fd, "SID:       %-9s with transition: %s\n",
+                                  flp->dep.sid.        proc->info.idnt,
+                                  flp->dep.sid.enroute.proc->info.misc);
         }
         else
         {
-            ret = ndt_fprintf(fd, "SID:       %-9s\n",
-                              flp->dep.sid.proc->info.idnt);
+            ret = ndt_sink_printf(fd, "SID:       %-9s\n",
+                                  flp->dep.sid.proc->info.idnt);
         }
         if (ret)
         {
@@ -1180,14 +1216,14 @@ int ndt_fmt_irecp_flightplan_write(ndt_flightplan *flp, FILE *fd)
     }
     if (ndt_list_count(flp->rte))
     {
-        if ((ret = ndt_fprintf(fd,   "%s", "Enroute:   ")))
+        if ((ret = ndt_sink_printf(fd,   "%s", "Enroute:   ")))
         {
             goto end;
         }
         if (flp->dep.sid.enroute.rsgt)
         {
             if ((flp->dep.sid.enroute.rsgt->dst) &&
-                (ret = ndt_fprintf(fd, "%s ", flp->dep.sid.enroute.rsgt->dst->info.idnt)))
+                (ret = ndt_sink_printf(fd, "%s ", flp->dep.sid.enroute.rsgt->dst->info.idnt)))
             {
                 goto end;
             }
@@ -1195,7 +1231,7 @@ int ndt_fmt_irecp_flightplan_write(ndt_flightplan *flp, FILE *fd)
         else if (flp->dep.sid.rsgt)
         {
             if ((flp->dep.sid.rsgt->dst) &&
-                (ret = ndt_fprintf(fd, "%s ", flp->dep.sid.rsgt->dst->info.idnt)))
+                (ret = ndt_sink_printf(fd, "%s ", flp->dep.sid.rsgt->dst->info.idnt)))
             {
                 goto end;
             }
@@ -1207,12 +1243,12 @@ int ndt_fmt_irecp_flightplan_write(ndt_flightplan *flp, FILE *fd)
     }
     else
     {
-        if ((ret = ndt_fprintf(fd, "%s", "Enroute:   DCT")))
+        if ((ret = ndt_sink_printf(fd, "%s", "Enroute:   DCT")))
         {
             goto end;
         }
     }
-    if ((ret = ndt_fprintf(fd, "%s", "\n")))
+    if ((ret = ndt_sink_printf(fd, "%s", "\n")))
     {
         goto end;
     }
@@ -1220,14 +1256,14 @@ int ndt_fmt_irecp_flightplan_write(ndt_flightplan *flp, FILE *fd)
     {
         if (flp->arr.star.enroute.proc)
         {
-            ret = ndt_fprintf(fd, "STAR:      %-9s with transition: %s\n",
-                              flp->arr.star.        proc->info.idnt,
-                              flp->arr.star.enroute.proc->info.misc);
+            ret = ndt_sink_printf(fd, "STAR:      %-9s with transition: %s\n",
+                                  flp->arr.star.        proc->info.idnt,
+                                  flp->arr.star.enroute.proc->info.misc);
         }
         else
         {
-            ret = ndt_fprintf(fd, "STAR:      %-9s\n",
-                              flp->arr.star.proc->info.idnt);
+            ret = ndt_sink_printf(fd, "STAR:      %-9s\n",
+                                  flp->arr.star.proc->info.idnt);
         }
         if (ret)
         {
@@ -1238,14 +1274,14 @@ int ndt_fmt_irecp_flightplan_write(ndt_flightplan *flp, FILE *fd)
     {
         if (flp->arr.apch.transition.proc)
         {
-            ret = ndt_fprintf(fd, "Approach:  %-9s with transition: %s\n",
-                              flp->arr.apch.           proc->info.idnt,
-                              flp->arr.apch.transition.proc->info.misc);
+            ret = ndt_sink_printf(fd, "Approach:  %-9s with transition: %s\n",
+                                  flp->arr.apch.           proc->info.idnt,
+                                  flp->arr.apch.transition.proc->info.misc);
         }
         else
         {
-            ret = ndt_fprintf(fd, "Approach:  %-9s\n",
-                              flp->arr.apch.proc->info.idnt);
+            ret = ndt_sink_printf(fd, "Approach:  %-9s\n",
+                                  flp->arr.apch.proc->info.idnt);
         }
         if (ret)
         {
@@ -1267,11 +1303,11 @@ int ndt_fmt_irecp_flightplan_write(ndt_flightplan *flp, FILE *fd)
     // all flightplan legs
     if (ndt_list_count(flp->legs) == 0)
     {
-        ret = ndt_fprintf(fd, "\n%s", "Flight route: DIRECT\n");
+        ret = ndt_sink_printf(fd, "\n%s", "Flight route: DIRECT\n");
     }
     else
     {
-        ret = ndt_fprintf(fd, "\n%s", "Flight route:\n");
+        ret = ndt_sink_printf(fd, "\n%s", "Flight route:\n");
     }
     if (ret)
     {
@@ -1303,7 +1339,7 @@ end:
     return ret;
 }
 
-int ndt_fmt_sbrif_flightplan_write(ndt_flightplan *flp, FILE *fd)
+int ndt_fmt_sbrif_flightplan_write(ndt_flightplan *flp, ndt_sink *fd)
 {
     int ret = 0;
 
@@ -1323,13 +1359,13 @@ int ndt_fmt_sbrif_flightplan_write(ndt_flightplan *flp, FILE *fd)
     // SID and transition, if present
     if (flp->dep.sid.proc)
     {
-        if ((ret = ndt_fprintf(fd, "%s", flp->dep.sid.proc->info.idnt)))
+        if ((ret = ndt_sink_printf(fd, "%s", flp->dep.sid.proc->info.idnt)))
         {
             goto end;
         }
         if (flp->dep.sid.enroute.proc)
         {
-            if ((ret = ndt_fprintf(fd, ".%s", flp->dep.sid.enroute.proc->info.misc)))
+            if ((ret = ndt_sink_printf(fd, ".%s", flp->dep.sid.enroute.proc->info.misc)))
             {
                 goto end;
             }
@@ -1340,7 +1376,7 @@ int ndt_fmt_sbrif_flightplan_write(ndt_flightplan *flp, FILE *fd)
     if (flp->dep.sid.enroute.rsgt)
     {
         if ((flp->dep.sid.enroute.rsgt->dst) &&
-            (ret = ndt_fprintf(fd, " %s", flp->dep.sid.enroute.rsgt->dst->info.idnt)))
+            (ret = ndt_sink_printf(fd, " %s", flp->dep.sid.enroute.rsgt->dst->info.idnt)))
         {
             goto end;
         }
@@ -1348,7 +1384,7 @@ int ndt_fmt_sbrif_flightplan_write(ndt_flightplan *flp, FILE *fd)
     else if (flp->dep.sid.rsgt)
     {
         if ((flp->dep.sid.rsgt->dst) &&
-            (ret = ndt_fprintf(fd, " %s", flp->dep.sid.rsgt->dst->info.idnt)))
+            (ret = ndt_sink_printf(fd, " %s", flp->dep.sid.rsgt->dst->info.idnt)))
         {
             goto end;
         }
@@ -1357,7 +1393,7 @@ int ndt_fmt_sbrif_flightplan_write(ndt_flightplan *flp, FILE *fd)
     // encoded route
     if (flp->dep.sid.enroute.proc || flp->dep.sid.proc)
     {
-        if ((ret = ndt_fprintf(fd, "%s", " ")))
+        if ((ret = ndt_sink_printf(fd, "%s", " ")))
         {
             goto end;
         }
@@ -1371,7 +1407,7 @@ int ndt_fmt_sbrif_flightplan_write(ndt_flightplan *flp, FILE *fd)
     }
     else
     {
-        if ((ret = ndt_fprintf(fd, "%s", "DCT")))
+        if ((ret = ndt_sink_printf(fd, "%s", "DCT")))
         {
             goto end;
         }
@@ -1380,25 +1416,25 @@ int ndt_fmt_sbrif_flightplan_write(ndt_flightplan *flp, FILE *fd)
     // STAR and transition, if present
     if (flp->arr.star.proc)
     {
-        if ((ret = ndt_fprintf(fd, "%s", " ")))
+        if ((ret = ndt_sink_printf(fd, "%s", " ")))
         {
             goto end;
         }
         if (flp->arr.star.enroute.proc)
         {
-            if ((ret = ndt_fprintf(fd, "%s.", flp->arr.star.enroute.proc->info.misc)))
+            if ((ret = ndt_sink_printf(fd, "%s.", flp->arr.star.enroute.proc->info.misc)))
             {
                 goto end;
             }
         }
-        if ((ret = ndt_fprintf(fd, "%s", flp->arr.star.proc->info.idnt)))
+        if ((ret = ndt_sink_printf(fd, "%s", flp->arr.star.proc->info.idnt)))
         {
             goto end;
         }
     }
 
     // we're done!
-    if ((ret = ndt_fprintf(fd, "%s", "\n")))
+    if ((ret = ndt_sink_printf(fd, "%s", "\n")))
     {
         goto end;
     }
@@ -1407,7 +1443,7 @@ end:
     return ret;
 }
 
-static int icao_printrt(FILE *fd, ndt_list *rte, ndt_fltplanformat fmt)
+static int icao_printrt(ndt_sink *fd, ndt_list *rte, ndt_fltplanformat fmt)
 {
     ndt_llcfmt llcfmt;
     int ret = 0;
@@ -1449,20 +1485,20 @@ static int icao_printrt(FILE *fd, ndt_list *rte, ndt_fltplanformat fmt)
             goto end;
         }
 
-        if (i && (ret = ndt_fprintf(fd, "%s", " ")))
+        if (i && (ret = ndt_sink_printf(fd, "%s", " ")))
         {
             goto end;
         }
         switch (rsg->type)
         {
             case NDT_RSTYPE_AWY:
-                ret = ndt_fprintf(fd, "%s %s", rsg->awy.awy->info.idnt, rsg->dst->info.idnt);
+                ret = ndt_sink_printf(fd, "%s %s", rsg->awy.awy->info.idnt, rsg->dst->info.idnt);
                 break;
 
             case NDT_RSTYPE_DCT:
                 if (i && fmt == NDT_FLTPFMT_ICAOX)
                 {   // mandatory "via" field except for first waypoint
-                    if ((ret = ndt_fprintf(fd, "%s", "DCT ")))
+                    if ((ret = ndt_sink_printf(fd, "%s", "DCT ")))
                     {
                         goto end;
                     }
@@ -1488,7 +1524,7 @@ end:
     return ret;
 }
 
-static int icao_printwp(FILE *fd, ndt_waypoint *dst, ndt_llcfmt llcfmt, ndt_fltplanformat fmt)
+static int icao_printwp(ndt_sink *fd, ndt_waypoint *dst, ndt_llcfmt llcfmt, ndt_fltplanformat fmt)
 {
     if (!fd || !dst)
     {
@@ -1496,7 +1532,7 @@ static int icao_printwp(FILE *fd, ndt_waypoint *dst, ndt_llcfmt llcfmt, ndt_fltp
     }
     if (fmt == NDT_FLTPFMT_DTEST)
     {
-        return ndt_position_fprintllc(dst->position, llcfmt, fd);
+        return ndt_position_sinkllc(dst->position, llcfmt, fd);
     }
     switch (dst->type)
     {
@@ -1505,7 +1541,7 @@ static int icao_printwp(FILE *fd, ndt_waypoint *dst, ndt_llcfmt llcfmt, ndt_fltp
         case NDT_WPTYPE_FIX:
         case NDT_WPTYPE_NDB:
         case NDT_WPTYPE_VOR: // use the identifier
-            return ndt_fprintf(fd, "%s", dst->info.idnt);
+            return ndt_sink_printf(fd, "%s", dst->info.idnt);
 
         case NDT_WPTYPE_PBD:
             if ((fmt == NDT_FLTPFMT_DCDED ||
@@ -1518,17 +1554,17 @@ static int icao_printwp(FILE *fd, ndt_waypoint *dst, ndt_llcfmt llcfmt, ndt_fltp
                 double   nm = ndt_distance_get(dst->pbd.distance, NDT_ALTUNIT_ME) / 1852.;
                 if (fabs(nm - round(nm)) < .05) // nm distance basically an integer, yay!
                 {
-                    return ndt_fprintf(fd, "%5s%03.0lf%03.0lf",
-                                       dst->pbd.place->info.idnt,
-                                       dst->pbd.bearing, round(nm));
+                    return ndt_sink_printf(fd, "%5s%03.0lf%03.0lf",
+                                           dst->pbd.place->info.idnt,
+                                           dst->pbd.bearing, round(nm));
                 }
             }
         default: // use latitude/longitude coordinates
-            return ndt_position_fprintllc(dst->position, llcfmt, fd);
+            return ndt_position_sinkllc(dst->position, llcfmt, fd);
     }
 }
 
-static int icao_printlg(FILE *fd, ndt_list *lgs, ndt_fltplanformat fmt)
+static int icao_printlg(ndt_sink *fd, ndt_list *lgs, ndt_fltplanformat fmt)
 {
     ndt_llcfmt llcfmt;
     int ret = 0;
@@ -1561,7 +1597,7 @@ static int icao_printlg(FILE *fd, ndt_list *lgs, ndt_fltplanformat fmt)
             goto end;
         }
 
-        if (need_space && (ret = ndt_fprintf(fd, "%s", " ")))
+        if (need_space && (ret = ndt_sink_printf(fd, "%s", " ")))
         {
             goto end;
         }
@@ -1583,7 +1619,7 @@ static int icao_printlg(FILE *fd, ndt_list *lgs, ndt_fltplanformat fmt)
                 {
                     for (size_t j = 0; j < ndt_list_count(leg->xpfms); j++)
                     {
-                        if (j && (ret = ndt_fprintf(fd, "%s", " ")))
+                        if (j && (ret = ndt_sink_printf(fd, "%s", " ")))
                         {
                             goto end;
                         }
@@ -1592,7 +1628,7 @@ static int icao_printlg(FILE *fd, ndt_list *lgs, ndt_fltplanformat fmt)
                             goto end;
                         }
                     }
-                    if (ndt_list_count(leg->xpfms) && (ret = ndt_fprintf(fd, "%s", " ")))
+                    if (ndt_list_count(leg->xpfms) && (ret = ndt_sink_printf(fd, "%s", " ")))
                     {
                         goto end;
                     }
@@ -1609,7 +1645,7 @@ static int icao_printlg(FILE *fd, ndt_list *lgs, ndt_fltplanformat fmt)
             {
                 for (size_t j = 0; j < ndt_list_count(leg->xpfms); j++)
                 {
-                    if (j && (ret = ndt_fprintf(fd, "%s", " ")))
+                    if (j && (ret = ndt_sink_printf(fd, "%s", " ")))
                     {
                         goto end;
                     }
@@ -1621,7 +1657,7 @@ static int icao_printlg(FILE *fd, ndt_list *lgs, ndt_fltplanformat fmt)
                 }
                 if (leg->dst)
                 {
-                    if (ndt_list_count(leg->xpfms) && (ret = ndt_fprintf(fd, "%s", " ")))
+                    if (ndt_list_count(leg->xpfms) && (ret = ndt_sink_printf(fd, "%s", " ")))
                     {
                         goto end;
                     }
@@ -1640,7 +1676,95 @@ end:
     return ret;
 }
 
+/*
+ * Place-bearing-distance elements, matched without sscanf (several attempts
+ * per route element add up). Same matches as the following formats, in order
+ * (bearing and distance in decimal notation):
+ *
+ *     prefix: "%5[^0-9]%1d%1d%1d%1d%1d%1d%c" (7 conversions)
+ *     elem:   "%7[^/]/%lf/%lf%c"             (3 conversions)
+ *     elem:   "%7[^0-9]%lf/%lf%c"            (3 conversions)
+ */
+static const char* icao_matchnm(const char *str, double *num)
+{
+    char *end;
+    *num = strtod(str, &end);
+    if (end == str)
+    {
+        return NULL;
+    }
+    if ((*end == 'e' || *end == 'E') && strcspn(str, "eE") == end - str && strchr("0123456789.", end[-1]))
+    {
+        // like sscanf, consume a dangling exponent (e.g. "10e", "10e+")
+        end += 1 + (end[1] == '+' || end[1] == '-');
+    }
+    return end;
+}
+
+static int icao_matchbd(const char *str, double *brg, double *dis)
+{
+    if ((str = icao_matchnm(str, brg)) && *str == '/' &&
+        (str = icao_matchnm(str + 1, dis)))
+    {
+        return *str == '\0';
+    }
+    return 0;
+}
+
+static int icao_matchpb(const char *elem, const char *prefix, char *place, double *brg, double *dis)
+{
+    size_t len = strcspn(prefix, "0123456789");
+    if (len >= 1 && len <= 5 && strspn(prefix + len, "0123456789") == 6 && !prefix[len + 6])
+    {
+        const char *num = prefix + len;
+        *brg = (num[0] - '0') * 100. + (num[1] - '0') * 10. + (num[2] - '0') * 1.;
+        *dis = (num[3] - '0') * 100. + (num[4] - '0') * 10. + (num[5] - '0') * 1.;
+        snprintf(place, 8, "%.*s", (int)len, prefix);
+        return 1;
+    }
+    if ((len = strcspn(elem, "/")) >= 1 && len <= 7 && elem[len] == '/' && icao_matchbd(elem + len + 1, brg, dis))
+    {
+        snprintf(place, 8, "%.*s", (int)len, elem);
+        return 1;
+    }
+    if ((len = strcspn(elem, "0123456789")) > 7)
+    {
+        len = 7;
+    }
+    if (len >= 1 && icao_matchbd(elem + len, brg, dis))
+    {
+        snprintf(place, 8, "%.*s", (int)len, elem);
+        return 1;
+    }
+    return 0;
+}
+
+static void icao_report(ndt_flightplan *flp, const char *elem, size_t offset, int error, const char *what, ndt_waypoint *wpt)
+{
+    if (flp && flp->check.cb)
+    {
+        ndt_route_check check =
+        {
+            .elem   = elem,
+            .offset = offset,
+            .error  = error,
+            .what   = what,
+            .wpt    = wpt,
+        };
+        flp->check.cb(&check, flp->check.ctx);
+    }
+}
+
 int ndt_fmt_icaor_print_airportnfo(ndt_navdatabase *ndb, const char *icao, int rwy_unit)
+{
+    ndt_sink *sink = ndt_sink_init(stdout);
+    int        ret = ndt_fmt_icaor_print_airportnfo2(ndb, icao, rwy_unit, sink);
+    int        err = ndt_sink_flush(sink);
+    ndt_sink_close(&sink);
+    return ret ? ret : err;
+}
+
+int ndt_fmt_icaor_print_airportnfo2(ndt_navdatabase *ndb, const char *icao, int rwy_unit, ndt_sink *sink)
 {
     ndt_procedure *pr1, *pr2;
     ndt_route_leg       *leg;
@@ -1662,30 +1786,30 @@ int ndt_fmt_icaor_print_airportnfo(ndt_navdatabase *ndb, const char *icao, int r
     k = ndt_distance_get(apt->trans_level,          NDT_ALTUNIT_FT);
     if (j && k)
     {
-        fprintf(stdout,
-                "Airport: %s (%s), elevation: %d, transition: %d/FL%d\n",
-                apt->info.idnt, apt->info.misc, i, j, k / 100);
+        ndt_sink_printf(sink,
+                        "Airport: %s (%s), elevation: %d, transition: %d/FL%d\n",
+                        apt->info.idnt, apt->info.misc, i, j, k / 100);
     }
     else if (j)
     {
-        fprintf(stdout,
-                "Airport: %s (%s), elevation: %d, transition: %d/ATC\n",
-                apt->info.idnt, apt->info.misc, i, j);
+        ndt_sink_printf(sink,
+                        "Airport: %s (%s), elevation: %d, transition: %d/ATC\n",
+                        apt->info.idnt, apt->info.misc, i, j);
     }
     else if (k)
     {
-        fprintf(stdout,
-                "Airport: %s (%s), elevation: %d, transition: ATC/FL%d\n",
-                apt->info.idnt, apt->info.misc, i, k / 100);
+        ndt_sink_printf(sink,
+                        "Airport: %s (%s), elevation: %d, transition: ATC/FL%d\n",
+                        apt->info.idnt, apt->info.misc, i, k / 100);
     }
     else
     {
-        fprintf(stdout,
-                "Airport: %s (%s), elevation: %d, transition: ATC\n",
-                apt->info.idnt, apt->info.misc, i);
+        ndt_sink_printf(sink,
+                        "Airport: %s (%s), elevation: %d, transition: ATC\n",
+                        apt->info.idnt, apt->info.misc, i);
     }
 
-    fprintf(stdout, "Runways:%s", "\n\n");
+    ndt_sink_printf(sink, "Runways:%s", "\n\n");
     for (i = 0; i < ndt_list_count(apt->runways); i++)
     {
         if ((rwy = ndt_list_item(apt->runways, i)))
@@ -1711,23 +1835,23 @@ int ndt_fmt_icaor_print_airportnfo(ndt_navdatabase *ndb, const char *icao, int r
             {
                 case 1:
                 {
-                    fprintf(stdout, "    %-3s %05.1lf° (db: %03d°) Length: %5d, width: %3d, surface: %s, %s: %.2lf (%03d°, %.1lf°)\n",
-                            rwy->info.idnt, rwy->mag_heading, rwy->ndb_heading, j, k, surfacetype_name(rwy), navaid_type_name(rwy),
-                            ndt_frequency_get(rwy->ils.freq), rwy->ils.course, rwy->ils.slope);
+                    ndt_sink_printf(sink, "    %-3s %05.1lf° (db: %03d°) Length: %5d, width: %3d, surface: %s, %s: %.2lf (%03d°, %.1lf°)\n",
+                                    rwy->info.idnt, rwy->mag_heading, rwy->ndb_heading, j, k, surfacetype_name(rwy), navaid_type_name(rwy),
+                                    ndt_frequency_get(rwy->ils.freq), rwy->ils.course, rwy->ils.slope);
                     break;
                 }
 
                 case -1:
                 {
-                    fprintf(stdout, "    %-3s %05.1lf° (db: %03d°) Length: %5d, width: %3d, surface: %s, glide path: %.1lf°\n",
-                            rwy->info.idnt, rwy->mag_heading, rwy->ndb_heading, j, k, surfacetype_name(rwy), rwy->ils.slope);
+                    ndt_sink_printf(sink, "    %-3s %05.1lf° (db: %03d°) Length: %5d, width: %3d, surface: %s, glide path: %.1lf°\n",
+                                    rwy->info.idnt, rwy->mag_heading, rwy->ndb_heading, j, k, surfacetype_name(rwy), rwy->ils.slope);
                     break;
                 }
 
                 default:
                 {
-                    fprintf(stdout, "    %-3s %05.1lf° (db: %03d°) Length: %5d, width: %3d, surface: %s\n",
-                            rwy->info.idnt, rwy->mag_heading, rwy->ndb_heading, j, k, surfacetype_name(rwy));
+                    ndt_sink_printf(sink, "    %-3s %05.1lf° (db: %03d°) Length: %5d, width: %3d, surface: %s\n",
+                                    rwy->info.idnt, rwy->mag_heading, rwy->ndb_heading, j, k, surfacetype_name(rwy));
                     break;
                 }
             }
@@ -1735,31 +1859,28 @@ int ndt_fmt_icaor_print_airportnfo(ndt_navdatabase *ndb, const char *icao, int r
             {
                 if ((pr1 = ndt_list_item(rwy->approaches, j)))
                 {
-                    if (!pr1->opened)
-                    {
-                        // open procedure only when needed (for performance)
-                        ndt_procedure_open(ndb, pr1);
-                    }
+                    // open procedure only when needed (for performance)
+                    ndt_procedure_open(ndb, pr1);
                     leg = ndt_list_item(pr1->proclegs, 0);
-                    fprintf(stdout, "        approach: %-7s from: %-5s",
-                            pr1->info.idnt,
-                            leg && leg->type == NDT_LEGTYPE_IF ? leg->dst->info.idnt :
-                            leg && leg->src  != NULL           ? leg->src->info.idnt : "");
+                    ndt_sink_printf(sink, "        approach: %-7s from: %-5s",
+                                    pr1->info.idnt,
+                                    leg && leg->type == NDT_LEGTYPE_IF ? leg->dst->info.idnt :
+                                    leg && leg->src  != NULL           ? leg->src->info.idnt : "");
                     if (ndt_list_count(pr1->transition.approach))
                     {
-                        fprintf(stdout, "%s", " with transition(s):");
+                        ndt_sink_printf(sink, "%s", " with transition(s):");
                     }
                     for (k = 0; k < ndt_list_count(pr1->transition.approach); k++)
                     {
                         if ((pr2 = ndt_list_item(pr1->transition.approach, k)))
                         {
-                            fprintf(stdout, " %s", pr2->info.misc);
+                            ndt_sink_printf(sink, " %s", pr2->info.misc);
                         }
                     }
-                    fprintf(stdout, "%s", "\n");
+                    ndt_sink_printf(sink, "%s", "\n");
                 }
             }
-            fprintf(stdout, "%s", "\n");
+            ndt_sink_printf(sink, "%s", "\n");
         }
     }
 
@@ -1771,91 +1892,85 @@ int ndt_fmt_icaor_print_airportnfo(ndt_navdatabase *ndb, const char *icao, int r
     ndt_procedure_names(apt->sids, names);
     if (ndt_list_count(names))
     {
-        fprintf(stdout, "Standard Instrument Departures:%s", "\n\n");
+        ndt_sink_printf(sink, "Standard Instrument Departures:%s", "\n\n");
         for (i = 0; i < ndt_list_count(names); i++)
         {
-            fprintf(stdout, "    %s\n", (char*)ndt_list_item(names, i));
-            fprintf(stdout, "    %s", "applicable to runways:");
+            ndt_sink_printf(sink, "    %s\n", (char*)ndt_list_item(names, i));
+            ndt_sink_printf(sink, "    %s", "applicable to runways:");
             for (j = 0; j < ndt_list_count(apt->runways); j++)
             {
                 if ((rwy = ndt_list_item(apt->runways, j)) &&
                     (ndt_procedure_get(apt->sids, ndt_list_item(names, i), rwy)))
                 {
-                    fprintf(stdout, " %s", rwy->info.idnt);
+                    ndt_sink_printf(sink, " %s", rwy->info.idnt);
                 }
             }
-            fprintf(stdout, "%s", "\n");
+            ndt_sink_printf(sink, "%s", "\n");
             pr1 = ndt_procedure_get(apt->sids, ndt_list_item(names, i), NULL);
             if (pr1)
             {
                 pr2 = pr1->transition.sid ? pr1->transition.sid : pr1;
-                if  (!pr2->opened)
-                {
-                    // open procedure only when needed (for performance)
-                    ndt_procedure_open(ndb, pr2);
-                }
+                // open procedure only when needed (for performance)
+                ndt_procedure_open(ndb, pr2);
                 if ((leg = ndt_list_item(pr2->proclegs, -1)) && leg->dst)
                 {
-                    fprintf(stdout, "    procedure's final fix: %s\n", leg->dst->info.idnt);
+                    ndt_sink_printf(sink, "    procedure's final fix: %s\n", leg->dst->info.idnt);
                 }
             }
             ndt_procedure_trans(pr1 ? pr1->transition.enroute : NULL, trans);
             if (ndt_list_count(trans))
             {
-                fprintf(stdout, "    %s", "enroute transition(s):");
+                ndt_sink_printf(sink, "    %s", "enroute transition(s):");
                 for (j = 0; j < ndt_list_count(trans); j++)
                 {
-                    fprintf(stdout, " %s", (char*)ndt_list_item(trans, j));
+                    ndt_sink_printf(sink, " %s", (char*)ndt_list_item(trans, j));
                 }
-                fprintf(stdout, "%s", "\n");
+                ndt_sink_printf(sink, "%s", "\n");
             }
-            fprintf(stdout, "%s", "\n");
+            ndt_sink_printf(sink, "%s", "\n");
         }
     }
 
     ndt_procedure_names(apt->stars, names);
     if (ndt_list_count(names))
     {
-        fprintf(stdout, "Standard Terminal Arrival Routes:%s", "\n\n");
+        ndt_sink_printf(sink, "Standard Terminal Arrival Routes:%s", "\n\n");
         for (i = 0; i < ndt_list_count(names); i++)
         {
-            fprintf(stdout, "    %s\n", (char*)ndt_list_item(names, i));
+            ndt_sink_printf(sink, "    %s\n", (char*)ndt_list_item(names, i));
             pr1 = ndt_procedure_get(apt->stars, ndt_list_item(names, i), NULL);
             ndt_procedure_trans(pr1 ? pr1->transition.enroute : NULL, trans);
             if (ndt_list_count(trans))
             {
-                fprintf(stdout, "    %s", "enroute transition(s):");
+                ndt_sink_printf(sink, "    %s", "enroute transition(s):");
                 for (j = 0; j < ndt_list_count(trans); j++)
                 {
-                    fprintf(stdout, " %s", (char*)ndt_list_item(trans, j));
+                    ndt_sink_printf(sink, " %s", (char*)ndt_list_item(trans, j));
                 }
-                fprintf(stdout, "%s", "\n");
+                ndt_sink_printf(sink, "%s", "\n");
             }
             if (pr1)
             {
                 pr2 = pr1->transition.star ? pr1->transition.star : pr1;
-                if  (!pr2->opened)
-                {
-                    // open procedure only when needed (for performance)
-                    ndt_procedure_open(ndb, pr2);
-                }
+                // open procedure only when needed (for performance)
+                ndt_procedure_open(ndb, pr2);
                 if ((leg = ndt_list_item(pr2->proclegs, 0)) &&
                     (leg->src || leg->type == NDT_LEGTYPE_IF))
                 {
-                    fprintf(stdout, "    initial procedure fix: %s\n",
-                            leg->src ? leg->src->info.idnt : leg->dst->info.idnt);
+                    ndt_sink_printf(sink, "    initial procedure fix: %s\n",
+                                    leg->src ? leg->src->info.idnt : leg->dst->info.idnt);
                 }
             }
-            fprintf(stdout, "    %s", "applicable to runways:");
+            ndt_sink_printf(sink, "    %s", "applicable to runways:");
             for (j = 0; j < ndt_list_count(apt->runways); j++)
             {
                 if ((rwy = ndt_list_item(apt->runways, j)) &&
                     (ndt_procedure_get(apt->stars, ndt_list_item(names, i), rwy)))
                 {
-                    fprintf(stdout, " %s", rwy->info.idnt);
+                    ndt_sink_printf(sink, " %s", rwy->info.idnt);
                 }
             }
-            fprintf(stdout, "%s", "\n\n");
+            ndt_sink_printf(sink, "%s", "\n\n");
         }
     }
 
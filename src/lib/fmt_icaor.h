@@ -22,17 +22,19 @@
 #define NDT_FMT_ICAOR_H
 
 #include "common/common.h"
+#include "common/sink.h"
 
 #include "flightplan.h"
 #include "navdata.h"
 
 int ndt_fmt_icaor_flightplan_set_route(ndt_flightplan *flightplan, const char *route);
-int ndt_fmt_dcded_flightplan_write    (ndt_flightplan *flightplan, FILE       *file );
-int ndt_fmt_dtest_flightplan_write    (ndt_flightplan *flightplan, FILE       *file );
-int ndt_fmt_icaor_flightplan_write    (ndt_flightplan *flightplan, FILE       *file );
-int ndt_fmt_icaox_flightplan_write    (ndt_flightplan *flightplan, FILE       *file );
-int ndt_fmt_irecp_flightplan_write    (ndt_flightplan *flightplan, FILE       *file );
-int ndt_fmt_sbrif_flightplan_write    (ndt_flightplan *flightplan, FILE       *file );
-int ndt_fmt_icaor_print_airportnfo(ndt_navdatabase *db, const char *icao, int rwunit);
+int ndt_fmt_dcded_flightplan_write    (ndt_flightplan *flightplan, ndt_sink   *sink );
+int ndt_fmt_dtest_flightplan_write    (ndt_flightplan *flightplan, ndt_sink   *sink );
+int ndt_fmt_icaor_flightplan_write    (ndt_flightplan *flightplan, ndt_sink   *sink );
+int ndt_fmt_icaox_flightplan_write    (ndt_flightplan *flightplan, ndt_sink   *sink );
+int ndt_fmt_irecp_flightplan_write    (ndt_flightplan *flightplan, ndt_sink   *sink );
+int ndt_fmt_sbrif_flightplan_write    (ndt_flightplan *flightplan, ndt_sink   *sink );
+int ndt_fmt_icaor_print_airportnfo (ndt_navdatabase *db, const char *icao, int rwunit                 );
+int ndt_fmt_icaor_print_airportnfo2(ndt_navdatabase *db, const char *icao, int rwunit, ndt_sink *sink);
 
 #endif /* NDT_FMT_ICAOR_H */
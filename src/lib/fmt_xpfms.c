@@ -27,6 +27,7 @@
 
 #include "common/common.h"
 #include "common/list.h"
+#include "common/sink.h"
 
 #include "compat/compat.h"
 
@@ -150,7 +151,7 @@ int ndt_fmt_xpfms_flightplan_set_route(ndt_flightplan *flp, const char *rte)
 
         if (typ != 13 && typ != 28)
         {
-            for (size_t dstidx = 0; (dst = ndt_navdata_get_waypoint(flp->ndb, buf, &dstidx)); dstidx++)
+            for (size_t dstidx = 0; (dst = ndt_flightplan_get_waypoint(flp, buf, &dstidx)); dstidx++)
             {
                 switch (dst->type)
                 {
@@ -167,6 +168,7 @@ int ndt_fmt_xpfms_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                         break;
 
                     case NDT_WPTYPE_FIX:
+                    case NDT_WPTYPE_LLC: // user waypoint, see ndt_flightplan_user_waypoint
                         if (typ != 11) dst = NULL;
                         break;
 
@@ -274,7 +276,7 @@ int ndt_fmt_xpfms_flightplan_set_route(ndt_flightplan *flp, const char *rte)
 
         if (typ != 13 && typ != 28)
         {
-            for (size_t dstidx = 0; (dst = ndt_navdata_get_waypoint(flp->ndb, buf, &dstidx)); dstidx++)
+            for (size_t dstidx = 0; (dst = ndt_flightplan_get_waypoint(flp, buf, &dstidx)); dstidx++)
             {
                 switch (dst->type)
                 {
@@ -291,6 +293,7 @@ int ndt_fmt_xpfms_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                         break;
 
                     case NDT_WPTYPE_FIX:
+                    case NDT_WPTYPE_LLC: // user waypoint, see ndt_flightplan_user_waypoint
                         if (typ != 11) dst = NULL;
                         break;
 
@@ -330,7 +333,7 @@ int ndt_fmt_xpfms_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                 // we're done with the identifier, we can use buf
                 snprintf(buf, sizeof(buf), "%+010.6lf/%+011.6lf", lat, lon);
             }
-            if (!(dst = ndt_waypoint_llc(buf)))
+            if (!(dst = ndt_waypoint_llc(buf, flp->arena)))
             {
                 err = ENOMEM;
                 goto end;
@@ -347,12 +350,12 @@ int ndt_fmt_xpfms_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                         if (flp->dep.rwy == NULL && ndt_list_count(flp->rte) == 0)
                         {
                             // first actual leg, so we can set depaerture runway
-                            ndt_waypoint_close(&dst);
+                            ndt_waypoint_close2(&dst, flp->arena);
                             flp->dep.rwy = rwy;
                             dst = NULL;
                             break;
                         }
-                        ndt_waypoint_close(&dst);
+                        ndt_waypoint_close2(&dst, flp->arena);
                         dst = rwy->waypoint;
                         break;
                     }
@@ -374,7 +377,7 @@ int ndt_fmt_xpfms_flightplan_set_route(ndt_flightplan *flp, const char *rte)
                         if (distancem < 9) // close enough, map to the runway
                         {
                             // arrival runway from route: trickier, don't bother
-                            ndt_waypoint_close(&dst);
+                            ndt_waypoint_close2(&dst, flp->arena);
                             dst = rwy->waypoint;
                             break;
                         }
@@ -389,7 +392,7 @@ int ndt_fmt_xpfms_flightplan_set_route(ndt_flightplan *flp, const char *rte)
 
         if (discontinuity)
         {
-            ndt_route_segment *dsc = ndt_route_segment_discon();
+            ndt_route_segment *dsc = ndt_route_segment_discon(flp->arena);
             if (!dsc)
             {
                 err = ENOMEM;
@@ -397,11 +400,11 @@ int ndt_fmt_xpfms_flightplan_set_route(ndt_flightplan *flp, const char *rte)
             }
             discontinuity = 0;
             ndt_list_add(flp->rte, dsc);
-            rsg = ndt_route_segment_direct(NULL, dst);
+            rsg = ndt_route_segment_direct(NULL, dst, flp->arena);
         }
         else
         {
-            rsg = ndt_route_segment_direct( src, dst);
+            rsg = ndt_route_segment_direct( src, dst, flp->arena);
         }
 
         if (!rsg)
@@ -554,12 +557,12 @@ end:
     return err;
 }
 
-static int update__row(FILE *fd, int row)
+static int update__row(ndt_sink *fd, int row)
 {
     if (row <= 0 || row >= 9)
     {
         // new page
-        if (ndt_fprintf(fd, "%s", "\n"))
+        if (ndt_sink_printf(fd, "%s", "\n"))
         {
             return -1;
         }
@@ -568,7 +571,7 @@ static int update__row(FILE *fd, int row)
     return row + 1;
 }
 
-static int helpr_waypoint_write(FILE *fd, ndt_waypoint *wpt, int row, ndt_fltplanformat fmt, ndt_restriction *constraints)
+static int helpr_waypoint_write(ndt_sink *fd, ndt_waypoint *wpt, int row, ndt_fltplanformat fmt, ndt_restriction *constraints)
 {
     char buf[25];
     int  ret;
@@ -577,29 +580,29 @@ static int helpr_waypoint_write(FILE *fd, ndt_waypoint *wpt, int row, ndt_fltpla
     {
         if (wpt == NULL)
         {
-            return ndt_fprintf(fd, "-------  %-19s  -------------------------\n", "F-PLN DISCONTINUITY");
+            return ndt_sink_printf(fd, "-------  %-19s  -------------------------\n", "F-PLN DISCONTINUITY");
         }
-        ret = ndt_fprintf(fd, "%2d  %s  %-19s  %2d  %+07.3lf  %+08.3lf  %2d", row,
-                          wpt->type == NDT_WPTYPE_APT ? "APT" :
-                          wpt->type == NDT_WPTYPE_FIX ? "fix" :
-                          wpt->type == NDT_WPTYPE_NDB ? "NDB" :
-                          wpt->type == NDT_WPTYPE_VOR ? "VOR" : "l/l",
-                          wpt->info.idnt, row,
-                          ndt_position_getlatitude (wpt->position, NDT_ANGUNIT_DEG),
-                          ndt_position_getlongitude(wpt->position, NDT_ANGUNIT_DEG), row);
+        ret = ndt_sink_printf(fd, "%2d  %s  %-19s  %2d  %+07.3lf  %+08.3lf  %2d", row,
+                              wpt->type == NDT_WPTYPE_APT ? "APT" :
+                              wpt->type == NDT_WPTYPE_FIX ? "fix" :
+                              wpt->type == NDT_WPTYPE_NDB ? "NDB" :
+                              wpt->type == NDT_WPTYPE_VOR ? "VOR" : "l/l",
+                              wpt->info.idnt, row,
+                              ndt_position_getlatitude (wpt->position, NDT_ANGUNIT_DEG),
+                              ndt_position_getlongitude(wpt->position, NDT_ANGUNIT_DEG), row);
     }
     else if (fmt == NDT_FLTPFMT_XPCDU)
     {
         if (wpt == NULL)
         {
-            return ndt_fprintf(fd, "--  %-19s  ------------------------\n", "F-PLN DISCONTINUITY");
+            return ndt_sink_printf(fd, "--  %-19s  ------------------------\n", "F-PLN DISCONTINUITY");
         }
         if (ndt_position_sprintllc(wpt->position, NDT_LLCFMT_AIBUS,
                                    buf, sizeof(buf)) < 0)
         {
             return EIO;
         }
-        ret = ndt_fprintf(fd, "%2d  %-19s  %2d  %s  %2d", row, wpt->info.idnt, row, buf, row);
+        ret = ndt_sink_printf(fd, "%2d  %-19s  %2d  %s  %2d", row, wpt->info.idnt, row, buf, row);
     }
     else if (fmt == NDT_FLTPFMT_XPCVA)
     {
@@ -608,7 +611,7 @@ static int helpr_waypoint_write(FILE *fd, ndt_waypoint *wpt, int row, ndt_fltpla
         {
             return EIO;
         }
-        ret = ndt_fprintf(fd, "%d  %-19s  %d  %s  %d", row, wpt->info.idnt, row, buf, row);
+        ret = ndt_sink_printf(fd, "%d  %-19s  %d  %s  %d", row, wpt->info.idnt, row, buf, row);
     }
     if (ret)
     {
@@ -627,19 +630,19 @@ static int helpr_waypoint_write(FILE *fd, ndt_waypoint *wpt, int row, ndt_fltpla
             switch (constraints->waypoint)
             {
                 case NDT_WPTCONST_FAF:
-                    ret = ndt_fprintf(fd, "  %s", "f");
+                    ret = ndt_sink_printf(fd, "  %s", "f");
                     break;
                 case NDT_WPTCONST_FOV:
-                    ret = ndt_fprintf(fd, "  %s", "o");
+                    ret = ndt_sink_printf(fd, "  %s", "o");
                     break;
                 case NDT_WPTCONST_IAF:
-                    ret = ndt_fprintf(fd, "  %s", "i");
+                    ret = ndt_sink_printf(fd, "  %s", "i");
                     break;
                 case NDT_WPTCONST_MAP:
-                    ret = ndt_fprintf(fd, "  %s", "m");
+                    ret = ndt_sink_printf(fd, "  %s", "m");
                     break;
                 default:
-                    ret = ndt_fprintf(fd, "  %s", " ");
+                    ret = ndt_sink_printf(fd, "  %s", " ");
                     break;
             }
             if (ret)
@@ -651,19 +654,19 @@ static int helpr_waypoint_write(FILE *fd, ndt_waypoint *wpt, int row, ndt_fltpla
         switch (constraints->altitude.typ)
         {
             case NDT_RESTRICT_AB:
-                ret = ndt_fprintf(fd, "  ALT above %5d",       altmin);
+                ret = ndt_sink_printf(fd, "  ALT above %5d",       altmin);
                 break;
             case NDT_RESTRICT_AT:
-                ret = ndt_fprintf(fd, "  ALT    at %5d",       altmax);
+                ret = ndt_sink_printf(fd, "  ALT    at %5d",       altmax);
                 break;
             case NDT_RESTRICT_BL:
-                ret = ndt_fprintf(fd, "  ALT below %5d",       altmax);
+                ret = ndt_sink_printf(fd, "  ALT below %5d",       altmax);
                 break;
             case NDT_RESTRICT_BT:
-                ret = ndt_fprintf(fd, "  ALT %5d %5d", altmax, altmin);
+                ret = ndt_sink_printf(fd, "  ALT %5d %5d", altmax, altmin);
                 break;
             default:
-                ret = ndt_fprintf(fd, "%17s", " ");
+                ret = ndt_sink_printf(fd, "%17s", " ");
                 break;
         }
         if (ret)
@@ -677,16 +680,16 @@ static int helpr_waypoint_write(FILE *fd, ndt_waypoint *wpt, int row, ndt_fltpla
             switch (constraints->airspeed.typ)
             {
                 case NDT_RESTRICT_AB:
-                    ret = ndt_fprintf(fd, "  SPD min %3d",         spdmin);
+                    ret = ndt_sink_printf(fd, "  SPD min %3d",         spdmin);
                     break;
                 case NDT_RESTRICT_AT:
-                    ret = ndt_fprintf(fd, "  SPD  at %3d",         spdmax);
+                    ret = ndt_sink_printf(fd, "  SPD  at %3d",         spdmax);
                     break;
                 case NDT_RESTRICT_BL:
-                    ret = ndt_fprintf(fd, "  SPD max %3d",         spdmax);
+                    ret = ndt_sink_printf(fd, "  SPD max %3d",         spdmax);
                     break;
                 case NDT_RESTRICT_BT:
-                    ret = ndt_fprintf(fd, "  SPD %3d %3d", spdmin, spdmax);
+                    ret = ndt_sink_printf(fd, "  SPD %3d %3d", spdmin, spdmax);
                     break;
                 default:
                     break;
@@ -698,10 +701,10 @@ static int helpr_waypoint_write(FILE *fd, ndt_waypoint *wpt, int row, ndt_fltpla
         }
     }
 
-    return ndt_fprintf(fd, "%s", "\n");
+    return ndt_sink_printf(fd, "%s", "\n");
 }
 
-static int ceeva_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanformat fmt)
+static int ceeva_flightplan_write(ndt_flightplan *flp, ndt_sink *fd, ndt_fltplanformat fmt)
 {
     int ret = 0, row = 0;
 
@@ -722,7 +725,7 @@ static int ceeva_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
         if (!flp->dep.sid.proc)
         {
             ndt_position posn = ndt_position_calcpos4pbd(flp->dep.rwy->waypoint->position, flp->dep.rwy->tru_heading, ndt_distance_add(flp->dep.rwy->length, ndt_distance_init(5, NDT_ALTUNIT_NM)));
-            ndt_waypoint *tmp = ndt_waypoint_posn(posn);
+            ndt_waypoint *tmp = ndt_waypoint_posn(posn, NULL);
             if (tmp)
             {
                 row = update__row(fd, row);
@@ -808,7 +811,7 @@ static int ceeva_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
     if (flp->arr.rwy && !flp->arr.apch.proc)
     {
         ndt_position posn = ndt_position_calcpos4pbd(flp->arr.rwy->waypoint->position, ndt_mod(flp->arr.rwy->tru_heading + 180., 360.), ndt_distance_init(5, NDT_ALTUNIT_NM));
-        ndt_waypoint *tmp = ndt_waypoint_posn(posn);
+        ndt_waypoint *tmp = ndt_waypoint_posn(posn, NULL);
         if (tmp)
         {
             row = update__row(fd, row);
@@ -837,17 +840,17 @@ static int ceeva_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
         goto fail;
     }
 
-    if ((ret = ndt_fprintf(fd, "%s", "\n")))
+    if ((ret = ndt_sink_printf(fd, "%s", "\n")))
     {
         goto fail;
     }
-    return ndt_flightplan_write(flp, fd, NDT_FLTPFMT_IRECP);
+    return ndt_flightplan_write2(flp, fd, NDT_FLTPFMT_IRECP);
 
 fail:
     return ret;
 }
 
-static int helpr_rtesegment_write(FILE *fd, ndt_route_segment *rsg, int *row, ndt_fltplanformat fmt)
+static int helpr_rtesegment_write(ndt_sink *fd, ndt_route_segment *rsg, int *row, ndt_fltplanformat fmt)
 {
     int ret = 0;
     if (!fd || !rsg || !row)
@@ -929,12 +932,12 @@ end:
     return ret;
 }
 
-static int helpr_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanformat fmt)
+static int helpr_flightplan_write(ndt_flightplan *flp, ndt_sink *fd, ndt_fltplanformat fmt)
 {
     int ret = 0, row = 1;
 
     // departure airport and runway
-    if ((ret = ndt_fprintf(fd, "%s:\n", "Departure")))
+    if ((ret = ndt_sink_printf(fd, "%s:\n", "Departure")))
     {
         goto fail;
     }
@@ -952,7 +955,7 @@ static int helpr_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
         if (!flp->dep.sid.proc)
         {
             ndt_position posn = ndt_position_calcpos4pbd(flp->dep.rwy->waypoint->position, flp->dep.rwy->tru_heading, ndt_distance_add(flp->dep.rwy->length, ndt_distance_init(5, NDT_ALTUNIT_NM)));
-            ndt_waypoint *tmp = ndt_waypoint_posn(posn);
+            ndt_waypoint *tmp = ndt_waypoint_posn(posn, NULL);
             if (tmp)
             {
                 if ((ret = helpr_waypoint_write(fd, tmp, row++, fmt, NULL)))
@@ -970,7 +973,7 @@ static int helpr_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
     // SID, enroute transition
     if (flp->dep.sid.rsgt)
     {
-        if ((ret = ndt_fprintf(fd, "\n%s:\n", flp->dep.sid.rsgt->info.idnt)))
+        if ((ret = ndt_sink_printf(fd, "\n%s:\n", flp->dep.sid.rsgt->info.idnt)))
         {
             goto fail;
         }
@@ -981,7 +984,7 @@ static int helpr_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
     }
     if (flp->dep.sid.enroute.rsgt)
     {
-        if ((ret = ndt_fprintf(fd, "\n%s:\n", flp->dep.sid.enroute.rsgt->info.idnt)))
+        if ((ret = ndt_sink_printf(fd, "\n%s:\n", flp->dep.sid.enroute.rsgt->info.idnt)))
         {
             goto fail;
         }
@@ -994,7 +997,7 @@ static int helpr_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
     // decoded route
     if (ndt_list_count(flp->rte))
     {
-        if ((ret = ndt_fprintf(fd, "\n%s:\n", "Enroute")))
+        if ((ret = ndt_sink_printf(fd, "\n%s:\n", "Enroute")))
         {
             goto fail;
         }
@@ -1016,7 +1019,7 @@ static int helpr_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
     // enroute transition, STAR
     if (flp->arr.star.enroute.rsgt)
     {
-        if ((ret = ndt_fprintf(fd, "\n%s:\n", flp->arr.star.enroute.rsgt->info.idnt)))
+        if ((ret = ndt_sink_printf(fd, "\n%s:\n", flp->arr.star.enroute.rsgt->info.idnt)))
         {
             goto fail;
         }
@@ -1027,7 +1030,7 @@ static int helpr_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
     }
     if (flp->arr.star.rsgt)
     {
-        if ((ret = ndt_fprintf(fd, "\n%s:\n", flp->arr.star.rsgt->info.idnt)))
+        if ((ret = ndt_sink_printf(fd, "\n%s:\n", flp->arr.star.rsgt->info.idnt)))
         {
             goto fail;
         }
@@ -1040,7 +1043,7 @@ static int helpr_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
     // approach transition, final
     if (flp->arr.apch.transition.rsgt)
     {
-        if ((ret = ndt_fprintf(fd, "\n%s:\n", flp->arr.apch.transition.rsgt->info.idnt)))
+        if ((ret = ndt_sink_printf(fd, "\n%s:\n", flp->arr.apch.transition.rsgt->info.idnt)))
         {
             goto fail;
         }
@@ -1051,7 +1054,7 @@ static int helpr_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
     }
     if (flp->arr.apch.rsgt)
     {
-        if ((ret = ndt_fprintf(fd, "\n%s:\n", flp->arr.apch.rsgt->info.idnt)))
+        if ((ret = ndt_sink_printf(fd, "\n%s:\n", flp->arr.apch.rsgt->info.idnt)))
         {
             goto fail;
         }
@@ -1062,14 +1065,14 @@ static int helpr_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
     }
 
     // arrival runway and airport
-    if ((ret = ndt_fprintf(fd, "\n%s:\n", "Arrival")))
+    if ((ret = ndt_sink_printf(fd, "\n%s:\n", "Arrival")))
     {
         goto fail;
     }
     if (flp->arr.rwy && !flp->arr.apch.proc)
     {
         ndt_position posn = ndt_position_calcpos4pbd(flp->arr.rwy->waypoint->position, ndt_mod(flp->arr.rwy->tru_heading + 180., 360.), ndt_distance_init(5, NDT_ALTUNIT_NM));
-        ndt_waypoint *tmp = ndt_waypoint_posn(posn);
+        ndt_waypoint *tmp = ndt_waypoint_posn(posn, NULL);
         if (tmp)
         {
             if ((ret = helpr_waypoint_write(fd, tmp, row++, fmt, NULL)))
@@ -1092,37 +1095,42 @@ static int helpr_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanform
         goto fail;
     }
 
-    if ((ret = ndt_fprintf(fd, "%s", "\n")))
+    if ((ret = ndt_sink_printf(fd, "%s", "\n")))
     {
         goto fail;
     }
-    return ndt_flightplan_write(flp, fd, NDT_FLTPFMT_IRECP);
+    return ndt_flightplan_write2(flp, fd, NDT_FLTPFMT_IRECP);
 
 fail:
     return ret;
 }
 
-static int print_line(FILE *fd, const char *idt, int alt, int spd, ndt_position pos, int row)
+static int print_line(ndt_sink *fd, const char *idt, int alt, int spd, ndt_position pos, int row)
 {
     if (fd && idt)
     {
-        if (row == 0 || row == 1)
+        // "%-2d  %-7s  %05d  %+010.6lf  %+011.6lf", but without a format string
+        ndt_sink_putint(fd, row, 2, NDT_SINKFMT_LEFT);
+        ndt_sink_write (fd, "  ", 2);
+        ndt_sink_putstr(fd, idt, 7, NDT_SINKFMT_LEFT);
+        ndt_sink_write (fd, "  ", 2);
+        ndt_sink_putint(fd, alt, 5, NDT_SINKFMT_ZERO);
+        ndt_sink_write (fd, "  ", 2);
+        ndt_sink_putfix(fd, ndt_position_getlatitude (pos, NDT_ANGUNIT_DEG), 10, 6, NDT_SINKFMT_PLUS|NDT_SINKFMT_ZERO);
+        ndt_sink_write (fd, "  ", 2);
+        ndt_sink_putfix(fd, ndt_position_getlongitude(pos, NDT_ANGUNIT_DEG), 11, 6, NDT_SINKFMT_PLUS|NDT_SINKFMT_ZERO);
+        if (row != 0 && row != 1)
         {
             // don't append speed for discontinuities and airports
-            return ndt_fprintf(fd, "%-2d  %-7s  %05d  %+010.6lf  %+011.6lf\n",
-                               row, idt, alt,
-                               ndt_position_getlatitude (pos, NDT_ANGUNIT_DEG),
-                               ndt_position_getlongitude(pos, NDT_ANGUNIT_DEG));
-        }
-        return ndt_fprintf(fd, "%-2d  %-7s  %05d  %+010.6lf  %+011.6lf  %010.6lf\n",
-                           row, idt, alt,
-                           ndt_position_getlatitude (pos, NDT_ANGUNIT_DEG),
-                           ndt_position_getlongitude(pos, NDT_ANGUNIT_DEG), (double)spd);
+            ndt_sink_write (fd, "  ", 2);
+            ndt_sink_putfix(fd, spd, 10, 6, NDT_SINKFMT_ZERO);
+        }
+        return ndt_sink_write(fd, "\n", 1);
     }
     return -1;
 }
 
-static int print_waypoint(FILE *fd, ndt_waypoint *wpt, int alt, int spd)
+static int print_waypoint(ndt_sink *fd, ndt_waypoint *wpt, int alt, int spd)
 {
     if (fd && wpt)
     {
@@ -1152,7 +1160,7 @@ static int print_waypoint(FILE *fd, ndt_waypoint *wpt, int alt, int spd)
     return -1;
 }
 
-static int print_airport(FILE *fd, ndt_airport *apt)
+static int print_airport(ndt_sink *fd, ndt_airport *apt)
 {
     if (fd && apt)
     {
@@ -1164,12 +1172,12 @@ static int print_airport(FILE *fd, ndt_airport *apt)
     return -1;
 }
 
-static int xpfms_write_header(FILE *fd, int count)
+static int xpfms_write_header(ndt_sink *fd, int count)
 {
-    return ndt_fprintf(fd, "I\n3 version\n1\n%d\n", count - 1);
+    return ndt_sink_printf(fd, "I\n3 version\n1\n%d\n", count - 1);
 }
 
-static int xpfms_write_footer(FILE *fd)
+static int xpfms_write_footer(ndt_sink *fd)
 {
     return print_line(fd, "-------", 0, 0, NDT_POSITION_NULL, 0);
 }
@@ -1227,14 +1235,13 @@ static int xpfms_skip4dist(ndt_waypoint *src, ndt_waypoint *leg_wpt, ndt_waypoin
     {
         // ensure at least 1 nautical mile between 2 consecutive waypoints
         // avoids weird flight path drawing on the QPAC ND (KEWR: EWR2.22L)
-        return (ndt_distance_get(ndt_position_calcdistance(src->position,
-                                                           dst->position),
-                                 NDT_ALTUNIT_ME) < INT64_C(1852));
+        return ndt_position_calcwithin(src->position, dst->position,
+                                       ndt_distance_init(1852, NDT_ALTUNIT_ME));
     }
     return 0;
 }
 
-static int xpfms_write_legs(FILE *fd, ndt_list *legs, ndt_runway *arr_rwy, int qpac_approach)
+static int xpfms_write_legs(ndt_sink *fd, ndt_list *legs, ndt_runway *arr_rwy, int qpac_approach)
 {
     ndt_waypoint *fapchfix = NULL, *mapchfix = NULL, *lst = NULL;
     ndt_distance rwthralt, fapchalt;
@@ -1493,7 +1500,7 @@ end:
     return ret;
 }
 
-static int xpfms_flightplan_write(ndt_flightplan *flp, FILE *fd)
+static int xpfms_flightplan_write(ndt_flightplan *flp, ndt_sink *fd)
 {
     /*
      * QPAC-specific hacks, part 1.
@@ -1579,7 +1586,7 @@ static int xpfms_flightplan_write(ndt_flightplan *flp, FILE *fd)
         if (!flp->dep.sid.proc)
         {
             ndt_position posn = ndt_position_calcpos4pbd(flp->dep.rwy->waypoint->position, flp->dep.rwy->tru_heading, ndt_distance_add(flp->dep.rwy->length, ndt_distance_init(5, NDT_ALTUNIT_NM)));
-            ndt_waypoint *tmp = ndt_waypoint_posn(posn);
+            ndt_waypoint *tmp = ndt_waypoint_posn(posn, NULL);
             if (tmp)
             {
                 if ((ret = print_waypoint(fd, tmp, 0, 0)))
@@ -1600,7 +1607,7 @@ static int xpfms_flightplan_write(ndt_flightplan *flp, FILE *fd)
     if (flp->arr.rwy && !flp->arr.apch.proc)
     {
         ndt_position posn = ndt_position_calcpos4pbd(flp->arr.rwy->waypoint->position, ndt_mod(flp->arr.rwy->tru_heading + 180., 360.), ndt_distance_init(5, NDT_ALTUNIT_NM));
-        ndt_waypoint *tmp = ndt_waypoint_posn(posn);
+        ndt_waypoint *tmp = ndt_waypoint_posn(posn, NULL);
         if (tmp)
         {
             if ((ret = print_waypoint(fd, tmp, 0, 0)))
@@ -1644,7 +1651,7 @@ end:
     return ret ? ret : xpfms_write_footer(fd);
 }
 
-int ndt_fmt_xpfms_flightplan_write(ndt_flightplan *flp, FILE *fd, ndt_fltplanformat fmt)
+int ndt_fmt_xpfms_flightplan_write(ndt_flightplan *flp, ndt_sink *fd, ndt_fltplanformat fmt)
 {
     if (!flp || !fd)
     {
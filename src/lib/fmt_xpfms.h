@@ -24,10 +24,11 @@
 #include <stdio.h>
 
 #include "common/common.h"
+#include "common/sink.h"
 
 #include "flightplan.h"
 
 int ndt_fmt_xpfms_flightplan_set_route(ndt_flightplan *flightplan, const char *route                      );
-int ndt_fmt_xpfms_flightplan_write    (ndt_flightplan *flightplan, FILE       *file, ndt_fltplanformat fmt);
+int ndt_fmt_xpfms_flightplan_write    (ndt_flightplan *flightplan, ndt_sink   *sink, ndt_fltplanformat fmt);
 
 #endif /* NDT_FMT_XPFMS_H */
@@ -21,6 +21,8 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,6 +30,7 @@
 
 #include "common/common.h"
 #include "common/list.h"
+#include "common/stats.h"
 
 #include "compat/compat.h"
 
@@ -35,15 +38,27 @@
 
 #include "airport.h"
 #include "airway.h"
+#include "flightplan.h"
 #include "navdata.h"
 #include "ndb_xpgns.h"
+#include "spatial.h"
 #include "waypoint.h"
 
 static int compare_apt(const void *apt1, const void *apt2);
 static int compare_awy(const void *awy1, const void *awy2);
 static int compare_wpt(const void *wpt1, const void *wpt2);
 
+static size_t navdata_lower_bound(const ndt_list *list, size_t first, const char *idt, size_t offset);
+
+static int          navdata_user_airport(ndt_navdatabase *ndb, const char *idnt, const char *misc, ndt_position coordinates);
+static ndt_airport* navdata_init_airport(ndt_navdatabase *ndb, ndt_airport *apt                                          );
+
 ndt_navdatabase* ndt_navdatabase_init(const char *ndr, ndt_navdataformat fmt, ndt_date date)
+{
+    return ndt_navdatabase_init2(ndr, fmt, date, NULL);
+}
+
+ndt_navdatabase* ndt_navdatabase_init2(const char *ndr, ndt_navdataformat fmt, ndt_date date, const ndt_navdatascope *scope)
 {
     int  err = 0;
     char errbuf[64];
@@ -54,6 +69,15 @@ ndt_navdatabase* ndt_navdatabase_init(const char *ndr, ndt_navdataformat fmt, nd
         err = ENOMEM;
         goto end;
     }
+    else
+    {
+        // recursive: procedures open their transitions, user airports add waypoints
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init   (&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init       (&ndb->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
 
     ndb->fmt       = fmt;
     ndb->root      = strdup(ndr);
@@ -67,7 +91,20 @@ ndt_navdatabase* ndt_navdatabase_init(const char *ndr, ndt_navdataformat fmt, nd
         goto end;
     }
 
-    if ((ndb->wmm = ndt_wmm_init(date)) == NULL)
+    if (scope)
+    {
+        ndb->scope = *scope;
+        if (scope->regions && !(ndb->scope.regions = strdup(scope->regions)))
+        {
+            err = ENOMEM;
+            goto end;
+        }
+    }
+
+    int64_t start = ndt_stats_begin();
+    ndb->wmm      = ndt_wmm_init(date);
+    ndt_stats_end(NDT_STAT_WMMINIT, start);
+    if (ndb->wmm == NULL)
     {
         ndt_log("navdata: failed to open World Magnetic Model\n");
         err = -1;
@@ -94,21 +131,31 @@ ndt_navdatabase* ndt_navdatabase_init(const char *ndr, ndt_navdataformat fmt, nd
      * lists are compiled from several source files, so we need to re-sort all
      * lists using a known method which can then be used for retrieving items.
      */
+    start = ndt_stats_begin();
     ndt_list_sort(ndb->airports,  sizeof(ndt_airport*),  &compare_apt);
+    ndt_stats_end(NDT_STAT_SORTAPT, start);
+    start = ndt_stats_begin();
     ndt_list_sort(ndb->airways,   sizeof(ndt_airway*),   &compare_awy);
+    ndt_stats_end(NDT_STAT_SORTAWY, start);
+    start = ndt_stats_begin();
     ndt_list_sort(ndb->waypoints, sizeof(ndt_waypoint*), &compare_wpt);
+    ndt_stats_end(NDT_STAT_SORTWPT, start);
 
-#if 0
-    /* Database is complete, test parsing of all procedures (slow) */
-    for (size_t i = 0; i < ndt_list_count(ndb->airports); i++)
+    /* Proximity index (nearest airport, navaids in range, etc.) */
+    if ((ndb->spatial = ndt_spatial_init()) == NULL)
     {
-        if (!ndt_navdata_init_airport(ndb, ndt_list_item(ndb->airports, i)))
-        {
-            err = EINVAL;
-            goto end;
-        }
+        err = ENOMEM;
+        goto end;
+    }
+    for (size_t i = 0; i < ndt_list_count(ndb->waypoints); i++)
+    {
+        ndt_spatial_add(ndb->spatial, ndt_list_item(ndb->waypoints, i));
+    }
+    if (ndt_spatial_count(ndb->spatial) != ndt_list_count(ndb->waypoints))
+    {
+        err = ENOMEM;
+        goto end;
     }
-#endif
 
 end:
     if (err)
@@ -149,6 +196,11 @@ void ndt_navdatabase_close(ndt_navdatabase **_ndb)
             ndt_list_close(&ndb->airways);
         }
 
+        if (ndb->spatial)
+        {
+            ndt_spatial_close(&ndb->spatial);
+        }
+
         if (ndb->waypoints)
         {
             while ((i = ndt_list_count(ndb->waypoints)))
@@ -165,22 +217,121 @@ void ndt_navdatabase_close(ndt_navdatabase **_ndb)
             free(ndb->root);
         }
 
+        if (ndb->scope.regions)
+        {
+            free(ndb->scope.regions);
+        }
+
         if (ndb->wmm)
         {
             ndt_wmm_close(&ndb->wmm);
         }
 
+        pthread_mutex_destroy(&ndb->lock);
+
         free(ndb);
 
         *_ndb = NULL;
     }
 }
 
+static size_t navdata_usage_legs(ndt_list *legs, ndt_navdata_memusage *usage)
+{
+    size_t size = ndt_list_size(legs);
+    for (size_t i = 0; i < ndt_list_count(legs); i++)
+    {
+        ndt_route_leg *leg = ndt_list_item(legs, i);
+        size           += sizeof(ndt_route_leg) - sizeof(ndt_info) + ndt_list_size(leg->xpfms);
+        size           += ndt_route_leg_memosize(leg); // dummies shared by flight plans
+        usage->strings += sizeof(ndt_info);
+    }
+    return size;
+}
+
+int ndt_navdatabase_usage(ndt_navdatabase *ndb, ndt_navdata_memusage *usage)
+{
+    if (!ndb || !usage)
+    {
+        return ENOMEM;
+    }
+    memset(usage, 0, sizeof(ndt_navdata_memusage));
+
+    for (size_t i = 0; i < ndt_list_count(ndb->airports); i++)
+    {
+        ndt_airport *apt = ndt_list_item(ndb->airports, i);
+        pthread_mutex_lock(&apt->lock); // may be initialized concurrently
+
+        usage->airports += sizeof(ndt_airport) - sizeof(ndt_info);
+        usage->airports += ndt_list_size(apt->runways);
+        usage->airports += ndt_list_size(apt->allprocs);
+        usage->airports += ndt_list_size(apt->sids);
+        usage->airports += ndt_list_size(apt->stars);
+        usage->strings  += sizeof(ndt_info);
+
+        for (size_t j = 0; j < ndt_list_count(apt->runways); j++)
+        {
+            ndt_runway *rwy = ndt_list_item(apt->runways, j);
+            usage->runways += sizeof(ndt_runway) - sizeof(ndt_info) * 2;
+            usage->runways += ndt_list_size(rwy->sids);
+            usage->runways += ndt_list_size(rwy->stars);
+            usage->runways += ndt_list_size(rwy->approaches);
+            usage->strings += sizeof(ndt_info) * 2; // runway, ILS
+        }
+
+        for (size_t j = 0; j < ndt_list_count(apt->allprocs); j++)
+        {
+            ndt_procedure *proc = ndt_list_item(apt->allprocs, j);
+            size_t         size = sizeof(ndt_procedure) - sizeof(ndt_info);
+            size               += ndt_list_size(proc->runways);
+            size               += ndt_list_size(proc->transition.approach);
+            size               += ndt_list_size(proc->transition.enroute);
+            size               += navdata_usage_legs(proc->proclegs, usage);
+            size               += navdata_usage_legs(proc->mapplegs, usage);
+            size               += ndt_list_size(proc->custwpts);
+            size               += ndt_list_count(proc->custwpts) * (sizeof(ndt_waypoint) - sizeof(ndt_info));
+            usage->strings     += ndt_list_count(proc->custwpts) * (sizeof(ndt_info)) + sizeof(ndt_info);
+            if (proc->raw_data)
+            {
+                usage->procraw += strlen(proc->raw_data) + 1;
+            }
+            usage->procedures  += size;
+        }
+
+        pthread_mutex_unlock(&apt->lock);
+    }
+    usage->procedures += usage->procraw;
+
+    usage->airways += ndt_list_size(ndb->airways);
+    for (size_t i = 0; i < ndt_list_count(ndb->airways); i++)
+    {
+        ndt_airway *awy = ndt_list_item(ndb->airways, i);
+        usage->airways += sizeof(ndt_airway) - sizeof(ndt_info);
+        usage->strings += sizeof(ndt_info);
+        for (ndt_airway_leg *leg = awy->leg; leg; leg = leg->next)
+        {
+            usage->airways += sizeof(ndt_airway_leg) - sizeof(ndt_info) * 2;
+            usage->strings += sizeof(ndt_info) * 2; // in, out
+        }
+    }
+
+    usage->waypoints += ndt_list_size(ndb->waypoints);
+    usage->waypoints += ndt_list_count(ndb->waypoints) * (sizeof(ndt_waypoint) - sizeof(ndt_info));
+    usage->strings   += ndt_list_count(ndb->waypoints) * (sizeof(ndt_info));
+    usage->spatial   += ndt_spatial_size(ndb->spatial);
+    usage->strings   += ndb->root          ? strlen(ndb->root)          + 1 : 0;
+    usage->strings   += ndb->scope.regions ? strlen(ndb->scope.regions) + 1 : 0;
+
+    usage->total = (usage->airports  + usage->runways + usage->procedures + usage->airways +
+                    usage->waypoints + usage->spatial + usage->strings);
+    return 0;
+}
+
 void ndt_navdata_add_waypoint(ndt_navdatabase *ndb, ndt_waypoint *wpt)
 {
     if (ndb && wpt)
     {
         ndt_waypoint *wp; int ii;
+        pthread_mutex_lock(&ndb->lock);
         ndt_list *l = ndb->waypoints;
         size_t jj = ndt_list_count(l);
         for (ii = 0; ii < jj; ii++)
@@ -191,6 +342,8 @@ void ndt_navdata_add_waypoint(ndt_navdatabase *ndb, ndt_waypoint *wpt)
             }
         }
         ndt_list_insert(l, wpt, ii);
+        ndt_spatial_add(ndb->spatial, wpt);
+        pthread_mutex_unlock(&ndb->lock);
     }
 }
 
@@ -198,11 +351,26 @@ void ndt_navdata_rem_waypoint(ndt_navdatabase *ndb, ndt_waypoint *wpt)
 {
     if (ndb && wpt)
     {
-        ndt_list_rem(ndb->waypoints, wpt);
+        pthread_mutex_lock(&ndb->lock);
+        ndt_spatial_rem(ndb->spatial, wpt);
+        ndt_list_rem(ndb->waypoints,  wpt);
+        pthread_mutex_unlock(&ndb->lock);
     }
 }
 
 int ndt_navdata_user_airport(ndt_navdatabase *ndb, const char *idnt, const char *misc, ndt_position coordinates)
+{
+    if (ndb)
+    {
+        pthread_mutex_lock(&ndb->lock);
+        int ret = navdata_user_airport(ndb, idnt, misc, coordinates);
+        pthread_mutex_unlock(&ndb->lock);
+        return ret;
+    }
+    return ENOMEM;
+}
+
+static int navdata_user_airport(ndt_navdatabase *ndb, const char *idnt, const char *misc, ndt_position coordinates)
 {
     if (ndb && misc && idnt && *idnt)
     {
@@ -247,14 +415,21 @@ int ndt_navdata_user_airport(ndt_navdatabase *ndb, const char *idnt, const char
             {
                 return -1; // ndt_waypoint_init will log the error
             }
-            // set sorting-relevant information prior to adding
+            // set sorting and indexing-relevant information prior to adding
             strncpy(wpt->info.idnt, idnt, sizeof(wpt->info.idnt));
+            wpt->position = apt->coordinates;
             wpt->type = NDT_WPTYPE_XPA; ndt_navdata_add_waypoint(ndb, wpt);
         }
+        else if (memcmp(&wpt->position, &apt->coordinates, sizeof(wpt->position)))
+        {
+            // waypoint moved, re-index it
+            ndt_spatial_rem(ndb->spatial, wpt);
+            wpt->position = apt->coordinates;
+            ndt_spatial_add(ndb->spatial, wpt);
+        }
         // update waypoint information to match corresponding airport
         strncpy(wpt->info.desc, apt->info.desc, sizeof(wpt->info.desc));
         strncpy(wpt->info.misc, apt->info.misc, sizeof(wpt->info.misc));
-        wpt->position = apt->coordinates;
         apt->waypoint = wpt;
         return 0;
     }
@@ -265,21 +440,11 @@ ndt_airport* ndt_navdata_get_airport(ndt_navdatabase *ndb, const char *idt)
 {
     if (idt)
     {
-        for (size_t i = 0; i < ndt_list_count(ndb->airports); i++)
+        size_t i = navdata_lower_bound(ndb->airports, 0, idt, offsetof(ndt_airport, info.idnt));
+        ndt_airport *apt = ndt_list_item(ndb->airports, i);
+        if (apt && !strcmp(idt, apt->info.idnt))
         {
-            ndt_airport *apt = ndt_list_item (ndb->airports,  i);
-            if (apt)
-            {
-                int cmp  = strcmp(idt, apt->info.idnt);
-                if (cmp <= 0)
-                {
-                    if (!cmp)
-                    {
-                        return apt;
-                    }
-                    break;
-                }
-            }
+            return apt;
         }
     }
 
@@ -292,7 +457,56 @@ ndt_airport* ndt_navdata_init_airport(ndt_navdatabase *ndb, ndt_airport *apt)
     {
         return NULL;
     }
+    if (__atomic_load_n(&apt->ready, __ATOMIC_ACQUIRE))
+    {
+        return apt; // already initialized, runway headings already computed
+    }
 
+    /*
+     * First use: parse the airport's procedures and compute runway headings,
+     * once; any other thread using the same airport waits for us to finish,
+     * threads using other airports don't (parsing only reads the database).
+     */
+    pthread_mutex_t *lock = &apt->lock;
+    pthread_mutex_lock(lock);
+    if (!apt->ready)
+    {
+        int64_t start = ndt_stats_begin();
+        if ((apt = navdata_init_airport(ndb, apt)))
+        {
+            __atomic_store_n(&apt->ready, 1, __ATOMIC_RELEASE);
+        }
+        ndt_stats_end(NDT_STAT_PROCS, start);
+    }
+    pthread_mutex_unlock(lock);
+    return apt;
+}
+
+int ndt_navdata_open_airport(ndt_navdatabase *ndb, ndt_airport *apt, ndt_list *failed)
+{
+    int count = 0;
+
+    if (!ndt_navdata_init_airport(ndb, apt))
+    {
+        return -1;
+    }
+    for (size_t i = 0; i < ndt_list_count(apt->allprocs); i++)
+    {
+        ndt_procedure *proc = ndt_list_item(apt->allprocs, i);
+        if (!ndt_procedure_open(ndb, proc))
+        {
+            if (failed)
+            {
+                ndt_list_add(failed, proc);
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+static ndt_airport* navdata_init_airport(ndt_navdatabase *ndb, ndt_airport *apt)
+{
     switch (ndb->fmt)
     {
         case NDT_NAVDFMT_XPGNS:
@@ -417,22 +631,12 @@ ndt_airway* ndt_navdata_get_airway(ndt_navdatabase *ndb, const char *idt, size_t
 {
     if (idt)
     {
-        for (size_t i = idx ? *idx : 0; i < ndt_list_count(ndb->airways); i++)
+        size_t i = navdata_lower_bound(ndb->airways, idx ? *idx : 0, idt, offsetof(ndt_airway, info.idnt));
+        ndt_airway *awy = ndt_list_item(ndb->airways, i);
+        if (awy && !strcmp(idt, awy->info.idnt))
         {
-            ndt_airway *awy = ndt_list_item(ndb->airways, i);
-            if (awy)
-            {
-                int cmp  = strcmp(idt, awy->info.idnt);
-                if (cmp <= 0)
-                {
-                    if (!cmp)
-                    {
-                        if (idx) *idx = i;
-                        return awy;
-                    }
-                    break;
-                }
-            }
+            if (idx) *idx = i;
+            return awy;
         }
     }
 
@@ -443,22 +647,12 @@ ndt_waypoint* ndt_navdata_get_waypoint(ndt_navdatabase *ndb, const char *idt, si
 {
     if (idt)
     {
-        for (size_t i = idx ? *idx : 0; i < ndt_list_count(ndb->waypoints); i++)
+        size_t i = navdata_lower_bound(ndb->waypoints, idx ? *idx : 0, idt, offsetof(ndt_waypoint, info.idnt));
+        ndt_waypoint *wpt = ndt_list_item(ndb->waypoints, i);
+        if (wpt && !strcmp(idt, wpt->info.idnt))
         {
-            ndt_waypoint *wpt = ndt_list_item(ndb->waypoints, i);
-            if (wpt)
-            {
-                int cmp  = strcmp(idt, wpt->info.idnt);
-                if (cmp <= 0)
-                {
-                    if (!cmp)
-                    {
-                        if (idx) *idx = i;
-                        return wpt;
-                    }
-                    break;
-                }
-            }
+            if (idx) *idx = i;
+            return wpt;
         }
     }
 
@@ -470,21 +664,45 @@ ndt_waypoint* ndt_navdata_get_wptnear2(ndt_navdatabase *ndb, const char *idt, si
     if (idt)
     {
         ndt_waypoint *wpt = NULL, *next;
-        int64_t       min = INT64_MAX;
+        int64_t       min = INT64_MAX, minerr = 0, minext = -1;
 
         for (size_t i = idx ? *idx : 0; (next = ndt_navdata_get_waypoint(ndb, idt, &i)); i++)
         {
-            int64_t dist = ndt_distance_get(ndt_position_calcdistance(pos, next->position), NDT_ALTUNIT_NA);
-
-            if (dist < min)
+            /*
+             * Rank candidates using the approximate distance; we only need the
+             * exact distance when the error bounds of two candidates overlap.
+             */
+            ndt_distance error;
+            int64_t      dist = ndt_distance_get(ndt_position_calcdistapprx(pos, next->position, &error), NDT_ALTUNIT_NA);
+            int64_t      derr = ndt_distance_get(error,                                                   NDT_ALTUNIT_NA);
+            int64_t      dext = -1;
+
+            if (wpt && (derr < 0 || minerr < 0 || (dist + derr >= min - minerr &&
+                                                   dist - derr <= min + minerr)))
             {
-                if (idx)
+                if (minext < 0)
+                {
+                    minext = ndt_distance_get(ndt_position_calcdistance(pos, wpt->position), NDT_ALTUNIT_NA);
+                }
+                dext = ndt_distance_get(ndt_position_calcdistance(pos, next->position), NDT_ALTUNIT_NA);
+                if (dext >= minext)
                 {
-                    *idx = i;
+                    continue;
                 }
-                min = dist;
-                wpt = next;
             }
+            else if (wpt && dist > min)
+            {
+                continue;
+            }
+
+            if (idx)
+            {
+                *idx = i;
+            }
+            min    = dist;
+            minerr = derr;
+            minext = dext;
+            wpt    = next;
         }
 
         return wpt;
@@ -531,7 +749,7 @@ ndt_waypoint* ndt_navdata_get_wpt4aws(ndt_navdatabase *ndb, ndt_waypoint *src, c
             {
                 if ((out = ndt_airway_intersect(in, awy2)))
                 {
-                    if ((dst = ndt_navdata_get_wpt4pos(ndb, out->out.info.idnt, NULL, out->out.position)))
+                    if ((dst = ndt_navdata_get_wpt4pos(ndb, out->out.info.idnt, NULL, ndt_position_unpack(out->out.position, NDT_DISTANCE_ZERO))))
                     {
                         if (_awy) *_awy = awy1;
                         if (_in)  *_in  =   in;
@@ -603,6 +821,48 @@ end:
     return NULL;
 }
 
+int ndt_navdata_get_wptinrng(ndt_navdatabase *ndb, ndt_position pos, ndt_distance range, uint64_t types, ndt_spatial_callback *cb, void *ctx, ndt_list *out)
+{
+    if (!ndb || !ndb->spatial)
+    {
+        return EINVAL;
+    }
+    return ndt_spatial_inrange(ndb->spatial, pos, range, types, cb, ctx, out);
+}
+
+int ndt_navdata_get_wptnearn(ndt_navdatabase *ndb, ndt_position pos, size_t count, ndt_distance range, uint64_t types, ndt_spatial_callback *cb, void *ctx, ndt_list *out)
+{
+    if (!ndb || !ndb->spatial)
+    {
+        return EINVAL;
+    }
+    return ndt_spatial_nearest(ndb->spatial, pos, count, range, types, cb, ctx, out);
+}
+
+/*
+ * Airports, airways and waypoints are sorted by identifier: look for the first
+ * item (at or after index first) whose identifier isn't lower than idt, using
+ * the offset of said identifier within the item.
+ */
+static size_t navdata_lower_bound(const ndt_list *list, size_t first, const char *idt, size_t offset)
+{
+    size_t last = ndt_list_count(list);
+    while (first < last)
+    {
+        size_t      mid = first + (last - first) / 2;
+        const char *itm = ndt_list_item(list, mid);
+        if (strcmp(idt, itm + offset) > 0)
+        {
+            first = mid + 1;
+        }
+        else
+        {
+            last = mid;
+        }
+    }
+    return first;
+}
+
 static int compare_apt(const void *p1, const void *p2)
 {
     ndt_airport *apt1 = *(ndt_airport**)p1;
@@ -22,12 +22,14 @@
 #define NDT_NAVDATA_H
 
 #include <inttypes.h>
+#include <pthread.h>
 
 #include "common/common.h"
 #include "common/list.h"
 
 #include "airport.h"
 #include "airway.h"
+#include "spatial.h"
 #include "waypoint.h"
 
 typedef enum ndt_navdataformat
@@ -36,6 +38,22 @@ typedef enum ndt_navdataformat
     NDT_NAVDFMT_XPGNS, // X-Plane 10.30 GNS navdata
 } ndt_navdataformat;
 
+/*
+ * Optional subset of the navdata to load (everything else is skipped): only
+ * records within a bounding box, and/or in a list of ICAO region codes (e.g.
+ * "LS,LF,ED"). Records without a region code (e.g. airports) are matched by
+ * their identifier's prefix instead (e.g. LSGG: "LS", KBOS: "K1" to "K7").
+ * Airways with any fix in scope are kept whole, and so are all of their fixes
+ * (in scope or not), so that routes along them can always be resolved.
+ */
+typedef struct ndt_navdatascope
+{
+    int    bbox;                // non-zero: bounding box below is applicable
+    double latmin, latmax;      // unit: decimal degrees
+    double lonmin, lonmax;      // unit: decimal degrees (min > max: crosses antimeridian)
+    char  *regions;             // comma-separated region codes (NULL: all regions)
+} ndt_navdatascope;
+
 typedef struct ndt_navdatabase
 {
     ndt_info         info;      // identification information
@@ -44,23 +62,71 @@ typedef struct ndt_navdatabase
     ndt_list   *waypoints;      // list of all waypoints in database (struct ndt_waypoint)
     ndt_navdataformat fmt;      // backend database's format
     char            *root;      // backend database's root folder
+    ndt_spatial  *spatial;      // proximity index over all waypoints in database
+    ndt_navdatascope scope;     // subset of the backend database that was loaded
+    pthread_mutex_t   lock;     // serializes modifications & lazy init. (airports: own lock)
 
     void *wmm;                  // World Magnetic Model library wrapper
 } ndt_navdatabase;
 
-ndt_navdatabase* ndt_navdatabase_init (const char      *root, ndt_navdataformat fmt, ndt_date date);
-void             ndt_navdatabase_close(ndt_navdatabase **ptr                                      );
+/*
+ * Once loaded, a navigation database can be shared by several threads, e.g.
+ * each with its own flight plan(s): airports and procedures are initialized
+ * on first use, exactly once (ndt_navdata_init_airport, ndt_procedure_open),
+ * and different airports can be initialized concurrently.
+ *
+ * ndt_navdata_open_airport initializes an airport and opens all of its
+ * procedures and transitions; it returns how many of them failed to open
+ * (and adds them to failed, if not NULL), or -1 if the airport itself failed.
+ *
+ * ndt_navdata_add_waypoint, ndt_navdata_rem_waypoint and ndt_navdata_user_airport
+ * modify the database itself, and must not be called while other threads are
+ * using it (flight plans keep their own custom waypoints, see ndt_flightplan).
+ * Note that ndt_navdata_user_airport still inserts the new airport's waypoint
+ * in the database's global waypoint list, where all flight plans will see it;
+ * for a fix only one flight plan can see, use ndt_flightplan_user_waypoint.
+ */
+
+/*
+ * Memory used by a navigation database, in bytes, per subsystem (computed on
+ * demand from what's currently loaded: e.g. procedures' raw data is only kept
+ * until they're opened). Identification information (ndt_info) embedded in
+ * all of the structures below is counted under strings, not with them.
+ *
+ * These are estimates, computed from struct and list sizes, not tracked
+ * allocations (e.g. the allocator's own overhead isn't counted).
+ */
+typedef struct ndt_navdata_memusage
+{
+    size_t airports;            // airports, their runway and procedure lists
+    size_t runways;             // runways, their procedure lists
+    size_t procedures;          // procedures, their legs, custom waypoints, shared dummies
+    size_t procraw;             // raw procedure data (included in procedures)
+    size_t airways;             // airways and airway legs
+    size_t waypoints;           // waypoints (including runways, airports)
+    size_t spatial;             // proximity index
+    size_t strings;             // identifiers, descriptions, paths
+    size_t total;               // all of the above
+} ndt_navdata_memusage;
+
+ndt_navdatabase* ndt_navdatabase_init (const char      *root, ndt_navdataformat fmt, ndt_date date                               );
+ndt_navdatabase* ndt_navdatabase_init2(const char      *root, ndt_navdataformat fmt, ndt_date date, const ndt_navdatascope *scope);
+void             ndt_navdatabase_close(ndt_navdatabase **ptr                                                                     );
+int              ndt_navdatabase_usage(ndt_navdatabase  *ndb, ndt_navdata_memusage *usage                                        );
 
 void          ndt_navdata_add_waypoint(ndt_navdatabase *ndb, ndt_waypoint *wpt                                                                                                        );
 void          ndt_navdata_rem_waypoint(ndt_navdatabase *ndb, ndt_waypoint *wpt                                                                                                        );
 int           ndt_navdata_user_airport(ndt_navdatabase *ndb, const char   *idt, const char *apname, ndt_position   pos                                                                );
 ndt_airport*  ndt_navdata_get_airport (ndt_navdatabase *ndb, const char   *idt                                                                                                        );
 ndt_airport*  ndt_navdata_init_airport(ndt_navdatabase *ndb, ndt_airport  *apt                                                                                                        );
+int           ndt_navdata_open_airport(ndt_navdatabase *ndb, ndt_airport  *apt, ndt_list      *failed                                                                                 );
 ndt_airway*   ndt_navdata_get_airway  (ndt_navdatabase *ndb, const char   *idt, size_t        *idx                                                                                    );
 ndt_waypoint* ndt_navdata_get_waypoint(ndt_navdatabase *ndb, const char   *idt, size_t        *idx                                                                                    );
 ndt_waypoint* ndt_navdata_get_wptnear2(ndt_navdatabase *ndb, const char   *idt, size_t        *idx, ndt_position   pos                                                                );
 ndt_waypoint* ndt_navdata_get_wpt4pos (ndt_navdatabase *ndb, const char   *idt, size_t        *idx, ndt_position   pos                                                                );
 ndt_waypoint* ndt_navdata_get_wpt4aws (ndt_navdatabase *ndb, ndt_waypoint *src, const char *awy2id, const char *awyidt, ndt_airway **_awy, ndt_airway_leg **_in, ndt_airway_leg **_out);
 ndt_waypoint* ndt_navdata_get_wpt4awy (ndt_navdatabase *ndb, ndt_waypoint *src, const char *dstidt, const char *awyidt, ndt_airway **_awy, ndt_airway_leg **_in, ndt_airway_leg **_out);
+int           ndt_navdata_get_wptinrng(ndt_navdatabase *ndb, ndt_position  pos,                ndt_distance range, uint64_t types, ndt_spatial_callback *cb, void *ctx, ndt_list *out);
+int           ndt_navdata_get_wptnearn(ndt_navdatabase *ndb, ndt_position  pos, size_t count, ndt_distance range, uint64_t types, ndt_spatial_callback *cb, void *ctx, ndt_list *out);
 
 #endif /* NDT_NAVDATA_H */
@@ -28,6 +28,7 @@
 #include <strings.h>
 
 #include "common/common.h"
+#include "common/stats.h"
 
 #include "compat/compat.h"
 
@@ -41,15 +42,45 @@
 // check whether first decimal digit is odd
 #define NDT_ODD_DEC1(F) (((int)(10 * F)) % 2)
 
-static int parse_airac     (char *src, ndt_navdatabase *ndb                  );
-static int parse_airports  (char *src, ndt_navdatabase *ndb                  );
-static int parse_airways   (char *src, ndt_navdatabase *ndb                  );
-static int parse_navaids   (char *src, ndt_navdatabase *ndb                  );
-static int parse_waypoints (char *src, ndt_navdatabase *ndb                  );
-static int parse_procedures(char *src, ndt_navdatabase *ndb, ndt_airport *apt);
-static int place_procedures(           ndt_navdatabase *ndb, ndt_airport *apt);
-static int rename_finalappr(                                 ndt_airport *apt);
-static int open_a_procedure(           ndt_navdatabase *ndb, ndt_procedure *p);
+/*
+ * Scoped loading: a sorted set of fixes (identifier, position), as found in
+ * Navaids.txt and Waypoints.txt or referenced by airways (ATS.txt).
+ */
+typedef struct scope_fix
+{
+    char       idnt[8];
+    ndt_latlon position;
+} scope_fix;
+
+typedef struct scope_fixes
+{
+    scope_fix *fix;
+    size_t     count;
+    size_t     alloc;
+} scope_fixes;
+
+static int  parse_airac     (char *src, ndt_navdatabase *ndb                  );
+static int  parse_airports  (char *src, ndt_navdatabase *ndb                  );
+static int  parse_airways   (char *src, ndt_navdatabase *ndb,
+                             const scope_fixes *fixes, scope_fixes *refs      );
+static int  parse_navaids   (char *src, ndt_navdatabase *ndb, const scope_fixes *refs);
+static int  parse_waypoints (char *src, ndt_navdatabase *ndb, const scope_fixes *refs);
+static int  parse_procedures(char *src, ndt_navdatabase *ndb, ndt_airport *apt);
+static int  place_procedures(           ndt_navdatabase *ndb, ndt_airport *apt);
+static int  rename_finalappr(                                 ndt_airport *apt);
+static int  open_a_procedure(           ndt_navdatabase *ndb, ndt_procedure *p);
+static int  scope_position  (const ndt_navdatascope *scope, double lat, double lon  );
+static int  scope_region    (const ndt_navdatascope *scope, const char *reg, int apt);
+static int  scope_record    (const ndt_navdatascope *scope, const char *line,
+                             int latfield, int lonfield, int regfield, int aptfield );
+static int  scope_collect   (const ndt_navdatascope *scope, char *src, scope_fixes *set,
+                             int latfield, int lonfield, int regfield               );
+static void scope_fix_parse (const char        *line, int latfield, int lonfield, scope_fix *fix);
+static int  scope_fixes_add (scope_fixes       *set,  const char *idnt, ndt_latlon position   );
+static void scope_fixes_sort(scope_fixes       *set                                           );
+static int  scope_fixes_find(const scope_fixes *set,  const char *idnt, ndt_latlon position   );
+static int  scope_fixes_line(const scope_fixes *set,  const char *line, int latfield, int lonfield);
+static int  compare_fix     (const void        *f1,   const void *f2                          );
 
 int ndt_ndb_xpgns_navdatabase_init(ndt_navdatabase *ndb)
 {
@@ -71,6 +102,8 @@ int ndt_ndb_xpgns_navdatabase_init(ndt_navdatabase *ndb)
     DIR   *procedures   = NULL;
     char  *path         = NULL;
     int    pathlen, ret = 0;
+    int64_t start;
+    scope_fixes inscope = { 0 }, refs = { 0 };
 
     if ((ret = ndt_file_getpath(ndb->root, "/cycle_info.txt", &path, &pathlen)))
     {
@@ -78,7 +111,13 @@ int ndt_ndb_xpgns_navdatabase_init(ndt_navdatabase *ndb)
     }
     airac = ndt_file_slurp(path, &ret);
 
-    if (ret || (ret = parse_airac(airac, ndb)))
+    if (!ret)
+    {
+        start = ndt_stats_begin();
+        ret   = parse_airac(airac, ndb);
+        ndt_stats_end(NDT_STAT_AIRAC, start);
+    }
+    if (ret)
     {
         goto end;
     }
@@ -89,7 +128,13 @@ int ndt_ndb_xpgns_navdatabase_init(ndt_navdatabase *ndb)
     }
     airports = ndt_file_slurp(path, &ret);
 
-    if (ret || (ret = parse_airports(airports, ndb)))
+    if (!ret)
+    {
+        start = ndt_stats_begin();
+        ret   = parse_airports(airports, ndb);
+        ndt_stats_end(NDT_STAT_AIRPORTS, start);
+    }
+    if (ret)
     {
         goto end;
     }
@@ -99,8 +144,7 @@ int ndt_ndb_xpgns_navdatabase_init(ndt_navdatabase *ndb)
         goto end;
     }
     airways = ndt_file_slurp(path, &ret);
-
-    if (ret || (ret = parse_airways(airways, ndb)))
+    if (ret)
     {
         goto end;
     }
@@ -110,8 +154,7 @@ int ndt_ndb_xpgns_navdatabase_init(ndt_navdatabase *ndb)
         goto end;
     }
     navaids = ndt_file_slurp(path, &ret);
-
-    if (ret || (ret = parse_navaids(navaids, ndb)))
+    if (ret)
     {
         goto end;
     }
@@ -121,8 +164,47 @@ int ndt_ndb_xpgns_navdatabase_init(ndt_navdatabase *ndb)
         goto end;
     }
     waypoints = ndt_file_slurp(path, &ret);
+    if (ret)
+    {
+        goto end;
+    }
 
-    if (ret || (ret = parse_waypoints(waypoints, ndb)))
+    /*
+     * Scoped loading: an airway is kept (whole) if any of its fixes is in
+     * scope, and so are all fixes it references, in scope or not (else any
+     * route along it would fail). Airways come first, so we collect in-scope
+     * fixes from the navaid and waypoint files before parsing the airways.
+     */
+    start = ndt_stats_begin();
+    if (ndb->scope.bbox || ndb->scope.regions)
+    {
+        if ((ret = scope_collect(&ndb->scope, navaids,   &inscope, 6, 7, 9)) ||
+            (ret = scope_collect(&ndb->scope, waypoints, &inscope, 1, 2, 3)))
+        {
+            goto end;
+        }
+        scope_fixes_sort(&inscope);
+    }
+    ret = parse_airways(airways, ndb, &inscope, &refs);
+    scope_fixes_sort(&refs);
+    ndt_stats_end(NDT_STAT_AIRWAYS, start);
+    if (ret)
+    {
+        goto end;
+    }
+
+    start = ndt_stats_begin();
+    ret   = parse_navaids(navaids, ndb, &refs);
+    ndt_stats_end(NDT_STAT_NAVAIDS, start);
+    if (ret)
+    {
+        goto end;
+    }
+
+    start = ndt_stats_begin();
+    ret   = parse_waypoints(waypoints, ndb, &refs);
+    ndt_stats_end(NDT_STAT_WAYPOINTS, start);
+    if (ret)
     {
         goto end;
     }
@@ -146,6 +228,8 @@ end:
     free(path);
     if  (procedures) closedir(procedures);
     free(waypoints);
+    free(inscope.fix);
+    free(refs.fix);
     return ret;
 }
 
@@ -226,7 +310,7 @@ static int parse_airports(char *src, ndt_navdatabase *ndb)
     char         *pos  = src;
     ndt_airport  *apt  = NULL;
     char         *line = NULL;
-    int           linecap, ret = 0;
+    int           linecap, skip = 0, ret = 0;
 
     while ((ret = ndt_file_getline(&line, &linecap, &pos)) > 0)
     {
@@ -240,6 +324,13 @@ static int parse_airports(char *src, ndt_navdatabase *ndb)
             double latitude, longitude;
             int    elevation, transalt, translvl, longestr;
 
+            if (!scope_record(&ndb->scope, line, 3, 4, -1, 1))
+            {
+                skip = 1; // airport (and its runways) not in scope
+                continue;
+            }
+            skip = 0;
+
             apt = ndt_airport_init();
             if (!apt)
             {
@@ -335,6 +426,11 @@ static int parse_airports(char *src, ndt_navdatabase *ndb)
             double frequency, latitude, longitude;
             int    length, width, elevation, overfly, surface, usage;
 
+            if (skip)
+            {
+                continue;
+            }
+
             if (!apt)
             {
                 ret = EINVAL;
@@ -517,13 +613,14 @@ end:
     return ret;
 }
 
-static int parse_airways(char *src, ndt_navdatabase *ndb)
+static int parse_airways(char *src, ndt_navdatabase *ndb, const scope_fixes *fixes, scope_fixes *refs)
 {
     char           *pos  = src;
     ndt_airway     *awy  = NULL;
     ndt_airway_leg *leg  = NULL;
     char           *line = NULL;
-    int             linecap, count_in, count_out, ret = 0;
+    int             linecap, count_in, count_out, inscope = 0, ret = 0;
+    int             scoped = ndb->scope.bbox || ndb->scope.regions;
 
     while ((ret = ndt_file_getline(&line, &linecap, &pos)) > 0)
     {
@@ -561,7 +658,7 @@ static int parse_airways(char *src, ndt_navdatabase *ndb)
             }
 
             ndt_list_add(ndb->airways, awy);
-            count_out = 0;
+            count_out = inscope = 0;
             continue;
         }
 
@@ -607,8 +704,8 @@ static int parse_airways(char *src, ndt_navdatabase *ndb)
                 goto end;
             }
 
-            next->in. position = ndt_position_init(latitude[0], longitude[0], ndt_distance_init(0, NDT_ALTUNIT_NA));
-            next->out.position = ndt_position_init(latitude[1], longitude[1], ndt_distance_init(0, NDT_ALTUNIT_NA));
+            next->in. position = ndt_position_pack(ndt_position_init(latitude[0], longitude[0], NDT_DISTANCE_ZERO));
+            next->out.position = ndt_position_pack(ndt_position_init(latitude[1], longitude[1], NDT_DISTANCE_ZERO));
             next->length       = ndt_distance_init((int)(distance * 1852.), NDT_ALTUNIT_ME);
             next->awy          = awy;
 
@@ -622,8 +719,31 @@ static int parse_airways(char *src, ndt_navdatabase *ndb)
                 leg       = next;
             }
 
+            if (scoped && !inscope)
+            {
+                inscope = (scope_fixes_find(fixes, next->in. info.idnt, next->in. position) ||
+                           scope_fixes_find(fixes, next->out.info.idnt, next->out.position));
+            }
+
             if (++count_out == count_in)
             {
+                if (scoped && !inscope)
+                {
+                    // no part of the airway is in scope, drop it
+                    ndt_list_rem    (ndb->airways, awy);
+                    ndt_airway_close(&awy);
+                    leg = NULL;
+                    continue;
+                }
+                for (ndt_airway_leg *l = scoped ? awy->leg : NULL; l; l = l->next)
+                {
+                    if ((l == awy->leg && (ret = scope_fixes_add(refs, l->in.info.idnt, l->in.position))) ||
+                        (ret = scope_fixes_add(refs, l->out.info.idnt, l->out.position)))
+                    {
+                        goto end;
+                    }
+                }
+
                 // that was the last leg, finalize airway
                 snprintf(awy->info.desc, sizeof(awy->info.desc),
                          "Airway: %5s, %2d legs, %-5s -> %s",  awy->info.idnt,
@@ -660,7 +780,7 @@ end:
     return ret;
 }
 
-static int parse_navaids(char *src, ndt_navdatabase *ndb)
+static int parse_navaids(char *src, ndt_navdatabase *ndb, const scope_fixes *refs)
 {
     char *pos  = src;
     char *line = NULL;
@@ -676,6 +796,11 @@ static int parse_navaids(char *src, ndt_navdatabase *ndb)
         int    elevation, range, vor;
         double frequency, latitude, longitude;
 
+        if (!scope_record(&ndb->scope, line, 6, 7, 9, -1) && !scope_fixes_line(refs, line, 6, 7))
+        {
+            continue; // neither in scope nor on an airway we kept
+        }
+
         ndt_waypoint *wpt = ndt_waypoint_init();
         if (!wpt)
         {
@@ -783,7 +908,7 @@ end:
     return ret;
 }
 
-static int parse_waypoints(char *src, ndt_navdatabase *ndb)
+static int parse_waypoints(char *src, ndt_navdatabase *ndb, const scope_fixes *refs)
 {
     char *pos  = src;
     char *line = NULL;
@@ -800,6 +925,11 @@ static int parse_waypoints(char *src, ndt_navdatabase *ndb)
         char   letter[1];
         int    digit [1];
 
+        if (!scope_record(&ndb->scope, line, 1, 2, 3, -1) && !scope_fixes_line(refs, line, 1, 2))
+        {
+            continue; // neither in scope nor on an airway we kept
+        }
+
         ndt_waypoint *wpt = ndt_waypoint_init();
         if (!wpt)
         {
@@ -855,6 +985,233 @@ end:
     return ret;
 }
 
+static int scope_position(const ndt_navdatascope *scope, double lat, double lon)
+{
+    if (!scope->bbox)
+    {
+        return 1;
+    }
+    if (lat < scope->latmin || lat > scope->latmax)
+    {
+        return 0;
+    }
+    if (scope->lonmin > scope->lonmax) // crosses the antimeridian
+    {
+        return lon >= scope->lonmin || lon <= scope->lonmax;
+    }
+    return lon >= scope->lonmin && lon <= scope->lonmax;
+}
+
+static int scope_region(const ndt_navdatascope *scope, const char *reg, int apt)
+{
+    /*
+     * Region codes are two characters (e.g. "LS"); for airports, we get the
+     * identifier instead (e.g. "LSGG"). Most region codes are an airport's
+     * first two letters; for some countries, the second character is a digit
+     * (e.g. K1-K7, PA), in which case we only match the first letter.
+     */
+    const char *tok = scope->regions;
+    size_t      len = strcspn(reg, ",\r\n");
+
+    if (!tok || !len || *reg == ' ')
+    {
+        return 1; // no filter, or no region code
+    }
+    while (*tok)
+    {
+        size_t toklen = strcspn(tok, ",");
+        if (toklen)
+        {
+            if (apt && toklen == 2 && tok[1] >= '0' && tok[1] <= '9')
+            {
+                if (len >= 1 && *reg == *tok)
+                {
+                    return 1;
+                }
+            }
+            else if (apt ? len >= toklen && !strncmp(reg, tok, toklen) :
+                           len == toklen && !strncmp(reg, tok, toklen))
+            {
+                return 1;
+            }
+        }
+        if (!tok[toklen])
+        {
+            break;
+        }
+        tok += toklen + 1;
+    }
+    return 0;
+}
+
+static int scope_record(const ndt_navdatascope *scope, const char *line, int latfield, int lonfield, int regfield, int aptfield)
+{
+    /*
+     * Check a CSV record before actually parsing it, so we don't allocate
+     * anything for records we'll be skipping anyway (negative: no such field).
+     */
+    double      lat = 0., lon = 0.;
+    const char *field;
+    int         idx;
+
+    if (!scope->bbox && !scope->regions)
+    {
+        return 1;
+    }
+    for (idx = 0, field = line; field && *field != '\r' && *field != '\n'; idx++)
+    {
+        if (idx == latfield && scope->bbox)
+        {
+            lat = strtod(field, NULL);
+        }
+        if (idx == lonfield && scope->bbox)
+        {
+            lon = strtod(field, NULL);
+        }
+        if (idx == regfield && !scope_region(scope, field, 0))
+        {
+            return 0;
+        }
+        if (idx == aptfield && !scope_region(scope, field, 1))
+        {
+            return 0;
+        }
+        if ((field = strchr(field, ',')))
+        {
+            field++;
+        }
+    }
+    return scope_position(scope, lat, lon);
+}
+
+static int scope_fixes_add(scope_fixes *set, const char *idnt, ndt_latlon position)
+{
+    if (set->count == set->alloc)
+    {
+        size_t     alloc = set->alloc ? set->alloc * 2 : 1024;
+        scope_fix *fix   = realloc(set->fix, alloc * sizeof(*fix));
+        if (!fix)
+        {
+            return ENOMEM;
+        }
+        set->alloc = alloc;
+        set->fix   = fix;
+    }
+    snprintf(set->fix[set->count].idnt, sizeof(set->fix[set->count].idnt), "%s", idnt);
+    set->fix[set->count++].position = position;
+    return 0;
+}
+
+static int compare_fix(const void *f1, const void *f2)
+{
+    return strcmp(((const scope_fix*)f1)->idnt, ((const scope_fix*)f2)->idnt);
+}
+
+static void scope_fixes_sort(scope_fixes *set)
+{
+    if (set->count)
+    {
+        qsort(set->fix, set->count, sizeof(*set->fix), &compare_fix);
+    }
+}
+
+static int scope_fixes_find(const scope_fixes *set, const char *idnt, ndt_latlon pos)
+{
+    /*
+     * Same identifier, same position: like ndt_navdata_get_wpt4pos (which
+     * airways use to look up their fixes), but with some leeway (about one
+     * arc second); an extra fix now and then costs less than a missing one.
+     */
+    size_t min = 0, max = set->count;
+    while (min < max)
+    {
+        size_t mid = min + (max - min) / 2;
+        if (strcmp(set->fix[mid].idnt, idnt) < 0)
+        {
+            min = mid + 1;
+        }
+        else
+        {
+            max = mid;
+        }
+    }
+    for (; min < set->count && !strcmp(set->fix[min].idnt, idnt); min++)
+    {
+        if (llabs((long long)set->fix[min].position.latitude  - pos.latitude ) <= 1650 &&
+            llabs((long long)set->fix[min].position.longitude - pos.longitude) <= 1650)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void scope_fix_parse(const char *line, int latfield, int lonfield, scope_fix *fix)
+{
+    /*
+     * CSV record: identifier first, then latitude and longitude somewhere.
+     */
+    double      lat = 0., lon = 0.;
+    const char *field;
+    int         idx;
+
+    snprintf(fix->idnt, sizeof(fix->idnt), "%.*s", (int)strcspn(line, ",\r\n"), line);
+    for (idx = 0, field = line; field && *field != '\r' && *field != '\n'; idx++)
+    {
+        if (idx == latfield)
+        {
+            lat = strtod(field, NULL);
+        }
+        if (idx == lonfield)
+        {
+            lon = strtod(field, NULL);
+        }
+        if ((field = strchr(field, ',')))
+        {
+            field++;
+        }
+    }
+    fix->position = ndt_position_pack(ndt_position_init(lat, lon, NDT_DISTANCE_ZERO));
+}
+
+static int scope_fixes_line(const scope_fixes *set, const char *line, int latfield, int lonfield)
+{
+    scope_fix fix;
+    if (!set->count)
+    {
+        return 0;
+    }
+    scope_fix_parse(line, latfield, lonfield, &fix);
+    return scope_fixes_find(set, fix.idnt, fix.position);
+}
+
+static int scope_collect(const ndt_navdatascope *scope, char *src, scope_fixes *set, int latfield, int lonfield, int regfield)
+{
+    char *pos  = src;
+    char *line = NULL;
+    int   linecap, ret = 0;
+
+    while ((ret = ndt_file_getline(&line, &linecap, &pos)) > 0)
+    {
+        if (*line == '\r' || *line == '\n' || !scope_record(scope, line, latfield, lonfield, regfield, -1))
+        {
+            continue;
+        }
+
+        scope_fix fix;
+        scope_fix_parse(line, latfield, lonfield, &fix);
+        if ((ret = scope_fixes_add(set, fix.idnt, fix.position)))
+        {
+            goto end;
+        }
+    }
+    ret = ret < 0 ? EIO : 0;
+
+end:
+    free(line);
+    return ret;
+}
+
 ndt_airport* ndt_ndb_xpgns_navdata_init_airport(ndt_navdatabase *ndb, ndt_airport *apt)
 {
     ndt_airport *ret = NULL;
@@ -953,7 +1310,7 @@ ndt_procedure* ndt_ndb_xpgns_navdata_open_procdre(ndt_navdatabase *ndb, ndt_proc
         free(proc->raw_data);
         proc->raw_data = NULL;
     }
-    proc->opened = 1;
+    __atomic_store_n(&proc->opened, 1, __ATOMIC_RELEASE); // legs ready, see ndt_procedure_open
     return proc;
 }
 
@@ -3963,7 +4320,7 @@ static int open_a_procedure(ndt_navdatabase *ndb, ndt_procedure *proc)
         free(proc->raw_data);
         proc->raw_data = NULL;
     }
-    proc->opened = 1;
+    __atomic_store_n(&proc->opened, 1, __ATOMIC_RELEASE); // legs ready, see ndt_procedure_open
 
 end:
     if (ret)
@@ -0,0 +1,366 @@
+/*
+ * spatial.c
+ *
+ * This file is part of the navdtools source code.
+ *
+ * (C) Copyright 2014-2016 Timothy D. Walker and others.
+ *
+ * All rights reserved. This program and the accompanying materials are made
+ * available under the terms of the GNU General Public License (GPL) version 2
+ * which accompanies this distribution (LICENSE file), and is also available at
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * Contributors:
+ *     Timothy D. Walker
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/common.h"
+#include "common/list.h"
+
+#include "compat/compat.h"
+
+#include "spatial.h"
+#include "waypoint.h"
+
+#define NDT_SPATIAL_NLAT (180)
+#define NDT_SPATIAL_NLON (360)
+
+struct ndt_spatial
+{
+    ndt_list *cells[NDT_SPATIAL_NLAT * NDT_SPATIAL_NLON]; // allocated on demand
+    size_t    count;
+};
+
+typedef struct spatial_result
+{
+    ndt_waypoint *wpt;
+    int64_t      dist;
+} spatial_result;
+
+static int spatial_cell  (ndt_position pos);
+static int spatial_search(ndt_spatial *idx, ndt_position pos, ndt_distance range, uint64_t types,
+                          ndt_spatial_callback *cb, void *ctx, spatial_result **_res, size_t *_cnt);
+static int spatial_output(spatial_result *res, size_t cnt, size_t max, ndt_list *out);
+static int compare_res   (const void *res1, const void *res2);
+
+ndt_spatial* ndt_spatial_init()
+{
+    ndt_spatial *idx = calloc(1, sizeof(ndt_spatial));
+    if (!idx)
+    {
+        goto end;
+    }
+
+end:
+    return idx;
+}
+
+void ndt_spatial_close(ndt_spatial **_idx)
+{
+    if (_idx && *_idx)
+    {
+        ndt_spatial *idx = *_idx;
+
+        for (size_t i = 0; i < NDT_SPATIAL_NLAT * NDT_SPATIAL_NLON; i++)
+        {
+            if (idx->cells[i])
+            {
+                ndt_list_close(&idx->cells[i]);
+            }
+        }
+
+        free(idx);
+
+        *_idx = NULL;
+    }
+}
+
+void ndt_spatial_add(ndt_spatial *idx, ndt_waypoint *wpt)
+{
+    if (idx && wpt)
+    {
+        int cell = spatial_cell(wpt->position);
+        if (!idx->cells[cell] && !(idx->cells[cell] = ndt_list_init()))
+        {
+            return;
+        }
+        size_t count = ndt_list_count(idx->cells[cell]);
+        ndt_list_add(idx->cells[cell], wpt);
+        idx->count  += ndt_list_count(idx->cells[cell]) - count;
+    }
+}
+
+void ndt_spatial_rem(ndt_spatial *idx, ndt_waypoint *wpt)
+{
+    if (idx && wpt)
+    {
+        int cell = spatial_cell(wpt->position);
+        size_t count = ndt_list_count(idx->cells[cell]);
+        ndt_list_rem(idx->cells[cell], wpt);
+        if (ndt_list_count(idx->cells[cell]) < count)
+        {
+            idx->count--;
+            return;
+        }
+
+        /*
+         * Not where we expected it: the waypoint was moved after it was added,
+         * so we have to look for it everywhere (slow, but it shouldn't happen).
+         */
+        for (size_t i = 0; i < NDT_SPATIAL_NLAT * NDT_SPATIAL_NLON; i++)
+        {
+            if ((count = ndt_list_count(idx->cells[i])))
+            {
+                ndt_list_rem(idx->cells[i], wpt);
+                if (ndt_list_count(idx->cells[i]) < count)
+                {
+                    idx->count--;
+                    return;
+                }
+            }
+        }
+    }
+}
+
+size_t ndt_spatial_count(ndt_spatial *idx)
+{
+    return idx ? idx->count : 0;
+}
+
+size_t ndt_spatial_size(ndt_spatial *idx)
+{
+    size_t size = idx ? sizeof(ndt_spatial) : 0;
+    for (size_t i = 0; idx && i < NDT_SPATIAL_NLAT * NDT_SPATIAL_NLON; i++)
+    {
+        size += ndt_list_size(idx->cells[i]);
+    }
+    return size;
+}
+
+int ndt_spatial_inrange(ndt_spatial *idx, ndt_position pos, ndt_distance range, uint64_t types,
+                        ndt_spatial_callback *cb, void *ctx, ndt_list *out)
+{
+    spatial_result *res = NULL;
+    size_t          cnt = 0;
+    int             ret = 0;
+
+    if (!idx || !out || ndt_distance_get(range, NDT_ALTUNIT_NA) < 0)
+    {
+        ret = EINVAL;
+        goto end;
+    }
+
+    if ((ret = spatial_search(idx, pos, range, types, cb, ctx, &res, &cnt)))
+    {
+        goto end;
+    }
+
+    ret = spatial_output(res, cnt, cnt, out);
+
+end:
+    free(res);
+    return ret;
+}
+
+int ndt_spatial_nearest(ndt_spatial *idx, ndt_position pos, size_t count, ndt_distance range, uint64_t types,
+                        ndt_spatial_callback *cb, void *ctx, ndt_list *out)
+{
+    spatial_result *res = NULL;
+    size_t          cnt = 0;
+    int             ret = 0;
+
+    if (!idx || !out)
+    {
+        ret = EINVAL;
+        goto end;
+    }
+
+    if (!count)
+    {
+        goto end;
+    }
+
+    /*
+     * Expanding search: start small, and widen the search radius until we've
+     * found enough waypoints (or covered the whole range). All waypoints in a
+     * given radius are found, so the first count results are the nearest ones.
+     *
+     * A non-positive range means unlimited (half the Earth's circumference).
+     */
+    double maxnm = 180. * 60.;
+    if (ndt_distance_get(range, NDT_ALTUNIT_NA) > 0)
+    {
+        maxnm = fmin(maxnm, (double)ndt_distance_get(range, NDT_ALTUNIT_NA) / 18520000.);
+    }
+    for (double radius = 25.; ; radius *= 4.)
+    {
+        double       nmiles = fmin(radius, maxnm);
+        ndt_distance search = ndt_distance_init((int64_t)(nmiles * 18520000.), NDT_ALTUNIT_NA);
+
+        free(res); res = NULL; cnt = 0;
+        if ((ret = spatial_search(idx, pos, search, types, cb, ctx, &res, &cnt)))
+        {
+            goto end;
+        }
+        if (cnt >= count || nmiles >= maxnm)
+        {
+            break;
+        }
+    }
+
+    ret = spatial_output(res, cnt, count, out);
+
+end:
+    free(res);
+    return ret;
+}
+
+static int spatial_cell(ndt_position pos)
+{
+    int row = (int)floor(ndt_position_getlatitude (pos, NDT_ANGUNIT_DEG) +  90.);
+    int col = (int)floor(ndt_position_getlongitude(pos, NDT_ANGUNIT_DEG) + 180.);
+
+    row = row < 0 ? 0 : row >= NDT_SPATIAL_NLAT ? NDT_SPATIAL_NLAT - 1 : row;
+    col = ((col % NDT_SPATIAL_NLON) + NDT_SPATIAL_NLON) % NDT_SPATIAL_NLON;
+
+    return row * NDT_SPATIAL_NLON + col;
+}
+
+static int spatial_search(ndt_spatial *idx, ndt_position pos, ndt_distance range, uint64_t types,
+                          ndt_spatial_callback *cb, void *ctx, spatial_result **_res, size_t *_cnt)
+{
+    spatial_result *res = NULL;
+    size_t     cnt = 0, cap = 0;
+    int        ret = 0;
+
+    /*
+     * One nautical mile is one minute of arc (see EARTHRAD in common.c); add a
+     * nautical mile of margin, the exact distance check will take care of it.
+     *
+     * Longitude bounds: http://janmatuschek.de/LatitudeLongitudeBoundingCoordinates
+     */
+    double lat  = ndt_position_getlatitude (pos, NDT_ANGUNIT_DEG);
+    double lon  = ndt_position_getlongitude(pos, NDT_ANGUNIT_DEG);
+    double dist = (double)ndt_distance_get(range, NDT_ALTUNIT_NA) / 18520000. / 60. + 1. / 60.;
+    double dlon = 180.;
+    int    row1 = (int)floor(lat - dist + 90.);
+    int    row2 = (int)floor(lat + dist + 90.);
+    int    col1 = 0, col2 = NDT_SPATIAL_NLON - 1;
+
+    if (lat - dist > -90. && lat + dist < 90.)
+    {
+        double sinr = sin(dist * M_PI / 180.) / cos(lat * M_PI / 180.);
+        if (sinr < 1.)
+        {
+            dlon = asin(sinr) * 180. / M_PI;
+        }
+    }
+    if (dlon < 179.)
+    {
+        col1 = (int)floor(lon - dlon + 180.);
+        col2 = (int)floor(lon + dlon + 180.);
+    }
+    row1 = row1 < 0 ? 0 : row1;
+    row2 = row2 >= NDT_SPATIAL_NLAT ? NDT_SPATIAL_NLAT - 1 : row2;
+
+    // calcwithin is a strict comparison, but range is inclusive
+    ndt_distance limit = ndt_distance_add(range, ndt_distance_init(1, NDT_ALTUNIT_NA));
+
+    for (int row = row1; row <= row2; row++)
+    {
+        for (int c = col1; c <= col2; c++)
+        {
+            int       col  = ((c % NDT_SPATIAL_NLON) + NDT_SPATIAL_NLON) % NDT_SPATIAL_NLON;
+            ndt_list *cell = idx->cells[row * NDT_SPATIAL_NLON + col];
+
+            for (size_t i = 0; i < ndt_list_count(cell); i++)
+            {
+                ndt_waypoint *wpt = ndt_list_item(cell, i);
+                if (!wpt || wpt->type >= 64 || !(types & NDT_SPATIAL_TYPE(wpt->type)))
+                {
+                    continue;
+                }
+                if (!ndt_position_calcwithin(pos, wpt->position, limit))
+                {
+                    continue;
+                }
+                if (cb && !cb(wpt, ctx))
+                {
+                    continue;
+                }
+                if (cnt == cap)
+                {
+                    spatial_result *ptr = realloc(res, (cap + 64) * sizeof(spatial_result));
+                    if (!ptr)
+                    {
+                        ret = ENOMEM;
+                        goto end;
+                    }
+                    cap += 64;
+                    res  = ptr;
+                }
+                res[cnt].wpt  = wpt;
+                res[cnt].dist = ndt_distance_get(ndt_position_calcdistance(pos, wpt->position), NDT_ALTUNIT_NA);
+                cnt++;
+            }
+        }
+    }
+
+end:
+    if (ret)
+    {
+        free(res);
+        res = NULL;
+        cnt = 0;
+    }
+    *_res = res;
+    *_cnt = cnt;
+    return ret;
+}
+
+static int spatial_output(spatial_result *res, size_t cnt, size_t max, ndt_list *out)
+{
+    if (cnt)
+    {
+        qsort(res, cnt, sizeof(spatial_result), &compare_res);
+    }
+    for (size_t i = 0; i < cnt && i < max; i++)
+    {
+        size_t count = ndt_list_count(out);
+        ndt_list_add(out, res[i].wpt);
+        if (ndt_list_count(out) == count)
+        {
+            return ENOMEM;
+        }
+    }
+    return 0;
+}
+
+static int compare_res(const void *p1, const void *p2)
+{
+    const spatial_result *res1 = p1;
+    const spatial_result *res2 = p2;
+
+    if (res1->dist != res2->dist)
+    {
+        return res1->dist < res2->dist ? -1 : 1;
+    }
+
+    int cmp = strcmp(res1->wpt->info.idnt, res2->wpt->info.idnt);
+    if (cmp)
+    {
+        return cmp;
+    }
+
+    return res1->wpt->type - res2->wpt->type;
+}
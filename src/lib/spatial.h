@@ -0,0 +1,55 @@
+/*
+ * spatial.h
+ *
+ * This file is part of the navdtools source code.
+ *
+ * (C) Copyright 2014-2016 Timothy D. Walker and others.
+ *
+ * All rights reserved. This program and the accompanying materials are made
+ * available under the terms of the GNU General Public License (GPL) version 2
+ * which accompanies this distribution (LICENSE file), and is also available at
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * Contributors:
+ *     Timothy D. Walker
+ */
+
+#ifndef NDT_SPATIAL_H
+#define NDT_SPATIAL_H
+
+#include <inttypes.h>
+
+#include "common/common.h"
+#include "common/list.h"
+
+#include "waypoint.h"
+
+/*
+ * Proximity index over waypoints: a fixed 1° x 1° latitude/longitude grid, each
+ * cell listing the waypoints it contains. The index doesn't own the waypoints,
+ * it merely references them; waypoints must be removed from the index before
+ * they're closed, and re-added if their position changes.
+ */
+typedef struct ndt_spatial ndt_spatial;
+
+/* Waypoint type filter: e.g. NDT_SPATIAL_TYPE(NDT_WPTYPE_VOR)|NDT_SPATIAL_TYPE(NDT_WPTYPE_NDB) */
+#define NDT_SPATIAL_TYPE(type) (UINT64_C(1) << (type))
+#define NDT_SPATIAL_ALL        (UINT64_MAX)
+
+/* Optional per-waypoint filter (non-zero to accept the waypoint) */
+typedef int (ndt_spatial_callback)(ndt_waypoint *wpt, void *context);
+
+ndt_spatial* ndt_spatial_init   (                                                                                                                                        );
+void         ndt_spatial_close  (ndt_spatial **_index                                                                                                                    );
+void         ndt_spatial_add    (ndt_spatial   *index, ndt_waypoint *wpt                                                                                                  );
+void         ndt_spatial_rem    (ndt_spatial   *index, ndt_waypoint *wpt                                                                                                  );
+size_t       ndt_spatial_count  (ndt_spatial   *index                                                                                                                    );
+size_t       ndt_spatial_size   (ndt_spatial   *index                                                                                                                    );
+int          ndt_spatial_inrange(ndt_spatial   *index, ndt_position  pos,                ndt_distance range, uint64_t types, ndt_spatial_callback *cb, void *ctx, ndt_list *out);
+int          ndt_spatial_nearest(ndt_spatial   *index, ndt_position  pos, size_t count, ndt_distance range, uint64_t types, ndt_spatial_callback *cb, void *ctx, ndt_list *out);
+
+#endif /* NDT_SPATIAL_H */
@@ -35,11 +35,17 @@
 
 ndt_waypoint* ndt_waypoint_init()
 {
-    ndt_waypoint *wpt = calloc(1, sizeof(ndt_waypoint));
+    return ndt_waypoint_init2(NULL);
+}
+
+ndt_waypoint* ndt_waypoint_init2(ndt_arena *arena)
+{
+    ndt_waypoint *wpt = ndt_arena_alloc(arena, sizeof(ndt_waypoint));
     if (!wpt)
     {
         goto end;
     }
+    wpt->arena = !!arena;
 
     // make it valid by default
     wpt->type     = NDT_WPTYPE_LLC;
@@ -50,20 +56,33 @@ end:
 }
 
 void ndt_waypoint_close(ndt_waypoint **_wpt)
+{
+    ndt_waypoint_close2(_wpt, NULL);
+}
+
+void ndt_waypoint_close2(ndt_waypoint **_wpt, ndt_arena *arena)
 {
     if (_wpt && *_wpt)
     {
         ndt_waypoint *wpt = *_wpt;
 
-        free(wpt);
+        /*
+         * Waypoints don't know which arena they come from (it would cost 8
+         * bytes for each navdata waypoint); if it wasn't provided, leave it
+         * to the arena's owner (ndt_arena_close will release it anyway).
+         */
+        if (!wpt->arena || arena)
+        {
+            ndt_arena_free(wpt->arena ? arena : NULL, wpt, sizeof(ndt_waypoint));
+        }
 
         *_wpt = NULL;
     }
 }
 
-ndt_waypoint* ndt_waypoint_posn(ndt_position position)
+ndt_waypoint* ndt_waypoint_posn(ndt_position position, ndt_arena *arena)
 {
-    ndt_waypoint *wpt = ndt_waypoint_init();
+    ndt_waypoint *wpt = ndt_waypoint_init2(arena);
     if (wpt == NULL)
     {
         goto end;
@@ -84,7 +103,7 @@ end:
     return wpt;
 }
 
-ndt_waypoint* ndt_waypoint_llc(const char *fmt)
+ndt_waypoint* ndt_waypoint_llc(const char *fmt, ndt_arena *arena)
 {
     if (!fmt)
     {
@@ -337,16 +356,16 @@ ndt_waypoint* ndt_waypoint_llc(const char *fmt)
         goto end;
     }
 
-    return ndt_waypoint_posn(ndt_position_init(lat, lon, ndt_distance_init(0, NDT_ALTUNIT_NA)));
+    return ndt_waypoint_posn(ndt_position_init(lat, lon, ndt_distance_init(0, NDT_ALTUNIT_NA)), arena);
 
 end:
     return NULL;
 }
 
-ndt_waypoint* ndt_waypoint_pbd(ndt_waypoint *plce, double magb, ndt_distance dist, void *wmm)
+ndt_waypoint* ndt_waypoint_pbd(ndt_waypoint *plce, double magb, ndt_distance dist, void *wmm, ndt_arena *arena)
 {
     ndt_waypoint *wpt = NULL;
-    if (!plce || !wmm || !(wpt = ndt_waypoint_init()))
+    if (!plce || !wmm || !(wpt = ndt_waypoint_init2(arena)))
     {
         goto end;
     }
@@ -365,10 +384,10 @@ end:
     return wpt;
 }
 
-ndt_waypoint* ndt_waypoint_pbpb(ndt_waypoint *src1, double mag1, ndt_waypoint *src2, double mag2, void *wmm)
+ndt_waypoint* ndt_waypoint_pbpb(ndt_waypoint *src1, double mag1, ndt_waypoint *src2, double mag2, void *wmm, ndt_arena *arena)
 {
     ndt_waypoint *wpt = NULL;
-    if (!src1 || !src2 || !wmm || !(wpt = ndt_waypoint_init()))
+    if (!src1 || !src2 || !wmm || !(wpt = ndt_waypoint_init2(arena)))
     {
         goto end;
     }
@@ -405,10 +424,10 @@ end:
     return wpt;
 }
 
-ndt_waypoint* ndt_waypoint_pbpd(ndt_waypoint *src1, double magb, ndt_waypoint *src2, ndt_distance dist, void *wmm)
+ndt_waypoint* ndt_waypoint_pbpd(ndt_waypoint *src1, double magb, ndt_waypoint *src2, ndt_distance dist, void *wmm, ndt_arena *arena)
 {
     ndt_waypoint *wpt = NULL;
-    if (!src1 || !src2 || !wmm || !(wpt = ndt_waypoint_init()))
+    if (!src1 || !src2 || !wmm || !(wpt = ndt_waypoint_init2(arena)))
     {
         goto end;
     }
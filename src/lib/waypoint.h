@@ -21,6 +21,7 @@
 #ifndef NDT_WAYPOINT_H
 #define NDT_WAYPOINT_H
 
+#include "common/arena.h"
 #include "common/common.h"
 
 typedef enum ndt_acftype
@@ -141,14 +142,18 @@ typedef struct ndt_waypoint
         NDT_WPTYPE_TOC = 51, // top of climb   (pseudo-waypoint) (no XPLM equivalent)
         NDT_WPTYPE_TOD = 52, // top of descent (pseudo-waypoint) (no XPLM equivalent)
     } type;
+
+    int arena; // allocated from an arena (close with ndt_waypoint_close2)
 } ndt_waypoint;
 
-ndt_waypoint* ndt_waypoint_init (                        );
-void          ndt_waypoint_close(ndt_waypoint **_waypoint);
-ndt_waypoint* ndt_waypoint_posn (ndt_position    position);
-ndt_waypoint* ndt_waypoint_llc  (const char       *format);
-ndt_waypoint* ndt_waypoint_pbd  (ndt_waypoint  *place, double magbearing, ndt_distance distance,                    void *wmm);
-ndt_waypoint* ndt_waypoint_pbpb (ndt_waypoint  *plce1, double magneticb1, ndt_waypoint   *plce2, double magneticb2, void *wmm);
-ndt_waypoint* ndt_waypoint_pbpd (ndt_waypoint  *plce1, double magbearing, ndt_waypoint   *plce2, ndt_distance dist, void *wmm);
+ndt_waypoint* ndt_waypoint_init (                                                                                                              );
+ndt_waypoint* ndt_waypoint_init2(                                                                                              ndt_arena *arena);
+void          ndt_waypoint_close(ndt_waypoint **_waypoint                                                                                      );
+void          ndt_waypoint_close2(ndt_waypoint **_waypoint,                                                                 ndt_arena *arena);
+ndt_waypoint* ndt_waypoint_posn (ndt_position    position,                                                                     ndt_arena *arena);
+ndt_waypoint* ndt_waypoint_llc  (const char       *format,                                                                     ndt_arena *arena);
+ndt_waypoint* ndt_waypoint_pbd  (ndt_waypoint  *place, double magbearing, ndt_distance distance,                    void *wmm, ndt_arena *arena);
+ndt_waypoint* ndt_waypoint_pbpb (ndt_waypoint  *plce1, double magneticb1, ndt_waypoint   *plce2, double magneticb2, void *wmm, ndt_arena *arena);
+ndt_waypoint* ndt_waypoint_pbpd (ndt_waypoint  *plce1, double magbearing, ndt_waypoint   *plce2, ndt_distance dist, void *wmm, ndt_arena *arena);
 
 #endif /* NDT_WAYPOINT_H */
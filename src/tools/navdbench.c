@@ -0,0 +1,1368 @@
+/*
+ * navdbench.c
+ *
+ * This file is part of the navdtools source code.
+ *
+ * (C) Copyright 2014-2016 Timothy D. Walker and others.
+ *
+ * All rights reserved. This program and the accompanying materials are made
+ * available under the terms of the GNU General Public License (GPL) version 2
+ * which accompanies this distribution (LICENSE file), and is also available at
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * Contributors:
+ *     Timothy D. Walker
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/common.h"
+#include "common/sink.h"
+#include "common/stats.h"
+#include "compat/compat.h"
+#include "lib/flightplan.h"
+#include "lib/navdata.h"
+#include "wmm/wmm.h"
+
+// executable name and version
+#ifndef NDBENCH_EXE
+#define NDBENCH_EXE "navdbench"
+#endif
+#ifndef NDT_VERSION
+#define NDT_VERSION "unknown"
+#endif
+
+#define OPT_HELP 256
+#define OPT_DTBS 257
+#define OPT_GDIR 258
+#define OPT_OTPT 259
+#define OPT_NAPT 260
+#define OPT_NWPT 261
+#define OPT_NNAV 262
+#define OPT_NAWY 263
+#define OPT_NPRC 264
+#define OPT_NQRY 265
+#define OPT_NRTE 266
+#define OPT_NLDS 267
+#define OPT_SEED 268
+
+// navigation data (existing, or generated)
+static char *path_navdat = NULL;
+static char *path_gendir = NULL;
+static int   keep_gendir =    0;
+static char *path_out    = NULL;
+
+// synthetic navigation data size
+static int   gen_airports  =   2000;
+static int   gen_waypoints =  50000;
+static int   gen_navaids   =   5000;
+static int   gen_airways   =   1000;
+static int   gen_procs     =      2; // SIDs and STARs per airport
+static int   gen_awylegs   =     10; // legs per airway
+
+// workload
+static int      bench_queries = 100000;
+static int      bench_routes  =    500;
+static int      bench_loads   =      3;
+static uint64_t bench_seed    =     42;
+static int      bench_micro   =      0; // geodesy, WMM primitives only
+
+static struct option navdbench_opts[] =
+{
+    { "h",             no_argument,       NULL, OPT_HELP, },
+    { "help",          no_argument,       NULL, OPT_HELP, },
+
+    // navigation data
+    { "db",            required_argument, NULL, OPT_DTBS, },
+    { "dir",           required_argument, NULL, OPT_GDIR, },
+    { "keep",          no_argument,      &keep_gendir, 1, },
+    { "airports",      required_argument, NULL, OPT_NAPT, },
+    { "waypoints",     required_argument, NULL, OPT_NWPT, },
+    { "navaids",       required_argument, NULL, OPT_NNAV, },
+    { "airways",       required_argument, NULL, OPT_NAWY, },
+    { "procs",         required_argument, NULL, OPT_NPRC, },
+
+    // workload, output
+    { "queries",       required_argument, NULL, OPT_NQRY, },
+    { "routes",        required_argument, NULL, OPT_NRTE, },
+    { "loads",         required_argument, NULL, OPT_NLDS, },
+    { "seed",          required_argument, NULL, OPT_SEED, },
+    { "micro",         no_argument,      &bench_micro,  1, },
+    { "o",             required_argument, NULL, OPT_OTPT, },
+
+    // that's all folks!
+    { NULL,            0,                 NULL,        0, },
+};
+
+/*
+ * Writers to benchmark (same names as navdconv's --ofmt).
+ */
+static const struct
+{
+    const char        *name;
+    ndt_fltplanformat format;
+}
+bench_writers[] =
+{
+    { "airbusx",  NDT_FLTPFMT_AIBXT, },
+    { "civa",     NDT_FLTPFMT_XPCVA, },
+    { "decoded",  NDT_FLTPFMT_DCDED, },
+    { "helper",   NDT_FLTPFMT_XPHLP, },
+    { "icao",     NDT_FLTPFMT_ICAOR, },
+    { "ixeg",     NDT_FLTPFMT_ICAOX, },
+    { "mcdu",     NDT_FLTPFMT_XPCDU, },
+    { "recap",    NDT_FLTPFMT_IRECP, },
+    { "simbrief", NDT_FLTPFMT_SBRIF, },
+    { "xplane",   NDT_FLTPFMT_XPFMS, },
+};
+#define BENCH_NWRITERS (sizeof(bench_writers) / sizeof(bench_writers[0]))
+
+typedef struct bench_route
+{
+    char dep[32];
+    char arr[32];
+    char rte[128];
+} bench_route;
+
+typedef struct micro_input
+{
+    ndt_position pos1;
+    ndt_position pos2;
+    ndt_position pos3; // on course brg1 from pos1, and on course brg2 from pos2
+    ndt_distance dist; // from pos2 to pos3
+    double       brg1;
+    double       brg2;
+} micro_input;
+
+typedef struct bench_result
+{
+    char      name[32];
+    uint64_t       ops;
+    uint64_t    failed;
+    int64_t         ns;
+} bench_result;
+
+typedef struct bench_check
+{
+    char      name[32];
+    double       value;
+    double   reference;
+    double   tolerance;
+} bench_check;
+
+static bench_result results[32];
+static size_t       results_count = 0;
+static bench_check  checks [64];
+static size_t       checks_count  = 0;
+static size_t       checks_failed = 0;
+
+static int  parse_options(int argc, char **argv);
+static int  generate     (const char *dir     );
+static void generate_rm  (const char *dir     );
+static int  bench_run    (const char *dir, FILE *out);
+static int  bench_scoped (const char *dir, ndt_navdatabase *ndb);
+static int  micro_run    (FILE       *out);
+static int  print_results(FILE *out, const char *navdata);
+static int  print_help   (void);
+
+int main(int argc, char **argv)
+{
+    char tmpdir[256];
+    char  *path = NULL;
+    FILE   *out = stdout;
+    int     ret = 0;
+
+    if ((ret = parse_options(argc, argv)))
+    {
+        ret = ret < 0 ? 0 : ret; // help
+        goto end;
+    }
+    if (path_out && !(out = fopen(path_out, "w")))
+    {
+        fprintf(stderr, "Bad output file: '%s' (%s)\n", path_out, strerror((ret = errno)));
+        out = NULL;
+        goto end;
+    }
+    if (bench_micro)
+    {
+        ret = micro_run(out);
+        goto end;
+    }
+
+    /*
+     * Use existing navdata (--db), or generate some in a new directory.
+     */
+    if (path_navdat)
+    {
+        path = path_navdat;
+    }
+    else
+    {
+        if (path_gendir)
+        {
+            if (mkdir(path_gendir, 0755))
+            {
+                fprintf(stderr, "Bad output directory: '%s' (%s)\n", path_gendir, strerror((ret = errno)));
+                goto end;
+            }
+            path = path_gendir;
+        }
+        else
+        {
+            const char *tmp = getenv("TMPDIR");
+            snprintf(tmpdir, sizeof(tmpdir), "%s/navdbench.XXXXXX", tmp && *tmp ? tmp : "/tmp");
+            if (!(path = mkdtemp(tmpdir)))
+            {
+                fprintf(stderr, "Bad output directory: '%s' (%s)\n", tmpdir, strerror((ret = errno)));
+                goto end;
+            }
+        }
+        if ((ret = generate(path)))
+        {
+            fprintf(stderr, "Failed to generate navdata in '%s' (%s)\n", path, strerror(ret));
+            goto end;
+        }
+    }
+    ret = bench_run(path, out);
+
+end:
+    if (path && !path_navdat && !keep_gendir)
+    {
+        generate_rm(path);
+    }
+    if (out && out != stdout)
+    {
+        fclose(out);
+    }
+    if (ret)
+    {
+        fprintf(stderr, "Error: %s\n", strerror(ret));
+    }
+    return ret;
+}
+
+/*
+ * Reproducible pseudo-random numbers (xorshift64*), same on every platform.
+ */
+static uint64_t rng_state = 42;
+
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * UINT64_C(2685821657736338717);
+}
+
+static size_t rng_index(size_t count)
+{
+    return count ? (size_t)(rng_next() % count) : 0;
+}
+
+static double rng_real(double min, double max)
+{
+    return min + (max - min) * ((rng_next() >> 11) * (1. / 9007199254740992.));
+}
+
+static int64_t bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * INT64_C(1000000000) + ts.tv_nsec;
+}
+
+static void bench_add(const char *name, uint64_t ops, uint64_t failed, int64_t ns)
+{
+    if (results_count < sizeof(results) / sizeof(results[0]))
+    {
+        bench_result *res = &results[results_count++];
+        snprintf(res->name, sizeof(res->name), "%s", name);
+        res->ops    = ops;
+        res->failed = failed;
+        res->ns     = ns;
+    }
+    fprintf(stderr, "%-24s %10"PRIu64" op(s) %14.1lf ns/op\n", name, ops, ops ? (double)ns / ops : 0.);
+}
+
+/*
+ * Accuracy: value vs. reference, within tolerance (failures are reported).
+ */
+static void bench_check_add(const char *name, double value, double reference, double tolerance)
+{
+    int failed = !(fabs(value - reference) <= tolerance); // NaN fails too
+    if (checks_count < sizeof(checks) / sizeof(checks[0]))
+    {
+        bench_check *chk = &checks[checks_count++];
+        snprintf(chk->name, sizeof(chk->name), "%s", name);
+        chk->value     = value;
+        chk->reference = reference;
+        chk->tolerance = tolerance;
+    }
+    if (failed)
+    {
+        fprintf(stderr, "Check failed: %s: %.9lf (reference: %.9lf, tolerance: %.9lf)\n",
+                name, value, reference, tolerance);
+        checks_failed++;
+    }
+}
+
+/*
+ * Identifiers: fixed-length, uppercase letters only (e.g. "AAAA", "AAAAB").
+ */
+static void ident(char *buf, size_t len, uint64_t index)
+{
+    for (size_t i = len; i > 0; i--)
+    {
+        buf[i - 1] = 'A' + index % 26;
+        index     /= 26;
+    }
+    buf[len] = '\0';
+}
+
+static FILE* gen_open(const char *dir, const char *name)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    return fopen(path, "w");
+}
+
+static int gen_close(FILE **f)
+{
+    int ret = fclose(*f) ? errno : 0;
+    *f      = NULL;
+    return ret;
+}
+
+/*
+ * Synthetic X-Plane 10 GNS navdata (see ndb_xpgns.c for the format): airports
+ * with two runways (09/27), waypoints (those on airways are placed along their
+ * airway, all others at random), navaids (VOR, NDB), airways, and procedures
+ * for every airport (SIDs, STARs, an approach with two transitions).
+ */
+static int gen_procs_airport(const char *dir, const char *icao, double lat, double lon)
+{
+    char  name[64];
+    FILE *f;
+
+    snprintf(name, sizeof(name), "Proc/%s.txt", icao);
+    if (!(f = gen_open(dir, name)))
+    {
+        return errno;
+    }
+    for (int s = 1; s <= gen_procs; s++)
+    {
+        double d = s * .05;
+        fprintf(f, "SID,DEP%d,09,1\n", s);
+        fprintf(f, "CA,0,90.0,2,1000,0,0,0,0,0,0\n");
+        fprintf(f, "DF,D%dA,%.6lf,%.6lf,0,D%dA,0.0,0.0,0,0,0,0,0,0,0,0\n", s, lat + .1 + d, lon + .3, s);
+        fprintf(f, "TF,D%dB,%.6lf,%.6lf,0,D%dB,0.0,0.0,0.0,0.0,0,0,0,0,0,0,0,0\n\n", s, lat + .3 + d, lon + .5, s);
+        fprintf(f, "SID,DEP%d,27,1\n", s);
+        fprintf(f, "VA,0,270.0,2,1000,0,0,0,0,0,0\n");
+        fprintf(f, "DF,D%dA,%.6lf,%.6lf,0,D%dA,0.0,0.0,0,0,0,0,0,0,0,0\n", s, lat + .1 + d, lon + .3, s);
+        fprintf(f, "TF,D%dB,%.6lf,%.6lf,0,D%dB,0.0,0.0,0.0,0.0,0,0,0,0,0,0,0,0\n\n", s, lat + .3 + d, lon + .5, s);
+    }
+    for (int s = 1; s <= gen_procs; s++)
+    {
+        double d = s * .05;
+        fprintf(f, "STAR,ARR%d,ALL,2\n", s);
+        fprintf(f, "IF,S%dA,%.6lf,%.6lf,S%dA,0.0,0.0,0,0,0,0,0,0,0,0\n", s, lat + .4 + d, lon + .7, s);
+        fprintf(f, "TF,S%dB,%.6lf,%.6lf,0,S%dB,0.0,0.0,0.0,0.0,0,0,0,0,0,0,0,0\n", s, lat + .3, lon + .5 + d, s);
+        fprintf(f, "TF,SMO,%.6lf,%.6lf,0,SMO,0.0,0.0,0.0,0.0,0,0,0,0,0,0,0,0\n", lat + .2, lon + .2);
+        fprintf(f, "TF,SC,%.6lf,%.6lf,0,SC,0.0,0.0,0.0,0.0,0,0,0,0,0,0,0,0\n", lat + .1, lon + .1);
+        fprintf(f, "TF,SD,%.6lf,%.6lf,0,SD,0.0,0.0,0.0,0.0,0,0,0,0,0,0,0,0\n\n", lat + .05, lon - .1);
+    }
+    fprintf(f, "APPTR,I09,RW09,SMO\n");
+    fprintf(f, "IF,SMO,%.6lf,%.6lf,SMO,0.0,0.0,0,0,0,0,0,0,1,0\n", lat + .2, lon + .2);
+    fprintf(f, "TF,SP1,%.6lf,%.6lf,0,SP1,0.0,0.0,0.0,0.0,2,5000,0,0,0,0,0,0\n", lat + .1, lon - .3);
+    fprintf(f, "TF,SP2,%.6lf,%.6lf,0,SP2,0.0,0.0,0.0,0.0,2,4000,0,0,0,0,0,0\n\n", lat, lon - .3);
+    fprintf(f, "APPTR,I09,RW09,SD\n");
+    fprintf(f, "IF,SD,%.6lf,%.6lf,SD,0.0,0.0,0,0,0,0,0,0,1,0\n", lat + .05, lon - .1);
+    fprintf(f, "HF,SD,%.6lf,%.6lf,0,SD,0.0,0.0,90.0,1.0,0,0,0,0,0,0,0,0,0\n", lat + .05, lon - .1);
+    fprintf(f, "TF,SP2,%.6lf,%.6lf,0,SP2,0.0,0.0,0.0,0.0,2,4000,0,0,0,0,0,0\n\n", lat, lon - .3);
+    fprintf(f, "FINAL,I09,09,I,0\n");
+    fprintf(f, "IF,SP2,%.6lf,%.6lf,SP2,0.0,0.0,2,4000,0,0,0,0,0,0\n", lat, lon - .3);
+    fprintf(f, "CF,FAF9,%.6lf,%.6lf,0,SP2,0.0,0.0,90.0,8.0,1,3000,0,0,0,0,2,0\n", lat, lon - .15);
+    fprintf(f, "CF,RW09,%.6lf,%.6lf,0,SP2,0.0,0.0,90.0,8.0,1,200,0,0,0,0,3,0\n", lat + .001, lon - .01);
+    fprintf(f, "CA,0,90.0,2,2000,0,0,0,0,0,0\n");
+    fprintf(f, "DF,SP1,%.6lf,%.6lf,0,SP1,0.0,0.0,0,0,0,0,0,0,0,0\n", lat + .1, lon - .3);
+    fprintf(f, "HM,SP1,%.6lf,%.6lf,0,SP1,0.0,0.0,90.0,1.0,0,0,0,0,0,0,0,0,0\n\n", lat + .1, lon - .3);
+
+    return gen_close(&f);
+}
+
+static int generate(const char *dir)
+{
+    FILE       *f = NULL;
+    char     path[1024];
+    char      idt[8], idt2[8];
+    double    *wpts = NULL;
+    int        ret = 0;
+
+    rng_state = bench_seed ? bench_seed : 42;
+    fprintf(stderr, "Generating navdata in '%s'...\n", dir);
+
+    if (!(f = gen_open(dir, "cycle_info.txt")))
+    {
+        ret = errno;
+        goto end;
+    }
+    fprintf(f, "AIRAC cycle    : 1611\n"              // parse_airac requires a known vendor
+               "Version        : 1\n"
+               "Valid (from/to): 10/NOV/2016 - 08/DEC/2016\n"
+               "Forum          : Navigraph (synthetic, %s)\n", NDBENCH_EXE);
+    if ((ret = gen_close(&f)))
+    {
+        goto end;
+    }
+
+    snprintf(path, sizeof(path), "%s/Proc", dir);
+    if (mkdir(path, 0755))
+    {
+        ret = errno;
+        goto end;
+    }
+    if (!(f = gen_open(dir, "Airports.txt")))
+    {
+        ret = errno;
+        goto end;
+    }
+    for (int i = 0; i < gen_airports; i++)
+    {
+        double lat = rng_real(-60., 70.), lon = rng_real(-179., 179.);
+        ident(idt, 4, i);
+        fprintf(f, "A,%s,AIRPORT %d,%.6lf,%.6lf,%d,5000,18000,8000\n", idt, i, lat, lon, (int)rng_index(5000));
+        fprintf(f, "R,09,90,8000,150,1,110.10,90,%.6lf,%.6lf,100,3.00,50,1,0\n",  lat + .001, lon - .01);
+        fprintf(f, "R,27,270,8000,150,0,0.00,0,%.6lf,%.6lf,100,3.00,50,1,0\n\n", lat + .001, lon + .01);
+        if (gen_procs > 0 && (ret = gen_procs_airport(dir, idt, lat, lon)))
+        {
+            goto end;
+        }
+    }
+    if ((ret = gen_close(&f)))
+    {
+        goto end;
+    }
+
+    if (!(f = gen_open(dir, "Navaids.txt")))
+    {
+        ret = errno;
+        goto end;
+    }
+    for (int i = 0; i < gen_navaids; i++)
+    {
+        double lat = rng_real(-60., 70.), lon = rng_real(-180., 180.);
+        ident(idt, 3, i * 7919);
+        if (i % 2)
+        {
+            fprintf(f, "%s,VOR %d,%.2lf,1,1,130,%.6lf,%.6lf,500,EG,0\n", idt, i, 108. + (i % 200) * .05, lat, lon);
+        }
+        else
+        {
+            fprintf(f, "%s,NDB %d,%d,0,0,50,%.6lf,%.6lf,500,LF,0\n", idt, i, 200 + i % 500, lat, lon);
+        }
+    }
+    if ((ret = gen_close(&f)))
+    {
+        goto end;
+    }
+
+    /*
+     * Airway waypoints first (in sequence, along a great-ish circle), all
+     * others afterwards; gen_waypoints is the total (may limit airways).
+     */
+    if (gen_airways > gen_waypoints / (gen_awylegs + 1))
+    {
+        gen_airways = gen_waypoints / (gen_awylegs + 1);
+    }
+    if (!(wpts = calloc(2 * (size_t)gen_waypoints + 2, sizeof(double))))
+    {
+        ret = ENOMEM;
+        goto end;
+    }
+    for (int i = 0; i < gen_waypoints; i++)
+    {
+        if (i < gen_airways * (gen_awylegs + 1) && i % (gen_awylegs + 1))
+        {
+            wpts[2 * i + 0] = fmax(-80., fmin(80., wpts[2 * i - 2] + rng_real(-.5, .5)));
+            wpts[2 * i + 1] = fmax(-179., fmin(179., wpts[2 * i - 1] + rng_real(.2, .8)));
+        }
+        else
+        {
+            wpts[2 * i + 0] = rng_real(-60., 70.);
+            wpts[2 * i + 1] = rng_real(-170., 170.);
+        }
+    }
+    if (!(f = gen_open(dir, "Waypoints.txt")))
+    {
+        ret = errno;
+        goto end;
+    }
+    for (int i = 0; i < gen_waypoints; i++)
+    {
+        ident(idt, 5, i);
+        fprintf(f, "%s,%.6lf,%.6lf,%s\n", idt, wpts[2 * i], wpts[2 * i + 1], i % 2 ? "LF" : "EG");
+    }
+    if ((ret = gen_close(&f)))
+    {
+        goto end;
+    }
+    if (!(f = gen_open(dir, "ATS.txt")))
+    {
+        ret = errno;
+        goto end;
+    }
+    for (int a = 0; a < gen_airways; a++)
+    {
+        int first = a * (gen_awylegs + 1);
+        fprintf(f, "A,UN%d,%d\n", a, gen_awylegs);
+        for (int j = first; j < first + gen_awylegs; j++)
+        {
+            ident(idt,  5, j);
+            ident(idt2, 5, j + 1);
+            fprintf(f, "S,%s,%.6lf,%.6lf,%s,%.6lf,%.6lf,90,270,100.0\n",
+                    idt,  wpts[2 * j + 0], wpts[2 * j + 1],
+                    idt2, wpts[2 * j + 2], wpts[2 * j + 3]);
+        }
+        fprintf(f, "\n");
+    }
+    if ((ret = gen_close(&f)))
+    {
+        goto end;
+    }
+
+end:
+    if (f)
+    {
+        fclose(f);
+    }
+    free(wpts);
+    return ret;
+}
+
+static void generate_rm(const char *dir)
+{
+    const char *files[] = { "cycle_info.txt", "Airports.txt", "Navaids.txt", "Waypoints.txt", "ATS.txt", };
+    char         path[1024];
+    char          idt[8];
+
+    for (int i = 0; i < gen_airports; i++)
+    {
+        ident(idt, 4, i);
+        snprintf(path, sizeof(path), "%s/Proc/%s.txt", dir, idt);
+        unlink(path);
+    }
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+        unlink(path);
+    }
+    snprintf(path, sizeof(path), "%s/Proc", dir);
+    rmdir(path);
+    rmdir(dir);
+}
+
+/*
+ * Workloads draw their inputs from the loaded navdata (not the generator), so
+ * they work the same with a real database (see --db); inputs are prepared
+ * beforehand, only the operation itself is timed.
+ */
+static int bench_run(const char *dir, FILE *file)
+{
+    ndt_navdatabase *ndb = NULL;
+    ndt_flightplan **flp = NULL;
+    ndt_list        *out = NULL;
+    ndt_sink       *sink = NULL;
+    char          (*ids)[32] = NULL;
+    bench_route     *rte = NULL;
+    ndt_position    *pos = NULL;
+    size_t         count = bench_queries > 0 ? bench_queries : 1;
+    size_t        routes = bench_routes  > 0 ? bench_routes  : 1;
+    uint64_t      failed, calls0, calls1, ns0, ns1;
+    int64_t        start, total;
+    int              ret = 0;
+
+    rng_state = bench_seed ? bench_seed : 42;
+
+    /* Database load (all but the last one are closed right away). */
+    total = 0;
+    for (int i = 0; i < bench_loads || !ndb; i++)
+    {
+        ndt_navdatabase_close(&ndb);
+        start  = bench_now();
+        ndb    = ndt_navdatabase_init2(dir, NDT_NAVDFMT_XPGNS, ndt_date_now(), NULL);
+        total += bench_now() - start;
+        if (!ndb)
+        {
+            ret = EINVAL;
+            goto end;
+        }
+    }
+    bench_add("load", bench_loads > 0 ? bench_loads : 1, 0, total);
+
+    if (!(ids = calloc(count,  sizeof(*ids))) ||
+        !(pos = calloc(count,  sizeof(*pos))) ||
+        !(rte = calloc(routes, sizeof(*rte))) ||
+        !(flp = calloc(routes, sizeof(*flp))) ||
+        !(out = ndt_list_init())              || !(sink = ndt_sink_init(NULL)))
+    {
+        ret = ENOMEM;
+        goto end;
+    }
+
+    /* Identifier lookups. */
+    struct
+    {
+        const char *name;
+        ndt_list   *list;
+        int         type;
+    }
+    lookups[] =
+    {
+        { "lookup_airport",  ndb->airports,  0, },
+        { "lookup_waypoint", ndb->waypoints, 1, },
+        { "lookup_airway",   ndb->airways,   2, },
+    };
+    for (size_t l = 0; l < sizeof(lookups) / sizeof(lookups[0]); l++)
+    {
+        size_t n = ndt_list_count(lookups[l].list);
+        for (size_t i = 0; i < count && n; i++)
+        {
+            ndt_info *info = ndt_list_item(lookups[l].list, rng_index(n)); // info is the first member
+            snprintf(ids[i], sizeof(ids[i]), "%s", info->idnt);
+        }
+        failed = 0;
+        start  = bench_now();
+        for (size_t i = 0; i < count && n; i++)
+        {
+            switch (lookups[l].type)
+            {
+                case 0:
+                    failed += !ndt_navdata_get_airport(ndb, ids[i]);
+                    break;
+                case 1:
+                    failed += !ndt_navdata_get_waypoint(ndb, ids[i], NULL);
+                    break;
+                default:
+                    failed += !ndt_navdata_get_airway(ndb, ids[i], NULL);
+                    break;
+            }
+        }
+        bench_add(lookups[l].name, n ? count : 0, failed, bench_now() - start);
+    }
+
+    /* Nearest queries: 10 closest waypoints (any type) within 100 nm. */
+    ndt_distance range = ndt_distance_init(100 * 1852, NDT_ALTUNIT_ME);
+    for (size_t i = 0; i < count; i++)
+    {
+        pos[i] = ndt_position_init(rng_real(-60., 70.), rng_real(-180., 180.), NDT_DISTANCE_ZERO);
+    }
+    failed = 0;
+    start  = bench_now();
+    for (size_t i = 0; i < count; i++)
+    {
+        failed += !!ndt_navdata_get_wptnearn(ndb, pos[i], 10, range, UINT64_MAX, NULL, NULL, out);
+        ndt_list_empty(out);
+    }
+    bench_add("nearest", count, failed, bench_now() - start);
+
+    /* Procedures: first use of every airport. */
+    failed = 0;
+    start  = bench_now();
+    for (size_t i = 0; i < ndt_list_count(ndb->airports); i++)
+    {
+        failed += !ndt_navdata_init_airport(ndb, ndt_list_item(ndb->airports, i));
+    }
+    bench_add("procedures", ndt_list_count(ndb->airports), failed, bench_now() - start);
+
+    /*
+     * Routes: random departure and arrival (runway 09), then one airway (from
+     * its first to last waypoint) and a direct to a random waypoint. Parsing
+     * and route_leg_update are timed separately via the library's statistics.
+     */
+    size_t napt = ndt_list_count(ndb->airports), nawy = ndt_list_count(ndb->airways);
+    size_t nwpt = ndt_list_count(ndb->waypoints);
+    if (!napt || !nawy || !nwpt)
+    {
+        fprintf(stderr, "No airports, airways or waypoints: skipping routes\n");
+        goto print;
+    }
+    for (size_t i = 0; i < routes; i++)
+    {
+        ndt_airway     *awy = ndt_list_item(ndb->airways, rng_index(nawy));
+        ndt_airway_leg *leg = awy->leg;
+        while (leg && leg->next)
+        {
+            leg = leg->next;
+        }
+        ndt_airport  *dep = ndt_list_item(ndb->airports,  rng_index(napt));
+        ndt_airport  *arr = ndt_list_item(ndb->airports,  rng_index(napt));
+        ndt_waypoint *wpt = ndt_list_item(ndb->waypoints, rng_index(nwpt));
+        snprintf(rte[i].dep, sizeof(rte[i].dep), "%s", dep->info.idnt);
+        snprintf(rte[i].arr, sizeof(rte[i].arr), "%s", arr->info.idnt);
+        snprintf(rte[i].rte, sizeof(rte[i].rte), "%s %s %s %s", awy->leg ? awy->leg->in.info.idnt : "",
+                 awy->info.idnt, leg ? leg->out.info.idnt : "", wpt->info.idnt);
+    }
+    ndt_stats_enable(1);
+    ndt_stats_get(NDT_STAT_ROUTE, NULL,    &ns0);
+    ndt_stats_get(NDT_STAT_LEGS,  &calls0, &ns1);
+    failed = 0;
+    start  = bench_now();
+    for (size_t i = 0; i < routes; i++)
+    {
+        if (!(flp[i] = ndt_flightplan_init(ndb)) ||
+            ndt_flightplan_set_departure(flp[i], rte[i].dep, "09") ||
+            ndt_flightplan_set_arrival  (flp[i], rte[i].arr, "09") ||
+            ndt_flightplan_set_route    (flp[i], rte[i].rte, NDT_FLTPFMT_ICAOR))
+        {
+            ndt_flightplan_close(&flp[i]);
+            failed++;
+        }
+    }
+    total = bench_now() - start;
+    bench_add("route_total", routes, failed, total);
+    {
+        uint64_t ns2, ns3, calls2;
+        ndt_stats_get(NDT_STAT_ROUTE, NULL,    &ns2);
+        ndt_stats_get(NDT_STAT_LEGS,  &calls2, &ns3);
+        bench_add("route_parse",      routes,          failed, ns2 - ns0);
+        bench_add("route_leg_update", calls2 - calls0,      0, ns3 - ns1);
+    }
+    ndt_stats_enable(0);
+
+    /* Writers: every flight plan, once per format, into memory. */
+    for (size_t w = 0; w < BENCH_NWRITERS; w++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "write_%s", bench_writers[w].name);
+        calls1 = failed = 0;
+        start  = bench_now();
+        for (size_t i = 0; i < routes; i++)
+        {
+            if (flp[i])
+            {
+                ndt_sink_reset(sink);
+                failed += !!ndt_flightplan_write2(flp[i], sink, bench_writers[w].format);
+                calls1++;
+            }
+        }
+        bench_add(name, calls1, failed, bench_now() - start);
+    }
+
+print:
+    if ((ret = bench_scoped(dir, ndb)))
+    {
+        goto end;
+    }
+    if ((ret = print_results(file, ndb->info.desc)) == 0 && checks_failed)
+    {
+        fprintf(stderr, "%zu check(s) failed\n", checks_failed);
+        ret = EDOM;
+    }
+
+end:
+    for (size_t i = 0; flp && i < routes; i++)
+    {
+        ndt_flightplan_close(&flp[i]);
+    }
+    ndt_navdatabase_close(&ndb);
+    ndt_sink_close(&sink);
+    ndt_list_close(&out);
+    free(ids);
+    free(pos);
+    free(rte);
+    free(flp);
+    return ret;
+}
+
+/*
+ * Reference values for ndt_position_sprintllc: three positions (whole degrees,
+ * whole minutes, and arc seconds), every format.
+ */
+static const double micro_llcpos[3][2] =
+{
+    { +46.,                           +50.,                       }, // N46°00'00" E050°00'00"
+    { -33.5,                          -70.25,                     }, // S33°30'00" W070°15'00"
+    { +51. + 28. / 60. + 40. / 3600., -27. / 60. - 41. / 3600.,   }, // N51°28'40" W000°27'41"
+};
+
+static const struct
+{
+    const char *name;
+    ndt_llcfmt  format;
+    const char *reference[3];
+}
+micro_llcfmts[] =
+{
+    { "sprintllc_deflt", NDT_LLCFMT_DEFLT, { "N46E050",                "S34W070",                "N51W000",                }, },
+    { "sprintllc_defs5", NDT_LLCFMT_DEFS5, { "4650E",                  "3470W",                  "5100N",                  }, },
+    { "sprintllc_aibus", NDT_LLCFMT_AIBUS, { "4600.0N/05000.0E",       "3330.0S/07015.0W",       "5128.7N/00027.7W",       }, },
+    { "sprintllc_aibx2", NDT_LLCFMT_AIBX2, { "46 00.0N/050 00.0E",     "33 30.0S/070 15.0W",     "51 28.7N/000 27.7W",     }, },
+    { "sprintllc_boing", NDT_LLCFMT_BOING, { "N46E050",                "S3330.0W07015.0",        "N5128.7W00027.7",        }, },
+    { "sprintllc_ceeva", NDT_LLCFMT_CEEVA, { "N 46°00.0' E 050°00.0'", "S 33°30.0' W 070°15.0'", "N 51°28.7' W 000°27.7'", }, },
+    { "sprintllc_icaor", NDT_LLCFMT_ICAOR, { "46N050E",                "3330S07015W",            "5129N00028W",            }, },
+    { "sprintllc_recap", NDT_LLCFMT_RECAP, { "N46°00.0'  E050°00.0'",  "S33°30.0'  W070°15.0'",  "N51°28.7'  W000°27.7'",  }, },
+    { "sprintllc_sbrif", NDT_LLCFMT_SBRIF, { "4650E",                  "3330S 07015W",           "5129N 00028W",           }, },
+    { "sprintllc_svect", NDT_LLCFMT_SVECT, { "4650E",                  "3330S07015W",            "512840N0002741W",        }, },
+};
+#define MICRO_NLLCFMTS (sizeof(micro_llcfmts) / sizeof(micro_llcfmts[0]))
+
+static volatile double micro_sink; // keeps the results (and the calls) alive
+
+static double micro_nm(ndt_distance distance)
+{
+    return (double)ndt_distance_get(distance, NDT_ALTUNIT_NA) / 18520000.;
+}
+
+static ndt_position micro_pos(double lat, double lon)
+{
+    return ndt_position_init(lat, lon, NDT_DISTANCE_ZERO);
+}
+
+/*
+ * Accuracy: Ed Williams' Aviation Formulary examples (edwilliams.org/avform.htm,
+ * the same formulas, so the spherical Earth model matches), exact distances on
+ * a meridian and the equator, consistency on the benchmarks' random inputs and
+ * round trips for the World Magnetic Model (there's no fixed reference for the
+ * latter, since it depends on the date).
+ */
+static void micro_check(void *wmm, micro_input *in, size_t count)
+{
+    ndt_position lax = micro_pos(33. + 57. / 60., -118. - 24. / 60.);
+    ndt_position jfk = micro_pos(40. + 38. / 60.,  -73. - 47. / 60.);
+    ndt_position pos, tmp;
+    double       max;
+    int          ret;
+
+    bench_check_add("calcdistance_laxjfk",   micro_nm(ndt_position_calcdistance(lax, jfk)),
+                    0.623585 * 180. / M_PI * 60., .005);
+    bench_check_add("calcdistance_meridian", micro_nm(ndt_position_calcdistance(micro_pos(0., 0.), micro_pos(1.,  0.))),
+                    60., .001);
+    bench_check_add("calcdistance_equator",  micro_nm(ndt_position_calcdistance(micro_pos(0., 0.), micro_pos(0., 90.))),
+                    5400., .001);
+    bench_check_add("calcbearing_laxjfk",    ndt_position_calcbearing(lax, jfk), 1.150035 * 180. / M_PI, .0001);
+    bench_check_add("calcbearing_north",     ndt_position_calcbearing(micro_pos(0., 0.), micro_pos(1., 0.)), 360., 1e-9);
+    bench_check_add("calcbearing_east",      ndt_position_calcbearing(micro_pos(0., 0.), micro_pos(0., 1.)),  90., 1e-9);
+
+    /* LAX, radial 066, 100 nm: N34°37' W116°33' (published to the minute). */
+    pos = ndt_position_calcpos4pbd(lax, 66., ndt_distance_init(100, NDT_ALTUNIT_NM));
+    bench_check_add("calcpos4pbd_lat", ndt_position_getlatitude (pos, NDT_ANGUNIT_DEG),   34. + 37. / 60., 1. / 120.);
+    bench_check_add("calcpos4pbd_lon", ndt_position_getlongitude(pos, NDT_ANGUNIT_DEG), -116. - 33. / 60., 1. / 120.);
+
+    /* REO course 051, BKE course 137: N43.572 W116.189. */
+    ret = ndt_position_calcpos4pbpb(&pos, micro_pos(42.600, -117.866), 51., micro_pos(44.840, -117.806), 137.);
+    bench_check_add("calcpos4pbpb_ret", ret, 0., 0.);
+    bench_check_add("calcpos4pbpb_lat", ndt_position_getlatitude (pos, NDT_ANGUNIT_DEG),   43.572, .001);
+    bench_check_add("calcpos4pbpb_lon", ndt_position_getlongitude(pos, NDT_ANGUNIT_DEG), -116.189, .001);
+
+    /* N10 E005 course 180, N00 E000 course 090: exactly N00 E005 (meridian meets equator). */
+    ret = ndt_position_calcpos4pbpb(&pos, micro_pos(10., 5.), 180., micro_pos(0., 0.), 90.);
+    bench_check_add("calcpos4pbpb_exact_ret", ret, 0., 0.);
+    bench_check_add("calcpos4pbpb_exact_lat", ndt_position_getlatitude (pos, NDT_ANGUNIT_DEG), 0., 1e-6);
+    bench_check_add("calcpos4pbpb_exact_lon", ndt_position_getlongitude(pos, NDT_ANGUNIT_DEG), 5., 1e-6);
+
+    /* LAX course 066, 30 nm from a point abeam; pbpd tolerates 660 feet. */
+    tmp = micro_pos(35.2, -115.3);
+    ret = ndt_position_calcpos4pbpd(&pos, lax, 66., tmp, ndt_distance_init(30, NDT_ALTUNIT_NM));
+    bench_check_add("calcpos4pbpd_ret",  ret, 0., 0.);
+    bench_check_add("calcpos4pbpd_brg",  ndt_position_calcbearing(lax, pos), 66., .01);
+    bench_check_add("calcpos4pbpd_dist", micro_nm(ndt_position_calcdistance(tmp, pos)), 30., 660. / 6076.12);
+
+    /* Random inputs: the intersections must be (close to) pos3. */
+    max = 0.;
+    for (size_t i = 0; i < count && i < 1000; i++)
+    {
+        if (!ndt_position_calcpos4pbpb(&pos, in[i].pos1, in[i].brg1, in[i].pos2, in[i].brg2))
+        {
+            max = fmax(max, micro_nm(ndt_position_calcdistance(pos, in[i].pos3)));
+        }
+        if (!ndt_position_calcpos4pbpd(&pos, in[i].pos1, in[i].brg1, in[i].pos2, in[i].dist))
+        {
+            max = fmax(max, fabs(micro_nm(ndt_position_calcdistance(pos, in[i].pos2)) - micro_nm(in[i].dist)));
+        }
+    }
+    bench_check_add("intersections_random", max, 0., 660. / 6076.12);
+
+    if (wmm)
+    {
+        /* True -> magnetic -> true, every degree; magnitude of the variation. */
+        ndt_position wmmpos[] = { lax, jfk, micro_pos(49.0097, 2.5478), micro_pos(-33.9461, 151.1772), micro_pos(35.5523, 139.7800), };
+        double       var = 0.;
+        max = 0.;
+        for (size_t p = 0; p < sizeof(wmmpos) / sizeof(wmmpos[0]); p++)
+        {
+            for (int b = 1; b <= 360; b++)
+            {
+                double mag = ndt_wmm_getbearing_mag(wmm, b, wmmpos[p]);
+                double tru = ndt_wmm_getbearing_tru(wmm, mag, wmmpos[p]);
+                max = fmax(max, fabs(ndt_position_bearing_angle(b, tru)));
+                var = fmax(var, fabs(ndt_position_bearing_angle(b, mag)));
+            }
+        }
+        bench_check_add("wmm_roundtrip", max, 0., 1e-6);
+        bench_check_add("wmm_variation", var, 0., 20.); // mid-latitude airports
+    }
+
+    for (size_t f = 0; f < MICRO_NLLCFMTS; f++)
+    {
+        char buf[32];
+        int  bad = 0;
+        for (size_t p = 0; p < 3; p++)
+        {
+            pos = micro_pos(micro_llcpos[p][0], micro_llcpos[p][1]);
+            if (ndt_position_sprintllc(pos, micro_llcfmts[f].format, buf, sizeof(buf)) < 0 ||
+                strcmp(buf, micro_llcfmts[f].reference[p]))
+            {
+                fprintf(stderr, "%s: '%s' (reference: '%s')\n", micro_llcfmts[f].name, buf, micro_llcfmts[f].reference[p]);
+                bad++;
+            }
+        }
+        bench_check_add(micro_llcfmts[f].name, bad, 0., 0.);
+    }
+}
+
+/*
+ * Scoped loading (not timed, beyond the load itself): routes along airways
+ * across the edge of the scope must compile, i.e. every fix of a kept airway
+ * must be loaded too. Two passes: everything west of the middle of the first
+ * airway's first leg (bounding box), then a single region (plus that of the
+ * departure airport). Routes are the leg of each airway that crosses the
+ * edge, from its in-scope fix to the other one.
+ */
+static int bench_scoped(const char *dir, ndt_navdatabase *ndb)
+{
+    ndt_navdatabase *sdb = NULL;
+    ndt_airport     *apt = NULL;
+    ndt_airway_leg *first;
+    char         regions[16];
+    char            name[32];
+    double          edge;
+    int              ret = 0;
+
+    if (!ndt_list_count(ndb->airways) ||
+        !(first = ((ndt_airway*)ndt_list_item(ndb->airways, 0))->leg))
+    {
+        fprintf(stderr, "No airways: skipping scoped loading\n");
+        return 0;
+    }
+    edge = (ndt_position_getlongitude(ndt_position_unpack(first->in. position, NDT_DISTANCE_ZERO), NDT_ANGUNIT_DEG) +
+            ndt_position_getlongitude(ndt_position_unpack(first->out.position, NDT_DISTANCE_ZERO), NDT_ANGUNIT_DEG)) / 2.;
+    for (size_t i = 0; i < ndt_list_count(ndb->airports) && !apt; i++)
+    {
+        ndt_airport *next = ndt_list_item(ndb->airports, i);
+        if (ndt_position_getlongitude(next->coordinates, NDT_ANGUNIT_DEG) <= edge)
+        {
+            apt = next;
+        }
+    }
+    if (!apt)
+    {
+        fprintf(stderr, "No airport west of %.1lf: skipping scoped loading\n", edge);
+        return 0;
+    }
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        ndt_navdatascope scope = { 0, };
+        ndt_waypoint    *wpt;
+        uint64_t       routes = 0, failed = 0;
+        int64_t         start;
+
+        if (pass == 0)
+        {
+            scope.bbox   = 1;
+            scope.latmin =  -90.;
+            scope.latmax =  +90.;
+            scope.lonmin = -180.;
+            scope.lonmax = edge;
+        }
+        else
+        {
+            wpt = ndt_navdata_get_wpt4pos(ndb, first->in.info.idnt, NULL, ndt_position_unpack(first->in.position, NDT_DISTANCE_ZERO));
+            if (!wpt || !*wpt->region)
+            {
+                break;
+            }
+            snprintf(regions, sizeof(regions), "%.2s,%.2s", wpt->region, apt->info.idnt);
+            scope.regions = regions;
+        }
+
+        start = bench_now();
+        sdb   = ndt_navdatabase_init2(dir, NDT_NAVDFMT_XPGNS, ndt_date_now(), &scope);
+        snprintf(name, sizeof(name), "scoped_load_%s", pass ? "regions" : "bbox");
+        bench_add(name, 1, !sdb, bench_now() - start);
+        if (!sdb)
+        {
+            ret = EINVAL;
+            goto end;
+        }
+
+        for (size_t i = 0; i < ndt_list_count(ndb->airways) && routes < bench_routes; i++)
+        {
+            ndt_airway *awy = ndt_list_item(ndb->airways, i);
+            for (ndt_airway_leg *leg = awy->leg; leg; leg = leg->next)
+            {
+                ndt_position pin  = ndt_position_unpack(leg->in. position, NDT_DISTANCE_ZERO);
+                ndt_position pout = ndt_position_unpack(leg->out.position, NDT_DISTANCE_ZERO);
+                int          cross;
+                if (pass == 0)
+                {
+                    cross = (ndt_position_getlongitude(pin,  NDT_ANGUNIT_DEG) <= edge &&
+                             ndt_position_getlongitude(pout, NDT_ANGUNIT_DEG) >  edge);
+                }
+                else
+                {
+                    ndt_waypoint *win  = ndt_navdata_get_wpt4pos(ndb, leg->in. info.idnt, NULL, pin);
+                    ndt_waypoint *wout = ndt_navdata_get_wpt4pos(ndb, leg->out.info.idnt, NULL, pout);
+                    cross = (win && wout && !strncmp(win->region, regions, 2) && strncmp(wout->region, regions, 2));
+                }
+                if (cross)
+                {
+                    ndt_flightplan *flp = ndt_flightplan_init(sdb);
+                    char            rte[128];
+                    snprintf(rte, sizeof(rte), "%s %s %s", leg->in.info.idnt, awy->info.idnt, leg->out.info.idnt);
+                    if (!flp ||
+                        ndt_flightplan_set_departure(flp, apt->info.idnt, NULL) ||
+                        ndt_flightplan_set_arrival  (flp, apt->info.idnt, NULL) ||
+                        ndt_flightplan_set_route    (flp, rte, NDT_FLTPFMT_ICAOR))
+                    {
+                        fprintf(stderr, "Scoped route failed (%s): %s\n", pass ? regions : "bbox", rte);
+                        failed++;
+                    }
+                    ndt_flightplan_close(&flp);
+                    routes++;
+                    break;
+                }
+            }
+        }
+        snprintf(name, sizeof(name), "scoped_routes_%s", pass ? "regions" : "bbox");
+        bench_check_add(name, failed, 0., 0.);
+        snprintf(name, sizeof(name), "scoped_edges_%s", pass ? "regions" : "bbox");
+        bench_check_add(name, !!routes, 1., 0.); // at least one airway crossing the edge
+        ndt_navdatabase_close(&sdb);
+    }
+
+end:
+    ndt_navdatabase_close(&sdb);
+    return ret;
+}
+
+/*
+ * Microbenchmarks: the geodesy and magnetic variation primitives under every
+ * leg computation. Inputs are random positions a few hundred nautical miles
+ * apart at most (like route legs), prepared beforehand; --queries operations
+ * each, except calcpos4pbpd (a brute-force search: 1/100th of that).
+ */
+static int micro_run(FILE *file)
+{
+    micro_input *in = NULL;
+    void       *wmm = NULL;
+    size_t     count = bench_queries > 0 ? bench_queries : 1;
+    size_t     slow  = count / 100 > 0 ? count / 100 : 1;
+    uint64_t  failed;
+    int64_t    start;
+    double       acc = 0.;
+    int          ret = 0;
+
+    rng_state = bench_seed ? bench_seed : 42;
+
+    if (!(in = calloc(count, sizeof(*in))))
+    {
+        ret = ENOMEM;
+        goto end;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        ndt_distance d13 = ndt_distance_init(rng_real(20., 300.) * 1852., NDT_ALTUNIT_ME);
+        ndt_distance d23 = ndt_distance_init(rng_real(10., 100.) * 1852., NDT_ALTUNIT_ME);
+        in[i].pos1 = micro_pos(rng_real(-60., 70.), rng_real(-180., 180.));
+        in[i].pos3 = ndt_position_calcpos4pbd(in[i].pos1, rng_real(0., 360.), d13);
+        in[i].pos2 = ndt_position_calcpos4pbd(in[i].pos3, rng_real(0., 360.), d23);
+        in[i].brg1 = ndt_position_calcbearing (in[i].pos1, in[i].pos3);
+        in[i].brg2 = ndt_position_calcbearing (in[i].pos2, in[i].pos3);
+        in[i].dist = ndt_position_calcdistance(in[i].pos2, in[i].pos3);
+    }
+    if (!(wmm = ndt_wmm_init(ndt_date_now())))
+    {
+        fprintf(stderr, "ndt_wmm_init failed: skipping magnetic variation\n");
+    }
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++)
+    {
+        acc += ndt_position_calcdistance(in[i].pos1, in[i].pos2).value;
+    }
+    bench_add("calcdistance", count, 0, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++)
+    {
+        acc += ndt_position_calcbearing(in[i].pos1, in[i].pos2);
+    }
+    bench_add("calcbearing", count, 0, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++)
+    {
+        acc += ndt_position_calcpos4pbd(in[i].pos1, in[i].brg1, in[i].dist).latitude.value;
+    }
+    bench_add("calcpos4pbd", count, 0, bench_now() - start);
+
+    failed = 0;
+    start  = bench_now();
+    for (size_t i = 0; i < count; i++)
+    {
+        ndt_position pos = in[i].pos3;
+        failed += !!ndt_position_calcpos4pbpb(&pos, in[i].pos1, in[i].brg1, in[i].pos2, in[i].brg2);
+        acc    += pos.latitude.value;
+    }
+    bench_add("calcpos4pbpb", count, failed, bench_now() - start);
+
+    failed = 0;
+    start  = bench_now();
+    for (size_t i = 0; i < slow; i++)
+    {
+        ndt_position pos = in[i].pos3;
+        failed += !!ndt_position_calcpos4pbpd(&pos, in[i].pos1, in[i].brg1, in[i].pos2, in[i].dist);
+        acc    += pos.latitude.value;
+    }
+    bench_add("calcpos4pbpd", slow, failed, bench_now() - start);
+
+    if (wmm)
+    {
+        start = bench_now();
+        for (size_t i = 0; i < count; i++)
+        {
+            acc += ndt_wmm_getbearing_mag(wmm, in[i].brg1, in[i].pos1);
+        }
+        bench_add("wmm_getbearing_mag", count, 0, bench_now() - start);
+
+        start = bench_now();
+        for (size_t i = 0; i < count; i++)
+        {
+            acc += ndt_wmm_getbearing_tru(wmm, in[i].brg1, in[i].pos1);
+        }
+        bench_add("wmm_getbearing_tru", count, 0, bench_now() - start);
+    }
+
+    for (size_t f = 0; f < MICRO_NLLCFMTS; f++)
+    {
+        char buf[32];
+        failed = 0;
+        start  = bench_now();
+        for (size_t i = 0; i < count; i++)
+        {
+            int len  = ndt_position_sprintllc(in[i].pos1, micro_llcfmts[f].format, buf, sizeof(buf));
+            failed  += len < 0;
+            acc     += len;
+        }
+        bench_add(micro_llcfmts[f].name, count, failed, bench_now() - start);
+    }
+    micro_sink = acc;
+
+    micro_check(wmm, in, count);
+    if ((ret = print_results(file, NULL)) == 0 && checks_failed)
+    {
+        fprintf(stderr, "%zu check(s) failed\n", checks_failed);
+        ret = EDOM;
+    }
+
+end:
+    ndt_wmm_close(&wmm);
+    free(in);
+    return ret;
+}
+
+static void print_string(FILE *out, const char *str)
+{
+    fputc('"', out);
+    for (; str && *str; str++)
+    {
+        if (*str == '"' || *str == '\\')
+        {
+            fputc('\\', out);
+        }
+        if ((unsigned char)*str >= 0x20)
+        {
+            fputc(*str, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/*
+ * Machine-readable results (JSON): configuration, then one object per
+ * benchmark with its operation count, failures and timings, then one per
+ * accuracy check.
+ */
+static int print_results(FILE *out, const char *navdata)
+{
+    if (!out)
+    {
+        return 0;
+    }
+    fprintf(out, "{\n  \"version\": ");
+    print_string(out, NDT_VERSION);
+    fprintf(out, ",\n  \"navdata\": ");
+    print_string(out, navdata);
+    fprintf(out, ",\n  \"source\": ");
+    print_string(out, bench_micro ? "micro" : path_navdat ? path_navdat : "generated");
+    fprintf(out, ",\n  \"config\": { \"airports\": %d, \"waypoints\": %d, \"navaids\": %d, "
+                 "\"airways\": %d, \"procs\": %d, \"queries\": %d, \"routes\": %d, \"loads\": %d, "
+                 "\"seed\": %"PRIu64" },\n", gen_airports, gen_waypoints, gen_navaids,
+            gen_airways, gen_procs, bench_queries, bench_routes, bench_loads, bench_seed);
+    fprintf(out, "  \"peak_rss\": %zu,\n  \"results\": [\n", ndt_stats_peakrss());
+    for (size_t i = 0; i < results_count; i++)
+    {
+        bench_result *res = &results[i];
+        fprintf(out, "    { \"name\": \"%s\", \"ops\": %"PRIu64", \"failed\": %"PRIu64", "
+                     "\"total_ns\": %"PRId64", \"ns_per_op\": %.1lf }%s\n", res->name,
+                res->ops, res->failed, res->ns, res->ops ? (double)res->ns / res->ops : 0.,
+                i + 1 < results_count ? "," : "");
+    }
+    fprintf(out, "  ],\n  \"checks\": [\n");
+    for (size_t i = 0; i < checks_count; i++)
+    {
+        bench_check *chk = &checks[i];
+        fprintf(out, "    { \"name\": \"%s\", \"value\": %.9lf, \"reference\": %.9lf, "
+                     "\"tolerance\": %.9lf, \"pass\": %s }%s\n", chk->name, chk->value,
+                chk->reference, chk->tolerance, fabs(chk->value - chk->reference) <= chk->tolerance ?
+                "true" : "false", i + 1 < checks_count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    return ferror(out) ? EIO : 0;
+}
+
+static int parse_options(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt_long_only(argc, argv, "", navdbench_opts, NULL)) >= 0)
+    {
+        switch (opt)
+        {
+            case 0: // long option flag set
+                break;
+
+            case OPT_HELP:
+                print_help();
+                return -1;
+
+            case OPT_DTBS:
+                free(path_navdat);
+                path_navdat = strdup(optarg);
+                break;
+
+            case OPT_GDIR:
+                free(path_gendir);
+                path_gendir = strdup(optarg);
+                break;
+
+            case OPT_OTPT:
+                free(path_out);
+                path_out = strdup(optarg);
+                break;
+
+            case OPT_NAPT:
+                gen_airports = atoi(optarg);
+                break;
+
+            case OPT_NWPT:
+                gen_waypoints = atoi(optarg);
+                break;
+
+            case OPT_NNAV:
+                gen_navaids = atoi(optarg);
+                break;
+
+            case OPT_NAWY:
+                gen_airways = atoi(optarg);
+                break;
+
+            case OPT_NPRC:
+                gen_procs = atoi(optarg);
+                break;
+
+            case OPT_NQRY:
+                bench_queries = atoi(optarg);
+                break;
+
+            case OPT_NRTE:
+                bench_routes = atoi(optarg);
+                break;
+
+            case OPT_NLDS:
+                bench_loads = atoi(optarg);
+                break;
+
+            case OPT_SEED:
+                bench_seed = strtoull(optarg, NULL, 10);
+                break;
+
+            default:
+                return EINVAL;
+        }
+    }
+    if (optind < argc)
+    {
+        fprintf(stderr, "Unexpected argument: '%s'\n", argv[optind]);
+        return EINVAL;
+    }
+    if (gen_airports < 1 || gen_waypoints < 2 || gen_navaids < 0 ||
+        gen_airways  < 0 || gen_procs     < 0 || gen_airports > 26 * 26 * 26 * 26)
+    {
+        fprintf(stderr, "Bad navdata size\n");
+        return EINVAL;
+    }
+    return 0;
+}
+
+static int print_help(void)
+{
+    fprintf(stderr,
+            "%s version %s, Copyright (c) 2014-2016 Timothy D. Walker           \n"
+            "                                                                   \n"
+            "Syntax: %s [options]                                               \n"
+            "                                                                   \n"
+            "Generates synthetic X-Plane 10 GNS navdata, then times: loading it,\n"
+            "identifier lookups, nearest queries, procedures, route parsing and \n"
+            "route_leg_update, and every flight plan writer. A summary is shown \n"
+            "on stderr, results (JSON) are written to stdout (or -o).           \n"
+            "                                                                   \n"
+            "With --micro, times the geodesy, magnetic variation and coordinate \n"
+            "formatting primitives instead (no navdata), and checks accuracy vs.\n"
+            "reference values: any failed check is an error.                    \n"
+            "                                                                   \n"
+            "### Navigation data     -------------------------------------------\n"
+            "  --db         <string> Use existing navdata instead (root folder).\n"
+            "  --dir        <string> Generate navdata in this (new) directory;  \n"
+            "                        default: a temporary directory.            \n"
+            "  --keep                Don't remove generated navdata afterwards. \n"
+            "  --airports   <number> Airports (default: 2000).                  \n"
+            "  --waypoints  <number> Waypoints (default: 50000).                \n"
+            "  --navaids    <number> Navaids (default: 5000).                   \n"
+            "  --airways    <number> Airways, 10 legs each (default: 1000).     \n"
+            "  --procs      <number> SIDs and STARs per airport (default: 2).   \n"
+            "                                                                   \n"
+            "### Workload            -------------------------------------------\n"
+            "  --queries    <number> Lookups, nearest queries (default: 100000).\n"
+            "  --routes     <number> Flight plans built, written (default: 500).\n"
+            "  --loads      <number> Database loads (default: 3).               \n"
+            "  --seed       <number> Random seed (default: 42).                 \n"
+            "  --micro               Microbenchmarks: --queries operations each.\n"
+            "  -o           <string> Write results to this file.                \n",
+            NDBENCH_EXE, NDT_VERSION, NDBENCH_EXE);
+    return 0;
+}
@@ -22,18 +22,31 @@
 #include <errno.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <pthread.h>
+#include <signal.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#else
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 #include "common/common.h"
+#include "common/stats.h"
 #include "compat/compat.h"
 #include "lib/flightplan.h"
 #include "lib/fmt_icaor.h"
 #include "lib/navdata.h"
+#include "wmm/wmm.h"
 
 // executable name and version
 #ifndef NDCONV_EXE
@@ -66,20 +79,52 @@
 #define OPT_ANFO 276
 #define OPT_QPAC 277
 #define OPT_MTRC 278
+#define OPT_NEAR 279
+#define OPT_NTYP 280
+#define OPT_NCNT 281
+#define OPT_NRNG 282
+#define OPT_NRWY 283
+#define OPT_NFRQ 284
+#define OPT_SBOX 285
+#define OPT_SREG 286
+#define OPT_BTCH 287
+#define OPT_THRD 288
+#define OPT_VALD 289
+#define OPT_SERV 290
+#define OPT_USRW 291
 
 // navigation data
 static char *info_aptidt = NULL;
 static char *path_navdat = NULL;
 static char *path_xplane = NULL;
 static char *qpac_aptids = NULL;
+static int check_procs = 0;
+static int print_usage = 0;
 static int rwu = NDT_ALTUNIT_FT;
+static ndt_navdatascope navdata_scope = { 0 };
+
+// nearby airports, navaids
+static char *near_place  = NULL;
+static uint64_t near_tps = NDT_SPATIAL_TYPE(NDT_WPTYPE_APT)|NDT_SPATIAL_TYPE(NDT_WPTYPE_XPA);
+static int near_count    =   10;
+static double near_range =   0.;
+static int near_rwylen   =    0;
+static double near_freq  =   0.;
+static int near_tunable  =    0;
 
 // file input/output
 static char *path_in     = NULL;
 static int format_in     =   -1;
 static char *path_out    = NULL;
 static int format_out    =   -1;
+static struct
+{
+    int   format;
+    char *path;                 // NULL: -o (or stdout)
+} outputs[16];
+static int outputs_count =    0;
 static int fprintairac   =    0;
+static int print_stats   =    0;
 
 // departure, arrival, route
 static char *dep_apt     = NULL;
@@ -93,6 +138,22 @@ static char *star_trans  = NULL;
 static char *appr_trans  = NULL;
 static char *final_appr  = NULL;
 static char *icao_route  = NULL;
+static int route_check   =    0;
+static struct
+{
+    char  *idnt;
+    double lat, lon;
+} user_wpts[16];
+static int user_wpts_count = 0;
+
+// batch route compilation
+static char *path_batch  = NULL;
+static int batch_threads =    0;
+static int batch_outdir  =    0;
+
+// server mode
+static char *path_serve  = NULL;
+static int pipe_mode     =    0;
 
 static struct option navdconv_opts[] =
 {
@@ -109,6 +170,19 @@ static struct option navdconv_opts[] =
     { "xplane",        required_argument, NULL, OPT_XPLN, },
     { "info",          required_argument, NULL, OPT_ANFO, },
     { "qpac",          required_argument, NULL, OPT_QPAC, },
+    { "check-procs",   no_argument,      &check_procs, 1, },
+    { "memory",        no_argument,      &print_usage, 1, },
+    { "scope",         required_argument, NULL, OPT_SBOX, },
+    { "regions",       required_argument, NULL, OPT_SREG, },
+
+    // nearby airports, navaids
+    { "near",          required_argument, NULL, OPT_NEAR, },
+    { "near-type",     required_argument, NULL, OPT_NTYP, },
+    { "near-count",    required_argument, NULL, OPT_NCNT, },
+    { "near-range",    required_argument, NULL, OPT_NRNG, },
+    { "near-rwy",      required_argument, NULL, OPT_NRWY, },
+    { "near-freq",     required_argument, NULL, OPT_NFRQ, },
+    { "near-tunable",  no_argument,     &near_tunable, 1, },
 
     // file input/output
     { "i",             required_argument, NULL, OPT_INPT, },
@@ -116,6 +190,7 @@ static struct option navdconv_opts[] =
     { "o",             required_argument, NULL, OPT_OTPT, },
     { "ofmt",          required_argument, NULL, OPT_OFMT, },
     { "airac",         no_argument,      &fprintairac, 1, },
+    { "stats",         no_argument,      &print_stats, 1, },
 
     // departure, arrival, route
     { "dep",           required_argument, NULL, OPT_DAPT, },
@@ -131,20 +206,38 @@ static struct option navdconv_opts[] =
     { "apptr",         required_argument, NULL, OPT_ATRS, },
     { "final",         required_argument, NULL, OPT_AFIN, },
     { "rte",           required_argument, NULL, OPT_IRTE, },
+    { "user-wpt",      required_argument, NULL, OPT_USRW, },
+    { "validate",      no_argument,       NULL, OPT_VALD, },
+
+    // batch route compilation
+    { "batch",         required_argument, NULL, OPT_BTCH, },
+    { "threads",       required_argument, NULL, OPT_THRD, },
+
+    // server mode
+    { "serve",         required_argument, NULL, OPT_SERV, },
+    { "pipe",          no_argument,        &pipe_mode, 1, },
 
     // that's all folks!
     { NULL,            0,                 NULL,        0, },
 };
 
+static ndt_navdatabase* navdata_init(void);
 static int sidstar_task    (void);
+static int procs_task      (void);
+static int nearest_task    (void);
 static int execute_task    (void);
+static int batch_task      (void);
+static int serve_task      (void);
+static int pipe_task       (void);
 static int parse_options   (int argc, char **argv);
 static int validate_options(void);
 static int print_airportnfo(void);
+static int print_memusage  (void);
 static int print_airac     (ndt_navdatabase  *ndb, FILE *stream);
 static int print_help      (void);
 static int print_examples  (void);
 static int print_version   (void);
+static void string_split4  (char *arg, const char *delim, char **fields[6]);
 
 int main(int argc, char **argv)
 {
@@ -165,6 +258,10 @@ int main(int argc, char **argv)
     {
         goto end;
     }
+    if (print_stats)
+    {
+        ndt_stats_enable(1);
+    }
 
     if (info_aptidt)
     {
@@ -176,9 +273,49 @@ int main(int argc, char **argv)
         ret = sidstar_task();
         goto end;
     }
+    if (check_procs)
+    {
+        ret = procs_task();
+        goto end;
+    }
+    if (print_usage)
+    {
+        ret = print_memusage();
+        goto end;
+    }
+    if (path_serve)
+    {
+        ret = serve_task();
+        goto end;
+    }
+    if (pipe_mode)
+    {
+        ret = pipe_task();
+        goto end;
+    }
+    if (near_place)
+    {
+        ret = nearest_task();
+        goto end;
+    }
+    if (path_batch)
+    {
+        ret = batch_task();
+        goto end;
+    }
     ret = execute_task();
 
 end:
+    if (print_stats)
+    {
+        ndt_sink *sink = ndt_sink_init(stderr);
+        if (sink)
+        {
+            ndt_stats_print(sink);
+            ndt_sink_flush (sink);
+            ndt_sink_close(&sink);
+        }
+    }
     if (ret)
     {
         fprintf(stderr, "Error: %s\n", strerror(ret));
@@ -186,9 +323,14 @@ end:
     return ret;
 }
 
+static ndt_navdatabase* navdata_init(void)
+{
+    return ndt_navdatabase_init2(path_navdat, NDT_NAVDFMT_XPGNS, ndt_date_now(), &navdata_scope);
+}
+
 static int print_airportnfo(void)
 {
-    ndt_navdatabase *navdata = ndt_navdatabase_init(path_navdat, NDT_NAVDFMT_XPGNS, ndt_date_now());
+    ndt_navdatabase *navdata = navdata_init();
     if (!navdata)
     {
         return EINVAL;
@@ -196,9 +338,94 @@ static int print_airportnfo(void)
     return print_airac(navdata, stdout) || ndt_fmt_icaor_print_airportnfo(navdata, info_aptidt, rwu);
 }
 
-static int sidstar_procedure(ndt_navdatabase *ndb, int type,
-                             ndt_procedure  *proc, ndt_procedure *trans)
+static int memusage_print(ndt_navdatabase *navdata, ndt_sink *sink)
+{
+    ndt_navdata_memusage usage;
+    int                    ret;
+
+    if ((ret = ndt_navdatabase_usage(navdata, &usage)))
+    {
+        return ret;
+    }
+    struct
+    {
+        const char *name;
+        size_t     bytes;
+    }
+    lines[] =
+    {
+        { "airports",   usage.airports,   },
+        { "runways",    usage.runways,    },
+        { "procedures", usage.procedures, },
+        { "(raw data)", usage.procraw,    },
+        { "airways",    usage.airways,    },
+        { "waypoints",  usage.waypoints,  },
+        { "spatial",    usage.spatial,    },
+        { "strings",    usage.strings,    },
+        { "total",      usage.total,      },
+    };
+    ndt_sink_printf(sink, "%-12s %14s %10s\n", "Subsystem", "Bytes", "MiB");
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++)
+    {
+        ret = ndt_sink_printf(sink, "%-12s %14zu %10.2lf\n", lines[i].name, lines[i].bytes, lines[i].bytes / 1048576.);
+    }
+    return ret;
+}
+
+static int print_memusage(void)
+{
+    ndt_navdatabase *navdata = navdata_init();
+    ndt_sink           *sink = NULL;
+    int                  ret = 0;
+
+    if (!navdata)
+    {
+        return EINVAL;
+    }
+    if (fprintairac)
+    {
+        print_airac(navdata, stdout);
+    }
+    if (!(sink = ndt_sink_init(stdout)))
+    {
+        ret = ENOMEM;
+        goto end;
+    }
+    if (!(ret = memusage_print(navdata, sink)))
+    {
+        ret = ndt_sink_flush(sink);
+    }
+
+end:
+    ndt_navdatabase_close(&navdata);
+    ndt_sink_close(&sink);
+    return ret;
+}
+
+typedef struct sidstar_job
+{
+    int            type;    // 1: SID, 2: STAR, 3: approach
+    const char  *subdir;    // first airport of the pair (see below)
+    const char    *icao;
+    const char     *rwy;
+    ndt_procedure *proc;
+    ndt_procedure *trans;
+} sidstar_job;
+
+typedef struct sidstar_pool
 {
+    ndt_navdatabase *navdata;
+    sidstar_job        *jobs;
+    size_t             count;
+    size_t              next;
+    size_t            failed;
+    pthread_mutex_t    mutex;
+} sidstar_pool;
+
+static int sidstar_procedure(ndt_navdatabase *ndb, sidstar_job *job)
+{
+    ndt_procedure *proc = job->proc, *trans = job->trans;
+    int            type = job->type;
     ndt_flightplan *flp = NULL;
     FILE            *fd = NULL;
     char          *path = NULL;
@@ -225,24 +452,24 @@ static int sidstar_procedure(ndt_navdatabase *ndb, int type,
     switch (type)
     {
         case 1:
-            if ((ret = ndt_flightplan_set_departure(flp, dep_apt, dep_rwy)) ||
-                (ret = ndt_flightplan_set_arrival  (flp, dep_apt, NULL)))
+            if ((ret = ndt_flightplan_set_departure(flp, job->icao, job->rwy)) ||
+                (ret = ndt_flightplan_set_arrival  (flp, job->icao, NULL)))
             {
                 goto end;
             }
             ret = ndt_flightplan_set_departsid(flp, proc->info.idnt, trans ? trans->info.misc : NULL);
             break;
         case 2:
-            if ((ret = ndt_flightplan_set_departure(flp, arr_apt, NULL)) ||
-                (ret = ndt_flightplan_set_arrival  (flp, arr_apt, arr_rwy)))
+            if ((ret = ndt_flightplan_set_departure(flp, job->icao, NULL)) ||
+                (ret = ndt_flightplan_set_arrival  (flp, job->icao, job->rwy)))
             {
                 goto end;
             }
             ret = ndt_flightplan_set_arrivstar(flp, proc->info.idnt, trans ? trans->info.misc : NULL);
             break;
         case 3:
-            if ((ret = ndt_flightplan_set_departure(flp, arr_apt, NULL)) ||
-                (ret = ndt_flightplan_set_arrival  (flp, arr_apt, arr_rwy)))
+            if ((ret = ndt_flightplan_set_departure(flp, job->icao, NULL)) ||
+                (ret = ndt_flightplan_set_arrival  (flp, job->icao, job->rwy)))
             {
                 goto end;
             }
@@ -286,7 +513,7 @@ static int sidstar_procedure(ndt_navdatabase *ndb, int type,
             transition = lleg->dst ? lleg->dst->info.idnt : NULL;
             transition = trans     ? trans->    info.misc : transition;
             snprintf(filename, sizeof(filename), "/SID_%s%s %s%s%s.fms",
-                     dep_apt, dep_rwy, proc->info.idnt,
+                     job->icao, job->rwy, proc->info.idnt,
                      transition == NULL ? "" : ".",
                      transition == NULL ? "" : transition);
             break;
@@ -294,7 +521,7 @@ static int sidstar_procedure(ndt_navdatabase *ndb, int type,
             transition = fleg->dst ? fleg->dst->info.idnt : NULL;
             transition = trans     ? trans->    info.misc : transition;
             snprintf(filename, sizeof(filename), "/STAR_%s%s %s%s%s.fms",
-                     arr_apt, arr_rwy, proc->info.idnt,
+                     job->icao, job->rwy, proc->info.idnt,
                      transition == NULL ? "" : ".",
                      transition == NULL ? "" : transition);
             break;
@@ -302,7 +529,7 @@ static int sidstar_procedure(ndt_navdatabase *ndb, int type,
             transition = fleg->dst ? fleg->dst->info.idnt : NULL;
             transition = trans     ? trans->    info.misc : transition;
             snprintf(filename, sizeof(filename), "/STAR_%s%s_%s%s%s.fms",
-                     arr_apt, arr_rwy, proc->approach.short_name,
+                     job->icao, job->rwy, proc->approach.short_name,
                      transition == NULL ? "" : ".",
                      transition == NULL ? "" : transition);
             break;
@@ -321,7 +548,7 @@ static int sidstar_procedure(ndt_navdatabase *ndb, int type,
      */
     struct stat stats;
     char subdir[1+4+1];// "/" "ICAO" "\n"
-    snprintf(subdir, sizeof(subdir), "/%4s", dep_apt);
+    snprintf(subdir, sizeof(subdir), "/%4s", job->subdir);
     if (!ndt_file_getpath(path_out, subdir, &path, &pathlen) &&
         !stat(path, &stats) && !!S_ISDIR(stats.st_mode) && !access(path, W_OK))
     {
@@ -365,387 +592,2096 @@ end:
     }
     if (ret)
     {
-        if (type == 1)
-        {
-            ndt_log("failed to create file for %s%s%s: %s%s%s (%s)\n", dep_apt,
-                    dep_rwy == NULL     ? "" : "/",
-                    dep_rwy == NULL     ? "" : dep_rwy,
-                    proc  ? proc-> info.idnt : NULL,
-                    trans   == NULL     ? "" : ".",
-                    trans   == NULL     ? "" : trans->info.misc, strerror(ret));
-        }
-        else
-        {
-            ndt_log("failed to create file for %s%s%s: %s%s%s (%s)\n", arr_apt,
-                    arr_rwy == NULL     ? "" : "/",
-                    arr_rwy == NULL     ? "" : arr_rwy,
-                    proc  ? proc-> info.idnt : NULL,
-                    trans   == NULL     ? "" : ".",
-                    trans   == NULL     ? "" : trans->info.misc, strerror(ret));
-        }
+        ndt_log("failed to create file for %s%s%s: %s%s%s (%s)\n", job->icao,
+                job->rwy == NULL ? "" : "/",
+                job->rwy == NULL ? "" : job->rwy,
+                proc  ? proc-> info.idnt : NULL,
+                trans == NULL    ? "" : ".",
+                trans == NULL    ? "" : trans->info.misc, strerror(ret));
     }
     free(outdir);
     free  (path);
-    return     0;
+    return   ret;
 }
 
-static int sidstar_task(void)
+static int sidstar_add(sidstar_pool *pool, int type, const char *subdir, const char *icao,
+                       ndt_runway   *rnwy, ndt_procedure *proc, ndt_procedure *trans)
 {
-    ndt_navdatabase   *navdata = NULL;
-    int                   rval = 0;
-    ndt_runway           *rnwy;
-    ndt_route_leg        *rleg;
-    ndt_airport   *apt1, *apt2;
-    ndt_procedure *proc, *tran;
-
-    /*
-     * Free some global variables we'll be re-using shortly.
-     */
-    free(dep_rwy);
-    free(arr_rwy);
-
-    /*
-     * Initialize navigation data and airport procedures.
-     */
-    if (!(navdata = ndt_navdatabase_init(path_navdat, NDT_NAVDFMT_XPGNS, ndt_date_now())))
-    {
-        rval = EINVAL;
-        goto end;
-    }
-    if (!(apt1 = ndt_navdata_get_airport(navdata, dep_apt)))
-    {
-        fprintf(stderr, "Airport %s not found\n", dep_apt);
-        rval = EINVAL;
-        goto end;
-    }
-    if (!(apt2 = ndt_navdata_get_airport(navdata, arr_apt)))
-    {
-        fprintf(stderr, "Airport %s not found\n", arr_apt);
-        rval = EINVAL;
-        goto end;
-    }
-    if (!(ndt_navdata_init_airport(navdata, apt1)) ||
-        !(ndt_navdata_init_airport(navdata, apt2)))
+    if (!proc)
     {
-        rval = EINVAL;
-        goto end;
+        return ENOMEM;
     }
-
-    /*
-     * First airport, all departures:
-     * - one file per runway for each SID procedure;
-     * - one file per runway for each transition (prepending its parent SID).
-     */
-    for (size_t i = 0; i < ndt_list_count(apt1->runways); i++)
+    if (pool->count % 256 == 0)
     {
-        if (!(rnwy = ndt_list_item(apt1->runways, i)))
+        sidstar_job *jobs = realloc(pool->jobs, (pool->count + 256) * sizeof(sidstar_job));
+        if (!jobs)
         {
-            rval = ENOMEM;
-            goto end;
+            return ENOMEM;
         }
-        else
+        pool->jobs = jobs;
+    }
+    sidstar_job *job = &pool->jobs[pool->count++];
+    job->type   = type;
+    job->subdir = subdir;
+    job->icao   = icao;
+    job->rwy    = rnwy->info.idnt;
+    job->proc   = proc;
+    job->trans  = trans;
+    return 0;
+}
+
+/*
+ * Enumerate all procedures for an airport (departures or arrivals).
+ */
+static int sidstar_airport(sidstar_pool *pool, const char *subdir, ndt_airport *apt, int departures)
+{
+    ndt_runway    *rnwy;
+    ndt_procedure *proc, *tran;
+    int            rval;
+
+    for (size_t i = 0; i < ndt_list_count(apt->runways); i++)
+    {
+        if (!(rnwy = ndt_list_item(apt->runways, i)))
         {
-            dep_rwy = rnwy->info.idnt;
-            arr_rwy = NULL;
+            return ENOMEM;
         }
-        for (size_t j = 0; j < ndt_list_count(rnwy->sids); j++)
+
+        /*
+         * Departures:
+         * - one file per runway for each SID procedure;
+         * - one file per runway for each transition (prepending its parent SID).
+         */
+        for (size_t j = 0; departures && j < ndt_list_count(rnwy->sids); j++)
         {
-            if (!(proc = ndt_list_item(rnwy->sids, j)))
-            {
-                rval = ENOMEM;
-                goto end;
-            }
-            if ((rval = sidstar_procedure(navdata, 1, proc, NULL)))
-            {
-                goto end;
-            }
-            if (!proc->transition.enroute)
+            if ((rval = sidstar_add(pool, 1, subdir, apt->info.idnt, rnwy, (proc = ndt_list_item(rnwy->sids, j)), NULL)))
             {
-                continue;
+                return rval;
             }
-            for (size_t k = 0; k < ndt_list_count(proc->transition.enroute); k++)
+            for (size_t k = 0; proc->transition.enroute && k < ndt_list_count(proc->transition.enroute); k++)
             {
                 if (!(tran = ndt_list_item(proc->transition.enroute, k)))
                 {
-                    rval = ENOMEM;
-                    goto end;
+                    return ENOMEM;
                 }
-                if ((rval = sidstar_procedure(navdata, 1, proc, tran)))
+                if ((rval = sidstar_add(pool, 1, subdir, apt->info.idnt, rnwy, proc, tran)))
                 {
-                    goto end;
+                    return rval;
                 }
             }
         }
-    }
 
-    /*
-     * Second airport, all departures:
-     * - one file per runway for each STAR procedure;
-     * - one file per runway for each transition (appending its parent STAR);
-     * - one file per runway for each final approach procedure;
-     * - one file per runway for each transition (appending the final approach).
-     */
-    for (size_t i = 0; i < ndt_list_count(apt2->runways); i++)
-    {
-        if (!(rnwy = ndt_list_item(apt2->runways, i)))
-        {
-            rval = ENOMEM;
-            goto end;
-        }
-        else
-        {
-            dep_rwy = NULL;
-            arr_rwy = rnwy->info.idnt;
-        }
-        for (size_t j = 0; j < ndt_list_count(rnwy->stars); j++)
+        /*
+         * Arrivals:
+         * - one file per runway for each STAR procedure;
+         * - one file per runway for each transition (appending its parent STAR);
+         * - one file per runway for each final approach procedure;
+         * - one file per runway for each transition (appending the final approach).
+         */
+        for (size_t j = 0; !departures && j < ndt_list_count(rnwy->stars); j++)
         {
-            if (!(proc = ndt_list_item(rnwy->stars, j)))
-            {
-                rval = ENOMEM;
-                goto end;
-            }
-            if ((rval = sidstar_procedure(navdata, 2, proc, NULL)))
+            if ((rval = sidstar_add(pool, 2, subdir, apt->info.idnt, rnwy, (proc = ndt_list_item(rnwy->stars, j)), NULL)))
             {
-                goto end;
-            }
-            if (!proc->transition.enroute)
-            {
-                continue;
+                return rval;
             }
-            for (size_t k = 0; k < ndt_list_count(proc->transition.enroute); k++)
+            for (size_t k = 0; proc->transition.enroute && k < ndt_list_count(proc->transition.enroute); k++)
             {
                 if (!(tran = ndt_list_item(proc->transition.enroute, k)))
                 {
-                    rval = ENOMEM;
-                    goto end;
+                    return ENOMEM;
                 }
-                if ((rval = sidstar_procedure(navdata, 2, proc, tran)))
+                if ((rval = sidstar_add(pool, 2, subdir, apt->info.idnt, rnwy, proc, tran)))
                 {
-                    goto end;
+                    return rval;
                 }
             }
         }
-        for (size_t j = 0; j < ndt_list_count(rnwy->approaches); j++)
+        for (size_t j = 0; !departures && j < ndt_list_count(rnwy->approaches); j++)
         {
-            if (!(proc = ndt_list_item(rnwy->approaches, j)))
-            {
-                rval = ENOMEM;
-                goto end;
-            }
-            if ((rval = sidstar_procedure(navdata, 3, proc, NULL)))
-            {
-                goto end;
-            }
-            if (!proc->transition.approach)
+            if ((rval = sidstar_add(pool, 3, subdir, apt->info.idnt, rnwy, (proc = ndt_list_item(rnwy->approaches, j)), NULL)))
             {
-                continue;
+                return rval;
             }
-            for (size_t k = 0; k < ndt_list_count(proc->transition.approach); k++)
+            for (size_t k = 0; proc->transition.approach && k < ndt_list_count(proc->transition.approach); k++)
             {
                 if (!(tran = ndt_list_item(proc->transition.approach, k)))
                 {
-                    rval = ENOMEM;
-                    goto end;
+                    return ENOMEM;
                 }
-                if ((rval = sidstar_procedure(navdata, 3, proc, tran)))
+                if ((rval = sidstar_add(pool, 3, subdir, apt->info.idnt, rnwy, proc, tran)))
                 {
-                    goto end;
+                    return rval;
                 }
             }
         }
     }
+    return 0;
+}
 
-end:
-    if (navdata)
+static void* sidstar_worker(void *arg)
+{
+    sidstar_pool *pool = arg;
+
+    for (;;)
     {
-        ndt_navdatabase_close(&navdata);
+        pthread_mutex_lock(&pool->mutex);
+        size_t i = pool->next < pool->count ? pool->next++ : pool->count;
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (i >= pool->count)
+        {
+            break;
+        }
+        if (sidstar_procedure(pool->navdata, &pool->jobs[i]))
+        {
+            __atomic_add_fetch(&pool->failed, 1, __ATOMIC_RELAXED);
+        }
     }
-    dep_rwy = NULL;
-    arr_rwy = NULL;
-    return    rval;
+
+    return NULL;
 }
 
-static int execute_task(void)
+static int sidstar_task(void)
 {
-    int                  ret = 0;
-    ndt_navdatabase *navdata = NULL;
-    ndt_flightplan  *fltplan = NULL;
-    char            *flp_rte = NULL;
-    FILE            *outfile = NULL;
+    ndt_navdatabase   *navdata = NULL;
+    ndt_list             *deps = NULL;
+    ndt_list             *arrs = NULL;
+    pthread_t         *threads = NULL;
+    int               nthreads = 0;
+    char                *pairs = NULL;
+    int                   rval = 0;
+    sidstar_pool          pool = { 0 };
+    ndt_airport   *apt1, *apt2;
 
-    if (!(navdata = ndt_navdatabase_init(path_navdat, NDT_NAVDFMT_XPGNS, ndt_date_now())))
-    {
-        ret = EINVAL;
-        goto end;
-    }
+    /*
+     * Free some global variables we won't be using.
+     */
+    free(dep_rwy);
+    free(arr_rwy);
+    dep_rwy = NULL;
+    arr_rwy = NULL;
 
-    if (fprintairac)
+    /*
+     * Initialize navigation data.
+     */
+    if (!(navdata = navdata_init()))
     {
-        print_airac(navdata, stderr);
+        rval = EINVAL;
+        goto end;
     }
-
-    if (!(fltplan = ndt_flightplan_init(navdata)))
+    if (!(deps = ndt_list_init()) ||
+        !(arrs = ndt_list_init()) || !(pairs = strdup(qpac_aptids)))
     {
-        ret = ENOMEM;
+        rval = ENOMEM;
         goto end;
     }
 
     /*
-     * TODO: future: also applicable to YFMS
-     * When setting up a departure resp. arrival runway *without* corresponding
-     * departure resp. approach procedures, insert a wayppoint 5nm after/before
-     * the applicable runway threshold; compute the runway's true bearing using
-     * the reciprocal runway's threshold instead of relying on the nav database
-     * to avoid mismatch between database's magnetic model vs. that of the sim.
+     * One or more comma-separated airport pairs: enumerate all procedures first
+     * (departures for the first airport of each pair, arrivals for the second),
+     * initializing airports as we go; an airport's departures (or arrivals) are
+     * only written once, even if it's part of several pairs (its files go to
+     * the subdirectory of the first pair it's found in, if there is one).
      */
-
-    // departure airport/runway, SID and arrival airport/runway must
-    // be set first for sequencing and filtering of duplicate waypoints
-    if (dep_apt)
+    char *next = pairs, *pair;
+    while ((pair = strsep(&next, ",")))
     {
-        if ((ret = ndt_flightplan_set_departure(fltplan, dep_apt, dep_rwy)))
+        char *arr = pair, *dep = strsep(&arr, "/\\-.");
+        if (!dep || !strlen(dep))
         {
+            fprintf(stderr, "Failed to split \"%s\"\n", pair);
+            rval = EINVAL;
             goto end;
         }
-        if (sid_name && (ret = ndt_flightplan_set_departsid(fltplan, sid_name, sid_trans)))
+        if (!arr || !strlen(arr))
+        {
+            arr = dep;
+        }
+        if (!(apt1 = ndt_navdata_get_airport(navdata, dep)))
         {
+            fprintf(stderr, "Airport %s not found\n", dep);
+            rval = EINVAL;
             goto end;
         }
-    }
-    if (arr_apt)
-    {
-        if ((ret = ndt_flightplan_set_arrival(fltplan, arr_apt, arr_rwy)))
+        if (!(apt2 = ndt_navdata_get_airport(navdata, arr)))
+        {
+            fprintf(stderr, "Airport %s not found\n", arr);
+            rval = EINVAL;
+            goto end;
+        }
+        if (!(ndt_navdata_init_airport(navdata, apt1)) ||
+            !(ndt_navdata_init_airport(navdata, apt2)))
         {
+            rval = EINVAL;
             goto end;
         }
+        int newdep = 1, newarr = 1;
+        for (size_t i = 0; i < ndt_list_count(deps); i++)
+        {
+            newdep = newdep && ndt_list_item(deps, i) != apt1;
+        }
+        for (size_t i = 0; i < ndt_list_count(arrs); i++)
+        {
+            newarr = newarr && ndt_list_item(arrs, i) != apt2;
+        }
+        if (newdep)
+        {
+            if ((rval = sidstar_airport(&pool, apt1->info.idnt, apt1, 1)))
+            {
+                goto end;
+            }
+            ndt_list_add(deps, apt1);
+        }
+        if (newarr)
+        {
+            if ((rval = sidstar_airport(&pool, apt1->info.idnt, apt2, 0)))
+            {
+                goto end;
+            }
+            ndt_list_add(arrs, apt2);
+        }
     }
 
-    if (path_in && !icao_route)
+    /*
+     * The navdata is read-only from here on, write all files in parallel.
+     */
+    pool.navdata = navdata;
+    pthread_mutex_init(&pool.mutex, NULL);
+    if (pool.count && !(threads = calloc(batch_threads, sizeof(pthread_t))))
     {
-        flp_rte = ndt_file_slurp(path_in, &ret);
-        if (ret)
+        rval = ENOMEM;
+        goto end;
+    }
+    while (nthreads < batch_threads && nthreads < pool.count)
+    {
+        if (pthread_create(&threads[nthreads], NULL, &sidstar_worker, &pool))
         {
-            goto end;
+            break;
         }
+        nthreads++;
     }
-    else
+    if (!nthreads)
     {
-        flp_rte   = icao_route;
-        format_in = NDT_FLTPFMT_ICAOR;
+        sidstar_worker(&pool); // no threads, write everything ourselves
     }
-
-    // we can set the flight route now
-    if (flp_rte && (ret = ndt_flightplan_set_route(fltplan, flp_rte, format_in)))
+    for (int i = 0; i < nthreads; i++)
     {
-        goto end;
+        pthread_join(threads[i], NULL);
     }
+    fprintf(stderr, "%zu procedure(s) written, %zu failed\n", pool.count - pool.failed, pool.failed);
 
-    // STAR and approach must be set after the flight route for proper sequencing
-    if (star_name)
+end:
+    if (pool.navdata)
     {
-        if (fltplan->arr.star.proc) // STAR might be present in the flight route
-        {
-            if (star_trans)
-            {
-                fprintf(stderr, "warning: ignoring STAR '%s.%s'\n", star_name, star_trans);
-            }
-            else
-            {
-                fprintf(stderr, "warning: ignoring STAR '%s'\n", star_name);
+        pthread_mutex_destroy(&pool.mutex);
+    }
+    if (navdata)
+    {
+        ndt_navdatabase_close(&navdata);
+    }
+    ndt_list_close(&deps);
+    ndt_list_close(&arrs);
+    free(pool.jobs);
+    free(threads);
+    free(pairs);
+    return rval;
+}
+
+typedef struct procs_result
+{
+    ndt_airport *apt;
+    ndt_list *failed;   // procedures that failed to open
+    int        count;   // ndt_navdata_open_airport
+    double      msec;
+} procs_result;
+
+typedef struct procs_pool
+{
+    ndt_navdatabase *navdata;
+    procs_result    *results;
+    size_t             count;
+    size_t              next;
+} procs_pool;
+
+static double procs_msec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000. + ts.tv_nsec / 1000000.;
+}
+
+static void* procs_worker(void *arg)
+{
+    procs_pool *pool = arg;
+    size_t         i;
+
+    while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->count)
+    {
+        procs_result *res = &pool->results[i];
+        double      start = procs_msec();
+        res->count        = ndt_navdata_open_airport(pool->navdata, res->apt, res->failed);
+        res->msec         = procs_msec() - start;
+    }
+
+    return NULL;
+}
+
+/*
+ * Parse and open every procedure (and transition) for every airport in the
+ * database, in parallel; print failures and per-airport timings.
+ */
+static int procs_task(void)
+{
+    ndt_navdatabase *navdata = NULL;
+    pthread_t       *threads = NULL;
+    int             nthreads = 0;
+    FILE            *outfile = NULL;
+    size_t          nairport = 0;
+    size_t          nprocdre = 0;
+    size_t          nfailure = 0;
+    procs_pool          pool = { 0 };
+    double             start;
+    int                  ret = 0;
+
+    if (!(navdata = navdata_init()))
+    {
+        ret = EINVAL;
+        goto end;
+    }
+    if (fprintairac)
+    {
+        print_airac(navdata, stderr);
+    }
+    if (path_out)
+    {
+        if (!(outfile = fopen(path_out, "w")))
+        {
+            ret = errno;
+            goto end;
+        }
+    }
+    else
+    {
+        outfile = stdout;
+    }
+
+    pool.navdata = navdata;
+    pool.count   = ndt_list_count(navdata->airports);
+    if (!(pool.results = calloc(pool.count + 1, sizeof(procs_result))) ||
+        !(threads      = calloc(batch_threads,  sizeof(pthread_t))))
+    {
+        ret = ENOMEM;
+        goto end;
+    }
+    for (size_t i = 0; i < pool.count; i++)
+    {
+        if (!(pool.results[i].apt    = ndt_list_item(navdata->airports, i)) ||
+            !(pool.results[i].failed = ndt_list_init()))
+        {
+            ret = ENOMEM;
+            goto end;
+        }
+    }
+
+    start = procs_msec();
+    while (nthreads < batch_threads && nthreads < pool.count)
+    {
+        if (pthread_create(&threads[nthreads], NULL, &procs_worker, &pool))
+        {
+            break;
+        }
+        nthreads++;
+    }
+    if (!nthreads)
+    {
+        procs_worker(&pool); // no threads, check everything ourselves
+    }
+    for (int i = 0; i < nthreads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    /*
+     * Airports without any procedures are skipped, unless they failed.
+     */
+    for (size_t i = 0; i < pool.count; i++)
+    {
+        procs_result *res = &pool.results[i];
+        size_t      procs = res->apt->allprocs ? ndt_list_count(res->apt->allprocs) : 0;
+        if (res->count < 0)
+        {
+            fprintf(outfile, "%-4s failed to parse procedures (%.3lf ms)\n", res->apt->info.idnt, res->msec);
+            nfailure++;
+            continue;
+        }
+        if (!procs)
+        {
+            continue;
+        }
+        fprintf(outfile, "%-4s %5zu procedure(s), %5d failed (%.3lf ms)\n", res->apt->info.idnt, procs, res->count, res->msec);
+        for (size_t j = 0; j < ndt_list_count(res->failed); j++)
+        {
+            ndt_procedure *proc = ndt_list_item(res->failed, j);
+            fprintf(outfile, "     failed: %s\n", proc->info.desc);
+        }
+        nairport += 1;
+        nprocdre += procs;
+        nfailure += res->count;
+    }
+    fprintf(stderr, "%zu airport(s), %zu procedure(s), %zu failed (%.3lf s, %d thread(s))\n",
+            nairport, nprocdre, nfailure, (procs_msec() - start) / 1000., nthreads ? nthreads : 1);
+    if (nfailure)
+    {
+        ret = EINVAL;
+    }
+
+end:
+    for (size_t i = 0; pool.results && i < pool.count; i++)
+    {
+        ndt_list_close(&pool.results[i].failed);
+    }
+    if (outfile && outfile != stdout)
+    {
+        fclose(outfile);
+    }
+    ndt_navdatabase_close(&navdata);
+    free(pool.results);
+    free(threads);
+    return ret;
+}
+
+typedef struct nearest_filter
+{
+    ndt_navdatabase *ndb;
+    ndt_position     pos;
+} nearest_filter;
+
+static int nearest_isnavaid(ndt_waypoint *wpt)
+{
+    switch (wpt->type)
+    {
+        case NDT_WPTYPE_DME:
+        case NDT_WPTYPE_LOC:
+        case NDT_WPTYPE_NDB:
+        case NDT_WPTYPE_VOR:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int nearest_callback(ndt_waypoint *wpt, void *ctx)
+{
+    nearest_filter *flt = ctx;
+
+    /*
+     * Each filter only applies to the waypoint types where it's meaningful:
+     * runway length for airports, frequency and reception range for navaids.
+     */
+    if (near_rwylen > 0 && (wpt->type == NDT_WPTYPE_APT || wpt->type == NDT_WPTYPE_XPA))
+    {
+        ndt_airport *apt = ndt_navdata_get_airport(flt->ndb, wpt->info.idnt);
+        if (!apt || ndt_distance_get(apt->rwy_longest, rwu) < near_rwylen)
+        {
+            return 0;
+        }
+    }
+    if (near_freq > 0. && nearest_isnavaid(wpt))
+    {
+        if (ndt_frequency_init(near_freq).value != wpt->frequency.value)
+        {
+            return 0;
+        }
+    }
+    if (near_tunable && nearest_isnavaid(wpt))
+    {
+        ndt_distance range = ndt_distance_add(wpt->range, ndt_distance_init(1, NDT_ALTUNIT_NA));
+        if (!ndt_position_calcwithin(flt->pos, wpt->position, range))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static const char* nearest_typename(ndt_waypoint *wpt)
+{
+    switch (wpt->type)
+    {
+        case NDT_WPTYPE_APT:
+        case NDT_WPTYPE_XPA:
+            return "APT";
+        case NDT_WPTYPE_DME:
+            return "DME";
+        case NDT_WPTYPE_FIX:
+            return "fix";
+        case NDT_WPTYPE_LOC:
+            return "LOC";
+        case NDT_WPTYPE_NDB:
+            return "NDB";
+        case NDT_WPTYPE_RWY:
+            return "RWY";
+        case NDT_WPTYPE_VOR:
+            return "VOR";
+        default:
+            return "l/l";
+    }
+}
+
+static int print_nearby(ndt_sink *sink, ndt_navdatabase *ndb, ndt_position pos, ndt_list *list, int fmt)
+{
+    char buf[64];
+    int  ret = 0;
+
+    for (size_t i = 0; i < ndt_list_count(list); i++)
+    {
+        ndt_waypoint *wpt = ndt_list_item(list, i);
+        double        lat = ndt_position_getlatitude (wpt->position, NDT_ANGUNIT_DEG);
+        double        lon = ndt_position_getlongitude(wpt->position, NDT_ANGUNIT_DEG);
+
+        switch (fmt)
+        {
+            case NDT_FLTPFMT_DCDED:
+            case NDT_FLTPFMT_ICAOR:
+            case NDT_FLTPFMT_ICAOX:
+            case NDT_FLTPFMT_SBRIF:
+                ret = ndt_sink_printf(sink, "%s%s", i ? " " : "", wpt->info.idnt);
+                break;
+
+            case NDT_FLTPFMT_DTEST:
+                if (ndt_position_sprintllc(wpt->position, NDT_LLCFMT_SVECT, buf, sizeof(buf)) < 0)
+                {
+                    ret = EIO;
+                    break;
+                }
+                ret = ndt_sink_printf(sink, "%s%s", i ? " " : "", buf);
+                break;
+
+            case NDT_FLTPFMT_AIBXT:
+                ret = ndt_sink_printf(sink, "DctWpt%zu=%s\nDctWpt%zuCoordinates=%lf,%lf\n",
+                                        i + 1, wpt->info.idnt, i + 1, lat, lon);
+                break;
+
+            case NDT_FLTPFMT_XPFMS:
+                ret = ndt_sink_printf(sink, "%d %s %d %lf %lf\n",
+                                        wpt->type == NDT_WPTYPE_APT ||
+                                        wpt->type == NDT_WPTYPE_XPA ?  1 :
+                                        wpt->type == NDT_WPTYPE_NDB ?  2 :
+                                        wpt->type == NDT_WPTYPE_VOR ?  3 :
+                                        wpt->type == NDT_WPTYPE_FIX ? 11 : 28, wpt->info.idnt,
+                                        (int)ndt_distance_get(ndt_position_getaltitude(wpt->position), NDT_ALTUNIT_FT), lat, lon);
+                break;
+
+            case NDT_FLTPFMT_XPHLP:
+                ret = ndt_sink_printf(sink, "%2zu  %s  %-19s  %+07.3lf  %+08.3lf\n",
+                                        i + 1, nearest_typename(wpt), wpt->info.idnt, lat, lon);
+                break;
+
+            case NDT_FLTPFMT_XPCDU:
+            case NDT_FLTPFMT_XPCVA:
+                if (ndt_position_sprintllc(wpt->position,
+                                           fmt == NDT_FLTPFMT_XPCDU ? NDT_LLCFMT_AIBUS : NDT_LLCFMT_CEEVA,
+                                           buf, sizeof(buf)) < 0)
+                {
+                    ret = EIO;
+                    break;
+                }
+                ret = ndt_sink_printf(sink, "%2zu  %-19s  %s\n", i + 1, wpt->info.idnt, buf);
+                break;
+
+            case NDT_FLTPFMT_IRECP:
+            default:
+            {
+                double       trub = ndt_position_calcbearing(pos, wpt->position);
+                double       magb = ndt_wmm_getbearing_mag(ndb->wmm, trub, pos);
+                ndt_distance dist = ndt_position_calcdistance(pos, wpt->position);
+                if (ndt_position_sprintllc(wpt->position, NDT_LLCFMT_RECAP, buf, sizeof(buf)) < 0)
+                {
+                    ret = EIO;
+                    break;
+                }
+                if ((ret = ndt_sink_printf(sink, "%2zu  %s  %-7s %6.1lf nm  %05.1lf° (%05.1lf°T)  %s  ",
+                                             i + 1, nearest_typename(wpt), wpt->info.idnt,
+                                             (double)ndt_distance_get(dist, NDT_ALTUNIT_NA) / 18520000.,
+                                             ndt_mod(magb, 360.), ndt_mod(trub, 360.), buf)))
+                {
+                    break;
+                }
+                if (wpt->type == NDT_WPTYPE_APT || wpt->type == NDT_WPTYPE_XPA)
+                {
+                    ndt_airport *apt = ndt_navdata_get_airport(ndb, wpt->info.idnt);
+                    ret = ndt_sink_printf(sink, "%s, longest runway: %d %s\n", wpt->info.misc,
+                                            apt ? (int)ndt_distance_get(apt->rwy_longest, rwu) : 0,
+                                            rwu == NDT_ALTUNIT_ME ? "m" : "ft");
+                    break;
+                }
+                if (nearest_isnavaid(wpt))
+                {
+                    ret = ndt_sink_printf(sink, "%s, %.*lf %s, range: %d nm\n", wpt->info.misc,
+                                            wpt->type == NDT_WPTYPE_NDB ? 0 : 3, ndt_frequency_get(wpt->frequency),
+                                            wpt->type == NDT_WPTYPE_NDB ? "kHz" : "MHz",
+                                            (int)ndt_distance_get(wpt->range, NDT_ALTUNIT_NM));
+                    break;
+                }
+                ret = ndt_sink_printf(sink, "%s\n", wpt->info.desc);
+                break;
+            }
+        }
+        if (ret)
+        {
+            goto end;
+        }
+    }
+    switch (fmt)
+    {
+        case NDT_FLTPFMT_DCDED:
+        case NDT_FLTPFMT_DTEST:
+        case NDT_FLTPFMT_ICAOR:
+        case NDT_FLTPFMT_ICAOX:
+        case NDT_FLTPFMT_SBRIF:
+            if (ndt_list_count(list))
+            {
+                ret = ndt_sink_printf(sink, "%s", "\n");
+            }
+            break;
+        default:
+            break;
+    }
+
+end:
+    return ret;
+}
+
+/*
+ * Reference position: decimal coordinates (latitude,longitude), a lat/lon
+ * waypoint (e.g. N46E006), an airport or any other waypoint in navdata.
+ */
+static int nearest_print(ndt_navdatabase *navdata, const char *place, int fmt, ndt_sink *sink)
+{
+    ndt_waypoint    *llcwpt  = NULL;
+    ndt_list        *results = NULL;
+    ndt_airport     *apt;
+    ndt_waypoint    *wpt;
+    nearest_filter   filter;
+    double           lat, lon;
+    char             chr;
+    int              ret = 0;
+
+    if (!(results = ndt_list_init()))
+    {
+        ret = ENOMEM;
+        goto end;
+    }
+
+    filter.ndb = navdata;
+    if (sscanf(place, "%lf,%lf%c", &lat, &lon, &chr) == 2 && fabs(lat) <= 90. && fabs(lon) <= 180.)
+    {
+        filter.pos = ndt_position_init(lat, lon, NDT_DISTANCE_ZERO);
+    }
+    else if ((llcwpt = ndt_waypoint_llc(place, NULL)))
+    {
+        filter.pos = llcwpt->position;
+    }
+    else if ((apt = ndt_navdata_get_airport(navdata, place)))
+    {
+        filter.pos = apt->coordinates;
+    }
+    else if ((wpt = ndt_navdata_get_waypoint(navdata, place, NULL)))
+    {
+        size_t idx = 0;
+        ndt_navdata_get_waypoint(navdata, place, &idx); idx++;
+        if (ndt_navdata_get_waypoint(navdata, place, &idx))
+        {
+            fprintf(stderr, "warning: waypoint '%s' is ambiguous, using %s\n", place, wpt->info.desc);
+        }
+        filter.pos = wpt->position;
+    }
+    else
+    {
+        fprintf(stderr, "Position or waypoint '%s' not found\n", place);
+        ret = EINVAL;
+        goto end;
+    }
+
+    ndt_distance range = ndt_distance_init((int64_t)(near_range * 1852.), NDT_ALTUNIT_ME);
+    if (near_count > 0)
+    {
+        ret = ndt_navdata_get_wptnearn(navdata, filter.pos, near_count, range, near_tps, &nearest_callback, &filter, results);
+    }
+    else
+    {
+        ret = ndt_navdata_get_wptinrng(navdata, filter.pos, range, near_tps, &nearest_callback, &filter, results);
+    }
+    if (ret)
+    {
+        goto end;
+    }
+
+    ret = print_nearby(sink, navdata, filter.pos, results, fmt == -1 ? NDT_FLTPFMT_IRECP : fmt);
+
+end:
+    ndt_waypoint_close(&llcwpt);
+    ndt_list_close    (&results);
+    return ret;
+}
+
+static int nearest_task(void)
+{
+    ndt_navdatabase *navdata = NULL;
+    FILE            *outfile = NULL;
+    ndt_sink        *outsink = NULL;
+    int              ret = 0;
+
+    if (!(navdata = navdata_init()))
+    {
+        ret = EINVAL;
+        goto end;
+    }
+
+    if (fprintairac)
+    {
+        print_airac(navdata, stderr);
+    }
+
+    if (path_out)
+    {
+        outfile = fopen(path_out, "w");
+        if (!outfile)
+        {
+            ret = errno;
+            goto end;
+        }
+    }
+    else
+    {
+        outfile = stdout;
+    }
+    if (!(outsink = ndt_sink_init(outfile)))
+    {
+        ret = ENOMEM;
+        goto end;
+    }
+
+    if (!(ret = nearest_print(navdata, near_place, format_out, outsink)))
+    {
+        ret = ndt_sink_flush(outsink);
+    }
+
+end:
+    ndt_sink_close(&outsink);
+    if (outfile && outfile != stdout)
+    {
+        fclose(outfile);
+    }
+    ndt_navdatabase_close(&navdata);
+    return ret;
+}
+
+/*
+ * Everything needed to build one flight plan (see --dep, --arr and --rte).
+ */
+typedef struct route_request
+{
+    char *dep_apt, *dep_rwy, *sid_name, *sid_trans;
+    char *arr_apt, *arr_rwy, *final_appr, *appr_trans, *star_name, *star_trans;
+    char *route;
+} route_request;
+
+/*
+ * Route validation (see --validate): print one line per route element.
+ */
+static void route_check_print(const ndt_route_check *check, void *context)
+{
+    ndt_sink *fd = context;
+
+    if (check->error)
+    {
+        ndt_sink_printf(fd, "%5zu %-15s error: %s (%s)\n", check->offset, check->elem, check->what, strerror(check->error));
+    }
+    else if (check->wpt)
+    {
+        ndt_sink_printf(fd, "%5zu %-15s %s %s (%+.6lf, %+.6lf)\n", check->offset, check->elem, check->what, check->wpt->info.idnt,
+                        ndt_position_getlatitude (check->wpt->position, NDT_ANGUNIT_DEG),
+                        ndt_position_getlongitude(check->wpt->position, NDT_ANGUNIT_DEG));
+    }
+    else
+    {
+        ndt_sink_printf(fd, "%5zu %-15s %s\n", check->offset, check->elem, check->what);
+    }
+}
+
+/*
+ * One route: <dep> <arr> <ICAO route> (see --batch), uppercased in place.
+ */
+static int request_parse(char *line, route_request *req)
+{
+    char *dep, *arr, *rte = line + strspn(line, " \t\r");
+
+    for (size_t i = 0; rte[i] != '\0'; i++)
+    {
+        rte[i] = rte[i] == '\r' || rte[i] == '\n' ? ' ' : toupper(rte[i]);
+    }
+    dep = strsep(&rte, " \t"); rte = rte ? rte + strspn(rte, " \t") : NULL;
+    arr = strsep(&rte, " \t"); rte = rte ? rte + strspn(rte, " \t") : NULL;
+
+    if (dep && *dep && strcmp(dep, "-"))
+    {
+        char **fields[6] = { &req->dep_apt, &req->dep_rwy, &req->sid_name, &req->sid_trans, NULL, NULL, };
+        string_split4(dep, "/.", fields);
+    }
+    if (arr && *arr && strcmp(arr, "-"))
+    {
+        char **fields[6] = { &req->arr_apt, &req->arr_rwy, &req->final_appr, &req->appr_trans, &req->star_name, &req->star_trans, };
+        string_split4(arr, "/.", fields);
+    }
+    if (rte && *rte && !(req->route = strdup(rte)))
+    {
+        return ENOMEM;
+    }
+    return 0;
+}
+
+static void request_free(route_request *req)
+{
+    free(req->dep_apt);    free(req->dep_rwy);
+    free(req->sid_name);   free(req->sid_trans);
+    free(req->arr_apt);    free(req->arr_rwy);
+    free(req->final_appr); free(req->appr_trans);
+    free(req->star_name);  free(req->star_trans);
+    free(req->route);
+    memset(req, 0, sizeof(route_request));
+}
+
+static int route_compile(ndt_navdatabase *navdata, route_request *req, int format,
+                         ndt_route_check_callback *cb, void *ctx, ndt_flightplan **_flp)
+{
+    int                  ret = 0;
+    ndt_flightplan  *fltplan = NULL;
+
+    if (!(fltplan = ndt_flightplan_init2(navdata, cb, ctx)))
+    {
+        ret = ENOMEM;
+        goto end;
+    }
+
+    // user waypoints (see --user-wpt) must be set before the flight route
+    for (int i = 0; i < user_wpts_count; i++)
+    {
+        ndt_position posn = ndt_position_init(user_wpts[i].lat, user_wpts[i].lon, NDT_DISTANCE_ZERO);
+        if ((ret = ndt_flightplan_user_waypoint(fltplan, user_wpts[i].idnt, posn)))
+        {
+            goto end;
+        }
+    }
+
+    /*
+     * TODO: future: also applicable to YFMS
+     * When setting up a departure resp. arrival runway *without* corresponding
+     * departure resp. approach procedures, insert a wayppoint 5nm after/before
+     * the applicable runway threshold; compute the runway's true bearing using
+     * the reciprocal runway's threshold instead of relying on the nav database
+     * to avoid mismatch between database's magnetic model vs. that of the sim.
+     */
+
+    // departure airport/runway, SID and arrival airport/runway must
+    // be set first for sequencing and filtering of duplicate waypoints
+    if (req->dep_apt)
+    {
+        if ((ret = ndt_flightplan_set_departure(fltplan, req->dep_apt, req->dep_rwy)))
+        {
+            goto end;
+        }
+        if (req->sid_name && (ret = ndt_flightplan_set_departsid(fltplan, req->sid_name, req->sid_trans)))
+        {
+            goto end;
+        }
+    }
+    if (req->arr_apt)
+    {
+        if ((ret = ndt_flightplan_set_arrival(fltplan, req->arr_apt, req->arr_rwy)))
+        {
+            goto end;
+        }
+    }
+
+    // we can set the flight route now
+    if (req->route && (ret = ndt_flightplan_set_route(fltplan, req->route, format)))
+    {
+        goto end;
+    }
+
+    // STAR and approach must be set after the flight route for proper sequencing
+    if (req->star_name)
+    {
+        if (fltplan->arr.star.proc) // STAR might be present in the flight route
+        {
+            if (req->star_trans)
+            {
+                fprintf(stderr, "warning: ignoring STAR '%s.%s'\n", req->star_name, req->star_trans);
+            }
+            else
+            {
+                fprintf(stderr, "warning: ignoring STAR '%s'\n", req->star_name);
+            }
+        }
+        else if ((ret = ndt_flightplan_set_arrivstar(fltplan, req->star_name, req->star_trans)))
+        {
+            goto end;
+        }
+    }
+    if (fltplan->arr.rwy && req->appr_trans && !strcasecmp(req->appr_trans, "auto"))
+    {
+        ndt_route_leg *leg = ndt_list_item(fltplan->legs, -1);
+        ndt_waypoint  *src = leg ? leg->dst : NULL;
+        free(req->appr_trans); req->appr_trans = NULL; // reset
+        if (src)
+        {
+            ndt_procedure *final = ndt_procedure_get(fltplan->arr.rwy->approaches, req->final_appr, NULL);
+            if (final)
+            {
+                for (size_t i = 0; i < ndt_list_count(final->transition.approach); i++)
+                {
+                    ndt_procedure *apptr = ndt_list_item(final->transition.approach, i);
+                    if (apptr)
+                    {
+                        ndt_route_leg *leg = ndt_list_item(apptr->proclegs, 0);
+                        if (leg)
+                        {
+                            if (leg->type == NDT_LEGTYPE_IF && leg->dst == src)
+                            {
+                                req->appr_trans = strdup(apptr->info.misc);
+                                break;
+                            }
+                            if (leg->src == src)
+                            {
+                                req->appr_trans = strdup(apptr->info.misc);
+                                break;
+                            }
+                        }
+                        for (size_t j = i; j < ndt_list_count(apptr->proclegs); j++)
+                        {
+                            leg = ndt_list_item(apptr->proclegs, j);
+                            if (leg && leg->type == NDT_LEGTYPE_IF && leg->dst == src)
+                            {
+                                req->appr_trans = strdup(apptr->info.misc);
+                                break;
+                            }
+                        }
+                        if (req->appr_trans)
+                        {
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        if (!req->appr_trans && !cb) // validation only: no legs to pick from
+        {
+            fprintf(stderr, "warning: no valid approach transition found\n");
+        }
+    }
+    if ((req->final_appr && req->arr_rwy) &&
+        (ret = ndt_flightplan_set_arrivapch(fltplan, req->final_appr, req->appr_trans)))
+    {
+        goto end;
+    }
+
+end:
+    if (ret)
+    {
+        ndt_flightplan_close(&fltplan);
+    }
+    *_flp = fltplan;
+    return ret;
+}
+
+static int output_format(const char *name)
+{
+    if (!strcasecmp(name, "airbusx"))
+    {
+        return NDT_FLTPFMT_AIBXT;
+    }
+    if (!strcasecmp(name, "civa"))
+    {
+        return NDT_FLTPFMT_XPCVA;
+    }
+    if (!strcasecmp(name, "decoded") ||
+        !strcasecmp(name, "skyvector")) // legacy name for flat, decoded route
+    {
+        return NDT_FLTPFMT_DCDED;
+    }
+    if (!strcasecmp(name, "test"))
+    {
+        return NDT_FLTPFMT_DTEST; // purposefully undocumented
+    }
+    if (!strcasecmp(name, "helper"))
+    {
+        return NDT_FLTPFMT_XPHLP;
+    }
+    if (!strcasecmp(name, "icao"))
+    {
+        return NDT_FLTPFMT_ICAOR;
+    }
+    if (!strcasecmp(name, "ixeg"))
+    {
+        return NDT_FLTPFMT_ICAOX;
+    }
+    if (!strcasecmp(name, "mcdu"))
+    {
+        return NDT_FLTPFMT_XPCDU;
+    }
+    if (!strcasecmp(name, "recap"))
+    {
+        return NDT_FLTPFMT_IRECP;
+    }
+    if (!strcasecmp(name, "simbrief"))
+    {
+        return NDT_FLTPFMT_SBRIF;
+    }
+    if (!strcasecmp(name, "xplane"))
+    {
+        return NDT_FLTPFMT_XPFMS;
+    }
+    return -1;
+}
+
+static int execute_output(FILE **outfile)
+{
+    if (path_out)
+    {
+        if (!(*outfile = fopen(path_out, "w")))
+        {
+            return errno;
+        }
+        return 0;
+    }
+    *outfile = stdout;
+    return 0;
+}
+
+/*
+ * Several output formats: write them all at once, each to its own file.
+ */
+static int execute_outputs(ndt_flightplan *flp)
+{
+    ndt_flightplan_output out[sizeof(outputs) / sizeof(outputs[0])] = { { 0 }, };
+    FILE                 *fds[sizeof(outputs) / sizeof(outputs[0])] = {   0,  };
+    int                   ret = 0;
+
+    for (int i = 0; i < outputs_count; i++)
+    {
+        if (outputs[i].path)
+        {
+            if (!(fds[i] = fopen(outputs[i].path, "w")))
+            {
+                ret = errno;
+                fprintf(stderr, "Bad output file: '%s' (%s)\n", outputs[i].path, strerror(ret));
+                goto end;
+            }
+        }
+        else if ((ret = execute_output(&fds[i])))
+        {
+            goto end;
+        }
+        if (!(out[i].sink = ndt_sink_init(fds[i])))
+        {
+            ret = ENOMEM;
+            goto end;
+        }
+        out[i].format = outputs[i].format;
+    }
+
+    ret = ndt_flightplan_writeall(flp, out, outputs_count);
+    for (int i = 0; i < outputs_count; i++)
+    {
+        int err = ndt_sink_flush(out[i].sink);
+        ret     = ret ? ret : err;
+    }
+
+end:
+    for (int i = 0; i < outputs_count; i++)
+    {
+        ndt_sink_close(&out[i].sink);
+        if (fds[i] && fds[i] != stdout)
+        {
+            fclose(fds[i]);
+        }
+    }
+    return ret;
+}
+
+static int execute_task(void)
+{
+    int                  ret = 0;
+    ndt_navdatabase *navdata = NULL;
+    ndt_flightplan  *fltplan = NULL;
+    char            *flp_rte = NULL;
+    FILE            *outfile = NULL;
+    ndt_sink        *outsink = NULL;
+
+    if (!(navdata = navdata_init()))
+    {
+        ret = EINVAL;
+        goto end;
+    }
+
+    if (fprintairac)
+    {
+        print_airac(navdata, stderr);
+    }
+
+    if (path_in && !icao_route)
+    {
+        flp_rte = ndt_file_slurp(path_in, &ret);
+        if (ret)
+        {
+            goto end;
+        }
+    }
+    else
+    {
+        flp_rte   = icao_route;
+        format_in = NDT_FLTPFMT_ICAOR;
+    }
+
+    // validation only: diagnostics are output even if the route is invalid
+    if (route_check && (ret = execute_output(&outfile)))
+    {
+        goto end;
+    }
+    if (route_check && !(outsink = ndt_sink_init(outfile)))
+    {
+        ret = ENOMEM;
+        goto end;
+    }
+
+    route_request request =
+    {
+        .dep_apt    = dep_apt,    .dep_rwy    = dep_rwy,
+        .sid_name   = sid_name,   .sid_trans  = sid_trans,
+        .arr_apt    = arr_apt,    .arr_rwy    = arr_rwy,
+        .final_appr = final_appr, .appr_trans = appr_trans,
+        .star_name  = star_name,  .star_trans = star_trans,
+        .route      = flp_rte,
+    };
+    ret        = route_compile(navdata, &request, format_in,
+                               route_check ? &route_check_print : NULL, outsink, &fltplan);
+    appr_trans = request.appr_trans; // may have been updated ("auto")
+    if (ret || route_check)
+    {
+        goto end;
+    }
+
+    if (outputs_count > 1 || (outputs_count && outputs[0].path))
+    {
+        ret = execute_outputs(fltplan);
+        goto end;
+    }
+
+    if ((ret = execute_output(&outfile)))
+    {
+        goto end;
+    }
+
+    if ((ret = ndt_flightplan_write(fltplan, outfile, format_out)))
+    {
+        goto end;
+    }
+
+end:
+    if (flp_rte != icao_route)
+    {
+        free(flp_rte);
+    }
+    if (outsink)
+    {
+        int err = ndt_sink_flush(outsink);
+        ret     = ret ? ret : err;
+        ndt_sink_close(&outsink);
+    }
+    if (outfile && outfile != stdout)
+    {
+        fclose(outfile);
+    }
+    ndt_navdatabase_close(&navdata);
+    ndt_flightplan_close (&fltplan);
+    return ret;
+}
+
+typedef struct batch_job
+{
+    route_request req;
+    size_t       line;  // line number in batch file
+    char        *text;  // flight plan (multiplexed output only)
+    size_t      textl;
+    int           ret;
+    int          done;
+} batch_job;
+
+typedef struct batch_pool
+{
+    ndt_navdatabase *navdata;
+    batch_job          *jobs;
+    size_t             count;
+    size_t              next;
+    pthread_mutex_t    mutex;
+    pthread_cond_t      cond;
+} batch_pool;
+
+/*
+ * Per-route output: its own file if -o is a directory; else kept in memory
+ * (it's written, in input order, by the main thread).
+ */
+static int batch_output(batch_job *job, const char *dep, const char *arr, FILE **fd, char **path, ndt_sink **sink)
+{
+    if (batch_outdir)
+    {
+        char filename[1+5+1+4+1+4+4+1];// "/" "00001" "_" "ICAO" "-" "ICAO" ".fms" "\n"
+        int pathlen = 0, ret;
+        snprintf(filename, sizeof(filename), "/%05zu_%.4s-%.4s%s", job->line,
+                 dep ? dep : "ZZZZ",
+                 arr ? arr : "ZZZZ",
+                 format_out == NDT_FLTPFMT_XPFMS && !route_check ? ".fms" : ".txt");
+        if ((ret = ndt_file_getpath(path_out, filename, path, &pathlen)))
+        {
+            return ret;
+        }
+        if (!(*fd = fopen(*path, "w")))
+        {
+            return errno;
+        }
+    }
+    if (!(*sink = ndt_sink_init(*fd)))
+    {
+        return ENOMEM;
+    }
+    return 0;
+}
+
+static int batch_compile(batch_pool *pool, batch_job *job)
+{
+    ndt_flightplan *flp = NULL;
+    ndt_sink      *sink = NULL;
+    FILE            *fd = NULL;
+    char          *path = NULL;
+    int             ret = 0;
+
+    if (route_check)
+    {
+        if ((ret = batch_output(job, job->req.dep_apt, job->req.arr_apt, &fd, &path, &sink)))
+        {
+            goto end;
+        }
+        ret = route_compile(pool->navdata, &job->req, NDT_FLTPFMT_ICAOR, &route_check_print, sink, &flp);
+    }
+    else if (!(ret = route_compile(pool->navdata, &job->req, NDT_FLTPFMT_ICAOR, NULL, NULL, &flp)) &&
+             !(ret = batch_output(job,
+                                  flp->dep.apt ? flp->dep.apt->info.idnt : NULL,
+                                  flp->arr.apt ? flp->arr.apt->info.idnt : NULL, &fd, &path, &sink)))
+    {
+        ret = ndt_flightplan_write2(flp, sink, format_out);
+    }
+    if (sink && (!ret || route_check))
+    {
+        int err = 0;
+        if (fd)
+        {
+            err = ndt_sink_flush(sink);
+        }
+        else if (!(job->text = ndt_sink_detach(sink, &job->textl)))
+        {
+            err = ENOMEM;
+        }
+        ret = ret ? ret : err;
+    }
+
+end:
+    ndt_sink_close(&sink);
+    if (fd)
+    {
+        fclose(fd);
+    }
+    ndt_flightplan_close(&flp);
+    free(path);
+    return ret;
+}
+
+static void* batch_worker(void *arg)
+{
+    batch_pool *pool = arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        size_t i = pool->next < pool->count ? pool->next++ : pool->count;
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (i >= pool->count)
+        {
+            break;
+        }
+        int ret = batch_compile(pool, &pool->jobs[i]);
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->jobs[i].ret  = ret;
+        pool->jobs[i].done = 1;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return NULL;
+}
+
+static int batch_task(void)
+{
+    int                  ret = 0;
+    ndt_navdatabase *navdata = NULL;
+    pthread_t       *threads = NULL;
+    int             nthreads = 0;
+    char            *content = NULL;
+    FILE            *outfile = NULL;
+    size_t            failed = 0;
+    batch_pool          pool = { 0 };
+
+    if (!(navdata = navdata_init()))
+    {
+        ret = EINVAL;
+        goto end;
+    }
+
+    if (fprintairac)
+    {
+        print_airac(navdata, stderr);
+    }
+
+    /*
+     * One route per line: <dep> <arr> <route>
+     */
+    if (!(content = ndt_file_slurp(path_batch, &ret)))
+    {
+        ret = ret ? ret : ENOMEM;
+        goto end;
+    }
+    char *buf = content, *line;
+    for (size_t lnum = 1; (line = strsep(&buf, "\n")); lnum++)
+    {
+        line += strspn(line, " \t\r");
+        if (*line == '\0' || *line == '#')
+        {
+            continue;
+        }
+        if (pool.count % 1024 == 0)
+        {
+            batch_job *jobs = realloc(pool.jobs, (pool.count + 1024) * sizeof(batch_job));
+            if (!jobs)
+            {
+                ret = ENOMEM;
+                goto end;
+            }
+            pool.jobs = jobs;
+        }
+        batch_job *job = memset(&pool.jobs[pool.count++], 0, sizeof(batch_job));
+        job->line = lnum;
+
+        if ((ret = request_parse(line, &job->req)))
+        {
+            goto end;
+        }
+    }
+
+    if (!batch_outdir)
+    {
+        if (path_out)
+        {
+            if (!(outfile = fopen(path_out, "w")))
+            {
+                ret = errno;
+                goto end;
+            }
+        }
+        else
+        {
+            outfile = stdout;
+        }
+    }
+
+    /*
+     * The navdata is read-only from here on, compile all routes in parallel.
+     */
+    pool.navdata = navdata;
+    pthread_mutex_init(&pool.mutex, NULL);
+    pthread_cond_init (&pool.cond,  NULL);
+    if (pool.count && !(threads = calloc(batch_threads, sizeof(pthread_t))))
+    {
+        ret = ENOMEM;
+        goto end;
+    }
+    while (nthreads < batch_threads && nthreads < pool.count)
+    {
+        if (pthread_create(&threads[nthreads], NULL, &batch_worker, &pool))
+        {
+            break;
+        }
+        nthreads++;
+    }
+    if (!nthreads)
+    {
+        batch_worker(&pool); // no threads, compile everything ourselves
+    }
+
+    for (size_t i = 0; i < pool.count; i++)
+    {
+        batch_job *job = &pool.jobs[i];
+
+        pthread_mutex_lock(&pool.mutex);
+        while (!job->done)
+        {
+            pthread_cond_wait(&pool.cond, &pool.mutex);
+        }
+        pthread_mutex_unlock(&pool.mutex);
+
+        if (job->ret)
+        {
+            failed++;
+        }
+        if (outfile)
+        {
+            fprintf(outfile, "=== %zu %s %s %s\n", job->line,
+                    job->req.dep_apt ? job->req.dep_apt : "-",
+                    job->req.arr_apt ? job->req.arr_apt : "-",
+                    job->ret ? strerror(job->ret) : "OK");
+            if (job->text)
+            {
+                fwrite(job->text, 1, job->textl, outfile);
+            }
+        }
+        else if (job->ret)
+        {
+            fprintf(stderr, "line %zu: failed to compile route (%s)\n", job->line, strerror(job->ret));
+        }
+        free(job->text);
+        job->text = NULL;
+    }
+    for (int i = 0; i < nthreads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    nthreads = 0;
+
+    fprintf(stderr, "%zu route(s) compiled, %zu failed\n", pool.count - failed, failed);
+    if (failed)
+    {
+        ret = EINVAL;
+    }
+
+end:
+    if (pool.navdata)
+    {
+        pthread_mutex_destroy(&pool.mutex);
+        pthread_cond_destroy (&pool.cond);
+    }
+    for (size_t i = 0; i < pool.count; i++)
+    {
+        request_free(&pool.jobs[i].req);
+        free(pool.jobs[i].text);
+    }
+    if (outfile && outfile != stdout)
+    {
+        fclose(outfile);
+    }
+    ndt_navdatabase_close(&navdata);
+    free(pool.jobs);
+    free(threads);
+    free(content);
+    return ret;
+}
+
+/*
+ * Compile a route, write it to sink in the given format; or, if the format
+ * is -1, only check it (the diagnostics are written to sink, even if invalid).
+ */
+static int request_execute(ndt_navdatabase *navdata, route_request *req, int fmt, ndt_sink *sink)
+{
+    ndt_flightplan *flp = NULL;
+    int             ret;
+
+    if (fmt == -1)
+    {
+        ret = route_compile(navdata, req, NDT_FLTPFMT_ICAOR, &route_check_print, sink, &flp);
+    }
+    else if (!(ret = route_compile(navdata, req, NDT_FLTPFMT_ICAOR, NULL, NULL, &flp)))
+    {
+        ret = ndt_flightplan_write2(flp, sink, fmt);
+    }
+    ndt_flightplan_close(&flp);
+    return ret;
+}
+
+/*
+ * Requests (--serve): one line each, with one of:
+ *
+ *     route <format> <dep> <arr> <ICAO route>  (--ofmt format, --batch syntax)
+ *     validate <dep> <arr> <ICAO route>         (same as --validate)
+ *     info <icao>                               (same as --info)
+ *     near <place>                              (same as --near, its options)
+ *     airac                                     (navdata cycle information)
+ *
+ * The output is written to sink; on failure, it's replaced by a description
+ * of the error (except for validate, where it describes the error already).
+ */
+static int serve_request(ndt_navdatabase *navdata, char *line, ndt_sink *sink)
+{
+    route_request   req = { 0 };
+    char          *args = line + strspn(line, " \t\r\n");
+    char          *verb = strsep(&args, " \t\r\n");
+    int        keepdata = 0;
+    int             ret = 0;
+    int             fmt;
+
+    args = args ? args + strspn(args, " \t\r\n") : "";
+    for (size_t len = strlen(args); len && strchr(" \t\r\n", args[len - 1]); len--)
+    {
+        args[len - 1] = '\0';
+    }
+    if (!verb || !*verb)
+    {
+        ret = EINVAL;
+        goto end;
+    }
+
+    if (!strcasecmp(verb, "route"))
+    {
+        char *name = strsep(&args, " \t");
+        if (!name || (fmt = output_format(name)) == -1)
+        {
+            ret = EINVAL;
+            goto end;
+        }
+        if (!(ret = request_parse(args ? args : "", &req)))
+        {
+            ret = request_execute(navdata, &req, fmt, sink);
+        }
+    }
+    else if (!strcasecmp(verb, "validate"))
+    {
+        if (!(ret = request_parse(args, &req)))
+        {
+            ret = request_execute(navdata, &req, -1, sink);
+        }
+        keepdata = 1;
+    }
+    else if (!strcasecmp(verb, "info") || !strcasecmp(verb, "near"))
+    {
+        for (size_t i = 0; args[i] != '\0'; i++)
+        {
+            args[i] = toupper(args[i]);
+        }
+        if (!*args)
+        {
+            ret = EINVAL;
+            goto end;
+        }
+        if (!strcasecmp(verb, "info"))
+        {
+            ret = ndt_fmt_icaor_print_airportnfo2(navdata, args, rwu, sink);
+        }
+        else
+        {
+            ret = nearest_print(navdata, args, format_out, sink);
+        }
+    }
+    else if (!strcasecmp(verb, "airac"))
+    {
+        ret = ndt_sink_printf(sink, "%s\n", navdata->info.desc);
+    }
+    else if (!strcasecmp(verb, "stats"))
+    {
+        ret = ndt_stats_print(sink);
+    }
+    else if (!strcasecmp(verb, "memory"))
+    {
+        ret = memusage_print(navdata, sink);
+    }
+    else
+    {
+        ret = ENOSYS;
+    }
+
+end:
+    if (ret && !keepdata)
+    {
+        ndt_sink_reset (sink);
+        ndt_sink_printf(sink, "%s\n", strerror(ret));
+    }
+    request_free(&req);
+    return ret;
+}
+
+#ifndef _WIN32
+#define SERVE_MAXREQ (1024 * 1024)
+
+typedef struct serve_pool
+{
+    ndt_navdatabase *navdata;
+    int                 sock;
+    int                 stop;
+    int                  err;       // accept failure (ends server mode)
+    pthread_mutex_t    mutex;
+} serve_pool;
+
+typedef struct serve_slot
+{
+    serve_pool *pool;
+    int           fd;               // worker's current client (-1: none)
+} serve_slot;
+
+static int serve_write(int fd, const char *buf, size_t len)
+{
+    while (len)
+    {
+        ssize_t ret = write(fd, buf, len);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return errno;
+        }
+        buf += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+/*
+ * Requests are handled in order, each one framed as "<length>\n" followed by
+ * length bytes (the request); responses likewise as "<status> <length>\n",
+ * followed by length bytes (output), where status is 0 on success, else an
+ * errno value. Protocol errors: we hang up.
+ */
+static void serve_client(ndt_navdatabase *navdata, int fd)
+{
+    ndt_sink    *sink = ndt_sink_init(NULL);
+    int           dfd = dup(fd);
+    FILE          *in = dfd < 0 ? NULL : fdopen(dfd, "r");
+    char        *line = NULL, *data = NULL;
+    size_t    linecap = 0, datacap = 0, size, len;
+    char      hdr[32], chr;
+
+    while (sink && in && getline(&line, &linecap, in) > 0)
+    {
+        if (sscanf(line, "%zu%c", &size, &chr) != 2 || (chr != '\n' && chr != '\r') || size > SERVE_MAXREQ)
+        {
+            break;
+        }
+        if (size + 1 > datacap)
+        {
+            char *tmp = realloc(data, size + 1);
+            if (!tmp)
+            {
+                break;
+            }
+            data    = tmp;
+            datacap = size + 1;
+        }
+        if (fread(data, 1, size, in) != size)
+        {
+            break;
+        }
+        data[size] = '\0';
+
+        ndt_sink_reset(sink);
+        int         status = serve_request(navdata, data, sink);
+        const char *output = ndt_sink_data(sink, &len);
+        snprintf(hdr, sizeof(hdr), "%d %zu\n", status, output ? len : 0);
+        if (serve_write(fd, hdr, strlen(hdr)) || (output && serve_write(fd, output, len)))
+        {
+            break;
+        }
+    }
+
+    if (in)
+    {
+        fclose(in);
+    }
+    else if (dfd >= 0)
+    {
+        close(dfd);
+    }
+    ndt_sink_close(&sink);
+    free(line);
+    free(data);
+}
+
+/*
+ * Fixed number of workers (--threads), each accepting and handling one client
+ * at a time; further clients wait in the socket's backlog until one is free.
+ */
+static void* serve_worker(void *arg)
+{
+    serve_slot *slot = arg;
+    serve_pool *pool = slot->pool;
+
+    for (;;)
+    {
+        int fd = accept(pool->sock, NULL, NULL), err = errno;
+
+        pthread_mutex_lock(&pool->mutex);
+        if (pool->stop)
+        {
+            pthread_mutex_unlock(&pool->mutex);
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            break;
+        }
+        if (fd < 0)
+        {
+            if (err == EINTR || err == ECONNABORTED)
+            {
+                pthread_mutex_unlock(&pool->mutex);
+                continue;
+            }
+            pool->err  = err;
+            pool->stop = 1;
+            pthread_mutex_unlock(&pool->mutex);
+            kill(getpid(), SIGTERM); // wake up the main thread
+            break;
+        }
+        slot->fd = fd;
+        pthread_mutex_unlock(&pool->mutex);
+
+        serve_client(pool->navdata, fd);
+
+        pthread_mutex_lock(&pool->mutex);
+        slot->fd = -1;
+        close(fd);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return NULL;
+}
+#endif
+
+/*
+ * Server mode: load navdata once, then handle requests from several concurrent
+ * clients over a local (Unix domain) socket; airports and their procedures stay
+ * in memory once used. Runs until interrupted (SIGINT, SIGTERM or SIGHUP).
+ */
+static int serve_task(void)
+{
+#ifndef _WIN32
+    struct sockaddr_un addr = { .sun_family = AF_UNIX, };
+    serve_pool          pool = { .sock = -1, };
+    serve_slot        *slots = NULL;
+    pthread_t       *threads = NULL;
+    int             nthreads = 0;
+    int                  ret = 0;
+    struct stat        stats;
+    sigset_t         signals;
+    int                  sig;
+
+    if (strlen(path_serve) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Bad socket path: '%s' (%s)\n", path_serve, strerror(ENAMETOOLONG));
+        ret = ENAMETOOLONG;
+        goto end;
+    }
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path_serve);
+
+    if (!(pool.navdata = navdata_init()))
+    {
+        ret = EINVAL;
+        goto end;
+    }
+    if (fprintairac)
+    {
+        print_airac(pool.navdata, stderr);
+    }
+
+    // a socket left over from a previous instance can be re-used
+    if (!stat(path_serve, &stats) && S_ISSOCK(stats.st_mode))
+    {
+        unlink(path_serve);
+    }
+    if ((pool.sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+        bind  (pool.sock, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(pool.sock, SOMAXCONN) < 0)
+    {
+        ret = errno;
+        fprintf(stderr, "Bad socket path: '%s' (%s)\n", path_serve, strerror(ret));
+        goto end;
+    }
+    signal(SIGPIPE, SIG_IGN); // clients hanging up mid-response
+
+    /*
+     * Workers inherit our signal mask: only the main thread handles these
+     * (with sigwait), then stops the workers before it releases navdata.
+     */
+    sigemptyset(&signals);
+    sigaddset  (&signals, SIGINT);
+    sigaddset  (&signals, SIGTERM);
+    sigaddset  (&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    if (pthread_mutex_init(&pool.mutex, NULL))
+    {
+        ret = ENOMEM;
+        goto end;
+    }
+    if (!(slots   = calloc(batch_threads, sizeof(serve_slot))) ||
+        !(threads = calloc(batch_threads, sizeof(pthread_t))))
+    {
+        ret = ENOMEM;
+        goto stop;
+    }
+    while (nthreads < batch_threads)
+    {
+        slots[nthreads].pool = &pool;
+        slots[nthreads].fd   = -1;
+        if (pthread_create(&threads[nthreads], NULL, &serve_worker, &slots[nthreads]))
+        {
+            break;
+        }
+        nthreads++;
+    }
+    if (!nthreads)
+    {
+        ret = EAGAIN;
+        goto stop;
+    }
+    fprintf(stderr, "Listening on %s (%d clients at once)\n", path_serve, nthreads);
+    sigwait(&signals, &sig);
+
+stop:
+    pthread_mutex_lock(&pool.mutex);
+    pool.stop = 1;
+    for (int i = 0; i < nthreads; i++)
+    {
+        if (slots[i].fd >= 0)
+        {
+            shutdown(slots[i].fd, SHUT_RDWR); // client's worker will hang up
+        }
+    }
+    pthread_mutex_unlock(&pool.mutex);
+    for (int i = 0; i < nthreads; i++)
+    {
+        // workers waiting for a client: give each of them one
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0)
+        {
+            connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+            close  (fd);
+        }
+    }
+    for (int i = 0; i < nthreads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool.mutex);
+    ret = ret ? ret : pool.err;
+
+end:
+    if (pool.sock >= 0)
+    {
+        close (pool.sock);
+        unlink(path_serve);
+    }
+    ndt_navdatabase_close(&pool.navdata);
+    free(threads);
+    free(slots);
+    return ret;
+#else
+    fprintf(stderr, "Server mode is not supported on this platform\n");
+    return ENOTSUP;
+#endif
+}
+
+/*
+ * Requests (--pipe): one line each, either the same as for --serve, or w/the
+ * same options as on the command line (each value runs up to the next one):
+ *
+ *     --dep LSGG/05/MOLU5A --rte MOLUS N871 BERSU --arr LSZH --ofmt recap
+ *
+ * Supported: --dep, --drwy, --sid, --sidtr, --arr, --arwy, --star, --startr,
+ * --final, --apptr, --rte, --ofmt and --validate.
+ */
+static int pipe_request(ndt_navdatabase *navdata, char *line, ndt_sink *sink)
+{
+    route_request req = { 0 };
+    int           fmt = format_out == -1 ? NDT_FLTPFMT_XPFMS : format_out;
+    int         check = 0;
+    int           ret = 0;
+    char    *name, *value, *next = line + strspn(line, " \t\r\n");
+
+    if (strncmp(next, "--", 2))
+    {
+        return serve_request(navdata, line, sink);
+    }
+    while (next && *next)
+    {
+        name  = next + 2;
+        value = name + strcspn(name, " \t\r\n=");
+        next  = strstr(value, " --");
+        if (next)
+        {
+            *next++ = '\0';
+        }
+        if (*value)
+        {
+            *value++ = '\0';
+        }
+        value += strspn(value, " \t\r\n");
+        for (size_t len = strlen(value); len && strchr(" \t\r\n", value[len - 1]); len--)
+        {
+            value[len - 1] = '\0';
+        }
+        if (!strcmp(name, "ofmt"))
+        {
+            if ((fmt = output_format(value)) == -1)
+            {
+                ret = EINVAL;
+                goto end;
+            }
+            continue;
+        }
+        if (!strcmp(name, "validate"))
+        {
+            check = 1;
+            continue;
+        }
+        for (size_t i = 0; value[i] != '\0'; i++)
+        {
+            value[i] = toupper(value[i]);
+        }
+        if (!strcmp(name, "rte"))
+        {
+            free(req.route);
+            if (!(req.route = strdup(value)))
+            {
+                ret = ENOMEM;
+                goto end;
             }
+            continue;
+        }
+
+        /* Same as parse_options(), including the shorthand (e.g. "LSGG/05"). */
+        char **fields[6] = { NULL, NULL, NULL, NULL, NULL, NULL, };
+        if (!strcmp(name, "dep"))
+        {
+            fields[0] = &req.dep_apt; fields[1] = &req.dep_rwy; fields[2] = &req.sid_name; fields[3] = &req.sid_trans;
+        }
+        else if (!strcmp(name, "drwy") || !strcmp(name, "dep-rwy"))
+        {
+            fields[0] = &req.dep_rwy; fields[1] = &req.sid_name; fields[2] = &req.sid_trans;
+        }
+        else if (!strcmp(name, "sid"))
+        {
+            fields[0] = &req.sid_name; fields[1] = &req.sid_trans;
+        }
+        else if (!strcmp(name, "sidtr"))
+        {
+            fields[0] = &req.sid_trans;
+        }
+        else if (!strcmp(name, "arr"))
+        {
+            fields[0] = &req.arr_apt; fields[1] = &req.arr_rwy; fields[2] = &req.final_appr; fields[3] = &req.appr_trans; fields[4] = &req.star_name; fields[5] = &req.star_trans;
+        }
+        else if (!strcmp(name, "arwy") || !strcmp(name, "arr-rwy"))
+        {
+            fields[0] = &req.arr_rwy; fields[1] = &req.final_appr; fields[2] = &req.appr_trans; fields[3] = &req.star_name; fields[4] = &req.star_trans;
+        }
+        else if (!strcmp(name, "star"))
+        {
+            fields[0] = &req.star_name; fields[1] = &req.star_trans;
+        }
+        else if (!strcmp(name, "startr"))
+        {
+            fields[0] = &req.star_trans;
         }
-        else if ((ret = ndt_flightplan_set_arrivstar(fltplan, star_name, star_trans)))
+        else if (!strcmp(name, "apptr"))
         {
-            goto end;
+            fields[0] = &req.appr_trans;
         }
-    }
-    if (fltplan->arr.rwy && appr_trans && !strcasecmp(appr_trans, "auto"))
-    {
-        ndt_route_leg *leg = ndt_list_item(fltplan->legs, -1);
-        ndt_waypoint  *src = leg ? leg->dst : NULL;
-        free(appr_trans); appr_trans = NULL; // reset
-        if (src)
+        else if (!strcmp(name, "final"))
         {
-            ndt_procedure *final = ndt_procedure_get(fltplan->arr.rwy->approaches, final_appr, NULL);
-            if (final)
-            {
-                for (size_t i = 0; i < ndt_list_count(final->transition.approach); i++)
-                {
-                    ndt_procedure *apptr = ndt_list_item(final->transition.approach, i);
-                    if (apptr)
-                    {
-                        ndt_route_leg *leg = ndt_list_item(apptr->proclegs, 0);
-                        if (leg)
-                        {
-                            if (leg->type == NDT_LEGTYPE_IF && leg->dst == src)
-                            {
-                                appr_trans = strdup(apptr->info.misc);
-                                break;
-                            }
-                            if (leg->src == src)
-                            {
-                                appr_trans = strdup(apptr->info.misc);
-                                break;
-                            }
-                        }
-                        for (size_t j = i; j < ndt_list_count(apptr->proclegs); j++)
-                        {
-                            leg = ndt_list_item(apptr->proclegs, j);
-                            if (leg && leg->type == NDT_LEGTYPE_IF && leg->dst == src)
-                            {
-                                appr_trans = strdup(apptr->info.misc);
-                                break;
-                            }
-                        }
-                        if (appr_trans)
-                        {
-                            break;
-                        }
-                    }
-                }
-            }
+            fields[0] = &req.final_appr; fields[1] = &req.appr_trans;
         }
-        if (!appr_trans)
+        else
         {
-            fprintf(stderr, "warning: no valid approach transition found\n");
+            ret = EINVAL;
+            goto end;
         }
+        string_split4(value, "/.", fields);
     }
-    if ((final_appr && arr_rwy) &&
-        (ret = ndt_flightplan_set_arrivapch(fltplan, final_appr, appr_trans)))
+    ret = request_execute(navdata, &req, check ? -1 : fmt, sink);
+
+end:
+    if (ret && !check)
     {
-        goto end;
+        ndt_sink_reset (sink);
+        ndt_sink_printf(sink, "%s\n", strerror(ret));
     }
+    request_free(&req);
+    return ret;
+}
 
-    if (path_out)
+/*
+ * Pipe mode: load navdata once, then handle requests from stdin, one per line
+ * (in order); each response is written to stdout as "<status> <length>\n"
+ * followed by length bytes (same as --serve), and flushed immediately.
+ */
+static int pipe_task(void)
+{
+    ndt_navdatabase *navdata = NULL;
+    ndt_sink           *sink = NULL;
+    char               *line = NULL;
+    size_t           linecap = 0, len;
+    int                  ret = 0;
+
+    if (!(navdata = navdata_init()))
     {
-        outfile = fopen(path_out, "w");
-        if (!outfile)
-        {
-            ret = errno;
-            goto end;
-        }
+        ret = EINVAL;
+        goto end;
     }
-    else
+    if (fprintairac)
     {
-        outfile = stdout;
+        print_airac(navdata, stderr);
     }
-
-    if ((ret = ndt_flightplan_write(fltplan, outfile, format_out)))
+    if (!(sink = ndt_sink_init(NULL)))
     {
+        ret = ENOMEM;
         goto end;
     }
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY); // length prefix counts raw bytes
+#endif
 
-end:
-    if (flp_rte != icao_route)
-    {
-        free(flp_rte);
-    }
-    if (outfile && outfile != stdout)
+    while (getline(&line, &linecap, stdin) > 0)
     {
-        fclose(outfile);
+        if (line[strspn(line, " \t\r\n")] == '\0')
+        {
+            continue; // empty line: no request
+        }
+        ndt_sink_reset(sink);
+        int         status = pipe_request(navdata, line, sink);
+        const char *output = ndt_sink_data(sink, &len);
+        fprintf(stdout, "%d %zu\n", status, output ? len : 0);
+        if (output)
+        {
+            fwrite(output, 1, len, stdout);
+        }
+        if (fflush(stdout))
+        {
+            ret = errno;
+            break;
+        }
     }
+
+end:
     ndt_navdatabase_close(&navdata);
-    ndt_flightplan_close (&fltplan);
+    ndt_sink_close(&sink);
+    free(line);
     return ret;
 }
 
@@ -838,6 +2774,115 @@ static int parse_options(int argc, char **argv)
                 qpac_aptids = strdup(optarg);
                 break;
 
+            case OPT_SBOX:
+                {
+                    double lat[2], lon[2];
+                    char   chr;
+                    if (sscanf(optarg, "%lf,%lf,%lf,%lf%c", &lat[0], &lon[0], &lat[1], &lon[1], &chr) != 4 ||
+                        fabs(lat[0]) > 90. || fabs(lat[1]) > 90. || fabs(lon[0]) > 180. || fabs(lon[1]) > 180.)
+                    {
+                        fprintf(stderr, "Invalid bounding box: '%s'\n", optarg);
+                        return EINVAL;
+                    }
+                    // southwest, northeast corners (west > east: crosses antimeridian)
+                    navdata_scope.bbox   = 1;
+                    navdata_scope.latmin = fmin(lat[0], lat[1]);
+                    navdata_scope.latmax = fmax(lat[0], lat[1]);
+                    navdata_scope.lonmin = lon[0];
+                    navdata_scope.lonmax = lon[1];
+                }
+                break;
+
+            case OPT_SREG:
+                free(navdata_scope.regions);
+                navdata_scope.regions = strdup(optarg);
+                break;
+
+            case OPT_NEAR:
+                free(near_place);
+                near_place = strdup(optarg);
+                break;
+
+            case OPT_NTYP:
+                {
+                    char *dup = strdup(optarg), *buf = dup, *elem;
+                    if  (!dup)
+                    {
+                        return ENOMEM;
+                    }
+                    near_tps = 0;
+                    while ((elem = strsep(&buf, ",/")))
+                    {
+                        if (!strcasecmp(elem, "apt") || !strcasecmp(elem, "airport"))
+                        {
+                            near_tps |= NDT_SPATIAL_TYPE(NDT_WPTYPE_APT)|NDT_SPATIAL_TYPE(NDT_WPTYPE_XPA);
+                            continue;
+                        }
+                        if (!strcasecmp(elem, "navaid"))
+                        {
+                            near_tps |= NDT_SPATIAL_TYPE(NDT_WPTYPE_DME)|NDT_SPATIAL_TYPE(NDT_WPTYPE_LOC);
+                            near_tps |= NDT_SPATIAL_TYPE(NDT_WPTYPE_NDB)|NDT_SPATIAL_TYPE(NDT_WPTYPE_VOR);
+                            continue;
+                        }
+                        if (!strcasecmp(elem, "vor"))
+                        {
+                            near_tps |= NDT_SPATIAL_TYPE(NDT_WPTYPE_VOR);
+                            continue;
+                        }
+                        if (!strcasecmp(elem, "ndb"))
+                        {
+                            near_tps |= NDT_SPATIAL_TYPE(NDT_WPTYPE_NDB);
+                            continue;
+                        }
+                        if (!strcasecmp(elem, "dme"))
+                        {
+                            near_tps |= NDT_SPATIAL_TYPE(NDT_WPTYPE_DME);
+                            continue;
+                        }
+                        if (!strcasecmp(elem, "loc"))
+                        {
+                            near_tps |= NDT_SPATIAL_TYPE(NDT_WPTYPE_LOC);
+                            continue;
+                        }
+                        if (!strcasecmp(elem, "fix"))
+                        {
+                            near_tps |= NDT_SPATIAL_TYPE(NDT_WPTYPE_FIX);
+                            continue;
+                        }
+                        if (!strcasecmp(elem, "rwy"))
+                        {
+                            near_tps |= NDT_SPATIAL_TYPE(NDT_WPTYPE_RWY);
+                            continue;
+                        }
+                        if (!strcasecmp(elem, "all"))
+                        {
+                            near_tps |= NDT_SPATIAL_ALL;
+                            continue;
+                        }
+                        fprintf(stderr, "Unsupported waypoint type: '%s'\n", elem);
+                        free(dup);
+                        return EINVAL;
+                    }
+                    free(dup);
+                }
+                break;
+
+            case OPT_NCNT:
+                near_count = atoi(optarg);
+                break;
+
+            case OPT_NRNG:
+                near_range = atof(optarg);
+                break;
+
+            case OPT_NRWY:
+                near_rwylen = atoi(optarg);
+                break;
+
+            case OPT_NFRQ:
+                near_freq = atof(optarg);
+                break;
+
             case OPT_INPT:
                 free(path_in);
                 free(icao_route);
@@ -873,64 +2918,74 @@ static int parse_options(int argc, char **argv)
                 break;
 
             case OPT_OFMT:
-                if (!strcasecmp(optarg, "airbusx"))
-                {
-                    format_out = NDT_FLTPFMT_AIBXT;
-                    break;
-                }
-                if (!strcasecmp(optarg, "civa"))
-                {
-                    format_out = NDT_FLTPFMT_XPCVA;
-                    break;
-                }
-                if (!strcasecmp(optarg, "decoded") ||
-                    !strcasecmp(optarg, "skyvector")) // legacy name for flat, decoded route
-                {
-                    format_out = NDT_FLTPFMT_DCDED;
-                    break;
-                }
-                if (!strcasecmp(optarg, "test"))
-                {
-                    format_out = NDT_FLTPFMT_DTEST; // purposefully undocumented
-                    break;
-                }
-                if (!strcasecmp(optarg, "helper"))
-                {
-                    format_out = NDT_FLTPFMT_XPHLP;
-                    break;
-                }
-                if (!strcasecmp(optarg, "icao"))
-                {
-                    format_out = NDT_FLTPFMT_ICAOR;
-                    break;
-                }
-                if (!strcasecmp(optarg, "ixeg"))
-                {
-                    format_out = NDT_FLTPFMT_ICAOX;
-                    break;
-                }
-                if (!strcasecmp(optarg, "mcdu"))
-                {
-                    format_out = NDT_FLTPFMT_XPCDU;
-                    break;
-                }
-                if (!strcasecmp(optarg, "recap"))
-                {
-                    format_out = NDT_FLTPFMT_IRECP;
-                    break;
-                }
-                if (!strcasecmp(optarg, "simbrief"))
                 {
-                    format_out = NDT_FLTPFMT_SBRIF;
-                    break;
+                    /*
+                     * Repeatable, with an optional destination for each format
+                     * (e.g. --ofmt xplane=plan.fms --ofmt recap=plan.txt); the
+                     * last format without a destination goes to --output.
+                     */
+                    int   i, fmt;
+                    char *dest = strchr(optarg, '=');
+                    if (dest)
+                    {
+                        *dest++ = '\0';
+                    }
+                    if ((fmt = output_format(optarg)) == -1)
+                    {
+                        fprintf(stderr, "Unsupported output format: '%s'\n", optarg);
+                        return EINVAL;
+                    }
+                    for (i = 0; i < outputs_count && (dest || outputs[i].path); i++)
+                    {
+                        continue;
+                    }
+                    if (i == sizeof(outputs) / sizeof(outputs[0]))
+                    {
+                        fprintf(stderr, "Too many output formats\n");
+                        return EINVAL;
+                    }
+                    if (!dest)
+                    {
+                        format_out = fmt;
+                    }
+                    outputs[i].format = fmt;
+                    outputs[i].path   = dest;
+                    outputs_count     = i == outputs_count ? i + 1 : outputs_count;
                 }
-                if (!strcasecmp(optarg, "xplane"))
+                break;
+
+            case OPT_USRW:
                 {
-                    format_out = NDT_FLTPFMT_XPFMS;
-                    break;
+                    /*
+                     * Repeatable: IDNT=LAT,LON (e.g. --user-wpt MYFIX=46.2,6.1);
+                     * added to each flight plan, so routes can refer to IDNT.
+                     */
+                    double lat, lon;
+                    char   chr, *pos = strchr(optarg, '=');
+                    if (!pos || pos == optarg || sscanf(pos + 1, "%lf,%lf%c", &lat, &lon, &chr) != 2 ||
+                        fabs(lat) > 90. || fabs(lon) > 180.)
+                    {
+                        fprintf(stderr, "Invalid user waypoint: '%s'\n", optarg);
+                        return EINVAL;
+                    }
+                    if (user_wpts_count == sizeof(user_wpts) / sizeof(user_wpts[0]))
+                    {
+                        fprintf(stderr, "Too many user waypoints\n");
+                        return EINVAL;
+                    }
+                    if (!(user_wpts[user_wpts_count].idnt = strndup(optarg, pos - optarg)))
+                    {
+                        return ENOMEM;
+                    }
+                    for (size_t i = 0; user_wpts[user_wpts_count].idnt[i] != '\0'; i++)
+                    {
+                        user_wpts[user_wpts_count].idnt[i] = toupper(user_wpts[user_wpts_count].idnt[i]);
+                    }
+                    user_wpts[user_wpts_count].lat = lat;
+                    user_wpts[user_wpts_count].lon = lon;
+                    user_wpts_count++;
                 }
-                fprintf(stderr, "Unsupported output format: '%s'\n", optarg);
-                return EINVAL;
+                break;
 
             /*
              * NOTE: undocumented feature.
@@ -1021,6 +3076,24 @@ static int parse_options(int argc, char **argv)
                 icao_route = strdup(optarg);
                 break;
 
+            case OPT_BTCH:
+                free(path_batch);
+                path_batch = strdup(optarg);
+                break;
+
+            case OPT_THRD:
+                batch_threads = atoi(optarg);
+                break;
+
+            case OPT_VALD:
+                route_check = 1;
+                break;
+
+            case OPT_SERV:
+                free(path_serve);
+                path_serve = strdup(optarg);
+                break;
+
             default:
                 return opt;
         }
@@ -1044,6 +3117,20 @@ static int validate_options(void)
             info_aptidt[i] = toupper(info_aptidt[i]);
         }
     }
+    if (navdata_scope.regions)
+    {
+        for (size_t i = 0; navdata_scope.regions[i] != '\0'; i++)
+        {
+            navdata_scope.regions[i] = toupper(navdata_scope.regions[i]);
+        }
+    }
+    if (near_place)
+    {
+        for (size_t i = 0; near_place[i] != '\0'; i++)
+        {
+            near_place[i] = toupper(near_place[i]);
+        }
+    }
     if (qpac_aptids)
     {
         for (size_t i = 0; qpac_aptids[i] != '\0'; i++)
@@ -1216,6 +3303,16 @@ static int validate_options(void)
         goto end;
     }
 
+    if (outputs_count > 1 || (outputs_count && outputs[0].path))
+    {
+        if (qpac_aptids || info_aptidt || near_place || path_batch || route_check)
+        {
+            fprintf(stderr, "Multiple output formats require a single flight plan\n");
+            ret = EINVAL;
+            goto end;
+        }
+    }
+
     if (qpac_aptids)
     {
         if (!path_out)
@@ -1254,26 +3351,78 @@ static int validate_options(void)
             fprintf(stderr, "Bad output directory: '%s' (%s)\n", path_out, error);
             goto end;
         }
-        free(arr_apt); arr_apt = strdup(qpac_aptids);
-        free(dep_apt); dep_apt = strsep(&arr_apt, "/\\-.");
-        if (!dep_apt || !strlen(dep_apt))
+        if (batch_threads <= 0)
+        {
+#ifdef _SC_NPROCESSORS_ONLN
+            batch_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+            batch_threads = batch_threads > 0 ? batch_threads : 1;
+        }
+        goto end; // no other data needed
+    }
+    if (info_aptidt)
+    {
+        goto end; // no other data needed
+    }
+    if (pipe_mode || print_usage)
+    {
+        goto end; // no other data needed
+    }
+    if (path_serve || check_procs)
+    {
+        if (batch_threads <= 0)
+        {
+#ifdef _SC_NPROCESSORS_ONLN
+            batch_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+            batch_threads = batch_threads > 0 ? batch_threads : 1;
+        }
+        goto end; // no other data needed
+    }
+    if (near_place)
+    {
+        if (near_count <= 0 && near_range <= 0.)
         {
-            fprintf(stderr, "Failed to split \"%s\"\n", qpac_aptids);
+            fprintf(stderr, "No count or range provided for nearby query\n");
             ret = EINVAL;
             goto end;
         }
-        if (!arr_apt && !(arr_apt = strdup(dep_apt)))
+        if (!near_tps)
         {
-            ret = ENOMEM;
+            fprintf(stderr, "No waypoint type provided for nearby query\n");
+            ret = EINVAL;
             goto end;
         }
         goto end; // no other data needed
     }
-    if (info_aptidt)
+    if (path_batch)
     {
-        goto end; // no other data needed
+        if (access(path_batch, R_OK))
+        {
+            strerror_r((ret = errno), error, sizeof(error));
+            fprintf(stderr, "Bad batch file: '%s' (%s)\n", path_batch, error);
+            goto end;
+        }
+        if (batch_threads <= 0)
+        {
+#ifdef _SC_NPROCESSORS_ONLN
+            batch_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+            batch_threads = batch_threads > 0 ? batch_threads : 1;
+        }
+        // output to a directory: one file per route
+        if (path_out && !stat(path_out, &stats) && S_ISDIR(stats.st_mode))
+        {
+            if (access(path_out, W_OK))
+            {
+                strerror_r((ret = errno), error, sizeof(error));
+                fprintf(stderr, "Bad output directory: '%s' (%s)\n", path_out, error);
+                goto end;
+            }
+            batch_outdir = 1;
+        }
     }
-    if (!path_in && !icao_route && !dep_apt && !arr_apt)
+    else if (!path_in && !icao_route && !dep_apt && !arr_apt)
     {
         fprintf(stderr, "No input file or route provided\n");
         ret = EINVAL;
@@ -1285,7 +3434,7 @@ static int validate_options(void)
         fprintf(stderr, "Bad input file: '%s' (%s)\n", path_in, error);
         goto end;
     }
-    if (path_out && strnlen(path_out, 1))
+    if (path_out && strnlen(path_out, 1) && !batch_outdir)
     {
         char  *dir, *sep;
         size_t dirlen;
@@ -1317,7 +3466,7 @@ static int validate_options(void)
             }
         }
     }
-    else
+    else if (!batch_outdir)
     {
         free(path_out);
         path_out = NULL;
@@ -1332,6 +3481,12 @@ static int validate_options(void)
     {
         format_out = NDT_FLTPFMT_XPFMS;
     }
+    if (route_check && format_in != NDT_FLTPFMT_ICAOR)
+    {
+        fprintf(stderr, "Route validation requires an ICAO route\n");
+        ret = EINVAL;
+        goto end;
+    }
 
 end:
     free(path);
@@ -1362,6 +3517,10 @@ static int print_help(void)
             "                        folder (in X-Plane 10.30 GNS430 format).   \n"
             "                        Required if the path to X-Plane is not set.\n"
             "  --airac               Print navadata description to stderr.      \n"
+            "  --stats               Print a profiling report to stderr on exit:\n"
+            "                        call count and time spent loading navdata, \n"
+            "                        procedures, parsing and writing routes,    \n"
+            "                        and peak memory usage (RSS).               \n"
             "                                                                   \n"
             "### Input and output    -------------------------------------------\n"
             "  -i           <string> Path to the file containing the route for  \n"
@@ -1402,6 +3561,10 @@ static int print_help(void)
             "                                        altitude constraints and   \n"
             "                                        fly-over waypoints         \n"
             "                        Default: xplane                            \n"
+            "                        May be repeated, as <format>=<path>, to get\n"
+            "                        the same route in several formats at once; \n"
+            "                        formats without a path are written to the  \n"
+            "                        --output file, or stdout (the last wins).  \n"
             "                                                                   \n"
             "  --info       <string> Print airport information to stdout for the\n"
             "                        specified ICAO identifier, including all   \n"
@@ -1416,6 +3579,44 @@ static int print_help(void)
             "                        to X-Plane's /Output/FMS plans/ folder by  \n"
             "                        default, unless a different output folder  \n"
             "                        is specified via option --o                \n"
+            "                        Several comma-separated pairs may be given \n"
+            "                        (e.g. LSGG/LSZH,LFPG/EGLL): all procedures \n"
+            "                        are written in parallel (see --threads).   \n"
+            "                                                                   \n"
+            "  --check-procs         Parse and open all procedures & transitions\n"
+            "                        of every airport (in parallel, see option  \n"
+            "                        --threads), e.g. to check a new AIRAC. One \n"
+            "                        line per airport w/procedures is written to\n"
+            "                        -o (default: stdout), with the time it took\n"
+            "                        and any procedure(s) that failed to open.  \n"
+            "  --memory              Load navdata, then print how much memory it\n"
+            "                        uses (per subsystem) to stdout.            \n"
+            "                                                                   \n"
+            "  --scope      <string> Only load navdata within a bounding box: SW\n"
+            "                        and NE corners (decimal degrees), e.g. for \n"
+            "                        the Alps: 44.0,5.0,48.5,16.5.              \n"
+            "  --regions    <string> Only load navdata for the specified (comma-\n"
+            "                        separated) ICAO region codes, e.g. LS,LF,ED\n"
+            "                        With either, airways with any waypoint in  \n"
+            "                        scope are kept whole, with all waypoints.  \n"
+            "                                                                   \n"
+            "### Nearby queries      -------------------------------------------\n"
+            "  --near       <string> List airports (or other waypoints) nearest \n"
+            "                        to a position: an airport, a waypoint, or  \n"
+            "                        coordinates (e.g. N46E006, 46.2,6.1). The  \n"
+            "                        list is written in the format set by --ofmt\n"
+            "                        (default: recap) to -o (default: stdout).  \n"
+            "  --near-type  <string> Comma-separated waypoint types to include: \n"
+            "                            apt vor ndb dme loc fix rwy navaid all \n"
+            "                        Default: apt                               \n"
+            "  --near-count <number> Maximum number of results. Default: 10. Set\n"
+            "                        to 0 to list everything within --near-range\n"
+            "  --near-range <number> Maximum distance (nm). Default: unlimited. \n"
+            "  --near-rwy   <number> Airports only: minimum length of longest   \n"
+            "                        runway (feet, or meters if --metric is set)\n"
+            "  --near-freq  <number> Navaids only: frequency (MHz, kHz for NDB).\n"
+            "  --near-tunable        Navaids only: within reception range of the\n"
+            "                        reference position.                        \n"
             "                                                                   \n"
             "### Flight planning     -------------------------------------------\n"
             "  --dep        <string> Set departure airport (4-letter ICAO code).\n"
@@ -1440,7 +3641,68 @@ static int print_help(void)
             "                                                                   \n"
             "  --rte        <string> Route in ICAO flight plan format. Should   \n"
             "                        include the departure and arrival airports,\n"
-            "                        if not set via the --dep and --arr options.\n");
+            "                        if not set via the --dep and --arr options.\n"
+            "  --user-wpt   <string> Define a user waypoint: IDNT=LAT,LON (e.g. \n"
+            "                        MYFIX=46.2,6.1), which routes can refer to \n"
+            "                        by name; it hides any navdata waypoint with\n"
+            "                        the same identifier. Can be repeated.      \n"
+            "  --validate            Only check the route: print one line per   \n"
+            "                        element (offset, element, what it resolved \n"
+            "                        to, or why it's invalid) to -o or stdout,  \n"
+            "                        instead of writing the flight plan.        \n"
+            "                                                                   \n"
+            "### Batch processing    -------------------------------------------\n"
+            "  --batch      <string> Compile many routes in one go: path to a   \n"
+            "                        file w/one route per line, in the format:  \n"
+            "                            <dep> <arr> <ICAO route>               \n"
+            "                        where <dep> and <arr> use the same syntax  \n"
+            "                        as --dep and --arr, e.g. LSGG/05/MOLU5A and\n"
+            "                        LFPG/27R/ILS27R/NONE/MOPA3W. Use - if the  \n"
+            "                        airport is part of the route. Empty lines, \n"
+            "                        lines starting with # are ignored. If -o is\n"
+            "                        a directory, each flight plan is written to\n"
+            "                        its own file in it (named after the line & \n"
+            "                        airports); else all of them are written to \n"
+            "                        -o (default: stdout), in input order, each \n"
+            "                        preceded by a line: === <line> <dep> <arr> \n"
+            "                        followed by OK or an error description.    \n"
+            "                        With --validate, the diagnostics are output\n"
+            "                        (instead of flight plans), failures too.   \n"
+            "  --threads    <number> Batch, QPAC, --check-procs, --serve only:  \n"
+            "                        number of routes (or procedures, airports) \n"
+            "                        compiled in parallel; with --serve, number \n"
+            "                        of clients handled at once (others wait    \n"
+            "                        until one hangs up). Default: one per      \n"
+            "                        processor.                                 \n"
+            "                                                                   \n"
+            "### Server mode         -------------------------------------------\n"
+            "  --serve      <string> Load navdata once, then handle requests on \n"
+            "                        a Unix domain socket (path), from several  \n"
+            "                        clients at once (see --threads), until it's\n"
+            "                        interrupted. Each request is sent as a     \n"
+            "                        line: <length>, then <length> bytes w/one  \n"
+            "                        of the following:                          \n"
+            "                            route <ofmt> <dep> <arr> <ICAO route>  \n"
+            "                            validate <dep> <arr> <ICAO route>      \n"
+            "                            info <icao>                            \n"
+            "                            near <place>                           \n"
+            "                            airac                                  \n"
+            "                            stats                                  \n"
+            "                            memory                                 \n"
+            "                        where <dep> and <arr> are as for --batch.  \n"
+            "                        Each response is sent as a line: <status>  \n"
+            "                        <length>, then <length> bytes of output; a \n"
+            "                        status other than 0 is an error code (the  \n"
+            "                        output then describes the error).          \n"
+            "  --pipe                Same as --serve, but requests are read from\n"
+            "                        standard input, one per line (no length),  \n"
+            "                        and responses written to standard output,  \n"
+            "                        in order. A request may also use the same  \n"
+            "                        options as the command line, e.g.:         \n"
+            "                            --dep <dep> --arr <arr> --rte <route>  \n"
+            "                        (also: --drwy, --sid, --sidtr, --arwy,     \n"
+            "                        --star, --startr, --final, --apptr, --ofmt \n"
+            "                        and --validate). Empty lines are ignored.  \n");
     return 0;
 }
 